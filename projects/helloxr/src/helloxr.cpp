@@ -113,6 +113,7 @@
 
 #include "actions.h"
 #include "paths.h"
+#include "hand_joints.h"
 
 namespace Diligent
 {
@@ -134,6 +135,9 @@ public:
 
 	virtual ~HelloXrApp()
 	{
+		// the simulation thread calls back into this class, so it has to stop before we're gone
+		StopSimulationThread();
+
 		if (m_pGraphicsBinding)
 		{
 			m_pGraphicsBinding->GetImmediateContext()->Flush();
@@ -148,6 +152,16 @@ public:
 		CreatePipelineState();
 		CreateVertexBuffer();
 		CreateIndexBuffer();
+		RegisterCube();
+
+		// image based lighting on the hands is nice to have but not worth dropping frames over
+		XRDE::QualityKnobDesc ibl;
+		ibl.name = "IBL";
+		ibl.priority = 50;
+		ibl.levelCount = 2;
+		ibl.cost = XRDE::QualityKnobCost::Gpu;
+		ibl.apply = [ this ]( int level ) { m_iblScale = level == 0 ? 1.f : 0.f; };
+		GetQualityGovernor().RegisterKnob( ibl );
 
 		return true;
 	}
@@ -158,14 +172,37 @@ public:
 	virtual bool PreSession() override;
 	virtual bool PostSession() override;
 	virtual std::vector<std::string> GetDesiredExtensions();
+	virtual std::vector<XRDE::GltfModelManifestEntry> GetGltfModelManifest() override;
 
 	void CreatePipelineState();
 	void CreateVertexBuffer();
 	void CreateIndexBuffer();
+	void RegisterCube();
+	void SubmitScene();
+	void AddBudgetPanel();
+	void UpdateBudgetPanel();
 
 	virtual bool RenderEye( int eye ) override;
+	virtual void RenderEyeGltf( int eye ) override;
 	virtual void UpdateEyeTransforms( float4x4 eyeToProj, float4x4 stageToEye, XrView& view ) override;
-	void UpdateHandPoses( XrHandTrackerEXT handTracker, GLTF::Model* model, XrTime displayTime );
+	virtual bool SupportsThreadedSimulation() override { return true; }
+	virtual void SimulateSnapshot( double currTime, double elapsedTime, XrTime displayTime, XRDE::FrameSnapshot& snapshot ) override;
+	virtual void ApplySnapshot( const XRDE::FrameSnapshot& snapshot ) override;
+
+	// The result of locating one hand for one frame
+	struct HandState
+	{
+		float4x4 handToWorld;
+		bool handValid = false;
+		float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ];
+		bool jointsValid = false;
+	};
+
+	void StepSimulation( double currTime, XrTime displayTime, float4x4* cubeToWorld, HandState hands[ 2 ], bool applyHandsToModels );
+	void LocateHand( int hand, XrTime displayTime, HandState* state );
+	bool LocateHandJoints( int hand, XrTime displayTime, float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ] );
+	void ApplyHandJoints( GLTF::Model* model, const float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ] );
+	GLTF::Model* HandModel( int hand ) { return hand == 0 ? m_leftHandModel.get() : m_rightHandModel.get(); }
 
 private:
 	RefCntAutoPtr<IPipelineState>		 m_pPSO;
@@ -174,10 +211,14 @@ private:
 	RefCntAutoPtr<IBuffer>				m_CubeIndexBuffer;
 	RefCntAutoPtr<IBuffer>				m_VSConstants;
 	float4x4							  m_CubeToWorld;
+	uint32_t							m_cubeMesh = XRDE::DrawList::k_invalidHandle;
+	uint32_t							m_cubeMaterial = XRDE::DrawList::k_invalidHandle;
 	float4x4							  m_ViewToProj;
-	float4x4							m_handCubeToWorld[ 2 ];
-	bool								m_handCubeToWorldValid[ 2 ] = { false, false };
+	HandState							m_hands[ 2 ];
 	bool								m_hideCube[ 2 ] = { false, false };
+	float								m_iblScale = 1.f;
+	uint32_t							m_budgetPanel = XRDE::CompositionLayerManager::k_invalidLayer;
+	int									m_budgetLevel = 0;
 
 	std::unique_ptr< XRDE::ActionSet > m_handActionSet;
 	XRDE::Action * m_handAction;
@@ -202,6 +243,17 @@ std::vector<std::string> HelloXrApp::GetDesiredExtensions()
 
 using namespace XRDE;
 
+static const char* k_leftHandModelPath = "models/valve_hand_models/left_hand.glb";
+static const char* k_rightHandModelPath = "models/valve_hand_models/right_hand.glb";
+
+std::vector<GltfModelManifestEntry> HelloXrApp::GetGltfModelManifest()
+{
+	GltfModelManifestEntry leftHand, rightHand;
+	leftHand.path = k_leftHandModelPath;
+	rightHand.path = k_rightHandModelPath;
+	return { leftHand, rightHand };
+}
+
 bool HelloXrApp::PreSession()
 {
 	XrPath leftHand = StringToPath( m_instance, k_userHandLeft );
@@ -245,56 +297,92 @@ bool HelloXrApp::PostSession()
 
 	SetPbrEnvironmentMap( "textures/papermill.ktx" );
 
-	m_leftHandModel = LoadGltfModel( "models/valve_hand_models/left_hand.glb" );
-	m_rightHandModel = LoadGltfModel( "models/valve_hand_models/right_hand.glb" );
+	m_leftHandModel = LoadGltfModel( k_leftHandModelPath );
+	m_rightHandModel = LoadGltfModel( k_rightHandModelPath );
+
+	AddBudgetPanel();
 
 	return true;
 }
 
+
+// green, yellow and red for CPU work under 75% of the display period, under all of it, and over it
+static const float k_budgetColors[ 3 ][ 4 ] =
+{
+	{ 0.1f, 0.6f, 0.1f, 1.f },
+	{ 0.7f, 0.6f, 0.1f, 1.f },
+	{ 0.7f, 0.1f, 0.1f, 1.f },
+};
+
+// A small panel just above the cube that shows how much of the frame budget the CPU uses. It's a quad layer, so
+// it's only rendered when its color changes and the compositor shows the last image in between.
+void HelloXrApp::AddBudgetPanel()
+{
+	CompositionLayerDesc desc;
+	desc.width = 64;
+	desc.height = 16;
+	desc.size = { 0.2f, 0.05f };
+	desc.pose.position = { 0, 0.6f, -0.5f };
+	desc.minUpdateInterval = 0.25;
+	desc.alphaBlend = false;
+	m_budgetPanel = GetCompositionLayers().AddLayer( desc,
+		[ this ]( IDeviceContext* context, ITextureView* target, uint32_t width, uint32_t height )
+		{
+			context->ClearRenderTarget( target, k_budgetColors[ m_budgetLevel ], RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+		} );
+}
+
+
+void HelloXrApp::UpdateBudgetPanel()
+{
+	const FrameStatistics& stats = GetFrameStatistics();
+	if ( m_budgetPanel == CompositionLayerManager::k_invalidLayer || stats.displayPeriodSeconds <= 0 )
+		return;
+
+	double used = stats.cpuWorkSeconds / stats.displayPeriodSeconds;
+	int level = used < 0.75 ? 0 : used < 1.0 ? 1 : 2;
+	if ( level != m_budgetLevel )
+	{
+		m_budgetLevel = level;
+		GetCompositionLayers().MarkDirty( m_budgetPanel );
+	}
+}
+
 void HelloXrApp::UpdateEyeTransforms( float4x4 eyeToProj, float4x4 stageToEye, XrView& view )
 {
 	// Map the buffer and write current world-view-projection matrix
 	MapHelper<float4x4> CBConstants( m_pGraphicsBinding->GetImmediateContext(), m_VSConstants, MAP_WRITE, MAP_FLAG_DISCARD );
-	*CBConstants = ( m_CubeToWorld * stageToEye * eyeToProj ).Transpose();
+	// the cube's own transform comes from the draw list's instance buffer
+	*CBConstants = ( stageToEye * eyeToProj ).Transpose();
 	m_ViewToProj = eyeToProj;
 };
 
 
 bool HelloXrApp::RenderEye( int eye )
 {
-	// Bind vertex and index buffers
-	Uint32   offset = 0;
-	IBuffer* pBuffs[] = { m_CubeVertexBuffer };
-	m_pGraphicsBinding->GetImmediateContext()->SetVertexBuffers( 0, 1, pBuffs, &offset, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET );
-	m_pGraphicsBinding->GetImmediateContext()->SetIndexBuffer( m_CubeIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-
-	// Set the pipeline state
-	m_pGraphicsBinding->GetImmediateContext()->SetPipelineState( m_pPSO );
-	// Commit shader resources. RESOURCE_STATE_TRANSITION_MODE_TRANSITION mode
-	// makes sure that resources are transitioned to required states.
-	m_pGraphicsBinding->GetImmediateContext()->CommitShaderResources( m_pSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-
-	DrawIndexedAttribs DrawAttrs;	 // This is an indexed draw call
-	DrawAttrs.IndexType = VT_UINT32; // Index type
-	DrawAttrs.NumIndices = 36;
-	// Verify the state of vertex and index buffers
-	DrawAttrs.Flags = DRAW_FLAG_VERIFY_ALL;
-	m_pGraphicsBinding->GetImmediateContext()->DrawIndexed( DrawAttrs );
+	// The render graph has already put the draw list's buffers in the right states, so it only verifies them
+	GetDrawList().Draw( m_pGraphicsBinding->GetImmediateContext() );
+	return true;
+}
 
+
+void HelloXrApp::RenderEyeGltf( int eye )
+{
 	m_gltfRenderer->Begin( m_pGraphicsBinding->GetRenderDevice(), m_pGraphicsBinding->GetImmediateContext(),
 		m_CacheUseInfo, m_CacheBindings, m_CameraAttribsCB, m_LightAttribsCB );
 
 	// draw the hands if they're available
 	for ( int cube = 0; cube < 2; cube++ )
 	{
-		if ( !m_handCubeToWorldValid[ cube ] )
+		if ( !m_hands[ cube ].handValid )
 			continue;
 
 		//if ( m_hideCube[ cube ] )
 		//	continue;
 
 		GLTF_PBR_Renderer::RenderInfo renderInfo;
-		renderInfo.ModelTransform = float4x4::Identity();// m_handCubeToWorld[ cube ];
+		renderInfo.ModelTransform = float4x4::Identity();// m_hands[ cube ].handToWorld;
+		renderInfo.IBLScale = m_iblScale;
 
 		if ( cube == 0 )
 		{
@@ -307,8 +395,6 @@ bool HelloXrApp::RenderEye( int eye )
 				nullptr, &m_CacheBindings );
 		}
 	}
-
-	return true;
 }
 
 
@@ -371,6 +457,7 @@ void HelloXrApp::CreatePipelineState()
 		CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
 		CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
 		m_pGraphicsBinding->GetRenderDevice()->CreateBuffer( CBDesc, nullptr, &m_VSConstants );
+		GetMemoryBudget().RegisterBuffer( m_VSConstants, XRDE::MemoryCategory::ConstantBuffers );
 	}
 
 	// Create a pixel shader
@@ -390,9 +477,12 @@ void HelloXrApp::CreatePipelineState()
 		// Attribute 0 - vertex position
 		LayoutElement{0, 0, 3, VT_FLOAT32, False},
 		// Attribute 1 - vertex color
-		LayoutElement{1, 0, 4, VT_FLOAT32, False}
+		LayoutElement{1, 0, 4, VT_FLOAT32, False},
+		// Attributes 2 to 5 - the instance's cube-to-world matrix, filled in below
+		LayoutElement{}, LayoutElement{}, LayoutElement{}, LayoutElement{},
 	};
 	// clang-format on
+	XRDE::DrawList::GetInstanceLayoutElements( 2, 1, &LayoutElems[ 2 ] );
 	PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems;
 	PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = _countof( LayoutElems );
 
@@ -464,6 +554,7 @@ void HelloXrApp::CreateVertexBuffer()
 	VBData.pData = CubeVerts;
 	VBData.DataSize = sizeof( CubeVerts );
 	m_pGraphicsBinding->GetRenderDevice()->CreateBuffer( VertBuffDesc, &VBData, &m_CubeVertexBuffer );
+	GetMemoryBudget().RegisterBuffer( m_CubeVertexBuffer, XRDE::MemoryCategory::AppBuffers );
 }
 
 void HelloXrApp::CreateIndexBuffer()
@@ -489,6 +580,25 @@ void HelloXrApp::CreateIndexBuffer()
 	IBData.pData = Indices;
 	IBData.DataSize = sizeof( Indices );
 	m_pGraphicsBinding->GetRenderDevice()->CreateBuffer( IndBuffDesc, &IBData, &m_CubeIndexBuffer );
+	GetMemoryBudget().RegisterBuffer( m_CubeIndexBuffer, XRDE::MemoryCategory::AppBuffers );
+}
+
+void HelloXrApp::RegisterCube()
+{
+	XRDE::DrawListMesh cube;
+	cube.vertexBuffers[ 0 ] = m_CubeVertexBuffer;
+	cube.indexBuffer = m_CubeIndexBuffer;
+	cube.indexCount = 36;
+	cube.boundsRadius = sqrtf( 3.f );
+	m_cubeMesh = GetDrawList().AddMesh( cube );
+	m_cubeMaterial = GetDrawList().AddMaterial( m_pPSO, m_pSRB );
+}
+
+
+void HelloXrApp::SubmitScene()
+{
+	GetDrawList().Clear();
+	GetDrawList().Submit( m_cubeMesh, m_cubeMaterial, m_CubeToWorld );
 }
 
 // Render a frame
@@ -506,31 +616,74 @@ void HelloXrApp::Render()
 	{
 		// Map the buffer and write current world-view-projection matrix
 		MapHelper<float4x4> CBConstants( m_pGraphicsBinding->GetImmediateContext(), m_VSConstants, MAP_WRITE, MAP_FLAG_DISCARD );
-		*CBConstants = ( m_CubeToWorld * stageToDesktopView * m_ViewToProj ).Transpose();
+		*CBConstants = ( stageToDesktopView * m_ViewToProj ).Transpose();
 	}
 
-	// Bind vertex and index buffers
-	Uint32   offset = 0;
-	IBuffer* pBuffs[] = { m_CubeVertexBuffer };
-	m_pGraphicsBinding->GetImmediateContext()->SetVertexBuffers( 0, 1, pBuffs, &offset, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET );
-	m_pGraphicsBinding->GetImmediateContext()->SetIndexBuffer( m_CubeIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-
-	// Set the pipeline state
-	m_pGraphicsBinding->GetImmediateContext()->SetPipelineState( m_pPSO );
-	// Commit shader resources. RESOURCE_STATE_TRANSITION_MODE_TRANSITION mode
-	// makes sure that resources are transitioned to required states.
-	m_pGraphicsBinding->GetImmediateContext()->CommitShaderResources( m_pSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-
-	DrawIndexedAttribs DrawAttrs;	 // This is an indexed draw call
-	DrawAttrs.IndexType = VT_UINT32; // Index type
-	DrawAttrs.NumIndices = 36;
-	// Verify the state of vertex and index buffers
-	DrawAttrs.Flags = DRAW_FLAG_VERIFY_ALL;
-	m_pGraphicsBinding->GetImmediateContext()->DrawIndexed( DrawAttrs );
+	// The mirror isn't part of the render graph, so let the draw list transition what it needs. It draws the
+	// instances the eyes were built with, which are gone in frames the headset didn't render.
+	if ( WasDrawListBuiltThisFrame() )
+	{
+		GetDrawList().Draw( m_pGraphicsBinding->GetImmediateContext(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	}
 }
 
 
 void HelloXrApp::Update( double CurrTime, double ElapsedTime, XrTime displayTime )
+{
+	StepSimulation( CurrTime, displayTime, &m_CubeToWorld, m_hands, true );
+	SubmitScene();
+	UpdateBudgetPanel();
+}
+
+
+void HelloXrApp::SimulateSnapshot( double currTime, double elapsedTime, XrTime displayTime, FrameSnapshot& snapshot )
+{
+	// Runs on the simulation thread, so nothing here may touch state the render thread reads
+	float4x4 cubeToWorld;
+	HandState hands[ 2 ];
+	StepSimulation( currTime, displayTime, &cubeToWorld, hands, false );
+
+	// transforms: cube, left hand, right hand
+	// visibility: left hand, right hand, left joints, right joints
+	// skinMatrices: the joint-to-parent matrices of the left hand followed by the right hand
+	snapshot.transforms.resize( 3 );
+	snapshot.visibility.resize( 4 );
+	snapshot.skinMatrices.resize( 2 * XR_HAND_JOINT_COUNT_EXT );
+	snapshot.transforms[ 0 ] = cubeToWorld;
+	for ( int hand = 0; hand < 2; hand++ )
+	{
+		snapshot.transforms[ 1 + hand ] = hands[ hand ].handToWorld;
+		snapshot.visibility[ hand ] = hands[ hand ].handValid;
+		snapshot.visibility[ 2 + hand ] = hands[ hand ].jointsValid;
+		std::copy( std::begin( hands[ hand ].jointsToParent ), std::end( hands[ hand ].jointsToParent ),
+			snapshot.skinMatrices.begin() + hand * XR_HAND_JOINT_COUNT_EXT );
+	}
+}
+
+
+void HelloXrApp::ApplySnapshot( const FrameSnapshot& snapshot )
+{
+	if ( snapshot.transforms.size() < 3 )
+		return;
+
+	m_CubeToWorld = snapshot.transforms[ 0 ];
+	SubmitScene();
+	UpdateBudgetPanel();
+	for ( int hand = 0; hand < 2; hand++ )
+	{
+		m_hands[ hand ].handToWorld = snapshot.transforms[ 1 + hand ];
+		m_hands[ hand ].handValid = snapshot.visibility[ hand ] != 0;
+		m_hands[ hand ].jointsValid = snapshot.visibility[ 2 + hand ] != 0;
+		if ( m_hands[ hand ].jointsValid )
+		{
+			ApplyHandJoints( HandModel( hand ), &snapshot.skinMatrices[ hand * XR_HAND_JOINT_COUNT_EXT ] );
+		}
+	}
+}
+
+
+void HelloXrApp::StepSimulation( double currTime, XrTime displayTime, float4x4* cubeToWorld, HandState hands[ 2 ], 
+	bool applyHandsToModels )
 {
 	// read input
 	XrActiveActionSet activeActionSets[] =
@@ -541,28 +694,24 @@ void HelloXrApp::Update( double CurrTime, double ElapsedTime, XrTime displayTime
 	XrActionsSyncInfo syncInfo = { XR_TYPE_ACTIONS_SYNC_INFO };
 	syncInfo.activeActionSets = activeActionSets;
 	syncInfo.countActiveActionSets = sizeof( activeActionSets ) / sizeof( activeActionSets[ 0 ] );
-	xrSyncActions( m_session, &syncInfo );
-
-	XrSpaceLocation spaceLocation = { XR_TYPE_SPACE_LOCATION };
-	if( XR_SUCCEEDED( m_handAction->LocateSpace( m_stageSpace, displayTime, Paths().userHandLeft, &spaceLocation ) ) 
-		&& ( spaceLocation.locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT ) != 0 )
-	{
-		m_handCubeToWorld[0] = matrixFromPose( spaceLocation.pose );
-		m_handCubeToWorldValid[ 0 ] = true;
-	}
-	else
-	{
-		m_handCubeToWorldValid[ 0 ] = false;
-	}
-	if ( XR_SUCCEEDED( m_handAction->LocateSpace( m_stageSpace, displayTime, Paths().userHandRight, &spaceLocation ) )
-		&& ( spaceLocation.locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT ) != 0 )
+	if ( !IsOffline() )
 	{
-		m_handCubeToWorld[ 1 ] = matrixFromPose( spaceLocation.pose );
-		m_handCubeToWorldValid[ 1 ] = true;
+		xrSyncActions( m_session, &syncInfo );
 	}
-	else
+
+	// The two hands don't share any state, so locate them and retarget their models in parallel
+	JobCounter handJobs;
+	for ( int hand = 0; hand < 2; hand++ )
 	{
-		m_handCubeToWorldValid[ 1 ] = false;
+		GetJobSystem().Run( hand == 0 ? "Left hand" : "Right hand", 
+			[ this, hand, hands, displayTime, applyHandsToModels ]
+			{
+				LocateHand( hand, displayTime, &hands[ hand ] );
+				if ( applyHandsToModels && hands[ hand ].jointsValid )
+				{
+					ApplyHandJoints( HandModel( hand ), hands[ hand ].jointsToParent );
+				}
+			}, &handJobs );
 	}
 
 	bool oldHideCube[ 2 ] = { m_hideCube[ 0 ], m_hideCube[ 1 ] };
@@ -586,50 +735,32 @@ void HelloXrApp::Update( double CurrTime, double ElapsedTime, XrTime displayTime
 	}
 
 	// Apply rotation
-	m_CubeToWorld = float4x4::Scale( 0.5f ) 
-		* float4x4::RotationY( static_cast<float>( CurrTime ) * 1.0f ) 
+	*cubeToWorld = float4x4::Scale( 0.5f ) 
+		* float4x4::RotationY( static_cast<float>( currTime ) * 1.0f ) 
 		* float4x4::RotationX( -PI_F * 0.1f );
 
-	UpdateHandPoses( m_handTrackers[ 0 ], m_leftHandModel.get(), displayTime );
-	UpdateHandPoses( m_handTrackers[ 1 ], m_rightHandModel.get(), displayTime );
+	GetJobSystem().Wait( handJobs );
 }
 
-XrHandJointEXT GetParentJoint( XrHandJointEXT joint )
+void HelloXrApp::LocateHand( int hand, XrTime displayTime, HandState* state )
 {
-	switch ( joint )
+	XrPath handPath = hand == 0 ? Paths().userHandLeft : Paths().userHandRight;
+	XrSpaceLocation spaceLocation = { XR_TYPE_SPACE_LOCATION };
+	if ( XR_SUCCEEDED( m_handAction->LocateSpace( m_stageSpace, displayTime, handPath, &spaceLocation ) )
+		&& ( spaceLocation.locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT ) != 0 )
 	{
-		case XR_HAND_JOINT_PALM_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_WRIST_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_THUMB_METACARPAL_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_THUMB_PROXIMAL_EXT: return XR_HAND_JOINT_THUMB_METACARPAL_EXT;
-		case XR_HAND_JOINT_THUMB_DISTAL_EXT: return XR_HAND_JOINT_THUMB_PROXIMAL_EXT;
-		case XR_HAND_JOINT_THUMB_TIP_EXT: return XR_HAND_JOINT_THUMB_DISTAL_EXT;
-		case XR_HAND_JOINT_INDEX_METACARPAL_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_INDEX_PROXIMAL_EXT: return XR_HAND_JOINT_INDEX_METACARPAL_EXT;
-		case XR_HAND_JOINT_INDEX_INTERMEDIATE_EXT: return XR_HAND_JOINT_INDEX_PROXIMAL_EXT;
-		case XR_HAND_JOINT_INDEX_DISTAL_EXT: return XR_HAND_JOINT_INDEX_INTERMEDIATE_EXT;
-		case XR_HAND_JOINT_INDEX_TIP_EXT: return XR_HAND_JOINT_INDEX_DISTAL_EXT;
-		case XR_HAND_JOINT_MIDDLE_METACARPAL_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_MIDDLE_PROXIMAL_EXT: return XR_HAND_JOINT_MIDDLE_METACARPAL_EXT;
-		case XR_HAND_JOINT_MIDDLE_INTERMEDIATE_EXT: return XR_HAND_JOINT_MIDDLE_PROXIMAL_EXT;
-		case XR_HAND_JOINT_MIDDLE_DISTAL_EXT: return XR_HAND_JOINT_MIDDLE_INTERMEDIATE_EXT;
-		case XR_HAND_JOINT_MIDDLE_TIP_EXT: return XR_HAND_JOINT_MIDDLE_DISTAL_EXT;
-		case XR_HAND_JOINT_RING_METACARPAL_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_RING_PROXIMAL_EXT: return XR_HAND_JOINT_RING_METACARPAL_EXT;
-		case XR_HAND_JOINT_RING_INTERMEDIATE_EXT: return XR_HAND_JOINT_RING_PROXIMAL_EXT;
-		case XR_HAND_JOINT_RING_DISTAL_EXT: return XR_HAND_JOINT_RING_INTERMEDIATE_EXT;
-		case XR_HAND_JOINT_RING_TIP_EXT: return XR_HAND_JOINT_RING_DISTAL_EXT;
-		case XR_HAND_JOINT_LITTLE_METACARPAL_EXT: return XR_HAND_JOINT_WRIST_EXT;
-		case XR_HAND_JOINT_LITTLE_PROXIMAL_EXT: return XR_HAND_JOINT_LITTLE_METACARPAL_EXT;
-		case XR_HAND_JOINT_LITTLE_INTERMEDIATE_EXT: return XR_HAND_JOINT_LITTLE_PROXIMAL_EXT;
-		case XR_HAND_JOINT_LITTLE_DISTAL_EXT: return XR_HAND_JOINT_LITTLE_INTERMEDIATE_EXT;
-		case XR_HAND_JOINT_LITTLE_TIP_EXT: return XR_HAND_JOINT_LITTLE_DISTAL_EXT;
-
-		default:
-			return XR_HAND_JOINT_MAX_ENUM_EXT;
+		state->handToWorld = matrixFromPose( spaceLocation.pose );
+		state->handValid = true;
 	}
+	else
+	{
+		state->handValid = false;
+	}
+
+	state->jointsValid = LocateHandJoints( hand, displayTime, state->jointsToParent );
 }
 
+
 uint32_t JointIndexFromHandJoint( XrHandJointEXT handJoint )
 {
 	if ( handJoint == XR_HAND_JOINT_PALM_EXT )
@@ -643,57 +774,29 @@ uint32_t JointIndexFromHandJoint( XrHandJointEXT handJoint )
 }
 
 
-void HelloXrApp::UpdateHandPoses( XrHandTrackerEXT handTracker, GLTF::Model* model, XrTime displayTime )
+bool HelloXrApp::LocateHandJoints( int hand, XrTime displayTime, float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ] )
 {
-	if ( !m_enableHandTrackers )
-		return;
-
-	XrHandJointsLocateInfoEXT locateInfo = { XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT };
-	locateInfo.time = displayTime;
-	locateInfo.baseSpace = m_stageSpace;
-
 	XrHandJointLocationEXT jointLocations[ XR_HAND_JOINT_COUNT_EXT ];
 	XrHandJointLocationsEXT locations = { XR_TYPE_HAND_JOINT_LOCATIONS_EXT };
 	locations.jointCount = XR_HAND_JOINT_COUNT_EXT;
 	locations.jointLocations = jointLocations;
-	XrResult res = m_xrLocateHandJointsEXT( handTracker, &locateInfo, &locations );
+	XrResult res = LocateHandJointLocations( hand, displayTime, &locations );
 	if ( XR_FAILED( res ) )
-		return;
+		return false;
 
 	if ( !locations.isActive )
-		return;
+		return false;
 
-	float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ];
-	float4x4 stageToJoint[ XR_HAND_JOINT_COUNT_EXT ];
-
-	// pre-load the wrist because the palm is out of order and earlier in the enum
-	jointsToParent[ XR_HAND_JOINT_WRIST_EXT ] = matrixFromPose( jointLocations[ XR_HAND_JOINT_WRIST_EXT ].pose );
-	stageToJoint[ XR_HAND_JOINT_WRIST_EXT ] = jointsToParent[ XR_HAND_JOINT_WRIST_EXT ].Inverse();
-	for ( uint32_t jointIndex = 0; jointIndex < XR_HAND_JOINT_COUNT_EXT; jointIndex++ )
-	{
-		if ( jointIndex == XR_HAND_JOINT_WRIST_EXT )
-			continue;
+	XRDE::JointsToParentFromLocations( jointLocations, jointsToParent );
 
-		float4x4 jointToStage = matrixFromPose( jointLocations[ jointIndex ].pose );
-		//float4x4 jointToStage = Diligent::float4x4::Translation( vectorFromXrVector( jointLocations[ jointIndex ].pose.position ) );
-		stageToJoint[ jointIndex ] = jointToStage.Inverse();
+	return true;
+}
 
-		XrHandJointEXT parentJoint = GetParentJoint( ( XrHandJointEXT)jointIndex );
-		if ( parentJoint == jointIndex )
-		{
-			// this joint has no parent, so its parent is the stage
-			jointsToParent[ jointIndex ] = jointToStage;
-		}
-		else
-		{
-			jointsToParent[ jointIndex ] = jointToStage * stageToJoint[ parentJoint ];
-		}
-	}
 
+void HelloXrApp::ApplyHandJoints( GLTF::Model* model, const float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ] )
+{
 	for ( auto& skin : model->Skins )
 	{
-		skin->Joints[ 0 ]->Translation = vectorFromXrVector( jointLocations[ 0 ].pose.position );
-		skin->Joints[ 0 ]->Rotation = quaternionFromXrQuaternion( jointLocations[ 0 ].pose.orientation);
 		for ( uint32_t handJoint = 0; handJoint < 26; handJoint++ )
 		{
 			//if ( handJoint > XR_HAND_JOINT_THUMB_TIP_EXT )
@@ -706,13 +809,9 @@ void HelloXrApp::UpdateHandPoses( XrHandTrackerEXT handTracker, GLTF::Model* mod
 			node->Rotation = Quaternion( 0, 0, 0, 1.f );
 			node->Translation = { 0, 0, 0 };
 			node->Scale = { 1.f, 1.f, 1.f };
+			GetSceneTransforms().MarkDirty( node );
 		}
 	}
-
-	for ( auto& root_node : model->Nodes )
-	{
-		root_node->UpdateTransforms();
-	}
 }
 
 std::unique_ptr<HelloXrApp> g_pTheApp;
@@ -0,0 +1,887 @@
+#include "xrappbase.h"
+#include "command_line.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef NOMINMAX
+#	define NOMINMAX
+#endif
+#include <Windows.h>
+
+#include <MapHelper.hpp>
+#include <GraphicsUtilities.h>
+#include <ShaderMacroHelper.hpp>
+
+using namespace Diligent;
+using namespace XRDE;
+
+// must match the array size in stress.psh, which gets it from the app
+static const uint32_t k_maxLights = 256;
+
+// has levels of detail, so the default sweep measures them
+static const char* k_defaultModelPath = "models/lod_sphere.glb";
+
+// records on every context -record-threads created
+static const uint32_t k_allRecordThreads = UINT32_MAX;
+
+// the pillars stand on a ring inside the shell of cubes, so most cubes behind one are hidden from the middle
+static const float k_pillarRingRadius = 2.5f;
+static const float k_pillarHalfWidth = 0.6f;
+static const float k_pillarHeight = 3.5f;
+
+// the default sphere's radius and how far its animation bobs it, which also covers hand sized models
+static const float k_animatedBoundsRadius = 0.1f;
+
+// A benchmark that renders procedurally generated scenes of N spinning cubes, M glTF model instances and K
+// point lights. Each combination of the values on the command line is one step of a sweep: the scene is
+// generated, rendered for a few warm up frames, then for a fixed number of measured frames. When the last
+// step is done, the CPU frame time, CPU submit time and GPU frame time percentiles of every step are printed,
+// and written as CSV if asked, and the app exits.
+class StressSceneApp : public XrAppBase
+{
+	typedef XrAppBase super;
+public:
+	virtual ~StressSceneApp()
+	{
+		if ( m_pGraphicsBinding )
+		{
+			m_pGraphicsBinding->GetImmediateContext()->Flush();
+		}
+	}
+
+	virtual std::string GetWindowName() override { return "Stress scene: " + super::GetWindowName(); }
+	virtual bool ProcessCommandLine( const std::string& cmdLine ) override;
+	virtual bool Initialize( HWND hWnd ) override;
+	virtual bool PostSession() override;
+	virtual std::vector<GltfModelManifestEntry> GetGltfModelManifest() override;
+
+	virtual void Render() override;
+	virtual void Update( double currTime, double elapsedTime, XrTime displayTime ) override;
+	virtual bool RenderEye( int eye ) override;
+	virtual void RenderEyeGltf( int eye ) override;
+	virtual void DeclareEyeResources( int eye, RenderGraphPassBuilder& pass ) override;
+	virtual void UpdateEyeTransforms( float4x4 eyeToProj, float4x4 stageToEye, XrView& view ) override;
+	virtual uint32_t GetEyeDrawChunkCount( int eye ) override;
+	virtual void PrepareEyeDrawChunks( int eye, IDeviceContext* immediateContext ) override;
+	virtual void RecordEyeDrawChunks( int eye, IDeviceContext* context, uint32_t firstChunk, uint32_t chunkCount ) override;
+
+private:
+	struct SweepStep
+	{
+		uint32_t cubes;
+		uint32_t models;
+		uint32_t lights;
+		uint32_t recordThreads;
+	};
+
+	struct StepResult
+	{
+		SweepStep step;
+		uint32_t recordThreads = 0;		// the contexts that really recorded, which -record-threads limits
+		uint32_t drawCount = 0;
+		uint64_t triangleCount = 0;		// per eye, in the glTF models after LOD selection
+		std::vector<uint64_t> levelTriangles;	// the part of triangleCount in level of detail chains, by level
+		uint32_t animatedCount = 0;
+		uint64_t sampledAnimations = 0;		// over the measured frames, which the far and unseen ones skip some of
+		std::vector<float> cpuFrame;
+		std::vector<float> cpuSubmit;
+		std::vector<float> gpuFrame;
+	};
+
+	struct Cube
+	{
+		float3 position;
+		float scale;
+		float3 axis;
+		float speed;
+		uint32_t material;
+	};
+
+	// matches the Lights constant buffer in stress.psh
+	struct Light
+	{
+		float4 posRadius;
+		float4 color;
+	};
+	struct LightConstants
+	{
+		Light lights[ k_maxLights ];
+		uint32_t count[ 4 ];
+	};
+
+	bool CreatePipelines();
+	void CreateCubeMesh();
+	void CreateMaterials();
+	void GeneratePillars();
+	void GenerateScene( const SweepStep& step );
+	void SubmitCubes( double currTime );
+	void FinishStep();
+	static float SampledPerFrame( const StepResult& result );
+	void PrintReport( std::ostream& out ) const;
+	bool WriteCsv( const std::string& path ) const;
+
+	// sweep settings
+	std::vector<uint32_t> m_cubeCounts = { 100, 1000, 10000 };
+	std::vector<uint32_t> m_modelCounts = { 0, 10 };
+	std::vector<uint32_t> m_lightCounts = { 1, 16 };
+	std::vector<uint32_t> m_recordThreadCounts = { k_allRecordThreads };
+	uint32_t m_materialCount = 16;
+	uint32_t m_pipelineCount = 2;
+	uint32_t m_pillarCount = 0;
+	uint32_t m_animatedCount = 10;
+	uint32_t m_warmupFrames = 60;
+	uint32_t m_measuredFrames = 300;
+	std::string m_modelPath = k_defaultModelPath;
+	std::string m_csvPath;
+
+	std::vector<SweepStep> m_steps;
+	uint32_t m_stepIndex = 0;
+	uint32_t m_stepFrame = 0;
+	uint64_t m_firstMeasuredGpuFrame = 0;
+	uint64_t m_lastGpuResultFrame = 0;
+	std::vector<StepResult> m_results;
+	bool m_finished = false;
+
+	// scene
+	std::vector< RefCntAutoPtr<IPipelineState> > m_pipelines;
+	std::vector< RefCntAutoPtr<IShaderResourceBinding> > m_bindings;
+	std::vector< RefCntAutoPtr<IBuffer> > m_materialConstants;
+	std::vector<uint32_t> m_materials;
+	RefCntAutoPtr<IBuffer> m_viewConstants;
+	RefCntAutoPtr<IBuffer> m_lightConstants;
+	RefCntAutoPtr<IBuffer> m_cubeVertices;
+	RefCntAutoPtr<IBuffer> m_cubeIndices;
+	uint32_t m_cubeMesh = DrawList::k_invalidHandle;
+	uint32_t m_cubeOccluder = OcclusionCuller::k_invalidHandle;
+	std::vector<float4x4> m_pillars;
+	bool m_chunkedDraws = false;	// the cubes are recorded on deferred contexts
+	std::vector<Cube> m_cubes;
+	std::vector<float4x4> m_modelTransforms;
+	std::vector<uint32_t> m_lodInstances;
+	std::unique_ptr<GLTF::Model> m_model;
+	// the first instances draw these instead, since an animation poses its own model's nodes
+	std::vector< std::unique_ptr<GLTF::Model> > m_animatedModels;
+	std::vector<uint32_t> m_animationInstances;
+};
+
+
+// "1,10,100" to { 1, 10, 100 }
+static bool GetCommandLineList( const std::string& cmdLine, const char* key, std::vector<uint32_t>* values )
+{
+	std::string list;
+	if ( !GetCommandLineValue( cmdLine, key, &list ) )
+		return false;
+
+	std::vector<uint32_t> parsed;
+	std::stringstream stream( list );
+	std::string value;
+	while ( std::getline( stream, value, ',' ) )
+	{
+		if ( !value.empty() )
+		{
+			parsed.push_back( (uint32_t)strtoul( value.c_str(), nullptr, 10 ) );
+		}
+	}
+	if ( parsed.empty() )
+		return false;
+
+	*values = parsed;
+	return true;
+}
+
+
+bool StressSceneApp::ProcessCommandLine( const std::string& cmdLine )
+{
+	if ( !super::ProcessCommandLine( cmdLine ) )
+		return false;
+
+	GetCommandLineList( cmdLine, "-stress-cubes ", &m_cubeCounts );
+	GetCommandLineList( cmdLine, "-stress-models ", &m_modelCounts );
+	GetCommandLineList( cmdLine, "-stress-lights ", &m_lightCounts );
+	GetCommandLineList( cmdLine, "-stress-record-threads ", &m_recordThreadCounts );
+	GetCommandLineValue( cmdLine, "-stress-model-path ", &m_modelPath );
+	GetCommandLineValue( cmdLine, "-stress-output ", &m_csvPath );
+
+	std::string value;
+	if ( GetCommandLineValue( cmdLine, "-stress-materials ", &value ) )
+	{
+		m_materialCount = std::max( 1ul, strtoul( value.c_str(), nullptr, 10 ) );
+	}
+	if ( GetCommandLineValue( cmdLine, "-stress-pipelines ", &value ) )
+	{
+		m_pipelineCount = std::max( 1ul, strtoul( value.c_str(), nullptr, 10 ) );
+	}
+	if ( GetCommandLineValue( cmdLine, "-stress-pillars ", &value ) )
+	{
+		m_pillarCount = strtoul( value.c_str(), nullptr, 10 );
+	}
+	if ( GetCommandLineValue( cmdLine, "-stress-animated ", &value ) )
+	{
+		m_animatedCount = strtoul( value.c_str(), nullptr, 10 );
+	}
+	if ( GetCommandLineValue( cmdLine, "-stress-warmup ", &value ) )
+	{
+		m_warmupFrames = strtoul( value.c_str(), nullptr, 10 );
+	}
+	if ( GetCommandLineValue( cmdLine, "-stress-frames ", &value ) )
+	{
+		m_measuredFrames = std::max( 1ul, strtoul( value.c_str(), nullptr, 10 ) );
+	}
+
+	for ( uint32_t recordThreads : m_recordThreadCounts )
+	{
+		for ( uint32_t lights : m_lightCounts )
+		{
+			for ( uint32_t models : m_modelCounts )
+			{
+				for ( uint32_t cubes : m_cubeCounts )
+				{
+					m_steps.push_back( { cubes, models, std::min( lights, k_maxLights ), recordThreads } );
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+bool StressSceneApp::Initialize( HWND hWnd )
+{
+	if ( !super::Initialize( hWnd ) )
+		return false;
+
+	CreateCubeMesh();
+	if ( !CreatePipelines() )
+		return false;
+
+	CreateMaterials();
+	GeneratePillars();
+
+	// with deferred contexts every step records the cubes in chunks, on the immediate context when a step asks
+	// for no threads, so the steps only differ in how many threads record
+	m_chunkedDraws = GetCommandRecorder().GetContextCount() > 0;
+	GetDrawList().SetDeferredRecording( m_chunkedDraws );
+
+	std::cerr << "Stress scene: " << m_steps.size() << " steps of " << m_warmupFrames << " warm up and "
+		<< m_measuredFrames << " measured frames\n";
+
+	// PostSession has already loaded the model by now
+	GenerateScene( m_steps[ 0 ] );
+	return true;
+}
+
+
+std::vector<GltfModelManifestEntry> StressSceneApp::GetGltfModelManifest()
+{
+	GltfModelManifestEntry model;
+	model.path = m_modelPath;
+	return std::vector<GltfModelManifestEntry>( m_animatedCount + 1, model );
+}
+
+
+bool StressSceneApp::PostSession()
+{
+	// every instance draws the same model, only the transform changes
+	m_model = LoadGltfModel( m_modelPath );
+	if ( !m_model )
+	{
+		std::cerr << "Unable to load " << m_modelPath << ", the sweep will run without models\n";
+	}
+	else if ( GetLodSelector().GetChainCount( m_model.get() ) == 0 )
+	{
+		std::cerr << m_modelPath << " has no levels of detail, every instance will be drawn at full detail\n";
+	}
+
+	if ( m_model && !m_model->Animations.empty() )
+	{
+		for ( uint32_t i = 0; i < m_animatedCount; i++ )
+		{
+			m_animatedModels.push_back( LoadGltfModel( m_modelPath ) );
+		}
+	}
+	return true;
+}
+
+
+bool StressSceneApp::CreatePipelines()
+{
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+
+	BufferDesc viewDesc;
+	viewDesc.Name = "Stress view constants";
+	viewDesc.uiSizeInBytes = sizeof( float4x4 );
+	// deferred contexts can't see what the immediate context maps, so it's updated instead
+	viewDesc.Usage = USAGE_DEFAULT;
+	viewDesc.BindFlags = BIND_UNIFORM_BUFFER;
+	device->CreateBuffer( viewDesc, nullptr, &m_viewConstants );
+	GetMemoryBudget().RegisterBuffer( m_viewConstants, MemoryCategory::ConstantBuffers );
+
+	BufferDesc lightDesc;
+	lightDesc.Name = "Stress light constants";
+	lightDesc.uiSizeInBytes = sizeof( LightConstants );
+	lightDesc.Usage = USAGE_DEFAULT;
+	lightDesc.BindFlags = BIND_UNIFORM_BUFFER;
+	device->CreateBuffer( lightDesc, nullptr, &m_lightConstants );
+	GetMemoryBudget().RegisterBuffer( m_lightConstants, MemoryCategory::ConstantBuffers );
+
+	RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
+	m_pGraphicsBinding->GetEngineFactory()->CreateDefaultShaderSourceStreamFactory( nullptr, &pShaderSourceFactory );
+
+	ShaderCreateInfo ShaderCI;
+	ShaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+	ShaderCI.UseCombinedTextureSamplers = true;
+	ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+	ShaderCI.EntryPoint = "main";
+
+	RefCntAutoPtr<IShader> pVS;
+	ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
+	ShaderCI.Desc.Name = "Stress VS";
+	ShaderCI.FilePath = "stress.vsh";
+	device->CreateShader( ShaderCI, &pVS );
+	if ( !pVS )
+		return false;
+
+	LayoutElement LayoutElems[] =
+	{
+		LayoutElement{ 0, 0, 3, VT_FLOAT32, False },
+		LayoutElement{ 1, 0, 3, VT_FLOAT32, False },
+		LayoutElement{}, LayoutElement{}, LayoutElement{}, LayoutElement{},
+	};
+	DrawList::GetInstanceLayoutElements( 2, 1, &LayoutElems[ 2 ] );
+
+	ShaderResourceVariableDesc variables[] =
+	{
+		{ SHADER_TYPE_PIXEL, "Material", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE },
+	};
+
+	// the pipelines only differ by the VARIANT macro, so material variety can be split between pipeline
+	// changes and binding changes
+	for ( uint32_t variant = 0; variant < m_pipelineCount; variant++ )
+	{
+		ShaderMacroHelper Macros;
+		Macros.AddShaderMacro( "MAX_LIGHTS", (int)k_maxLights );
+		Macros.AddShaderMacro( "VARIANT", (int)variant );
+
+		RefCntAutoPtr<IShader> pPS;
+		ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
+		ShaderCI.Desc.Name = "Stress PS";
+		ShaderCI.FilePath = "stress.psh";
+		ShaderCI.Macros = Macros;
+		device->CreateShader( ShaderCI, &pPS );
+		if ( !pPS )
+			return false;
+
+		GraphicsPipelineStateCreateInfo PSOCreateInfo;
+		PSOCreateInfo.PSODesc.Name = "Stress PSO";
+		PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
+		PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
+		PSOCreateInfo.GraphicsPipeline.RTVFormats[ 0 ] = m_pSwapChain->GetDesc().ColorBufferFormat;
+		PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
+		PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_BACK;
+		PSOCreateInfo.GraphicsPipeline.RasterizerDesc.FrontCounterClockwise = true;
+		PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = True;
+		PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems;
+		PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = _countof( LayoutElems );
+		PSOCreateInfo.pVS = pVS;
+		PSOCreateInfo.pPS = pPS;
+		PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+		PSOCreateInfo.PSODesc.ResourceLayout.Variables = variables;
+		PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof( variables );
+
+		RefCntAutoPtr<IPipelineState> pipeline;
+		device->CreateGraphicsPipelineState( PSOCreateInfo, &pipeline );
+		if ( !pipeline )
+			return false;
+
+		pipeline->GetStaticVariableByName( SHADER_TYPE_VERTEX, "Constants" )->Set( m_viewConstants );
+		pipeline->GetStaticVariableByName( SHADER_TYPE_PIXEL, "Lights" )->Set( m_lightConstants );
+		m_pipelines.push_back( pipeline );
+	}
+	return true;
+}
+
+
+void StressSceneApp::CreateCubeMesh()
+{
+	struct Vertex
+	{
+		float3 pos;
+		float3 normal;
+	};
+
+	// four vertices per face so every face gets its own normal
+	static const float3 k_normals[ 6 ] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	std::vector<Vertex> vertices;
+	std::vector<Uint32> indices;
+	for ( const float3& n : k_normals )
+	{
+		// two axes perpendicular to the normal, ordered so the face winds counter clockwise seen from outside
+		float3 u = float3( n.y, n.z, n.x );
+		float3 v = cross( n, u );
+		Uint32 first = (Uint32)vertices.size();
+		vertices.push_back( { n - u - v, n } );
+		vertices.push_back( { n + u - v, n } );
+		vertices.push_back( { n + u + v, n } );
+		vertices.push_back( { n - u + v, n } );
+		indices.insert( indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 } );
+	}
+
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+
+	BufferDesc VertBuffDesc;
+	VertBuffDesc.Name = "Stress cube vertices";
+	VertBuffDesc.Usage = USAGE_IMMUTABLE;
+	VertBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
+	VertBuffDesc.uiSizeInBytes = (Uint32)( vertices.size() * sizeof( Vertex ) );
+	BufferData VBData;
+	VBData.pData = vertices.data();
+	VBData.DataSize = VertBuffDesc.uiSizeInBytes;
+	device->CreateBuffer( VertBuffDesc, &VBData, &m_cubeVertices );
+	GetMemoryBudget().RegisterBuffer( m_cubeVertices, MemoryCategory::AppBuffers );
+
+	BufferDesc IndBuffDesc;
+	IndBuffDesc.Name = "Stress cube indices";
+	IndBuffDesc.Usage = USAGE_IMMUTABLE;
+	IndBuffDesc.BindFlags = BIND_INDEX_BUFFER;
+	IndBuffDesc.uiSizeInBytes = (Uint32)( indices.size() * sizeof( Uint32 ) );
+	BufferData IBData;
+	IBData.pData = indices.data();
+	IBData.DataSize = IndBuffDesc.uiSizeInBytes;
+	device->CreateBuffer( IndBuffDesc, &IBData, &m_cubeIndices );
+	GetMemoryBudget().RegisterBuffer( m_cubeIndices, MemoryCategory::AppBuffers );
+
+	DrawListMesh cube;
+	cube.vertexBuffers[ 0 ] = m_cubeVertices;
+	cube.indexBuffer = m_cubeIndices;
+	cube.indexCount = (uint32_t)indices.size();
+	cube.boundsRadius = sqrtf( 3.f );
+	m_cubeMesh = GetDrawList().AddMesh( cube );
+
+	// the pillars hide cubes with -occlusion-cull, and the occluder is exactly the mesh they're drawn with
+	std::vector<float3> positions;
+	for ( const Vertex& vertex : vertices )
+	{
+		positions.push_back( vertex.pos );
+	}
+	m_cubeOccluder = GetOcclusionCuller().AddOccluderMesh( positions.data(), (uint32_t)positions.size(), indices.data(),
+		(uint32_t)indices.size() );
+}
+
+
+void StressSceneApp::CreateMaterials()
+{
+	// the same seed every run so every run draws the same scene
+	std::mt19937 random( 1234 );
+	std::uniform_real_distribution<float> unit( 0.f, 1.f );
+
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+	for ( uint32_t i = 0; i < m_materialCount; i++ )
+	{
+		float4 constants[ 2 ] =
+		{
+			float4( 0.2f + 0.8f * unit( random ), 0.2f + 0.8f * unit( random ), 0.2f + 0.8f * unit( random ), 1.f ),
+			float4( 0.05f, 0.05f, 0.06f, 0.f ),
+		};
+
+		BufferDesc desc;
+		desc.Name = "Stress material constants";
+		desc.uiSizeInBytes = sizeof( constants );
+		desc.Usage = USAGE_IMMUTABLE;
+		desc.BindFlags = BIND_UNIFORM_BUFFER;
+		BufferData data;
+		data.pData = constants;
+		data.DataSize = sizeof( constants );
+		RefCntAutoPtr<IBuffer> buffer;
+		device->CreateBuffer( desc, &data, &buffer );
+		GetMemoryBudget().RegisterBuffer( buffer, MemoryCategory::ConstantBuffers );
+
+		// materials are spread over the pipelines so each one gets its share of bindings
+		IPipelineState* pipeline = m_pipelines[ i % m_pipelines.size() ];
+		RefCntAutoPtr<IShaderResourceBinding> binding;
+		pipeline->CreateShaderResourceBinding( &binding, true );
+		binding->GetVariableByName( SHADER_TYPE_PIXEL, "Material" )->Set( buffer );
+
+		m_materials.push_back( GetDrawList().AddMaterial( pipeline, binding ) );
+		m_materialConstants.push_back( buffer );
+		m_bindings.push_back( binding );
+	}
+}
+
+
+// Large static geometry that's the same in every step, so steps with and without -occlusion-cull can be compared
+void StressSceneApp::GeneratePillars()
+{
+	m_pillars.clear();
+	for ( uint32_t i = 0; i < m_pillarCount; i++ )
+	{
+		// square pillars, so they hide the same whichever way they face
+		float angle = 2.f * PI_F * i / m_pillarCount;
+		m_pillars.push_back( float4x4::Scale( k_pillarHalfWidth, k_pillarHeight * 0.5f, k_pillarHalfWidth )
+			* float4x4::Translation( cosf( angle ) * k_pillarRingRadius, k_pillarHeight * 0.5f, sinf( angle ) * k_pillarRingRadius ) );
+	}
+
+	// they never move, so they're submitted once and every Rasterize reuses them
+	GetOcclusionCuller().ClearOccluders();
+	for ( const float4x4& pillar : m_pillars )
+	{
+		GetOcclusionCuller().SubmitOccluder( m_cubeOccluder, pillar );
+	}
+}
+
+
+void StressSceneApp::GenerateScene( const SweepStep& step )
+{
+	// each step's scene only depends on its counts, so a step always draws the same scene
+	std::mt19937 random( step.cubes * 31 + step.models * 17 + step.lights );
+	std::uniform_real_distribution<float> unit( 0.f, 1.f );
+	auto range = [ & ]( float low, float high ) { return low + ( high - low ) * unit( random ); };
+
+	// a shell around the stage origin, so the cubes surround whoever stands there
+	m_cubes.resize( step.cubes );
+	for ( uint32_t i = 0; i < step.cubes; i++ )
+	{
+		Cube& cube = m_cubes[ i ];
+		float angle = range( 0.f, 2.f * PI_F );
+		float distance = range( 1.f, 6.f );
+		cube.position = float3( cosf( angle ) * distance, range( 0.f, 3.f ), sinf( angle ) * distance );
+		cube.scale = range( 0.03f, 0.12f );
+		cube.axis = normalize( float3( range( -1.f, 1.f ), range( -1.f, 1.f ), range( -1.f, 1.f ) ) + float3( 0, 0.01f, 0 ) );
+		cube.speed = range( -2.f, 2.f );
+		cube.material = i % (uint32_t)m_materials.size();
+	}
+
+	for ( uint32_t instance : m_lodInstances )
+	{
+		GetLodSelector().RemoveInstance( instance );
+	}
+	for ( uint32_t instance : m_animationInstances )
+	{
+		GetAnimationSystem().RemoveInstance( instance );
+	}
+	m_modelTransforms.resize( m_model ? step.models : 0 );
+	m_lodInstances.clear();
+	m_animationInstances.clear();
+	for ( uint32_t i = 0; i < (uint32_t)m_modelTransforms.size(); i++ )
+	{
+		float angle = range( 0.f, 2.f * PI_F );
+		float distance = range( 0.75f, 4.f );
+		float4x4& transform = m_modelTransforms[ i ];
+		transform = float4x4::RotationY( range( 0.f, 2.f * PI_F ) )
+			* float4x4::Translation( cosf( angle ) * distance, range( 0.5f, 2.f ), sinf( angle ) * distance );
+		if ( i >= m_animatedModels.size() )
+		{
+			m_lodInstances.push_back( GetLodSelector().AddInstance( m_model.get(), transform ) );
+			continue;
+		}
+
+		// the bounds let distant and unseen instances be sampled less often
+		GLTF::Model* model = m_animatedModels[ i ].get();
+		m_lodInstances.push_back( GetLodSelector().AddInstance( model, transform ) );
+		uint32_t animation = GetAnimationSystem().AddInstance( model, 0 );
+		GetAnimationSystem().SetTime( animation, 0.3f * i );
+		GetAnimationSystem().SetBounds( animation, float3( transform.m30, transform.m31, transform.m32 ), k_animatedBoundsRadius );
+		m_animationInstances.push_back( animation );
+	}
+
+	LightConstants lights = {};
+	for ( uint32_t i = 0; i < step.lights; i++ )
+	{
+		float angle = range( 0.f, 2.f * PI_F );
+		float distance = range( 0.5f, 5.f );
+		lights.lights[ i ].posRadius = float4( cosf( angle ) * distance, range( 0.f, 3.f ), sinf( angle ) * distance, range( 2.f, 4.f ) );
+
+		// more lights are dimmer so the scene doesn't wash out as K goes up
+		lights.lights[ i ].color = float4( range( 0.2f, 1.f ), range( 0.2f, 1.f ), range( 0.2f, 1.f ), 1.f ) * ( 2.f / sqrtf( (float)step.lights ) );
+	}
+	lights.count[ 0 ] = step.lights;
+
+	// Update runs outside of the render graph, so this can transition the buffer itself
+	m_pGraphicsBinding->GetImmediateContext()->UpdateBuffer( m_lightConstants, 0, sizeof( lights ), &lights,
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+
+	GetCommandRecorder().SetActiveContextCount( step.recordThreads );
+
+	std::cerr << "Stress scene: " << step.cubes << " cubes, " << m_pillars.size() << " pillars, " << m_modelTransforms.size() << " models ("
+		<< m_animationInstances.size() << " animated), "
+		<< step.lights << " lights, " << GetCommandRecorder().GetActiveContextCount() << " recording threads\n";
+}
+
+
+void StressSceneApp::SubmitCubes( double currTime )
+{
+	DrawList& drawList = GetDrawList();
+	drawList.Clear();
+	for ( const Cube& cube : m_cubes )
+	{
+		float4x4 cubeToWorld = float4x4::Scale( cube.scale )
+			* float4x4::RotationArbitrary( cube.axis, (float)currTime * cube.speed )
+			* float4x4::Translation( cube.position );
+		drawList.Submit( m_cubeMesh, m_materials[ cube.material ], cubeToWorld );
+	}
+	for ( const float4x4& pillar : m_pillars )
+	{
+		drawList.Submit( m_cubeMesh, m_materials[ 0 ], pillar );
+	}
+}
+
+
+void StressSceneApp::Update( double currTime, double elapsedTime, XrTime displayTime )
+{
+	SubmitCubes( currTime );
+
+	// nothing was rendered, or there's nothing left to measure
+	if ( displayTime == 0 || m_finished || m_steps.empty() )
+		return;
+
+	m_stepFrame++;
+	if ( m_stepFrame == m_warmupFrames + 1 )
+	{
+		// the GPU profiler reports frames a few frames late, so only take its results from here on
+		m_firstMeasuredGpuFrame = GetGpuProfiler().GetFrameIndex();
+		m_results.push_back( StepResult() );
+		m_results.back().step = m_steps[ m_stepIndex ];
+		m_results.back().recordThreads = GetCommandRecorder().GetActiveContextCount();
+		m_results.back().animatedCount = (uint32_t)m_animationInstances.size();
+	}
+	if ( m_stepFrame <= m_warmupFrames )
+		return;
+
+	const FrameStatistics& stats = GetFrameStatistics();
+	StepResult& result = m_results.back();
+	result.cpuFrame.push_back( (float)stats.cpuFrameSeconds );
+	result.cpuSubmit.push_back( (float)stats.cpuSubmitSeconds );
+	uint32_t cubeDraws = m_chunkedDraws ? GetDrawList().GetBatchCount() : GetDrawList().GetLastStats().drawCount;
+	result.drawCount = cubeDraws + (uint32_t)m_modelTransforms.size();
+	result.triangleCount = GetLodSelector().GetLastStats().selectedTriangleCount;
+	result.levelTriangles = GetLodSelector().GetLastStats().levelTriangleCounts;
+	result.sampledAnimations += GetAnimationSystem().GetLastStats().sampledInstanceCount;
+
+	uint64_t gpuResultFrame = GetGpuProfiler().GetResultFrameIndex();
+	if ( stats.gpuFrameSeconds > 0 && gpuResultFrame != m_lastGpuResultFrame && gpuResultFrame >= m_firstMeasuredGpuFrame )
+	{
+		result.gpuFrame.push_back( (float)stats.gpuFrameSeconds );
+	}
+	m_lastGpuResultFrame = gpuResultFrame;
+
+	if ( m_stepFrame == m_warmupFrames + m_measuredFrames )
+	{
+		FinishStep();
+	}
+}
+
+
+void StressSceneApp::FinishStep()
+{
+	m_stepFrame = 0;
+	if ( ++m_stepIndex < m_steps.size() )
+	{
+		GenerateScene( m_steps[ m_stepIndex ] );
+		return;
+	}
+
+	m_finished = true;
+	PrintReport( std::cout );
+	if ( !m_csvPath.empty() && WriteCsv( m_csvPath ) )
+	{
+		std::cerr << "Stress scene results written to " << m_csvPath << "\n";
+	}
+	PostQuitMessage( 0 );
+}
+
+
+static float Percentile( std::vector<float> samples, double fraction )
+{
+	if ( samples.empty() )
+		return 0;
+
+	std::sort( samples.begin(), samples.end() );
+	return samples[ (size_t)( fraction * (double)( samples.size() - 1 ) ) ] * 1000.f;
+}
+
+
+// "5120/1280/0", finest level first, or "-" for models without levels
+static std::string FormatLevelTriangles( const std::vector<uint64_t>& levels )
+{
+	if ( levels.empty() )
+		return "-";
+
+	std::string formatted;
+	for ( size_t i = 0; i < levels.size(); i++ )
+	{
+		formatted += ( i > 0 ? "/" : "" ) + std::to_string( levels[ i ] );
+	}
+	return formatted;
+}
+
+
+// animated instances sampled in an average measured frame
+float StressSceneApp::SampledPerFrame( const StepResult& result )
+{
+	return (float)result.sampledAnimations / (float)std::max( (size_t)1, result.cpuFrame.size() );
+}
+
+
+void StressSceneApp::PrintReport( std::ostream& out ) const
+{
+	out << "Stress scene sweep, " << m_measuredFrames << " frames per step (ms)\n";
+	out << std::fixed << std::setprecision( 2 );
+	out << std::setw( 8 ) << "cubes" << std::setw( 8 ) << "models" << std::setw( 8 ) << "lights" << std::setw( 8 ) << "threads"
+		<< std::setw( 8 ) << "draws" << std::setw( 10 ) << "tris" << std::setw( 10 ) << "frame p50" << std::setw( 10 ) << "p90"
+		<< std::setw( 10 ) << "p99"
+		<< std::setw( 11 ) << "submit p50" << std::setw( 10 ) << "p90" << std::setw( 10 ) << "p99"
+		<< std::setw( 10 ) << "gpu p50" << std::setw( 10 ) << "p90" << std::setw( 10 ) << "p99" << std::setw( 10 ) << "animated"
+		<< std::setw( 9 ) << "sampled" << "  tris by LOD\n";
+	for ( const StepResult& result : m_results )
+	{
+		out << std::setw( 8 ) << result.step.cubes << std::setw( 8 ) << result.step.models << std::setw( 8 ) << result.step.lights
+			<< std::setw( 8 ) << result.recordThreads << std::setw( 8 ) << result.drawCount << std::setw( 10 ) << result.triangleCount
+			<< std::setw( 10 ) << Percentile( result.cpuFrame, 0.5 ) << std::setw( 10 ) << Percentile( result.cpuFrame, 0.9 )
+			<< std::setw( 10 ) << Percentile( result.cpuFrame, 0.99 )
+			<< std::setw( 11 ) << Percentile( result.cpuSubmit, 0.5 ) << std::setw( 10 ) << Percentile( result.cpuSubmit, 0.9 )
+			<< std::setw( 10 ) << Percentile( result.cpuSubmit, 0.99 )
+			<< std::setw( 10 ) << Percentile( result.gpuFrame, 0.5 ) << std::setw( 10 ) << Percentile( result.gpuFrame, 0.9 )
+			<< std::setw( 10 ) << Percentile( result.gpuFrame, 0.99 ) << std::setw( 10 ) << result.animatedCount
+			<< std::setw( 9 ) << SampledPerFrame( result ) << "  " << FormatLevelTriangles( result.levelTriangles ) << "\n";
+	}
+	out << std::defaultfloat;
+}
+
+
+bool StressSceneApp::WriteCsv( const std::string& path ) const
+{
+	std::ofstream out( path );
+	if ( !out )
+	{
+		std::cerr << "Unable to write " << path << "\n";
+		return false;
+	}
+
+	out << "cubes,models,lights,record_threads,draws,triangles,frame_p50_ms,frame_p90_ms,frame_p99_ms,submit_p50_ms,submit_p90_ms,submit_p99_ms,"
+		"gpu_p50_ms,gpu_p90_ms,gpu_p99_ms,lod_triangles,animated,animations_sampled_per_frame\n";
+	for ( const StepResult& result : m_results )
+	{
+		out << result.step.cubes << "," << result.step.models << "," << result.step.lights << "," << result.recordThreads << "," << result.drawCount << "," << result.triangleCount;
+		for ( const std::vector<float>* samples : { &result.cpuFrame, &result.cpuSubmit, &result.gpuFrame } )
+		{
+			out << "," << Percentile( *samples, 0.5 ) << "," << Percentile( *samples, 0.9 ) << "," << Percentile( *samples, 0.99 );
+		}
+		out << "," << FormatLevelTriangles( result.levelTriangles ) << "," << result.animatedCount << "," << SampledPerFrame( result ) << "\n";
+	}
+	return true;
+}
+
+
+void StressSceneApp::UpdateEyeTransforms( float4x4 eyeToProj, float4x4 stageToEye, XrView& view )
+{
+	// runs before the eye's render pass, which expects the constants back in their usual state
+	IDeviceContext* context = m_pGraphicsBinding->GetImmediateContext();
+	float4x4 stageToProj = ( stageToEye * eyeToProj ).Transpose();
+	context->UpdateBuffer( m_viewConstants, 0, sizeof( stageToProj ), &stageToProj, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	StateTransitionDesc transition;
+	transition.pResource = m_viewConstants;
+	transition.NewState = RESOURCE_STATE_CONSTANT_BUFFER;
+	transition.Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
+	context->TransitionResourceStates( 1, &transition );
+}
+
+
+void StressSceneApp::DeclareEyeResources( int eye, RenderGraphPassBuilder& pass )
+{
+	pass.Read( m_viewConstants, RESOURCE_STATE_CONSTANT_BUFFER );
+	pass.Read( m_lightConstants, RESOURCE_STATE_CONSTANT_BUFFER );
+	for ( IBuffer* buffer : m_materialConstants )
+	{
+		pass.Read( buffer, RESOURCE_STATE_CONSTANT_BUFFER );
+	}
+}
+
+
+bool StressSceneApp::RenderEye( int eye )
+{
+	if ( !m_chunkedDraws )
+	{
+		GetDrawList().Draw( m_pGraphicsBinding->GetImmediateContext() );
+	}
+	return true;
+}
+
+
+uint32_t StressSceneApp::GetEyeDrawChunkCount( int eye )
+{
+	// one chunk per instanced draw, so more materials spread the cubes over more chunks
+	return m_chunkedDraws ? GetDrawList().GetBatchCount() : 0;
+}
+
+
+void StressSceneApp::PrepareEyeDrawChunks( int eye, IDeviceContext* immediateContext )
+{
+	// the deferred contexts can only verify states, so the app's buffers are put in their states here. The eye
+	// pass declared them and the draw list's own buffers just before, so these normally issue no barriers.
+	std::vector<StateTransitionDesc> transitions;
+	auto read = [ &transitions ]( IDeviceObject* object, RESOURCE_STATE state )
+	{
+		StateTransitionDesc transition;
+		transition.pResource = object;
+		transition.NewState = state;
+		transition.Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
+		transitions.push_back( transition );
+	};
+	read( m_viewConstants, RESOURCE_STATE_CONSTANT_BUFFER );
+	read( m_lightConstants, RESOURCE_STATE_CONSTANT_BUFFER );
+	for ( IBuffer* buffer : m_materialConstants )
+	{
+		read( buffer, RESOURCE_STATE_CONSTANT_BUFFER );
+	}
+	read( m_cubeVertices, RESOURCE_STATE_VERTEX_BUFFER );
+	read( m_cubeIndices, RESOURCE_STATE_INDEX_BUFFER );
+	immediateContext->TransitionResourceStates( (Uint32)transitions.size(), transitions.data() );
+}
+
+
+void StressSceneApp::RecordEyeDrawChunks( int eye, IDeviceContext* context, uint32_t firstChunk, uint32_t chunkCount )
+{
+	GetDrawList().DrawBatches( context, firstChunk, chunkCount, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+}
+
+
+void StressSceneApp::RenderEyeGltf( int eye )
+{
+	if ( !m_model || m_modelTransforms.empty() )
+		return;
+
+	IDeviceContext* context = m_pGraphicsBinding->GetImmediateContext();
+	m_gltfRenderer->Begin( m_pGraphicsBinding->GetRenderDevice(), context, m_CacheUseInfo, m_CacheBindings,
+		m_CameraAttribsCB, m_LightAttribsCB );
+	for ( size_t i = 0; i < m_modelTransforms.size(); i++ )
+	{
+		GetLodSelector().Apply( m_lodInstances[ i ] );
+		GLTF_PBR_Renderer::RenderInfo renderInfo;
+		renderInfo.ModelTransform = m_modelTransforms[ i ];
+		GLTF::Model& model = i < m_animatedModels.size() ? *m_animatedModels[ i ] : *m_model;
+		m_gltfRenderer->Render( context, model, renderInfo, nullptr, &m_CacheBindings );
+	}
+}
+
+
+void StressSceneApp::Render()
+{
+	// the mirror would only add noise to the numbers, so it just shows that the app is alive
+	auto* pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
+	const float ClearColor[] = { 0.1f, 0.1f, 0.15f, 1.0f };
+	m_pGraphicsBinding->GetImmediateContext()->SetRenderTargets( 1, &pRTV, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	m_pGraphicsBinding->GetImmediateContext()->ClearRenderTarget( pRTV, ClearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+}
+
+
+std::unique_ptr<IApp> CreateApp()
+{
+	return std::make_unique<StressSceneApp>();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif
+
+// Histogram of call durations in nanoseconds. Each power of two is split into 16 buckets, so a bucket is at most
+// about 6% wide, and anything over 2^40 ns (about 18 minutes) lands in the last one.
+//
+// Only the thread that owns a histogram records into it. Recording is plain loads and stores on relaxed atomics,
+// with no locks and no read-modify-write, and another thread can read it at any time to merge it into a report.
+class CallHistogram
+{
+public:
+	static const uint32_t k_subBucketBits = 4;
+	static const uint32_t k_maxValueBits = 40;
+	static const uint32_t k_bucketCount = ( k_maxValueBits - k_subBucketBits + 1 ) << k_subBucketBits;
+
+	// Only call from the owning thread
+	void Record( uint64_t nanoseconds )
+	{
+		uint32_t bucket = BucketIndex( nanoseconds );
+		m_buckets[ bucket ].store( m_buckets[ bucket ].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+		m_count.store( m_count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+		m_total.store( m_total.load( std::memory_order_relaxed ) + nanoseconds, std::memory_order_relaxed );
+		if ( nanoseconds > m_max.load( std::memory_order_relaxed ) )
+		{
+			m_max.store( nanoseconds, std::memory_order_relaxed );
+		}
+	}
+
+	// Only call while the owning thread isn't recording
+	void Reset()
+	{
+		for ( std::atomic<uint64_t>& bucket : m_buckets )
+		{
+			bucket.store( 0, std::memory_order_relaxed );
+		}
+		m_count.store( 0, std::memory_order_relaxed );
+		m_total.store( 0, std::memory_order_relaxed );
+		m_max.store( 0, std::memory_order_relaxed );
+	}
+
+	uint64_t GetCount() const { return m_count.load( std::memory_order_relaxed ); }
+	uint64_t GetTotal() const { return m_total.load( std::memory_order_relaxed ); }
+	uint64_t GetMax() const { return m_max.load( std::memory_order_relaxed ); }
+	uint64_t GetBucket( uint32_t bucket ) const { return m_buckets[ bucket ].load( std::memory_order_relaxed ); }
+
+	static uint32_t BucketIndex( uint64_t nanoseconds )
+	{
+		const uint64_t k_subBuckets = 1ull << k_subBucketBits;
+		nanoseconds = std::min<uint64_t>( nanoseconds, ( 1ull << k_maxValueBits ) - 1 );
+		if ( nanoseconds < k_subBuckets )
+			return (uint32_t)nanoseconds;
+
+		uint32_t shift = HighestBit( nanoseconds ) - k_subBucketBits;
+		return ( ( shift + 1 ) << k_subBucketBits ) + (uint32_t)( ( nanoseconds >> shift ) & ( k_subBuckets - 1 ) );
+	}
+
+	// the middle of the range of durations that land in a bucket
+	static uint64_t BucketValue( uint32_t bucket )
+	{
+		const uint32_t k_subBuckets = 1u << k_subBucketBits;
+		if ( bucket < k_subBuckets )
+			return bucket;
+
+		uint32_t shift = ( bucket >> k_subBucketBits ) - 1;
+		uint64_t lowest = (uint64_t)( k_subBuckets + ( bucket & ( k_subBuckets - 1 ) ) ) << shift;
+		return lowest + ( ( 1ull << shift ) >> 1 );
+	}
+
+private:
+	static uint32_t HighestBit( uint64_t value )
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64( &index, value );
+		return (uint32_t)index;
+#else
+		return 63 - (uint32_t)__builtin_clzll( value );
+#endif
+	}
+
+	std::atomic<uint64_t> m_buckets[ k_bucketCount ] = {};
+	std::atomic<uint64_t> m_count { 0 };
+	std::atomic<uint64_t> m_total { 0 };
+	std::atomic<uint64_t> m_max { 0 };
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+// The loader/layer negotiation structures from the OpenXR loader spec. The SDK keeps its copy of these with the
+// loader sources rather than with the public headers, so the layer declares them itself. Their layout is part of
+// the loader ABI and doesn't change.
+
+#include <openxr/openxr.h>
+
+#define XR_CURRENT_LOADER_API_LAYER_VERSION 1
+#define XR_LOADER_INFO_STRUCT_VERSION 1
+#define XR_API_LAYER_INFO_STRUCT_VERSION 1
+#define XR_API_LAYER_CREATE_INFO_STRUCT_VERSION 1
+#define XR_API_LAYER_NEXT_INFO_STRUCT_VERSION 1
+#define XR_API_LAYER_MAX_SETTINGS_PATH_SIZE 512
+
+typedef enum XrLoaderInterfaceStructs
+{
+	XR_LOADER_INTERFACE_STRUCT_UNINTIALIZED = 0,
+	XR_LOADER_INTERFACE_STRUCT_LOADER_INFO,
+	XR_LOADER_INTERFACE_STRUCT_API_LAYER_REQUEST,
+	XR_LOADER_INTERFACE_STRUCT_RUNTIME_REQUEST,
+	XR_LOADER_INTERFACE_STRUCT_API_LAYER_CREATE_INFO,
+	XR_LOADER_INTERFACE_STRUCT_API_LAYER_NEXT_INFO,
+} XrLoaderInterfaceStructs;
+
+typedef struct XrNegotiateLoaderInfo
+{
+	XrLoaderInterfaceStructs structType;
+	uint32_t structVersion;
+	size_t structSize;
+	uint32_t minInterfaceVersion;
+	uint32_t maxInterfaceVersion;
+	XrVersion minApiVersion;
+	XrVersion maxApiVersion;
+} XrNegotiateLoaderInfo;
+
+struct XrApiLayerCreateInfo;
+typedef XrResult( XRAPI_PTR* PFN_xrCreateApiLayerInstance )( const XrInstanceCreateInfo* info,
+	const struct XrApiLayerCreateInfo* apiLayerInfo, XrInstance* instance );
+
+typedef struct XrNegotiateApiLayerRequest
+{
+	XrLoaderInterfaceStructs structType;
+	uint32_t structVersion;
+	size_t structSize;
+	uint32_t layerInterfaceVersion;
+	XrVersion layerApiVersion;
+	PFN_xrGetInstanceProcAddr getInstanceProcAddr;
+	PFN_xrCreateApiLayerInstance createApiLayerInstance;
+} XrNegotiateApiLayerRequest;
+
+typedef struct XrApiLayerNextInfo
+{
+	XrLoaderInterfaceStructs structType;
+	uint32_t structVersion;
+	size_t structSize;
+	char layerName[ XR_MAX_API_LAYER_NAME_SIZE ];
+	PFN_xrGetInstanceProcAddr nextGetInstanceProcAddr;
+	PFN_xrCreateApiLayerInstance nextCreateApiLayerInstance;
+	struct XrApiLayerNextInfo* next;
+} XrApiLayerNextInfo;
+
+typedef struct XrApiLayerCreateInfo
+{
+	XrLoaderInterfaceStructs structType;
+	uint32_t structVersion;
+	size_t structSize;
+	void* loaderInstance;
+	char settings_file_location[ XR_API_LAYER_MAX_SETTINGS_PATH_SIZE ];
+	XrApiLayerNextInfo* nextInfo;
+} XrApiLayerCreateInfo;
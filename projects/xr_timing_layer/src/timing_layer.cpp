@@ -0,0 +1,407 @@
+// OpenXR API layer that times the calls an app makes into the runtime every frame. Each call is timed on the
+// thread that made it and recorded in that thread's histograms, and the counts and percentiles for each call are
+// printed when the instance is destroyed.
+
+#include "loader_interfaces.h"
+#include "call_histogram.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#	define LAYER_EXPORT extern "C" __declspec( dllexport )
+#else
+#	define LAYER_EXPORT extern "C" __attribute__( ( visibility( "default" ) ) )
+#endif
+
+static const char* k_layerName = "XR_APILAYER_XRDE_call_timing";
+
+enum TimedCall
+{
+	TimedCall_WaitFrame,
+	TimedCall_BeginFrame,
+	TimedCall_EndFrame,
+	TimedCall_AcquireSwapchainImage,
+	TimedCall_WaitSwapchainImage,
+	TimedCall_ReleaseSwapchainImage,
+	TimedCall_LocateViews,
+	TimedCall_SyncActions,
+	TimedCall_LocateSpace,
+
+	TimedCall_Count
+};
+
+static const char* k_timedCallNames[ TimedCall_Count ] =
+{
+	"xrWaitFrame",
+	"xrBeginFrame",
+	"xrEndFrame",
+	"xrAcquireSwapchainImage",
+	"xrWaitSwapchainImage",
+	"xrReleaseSwapchainImage",
+	"xrLocateViews",
+	"xrSyncActions",
+	"xrLocateSpace",
+};
+
+struct ThreadTimings
+{
+	CallHistogram calls[ TimedCall_Count ];
+};
+
+// Each thread records into its own histograms, so the only lock is taken the first time a thread makes a timed
+// call. The histograms outlive their threads so calls made on threads that have exited still get reported.
+static std::mutex g_threadsMutex;
+static std::vector< std::unique_ptr<ThreadTimings> > g_threads;
+static thread_local ThreadTimings* t_timings = nullptr;
+
+static ThreadTimings* GetThreadTimings()
+{
+	if ( !t_timings )
+	{
+		std::unique_lock<std::mutex> lock( g_threadsMutex );
+		g_threads.push_back( std::make_unique<ThreadTimings>() );
+		t_timings = g_threads.back().get();
+	}
+	return t_timings;
+}
+
+struct NextDispatch
+{
+	PFN_xrGetInstanceProcAddr GetInstanceProcAddr;
+	PFN_xrDestroyInstance DestroyInstance;
+	PFN_xrWaitFrame WaitFrame;
+	PFN_xrBeginFrame BeginFrame;
+	PFN_xrEndFrame EndFrame;
+	PFN_xrAcquireSwapchainImage AcquireSwapchainImage;
+	PFN_xrWaitSwapchainImage WaitSwapchainImage;
+	PFN_xrReleaseSwapchainImage ReleaseSwapchainImage;
+	PFN_xrLocateViews LocateViews;
+	PFN_xrSyncActions SyncActions;
+	PFN_xrLocateSpace LocateSpace;
+};
+
+// The layer serves one instance at a time, which is all apps create in practice. Every other handle belongs to
+// that instance, so the wrappers don't need to look up which dispatch table to use.
+static std::mutex g_instanceMutex;
+static XrInstance g_instance = XR_NULL_HANDLE;
+static NextDispatch g_next = {};
+static std::chrono::steady_clock::time_point g_instanceCreated;
+
+class ScopedCallTimer
+{
+public:
+	explicit ScopedCallTimer( TimedCall call ) : m_call( call ), m_start( std::chrono::steady_clock::now() ) {}
+	~ScopedCallTimer()
+	{
+		std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - m_start;
+		GetThreadTimings()->calls[ m_call ].Record( (uint64_t)elapsed.count() );
+	}
+
+private:
+	TimedCall m_call;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+
+static XrResult XRAPI_CALL TimedWaitFrame( XrSession session, const XrFrameWaitInfo* frameWaitInfo, XrFrameState* frameState )
+{
+	ScopedCallTimer timer( TimedCall_WaitFrame );
+	return g_next.WaitFrame( session, frameWaitInfo, frameState );
+}
+
+
+static XrResult XRAPI_CALL TimedBeginFrame( XrSession session, const XrFrameBeginInfo* frameBeginInfo )
+{
+	ScopedCallTimer timer( TimedCall_BeginFrame );
+	return g_next.BeginFrame( session, frameBeginInfo );
+}
+
+
+static XrResult XRAPI_CALL TimedEndFrame( XrSession session, const XrFrameEndInfo* frameEndInfo )
+{
+	ScopedCallTimer timer( TimedCall_EndFrame );
+	return g_next.EndFrame( session, frameEndInfo );
+}
+
+
+static XrResult XRAPI_CALL TimedAcquireSwapchainImage( XrSwapchain swapchain, const XrSwapchainImageAcquireInfo* acquireInfo,
+	uint32_t* index )
+{
+	ScopedCallTimer timer( TimedCall_AcquireSwapchainImage );
+	return g_next.AcquireSwapchainImage( swapchain, acquireInfo, index );
+}
+
+
+static XrResult XRAPI_CALL TimedWaitSwapchainImage( XrSwapchain swapchain, const XrSwapchainImageWaitInfo* waitInfo )
+{
+	ScopedCallTimer timer( TimedCall_WaitSwapchainImage );
+	return g_next.WaitSwapchainImage( swapchain, waitInfo );
+}
+
+
+static XrResult XRAPI_CALL TimedReleaseSwapchainImage( XrSwapchain swapchain, const XrSwapchainImageReleaseInfo* releaseInfo )
+{
+	ScopedCallTimer timer( TimedCall_ReleaseSwapchainImage );
+	return g_next.ReleaseSwapchainImage( swapchain, releaseInfo );
+}
+
+
+static XrResult XRAPI_CALL TimedLocateViews( XrSession session, const XrViewLocateInfo* viewLocateInfo, XrViewState* viewState,
+	uint32_t viewCapacityInput, uint32_t* viewCountOutput, XrView* views )
+{
+	ScopedCallTimer timer( TimedCall_LocateViews );
+	return g_next.LocateViews( session, viewLocateInfo, viewState, viewCapacityInput, viewCountOutput, views );
+}
+
+
+static XrResult XRAPI_CALL TimedSyncActions( XrSession session, const XrActionsSyncInfo* syncInfo )
+{
+	ScopedCallTimer timer( TimedCall_SyncActions );
+	return g_next.SyncActions( session, syncInfo );
+}
+
+
+static XrResult XRAPI_CALL TimedLocateSpace( XrSpace space, XrSpace baseSpace, XrTime time, XrSpaceLocation* location )
+{
+	ScopedCallTimer timer( TimedCall_LocateSpace );
+	return g_next.LocateSpace( space, baseSpace, time, location );
+}
+
+
+static void PrintTimings( FILE* out )
+{
+	// merge every thread's histograms into one per call
+	struct MergedCall
+	{
+		uint64_t count = 0;
+		uint64_t total = 0;
+		uint64_t max = 0;
+		std::vector<uint64_t> buckets = std::vector<uint64_t>( CallHistogram::k_bucketCount );
+	};
+	MergedCall merged[ TimedCall_Count ];
+	{
+		std::unique_lock<std::mutex> lock( g_threadsMutex );
+		for ( const std::unique_ptr<ThreadTimings>& thread : g_threads )
+		{
+			for ( uint32_t call = 0; call < TimedCall_Count; call++ )
+			{
+				const CallHistogram& histogram = thread->calls[ call ];
+				merged[ call ].count += histogram.GetCount();
+				merged[ call ].total += histogram.GetTotal();
+				merged[ call ].max = std::max( merged[ call ].max, histogram.GetMax() );
+				for ( uint32_t bucket = 0; bucket < CallHistogram::k_bucketCount; bucket++ )
+				{
+					merged[ call ].buckets[ bucket ] += histogram.GetBucket( bucket );
+				}
+			}
+		}
+	}
+
+	auto percentile = [&]( const MergedCall& call, double fraction ) -> double
+	{
+		uint64_t target = (uint64_t)( fraction * (double)( call.count - 1 ) );
+		uint64_t seen = 0;
+		for ( uint32_t bucket = 0; bucket < CallHistogram::k_bucketCount; bucket++ )
+		{
+			seen += call.buckets[ bucket ];
+			if ( seen > target )
+				return std::min<uint64_t>( CallHistogram::BucketValue( bucket ), call.max ) / 1e3;
+		}
+		return call.max / 1e3;
+	};
+
+	// time spent inside the runtime as a share of the instance's lifetime, so it can be told apart from the app's
+	// own work. Calls on different threads can overlap, so the shares can add up to more than 100%.
+	double lifetime = std::chrono::duration<double>( std::chrono::steady_clock::now() - g_instanceCreated ).count();
+	fprintf( out, "%s: timings over %.2f s, in microseconds\n", k_layerName, lifetime );
+	fprintf( out, "%-24s %10s %9s %9s %9s %9s %9s %9s %8s\n", "call", "count", "mean", "p50", "p90", "p99", "p99.9", "max", "share" );
+
+	double runtimeSeconds = 0;
+	for ( uint32_t call = 0; call < TimedCall_Count; call++ )
+	{
+		const MergedCall& calls = merged[ call ];
+		if ( !calls.count )
+			continue;
+
+		double seconds = calls.total / 1e9;
+		runtimeSeconds += seconds;
+		fprintf( out, "%-24s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %7.1f%%\n", k_timedCallNames[ call ],
+			(unsigned long long)calls.count, calls.total / 1e3 / calls.count, percentile( calls, 0.5 ), percentile( calls, 0.9 ),
+			percentile( calls, 0.99 ), percentile( calls, 0.999 ), calls.max / 1e3, lifetime > 0 ? 100.0 * seconds / lifetime : 0.0 );
+	}
+	fprintf( out, "%-24s %10s %9s %9s %9s %9s %9s %9s %7.1f%%\n", "total", "", "", "", "", "", "", "",
+		lifetime > 0 ? 100.0 * runtimeSeconds / lifetime : 0.0 );
+}
+
+
+static void ReportTimings()
+{
+	PrintTimings( stderr );
+
+	// set XR_TIMING_LAYER_OUTPUT to a file to keep the report, each instance appends to it
+	const char* outputPath = getenv( "XR_TIMING_LAYER_OUTPUT" );
+	if ( outputPath && *outputPath )
+	{
+		FILE* file = nullptr;
+#ifdef _WIN32
+		if ( fopen_s( &file, outputPath, "a" ) != 0 )
+		{
+			file = nullptr;
+		}
+#else
+		file = fopen( outputPath, "a" );
+#endif
+		if ( !file )
+		{
+			fprintf( stderr, "%s: unable to open %s\n", k_layerName, outputPath );
+			return;
+		}
+		PrintTimings( file );
+		fclose( file );
+	}
+}
+
+
+static XrResult XRAPI_CALL TimingDestroyInstance( XrInstance instance )
+{
+	ReportTimings();
+
+	XrResult result = g_next.DestroyInstance( instance );
+
+	std::unique_lock<std::mutex> lock( g_instanceMutex );
+	g_instance = XR_NULL_HANDLE;
+	return result;
+}
+
+
+static XrResult XRAPI_CALL TimingGetInstanceProcAddr( XrInstance instance, const char* name, PFN_xrVoidFunction* function )
+{
+	struct Hook
+	{
+		const char* name;
+		PFN_xrVoidFunction function;
+	};
+	static const Hook k_hooks[] =
+	{
+		{ "xrGetInstanceProcAddr", (PFN_xrVoidFunction)TimingGetInstanceProcAddr },
+		{ "xrDestroyInstance", (PFN_xrVoidFunction)TimingDestroyInstance },
+		{ "xrWaitFrame", (PFN_xrVoidFunction)TimedWaitFrame },
+		{ "xrBeginFrame", (PFN_xrVoidFunction)TimedBeginFrame },
+		{ "xrEndFrame", (PFN_xrVoidFunction)TimedEndFrame },
+		{ "xrAcquireSwapchainImage", (PFN_xrVoidFunction)TimedAcquireSwapchainImage },
+		{ "xrWaitSwapchainImage", (PFN_xrVoidFunction)TimedWaitSwapchainImage },
+		{ "xrReleaseSwapchainImage", (PFN_xrVoidFunction)TimedReleaseSwapchainImage },
+		{ "xrLocateViews", (PFN_xrVoidFunction)TimedLocateViews },
+		{ "xrSyncActions", (PFN_xrVoidFunction)TimedSyncActions },
+		{ "xrLocateSpace", (PFN_xrVoidFunction)TimedLocateSpace },
+	};
+
+	if ( !name || !function )
+		return XR_ERROR_VALIDATION_FAILURE;
+
+	for ( const Hook& hook : k_hooks )
+	{
+		if ( strcmp( name, hook.name ) == 0 )
+		{
+			*function = hook.function;
+			return XR_SUCCESS;
+		}
+	}
+
+	if ( !g_next.GetInstanceProcAddr )
+	{
+		*function = nullptr;
+		return XR_ERROR_HANDLE_INVALID;
+	}
+	return g_next.GetInstanceProcAddr( instance, name, function );
+}
+
+
+static XrResult XRAPI_CALL TimingCreateApiLayerInstance( const XrInstanceCreateInfo* info, const XrApiLayerCreateInfo* apiLayerInfo,
+	XrInstance* instance )
+{
+	if ( !apiLayerInfo || !apiLayerInfo->nextInfo
+		|| apiLayerInfo->structType != XR_LOADER_INTERFACE_STRUCT_API_LAYER_CREATE_INFO
+		|| apiLayerInfo->nextInfo->structType != XR_LOADER_INTERFACE_STRUCT_API_LAYER_NEXT_INFO
+		|| strcmp( apiLayerInfo->nextInfo->layerName, k_layerName ) != 0 )
+	{
+		return XR_ERROR_INITIALIZATION_FAILED;
+	}
+
+	std::unique_lock<std::mutex> lock( g_instanceMutex );
+	if ( g_instance != XR_NULL_HANDLE )
+	{
+		fprintf( stderr, "%s: only one instance at a time can be timed\n", k_layerName );
+		return XR_ERROR_LIMIT_REACHED;
+	}
+
+	// the next layer gets the chain from the layer after this one
+	XrApiLayerCreateInfo nextApiLayerInfo = *apiLayerInfo;
+	nextApiLayerInfo.nextInfo = apiLayerInfo->nextInfo->next;
+	XrResult result = apiLayerInfo->nextInfo->nextCreateApiLayerInstance( info, &nextApiLayerInfo, instance );
+	if ( XR_FAILED( result ) )
+		return result;
+
+	PFN_xrGetInstanceProcAddr getInstanceProcAddr = apiLayerInfo->nextInfo->nextGetInstanceProcAddr;
+	NextDispatch next = {};
+	next.GetInstanceProcAddr = getInstanceProcAddr;
+	getInstanceProcAddr( *instance, "xrDestroyInstance", (PFN_xrVoidFunction*)&next.DestroyInstance );
+	getInstanceProcAddr( *instance, "xrWaitFrame", (PFN_xrVoidFunction*)&next.WaitFrame );
+	getInstanceProcAddr( *instance, "xrBeginFrame", (PFN_xrVoidFunction*)&next.BeginFrame );
+	getInstanceProcAddr( *instance, "xrEndFrame", (PFN_xrVoidFunction*)&next.EndFrame );
+	getInstanceProcAddr( *instance, "xrAcquireSwapchainImage", (PFN_xrVoidFunction*)&next.AcquireSwapchainImage );
+	getInstanceProcAddr( *instance, "xrWaitSwapchainImage", (PFN_xrVoidFunction*)&next.WaitSwapchainImage );
+	getInstanceProcAddr( *instance, "xrReleaseSwapchainImage", (PFN_xrVoidFunction*)&next.ReleaseSwapchainImage );
+	getInstanceProcAddr( *instance, "xrLocateViews", (PFN_xrVoidFunction*)&next.LocateViews );
+	getInstanceProcAddr( *instance, "xrSyncActions", (PFN_xrVoidFunction*)&next.SyncActions );
+	getInstanceProcAddr( *instance, "xrLocateSpace", (PFN_xrVoidFunction*)&next.LocateSpace );
+
+	// no calls can be in flight before the app has the instance, so the old timings can be cleared safely
+	{
+		std::unique_lock<std::mutex> threadsLock( g_threadsMutex );
+		for ( const std::unique_ptr<ThreadTimings>& thread : g_threads )
+		{
+			for ( CallHistogram& histogram : thread->calls )
+			{
+				histogram.Reset();
+			}
+		}
+	}
+
+	g_next = next;
+	g_instance = *instance;
+	g_instanceCreated = std::chrono::steady_clock::now();
+	return XR_SUCCESS;
+}
+
+
+LAYER_EXPORT XrResult XRAPI_CALL xrNegotiateLoaderApiLayerInterface( const XrNegotiateLoaderInfo* loaderInfo, const char* layerName,
+	XrNegotiateApiLayerRequest* apiLayerRequest )
+{
+	if ( !loaderInfo || !apiLayerRequest || !layerName || strcmp( layerName, k_layerName ) != 0
+		|| loaderInfo->structType != XR_LOADER_INTERFACE_STRUCT_LOADER_INFO
+		|| loaderInfo->structVersion != XR_LOADER_INFO_STRUCT_VERSION
+		|| loaderInfo->structSize != sizeof( XrNegotiateLoaderInfo )
+		|| apiLayerRequest->structType != XR_LOADER_INTERFACE_STRUCT_API_LAYER_REQUEST
+		|| apiLayerRequest->structVersion != XR_API_LAYER_INFO_STRUCT_VERSION
+		|| apiLayerRequest->structSize != sizeof( XrNegotiateApiLayerRequest )
+		|| loaderInfo->minInterfaceVersion > XR_CURRENT_LOADER_API_LAYER_VERSION
+		|| loaderInfo->maxInterfaceVersion < XR_CURRENT_LOADER_API_LAYER_VERSION
+		|| loaderInfo->minApiVersion > XR_CURRENT_API_VERSION
+		|| loaderInfo->maxApiVersion < XR_MAKE_VERSION( 1, 0, 0 ) )
+	{
+		return XR_ERROR_INITIALIZATION_FAILED;
+	}
+
+	apiLayerRequest->layerInterfaceVersion = XR_CURRENT_LOADER_API_LAYER_VERSION;
+	apiLayerRequest->layerApiVersion = XR_CURRENT_API_VERSION;
+	apiLayerRequest->getInstanceProcAddr = TimingGetInstanceProcAddr;
+	apiLayerRequest->createApiLayerInstance = TimingCreateApiLayerInstance;
+	return XR_SUCCESS;
+}
@@ -4,9 +4,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include <BasicMath.hpp>
 
+#include "input_trace.h"
+
 namespace XRDE
 {
 
@@ -29,7 +32,7 @@ public:
 	std::vector< std::unique_ptr< Action > >::const_iterator begin() const { return m_actions.begin();  }
 	std::vector< std::unique_ptr< Action > >::const_iterator end() const { return m_actions.end(); }
 protected:
-	XrActionSet m_handle;
+	XrActionSet m_handle = XR_NULL_HANDLE;
 	XrActionSetCreateInfo m_createInfo;
 	std::vector< std::unique_ptr< Action > > m_actions;
 };
@@ -63,14 +66,17 @@ protected:
 	XrResult Init( XrInstance instance );
 	XrResult CreateSpace( XrSession session, XrPath subactionPath, const XrPosef& poseInActionSpace );
 	XrResult CreateSpaces( XrSession session );
+	uint32_t TraceChannel( InputTrace* trace, TraceChannelKind kind, XrPath subactionPath );
 
 	ActionSet* m_actionSet;
 
-	XrAction m_handle;
+	XrAction m_handle = XR_NULL_HANDLE;
 	XrActionCreateInfo m_createInfo;
 	std::vector<XrPath> m_subactionPaths;
 	std::map<XrPath, std::vector<XrPath>> m_bindings;
 	std::map<XrPath, XrSpace> m_spaces;
+	std::mutex m_traceMutex;
+	std::map<XrPath, uint32_t> m_traceChannels;
 };
 
 XrResult SuggestBindings( XrInstance instance, XrPath interactionProfile, const std::vector<const ActionSet*> & actionSets );
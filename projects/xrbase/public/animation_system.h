@@ -0,0 +1,146 @@
+#pragma once
+
+#include "job_system.h"
+#include "scene_transforms.h"
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+#include <GLTFLoader.hpp>
+
+#include <vector>
+
+namespace XRDE
+{
+
+// How often instances are sampled. An instance whose bounding sphere looks smaller than fullRateSize, as its
+// radius over its distance from the viewer, is sampled every second frame, then every fourth below half that
+// size, and so on up to maxInterval. Instances neither eye can see use offscreenInterval.
+struct AnimationLodSettings
+{
+	float fullRateSize = 0.05f;
+	uint32_t maxInterval = 8;
+	uint32_t offscreenInterval = 8;
+};
+
+struct AnimationStats
+{
+	uint32_t instanceCount = 0;
+	uint32_t sampledInstanceCount = 0;		// the rest kept their pose for this frame
+	uint32_t sampledChannelCount = 0;
+};
+
+// Plays glTF animations on many models at once, without Model::UpdateAnimation. Every channel remembers the key it
+// was last between, so playing forward finds the next key in constant time. The keys around the current time
+// are gathered channel by channel, then four channels are interpolated at a time with SSE: translations and
+// scales with lerp, rotations with a normalized lerp whose weight is adjusted to follow slerp closely. The
+// results go into the nodes' Translation, Rotation and Scale and the nodes are marked dirty in the scene
+// transforms, which turn them into matrices.
+//
+// Instances far from the viewer or outside both eyes are sampled less often. Their frames are staggered, so
+// the work stays even from frame to frame, and they are sampled at the current time when they do update.
+// Instances are split into jobs, so two instances must not animate the same model.
+class AnimationSystem
+{
+public:
+	static const uint32_t k_invalidHandle = UINT32_MAX;
+
+	void Init( SceneTransforms* transforms );
+
+	uint32_t AddInstance( Diligent::GLTF::Model* model, uint32_t animationIndex, bool loop = true );
+	// For animations that target nodes outside of a model
+	uint32_t AddInstance( const Diligent::GLTF::Animation* animation, bool loop = true );
+	void RemoveInstance( uint32_t instance );
+	void RemoveModel( const Diligent::GLTF::Model* model );
+
+	void SetTime( uint32_t instance, float seconds );
+	void SetSpeed( uint32_t instance, float speed );
+
+	// A stage space bounding sphere for the LOD. Instances without one are always sampled every frame.
+	void SetBounds( uint32_t instance, const Diligent::float3& center, float radius );
+
+	void SetLodSettings( const AnimationLodSettings& settings ) { m_lodSettings = settings; }
+	const AnimationLodSettings& GetLodSettings() const { return m_lodSettings; }
+
+	// Stage space. Without views every instance is sampled every frame.
+	void SetViews( const XrView views[ 2 ] );
+
+	// Advances every instance and samples the ones that are due
+	void Update( JobSystem& jobs, double elapsedSeconds );
+
+	const AnimationStats& GetLastStats() const { return m_lastStats; }
+
+private:
+	enum ChannelPath : uint8_t
+	{
+		ChannelPath_Translation,
+		ChannelPath_Rotation,
+		ChannelPath_Scale,
+	};
+
+	// what sampling a channel needs, copied out of the glTF sampler
+	struct Channel
+	{
+		const float* times;
+		const Diligent::float4* values;
+		uint32_t keyCount;
+		uint32_t valueStride;		// three for cubic splines, which keep tangents around every value
+		uint32_t valueOffset;
+		bool step;
+		ChannelPath path;
+		Diligent::GLTF::Node* node;
+		uint32_t nodeIndex;		// in the scene transforms
+	};
+
+	struct Instance
+	{
+		const void* owner = nullptr;	// the model, or the animation itself
+		bool active = false;
+		bool loop = true;
+		float start = 0;
+		float end = 0;
+		float time = 0;
+		float speed = 1.f;
+		Diligent::float3 boundsCenter = { 0, 0, 0 };
+		float boundsRadius = 0;
+		uint32_t phase = 0;
+		uint32_t firstChannel = 0;		// translations and scales first, then rotations
+		uint32_t vectorChannelCount = 0;
+		uint32_t rotationChannelCount = 0;
+	};
+
+	// per job scratch, so sampling never allocates once it has warmed up
+	struct SampleScratch
+	{
+		std::vector<Diligent::float4> from;
+		std::vector<Diligent::float4> to;
+		std::vector<float> weights;
+		std::vector<Diligent::float4> results;
+	};
+
+	uint32_t CreateInstance( const Diligent::GLTF::Animation* animation, const void* owner, bool loop );
+	uint32_t UpdateInterval( const Instance& instance ) const;
+	void SampleInstance( uint32_t instance, SampleScratch* scratch );
+	void GatherKeys( uint32_t firstChannel, uint32_t channelCount, float time, SampleScratch* scratch );
+	void CompactChannels();
+
+	SceneTransforms* m_transforms = nullptr;
+	uint32_t m_transformsVersion = UINT32_MAX;
+	AnimationLodSettings m_lodSettings;
+
+	std::vector<Instance> m_instances;
+	std::vector<Channel> m_channels;
+	std::vector<uint32_t> m_keyIndices;		// per channel, the key it was last at or after
+	uint32_t m_deadChannelCount = 0;
+
+	bool m_haveViews = false;
+	Diligent::float3 m_viewerPosition = { 0, 0, 0 };
+	Diligent::float4x4 m_stageToEye[ 2 ];
+	Diligent::float4 m_eyePlanes[ 2 ][ 4 ];		// inward side planes in eye space
+
+	uint64_t m_frameIndex = 0;
+	std::vector<uint32_t> m_dueInstances;
+	std::vector<SampleScratch> m_scratch;
+	AnimationStats m_lastStats;
+};
+
+}
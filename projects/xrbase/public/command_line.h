@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+namespace XRDE
+{
+	// Tokens are matched as whole arguments, so "-offline" doesn't match "-offline-output" and a value that
+	// happens to contain another key isn't mistaken for it. Keys that take a value end in a space.
+	bool HasCommandLineFlag( const std::string& cmdLine, const char* flag );
+
+	// Finds "<key> <value>" on the command line and returns the value token
+	bool GetCommandLineValue( const std::string& cmdLine, const char* key, std::string* value );
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <DeviceContext.h>
+#include <CommandList.h>
+#include <RefCntAutoPtr.hpp>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace XRDE
+{
+
+// Records draw submission on worker threads, one thread per Diligent deferred context. The chunks of work are
+// split into contiguous ranges so that executing the resulting command lists in context order preserves the
+// original draw order.
+//
+// Deferred contexts can't transition resource states, so everything the chunks touch has to be put into the
+// right state on the immediate context before recording, and chunks must record with
+// RESOURCE_STATE_TRANSITION_MODE_VERIFY or NONE. Dynamic buffers are per context in Diligent, so per-draw
+// constants that are mapped on the immediate context are not visible to the chunks either.
+class DeferredCommandRecorder
+{
+public:
+	// Called once per context before any chunks are recorded into it, typically to bind render targets
+	typedef std::function<void( Diligent::IDeviceContext* context )> SetupFunction;
+	// Records chunks [ firstChunk, firstChunk + chunkCount ) into the context
+	typedef std::function<void( Diligent::IDeviceContext* context, uint32_t firstChunk, uint32_t chunkCount )> RecordFunction;
+
+	~DeferredCommandRecorder();
+
+	void Init( const std::vector<Diligent::IDeviceContext*>& deferredContexts );
+	void Shutdown();
+
+	uint32_t GetContextCount() const { return (uint32_t)m_contexts.size(); }
+
+	// Only the first count contexts record, so one run can compare thread counts. Zero records on the immediate
+	// context. Init makes every context active.
+	void SetActiveContextCount( uint32_t count );
+	uint32_t GetActiveContextCount() const { return m_activeContexts; }
+
+	// Blocks until every context has finished recording, then executes the command lists on the immediate
+	// context in order.
+	void RecordAndExecute( Diligent::IDeviceContext* immediateContext, uint32_t chunkCount,
+		const SetupFunction& setup, const RecordFunction& record );
+
+	// Must be called once per frame after the immediate context has finished the frame
+	void FinishFrame();
+
+private:
+	void WorkerThread( uint32_t workerIndex );
+
+	std::vector< Diligent::RefCntAutoPtr<Diligent::IDeviceContext> > m_contexts;
+	std::vector< Diligent::RefCntAutoPtr<Diligent::ICommandList> > m_commandLists;
+	std::vector< std::thread > m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_workReady;
+	std::condition_variable m_workDone;
+	uint64_t m_generation = 0;
+	uint32_t m_pendingWorkers = 0;
+	uint32_t m_activeContexts = 0;
+	bool m_shutdown = false;
+
+	// state for the current RecordAndExecute call, only valid while m_pendingWorkers is non-zero
+	uint32_t m_chunkCount = 0;
+	uint32_t m_recordingContexts = 0;
+	const SetupFunction* m_setup = nullptr;
+	const RecordFunction* m_record = nullptr;
+};
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "igraphicsbinding.h"
+#include "memory_budget.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace XRDE
+{
+
+enum class CompositionLayerShape
+{
+	Quad,
+	Cylinder,	// needs XR_KHR_composition_layer_cylinder
+};
+
+struct CompositionLayerDesc
+{
+	CompositionLayerShape shape = CompositionLayerShape::Quad;
+
+	// size of the layer's swapchain images in pixels
+	uint32_t width = 1024;
+	uint32_t height = 1024;
+
+	// the layer is placed at pose in space, or in the stage if space is null
+	XrSpace space = XR_NULL_HANDLE;
+	XrPosef pose = { { 0, 0, 0, 1 }, { 0, 0, 0 } };
+	XrEyeVisibility eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+
+	// quads, in meters
+	XrExtent2Df size = { 1.f, 1.f };
+
+	// cylinders, in meters and radians, aspectRatio is width over height
+	float radius = 1.f;
+	float centralAngle = 1.f;
+	float aspectRatio = 1.f;
+
+	// a dirty layer is re-rendered at most once per interval, in seconds of display time, 0 for every frame
+	double minUpdateInterval = 0;
+
+	// blend with what's behind the layer using the alpha channel, which is premultiplied unless told otherwise
+	bool alphaBlend = true;
+	bool premultipliedAlpha = true;
+	float clearColor[ 4 ] = { 0, 0, 0, 0 };
+};
+
+// Records a layer's content into target. The render target is already bound, cleared to the layer's clear
+// color and sized to the whole image.
+typedef std::function<void( Diligent::IDeviceContext* context, Diligent::ITextureView* target, uint32_t width, uint32_t height )>
+	CompositionLayerRenderFn;
+
+// Owns the swapchains of quad and cylinder layers that are submitted alongside the projection layer. A layer is
+// only re-rendered when it's marked dirty. On every other frame the compositor reprojects the last image it was
+// given, so panels and HUDs that rarely change cost a layer's worth of composition instead of two eyes of
+// rendering. Text in a layer is only resampled once, by the compositor, so it stays sharper too.
+//
+// Everything but MarkDirty has to be called from the render thread. The swapchains keep the runtime's usual
+// image count, because a static image swapchain can only be acquired once and these are re-rendered.
+class CompositionLayerManager
+{
+public:
+	static const uint32_t k_invalidLayer = UINT32_MAX;
+
+	~CompositionLayerManager() { Shutdown(); }
+
+	// format is the swapchain format the layers are created with, usually the same one as the eyes
+	void Init( XrSession session, XrSpace stageSpace, IGraphicsBinding* graphicsBinding, MemoryBudget* memoryBudget,
+		int64_t format, bool cylinderSupported );
+	void Shutdown();
+	bool IsInitialized() const { return m_session != XR_NULL_HANDLE; }
+
+	// Creates the layer's swapchain and returns its handle, or k_invalidLayer. The layer starts dirty.
+	uint32_t AddLayer( const CompositionLayerDesc& desc, const CompositionLayerRenderFn& render );
+	void RemoveLayer( uint32_t layer );
+
+	// Safe to call from any thread, it takes the lock that adding and removing layers takes
+	void MarkDirty( uint32_t layer );
+
+	void SetPose( uint32_t layer, const XrPosef& pose );
+	void SetVisible( uint32_t layer, bool visible );
+
+	// Re-renders the dirty layers that are due at displayTime. Call once per rendered frame, before the frame's
+	// layers are appended.
+	bool UpdateLayers( Diligent::IDeviceContext* context, XrTime displayTime );
+
+	// Appends a header for every visible layer that has been rendered at least once. The headers stay valid
+	// until the next call.
+	void AppendLayers( std::vector<XrCompositionLayerBaseHeader*>& layers );
+
+	// layer images rendered, and layers submitted without being re-rendered
+	uint64_t GetRenderCount() const { return m_renderCount; }
+	uint64_t GetReuseCount() const { return m_reuseCount; }
+	void PrintSummary( std::ostream& out ) const;
+
+private:
+	struct Layer
+	{
+		CompositionLayerDesc desc;
+		CompositionLayerRenderFn render;
+		XrSwapchain swapchain = XR_NULL_HANDLE;
+		std::vector< Diligent::RefCntAutoPtr<Diligent::ITexture> > textures;
+		std::vector< Diligent::RefCntAutoPtr<Diligent::ITextureView> > targets;
+		std::atomic<bool> dirty { true };
+		bool visible = true;
+		bool hasContent = false;
+		bool renderedThisFrame = false;
+		XrTime lastRenderTime = 0;
+
+		XrCompositionLayerQuad quad = { XR_TYPE_COMPOSITION_LAYER_QUAD };
+		XrCompositionLayerCylinderKHR cylinder = { XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR };
+	};
+
+	Layer* GetLayer( uint32_t layer );
+	void DestroyLayer( Layer& layer );
+	bool RenderLayer( Diligent::IDeviceContext* context, Layer& layer );
+
+	XrSession m_session = XR_NULL_HANDLE;
+	XrSpace m_stageSpace = XR_NULL_HANDLE;
+	IGraphicsBinding* m_graphicsBinding = nullptr;
+	MemoryBudget* m_memoryBudget = nullptr;
+	int64_t m_format = 0;
+	bool m_cylinderSupported = false;
+
+	// removed layers leave a null behind so the handles of the others don't change. Only the render thread
+	// changes the list, and it holds m_mutex while it does so MarkDirty can look layers up from other threads.
+	std::vector< std::unique_ptr<Layer> > m_layers;
+	std::mutex m_mutex;
+
+	uint64_t m_renderCount = 0;
+	uint64_t m_reuseCount = 0;
+};
+
+}
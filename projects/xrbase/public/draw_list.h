@@ -0,0 +1,219 @@
+#pragma once
+
+#include "memory_budget.h"
+#include "occlusion_culler.h"
+#include "render_graph.h"
+
+#include <RenderDevice.h>
+#include <DeviceContext.h>
+#include <PipelineState.h>
+#include <ShaderResourceBinding.h>
+#include <RefCntAutoPtr.hpp>
+#include <BasicMath.hpp>
+
+#include <map>
+#include <vector>
+
+namespace XRDE
+{
+
+// Geometry that can be drawn many times. Vertex buffers go in slots 0 through vertexBufferCount - 1. Meshes
+// without an index buffer draw indexCount vertices starting at baseVertex. The bounding sphere is only used for
+// culling, and meshes without one are never culled.
+struct DrawListMesh
+{
+	static const uint32_t k_maxVertexBuffers = 4;
+
+	Diligent::IBuffer* vertexBuffers[ k_maxVertexBuffers ] = {};
+	Diligent::Uint32 vertexOffsets[ k_maxVertexBuffers ] = {};
+	uint32_t vertexBufferCount = 1;
+	Diligent::IBuffer* indexBuffer = nullptr;
+	Diligent::VALUE_TYPE indexType = Diligent::VT_UINT32;
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t baseVertex = 0;
+
+	Diligent::float3 boundsCenter = { 0, 0, 0 };
+	float boundsRadius = 0;
+};
+
+struct DrawListStats
+{
+	uint32_t itemCount = 0;
+	uint32_t drawCount = 0;
+	uint32_t pipelineChanges = 0;
+	uint32_t bindingChanges = 0;
+	uint32_t meshChanges = 0;
+	uint32_t occludedCount = 0;		// items Build left out because the occlusion culler hid them
+};
+
+// Draws submitted as (mesh, material, transform) items. Build sorts the items by a 64 bit key made of the
+// pipeline, the material and the mesh, so the pipeline changes as rarely as possible, then the material, then
+// the mesh. Runs of items that share a mesh and a material become one instanced draw. Their transforms are
+// written to a per-instance vertex buffer, bound in the slot the material names, which the material's
+// pipeline reads as four float4 rows of an object-to-world matrix (see GetInstanceLayoutElements).
+//
+// Items are kept until Clear, so apps with a static scene can submit it once. Everything has to be called
+// from the render thread.
+//
+// With GPU culling, Build uploads every instance along with the draw it belongs to, and Cull tests them against
+// both eye frusta in a compute shader. The visible instances are compacted into a second instance buffer and
+// counted into one indirect draw per batch, and Draw issues those. The CPU cost of culling and drawing then
+// only depends on the number of batches, not on the number of items.
+class DrawList
+{
+public:
+	static const uint32_t k_invalidHandle = UINT32_MAX;
+
+	void Init( Diligent::IRenderDevice* device, MemoryBudget* memoryBudget = nullptr );
+	void Shutdown();
+
+	// Meshes and materials are registered once and referred to by handle. The list holds a reference to
+	// every object they use until Shutdown.
+	uint32_t AddMesh( const DrawListMesh& mesh );
+	uint32_t AddMaterial( Diligent::IPipelineState* pipeline, Diligent::IShaderResourceBinding* binding,
+		uint32_t instanceBufferSlot = 1 );
+
+	// The input layout elements that read the instance transform, at inputs firstInput to firstInput + 3
+	static void GetInstanceLayoutElements( uint32_t firstInput, uint32_t bufferSlot, Diligent::LayoutElement elements[ 4 ] );
+
+	void Clear();
+	void Submit( uint32_t mesh, uint32_t material, const Diligent::float4x4& objectToWorld );
+	uint32_t GetItemCount() const { return (uint32_t)m_items.size(); }
+
+	// Sorts the items, merges them into instanced draws and uploads the transforms. Maps a dynamic buffer, so
+	// it has to run outside of render passes, once per frame before the first Draw.
+	void Build( Diligent::IDeviceContext* context );
+
+	// Reads every mesh buffer the built draws use, the instance buffer when it isn't dynamic, and the culling
+	// outputs when they are used.
+	void DeclareResources( RenderGraphPassBuilder& pass ) const;
+
+	// Issues the built draws. The caller sets the render targets and whatever constants the pipelines share.
+	void Draw( Diligent::IDeviceContext* context,
+		Diligent::RESOURCE_STATE_TRANSITION_MODE transitionMode = Diligent::RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+
+	// What the last Draw did
+	const DrawListStats& GetLastStats() const { return m_lastStats; }
+
+	// Build writes the instance transforms into a default buffer with UpdateBuffer instead of mapping a dynamic
+	// one, because deferred contexts can't see what the immediate context mapped. Takes effect at the next Build.
+	void SetDeferredRecording( bool enabled ) { m_deferredRecording = enabled; }
+	bool IsDeferredRecordingEnabled() const { return m_deferredRecording; }
+
+	// Draw in pieces, one draw per batch, for recording on several contexts at once (see DeferredCommandRecorder).
+	// Every call sets its own pipeline and bindings, and none of them touch GetLastStats.
+	uint32_t GetBatchCount() const { return (uint32_t)m_batches.size(); }
+	void DrawBatches( Diligent::IDeviceContext* context, uint32_t firstBatch, uint32_t batchCount,
+		Diligent::RESOURCE_STATE_TRANSITION_MODE transitionMode = Diligent::RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+
+	// Build leaves out items whose bounds the culler says are hidden, once it has rasterized something. The
+	// caller has to wait for the culler's jobs before Build.
+	void SetOcclusionCuller( const OcclusionCuller* culler ) { m_occlusionCuller = culler; }
+
+	// Takes effect at the next Build
+	void SetGpuCulling( bool enabled ) { m_gpuCulling = enabled; }
+	bool IsGpuCullingEnabled() const { return m_gpuCulling; }
+
+	// Cull runs in a compute pass after Build and before the first Draw. viewProj is the stage-to-clip
+	// transform of each eye. Instances are kept if either eye can see them, so both eyes share the results.
+	void DeclareCullResources( RenderGraphPassBuilder& pass ) const;
+	void Cull( Diligent::IDeviceContext* context, const Diligent::float4x4 viewProj[ 2 ] );
+
+private:
+	struct Mesh
+	{
+		DrawListMesh desc;
+		Diligent::RefCntAutoPtr<Diligent::IBuffer> references[ DrawListMesh::k_maxVertexBuffers + 1 ];
+	};
+
+	struct Material
+	{
+		uint32_t pipeline;
+		Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> binding;
+		uint32_t instanceBufferSlot;
+	};
+
+	struct Item
+	{
+		uint64_t key;
+		uint32_t index;		// into m_transforms
+	};
+
+	struct Batch
+	{
+		uint32_t mesh;
+		uint32_t material;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// match the structures in the culling shader
+	struct CullInstance
+	{
+		Diligent::float4x4 transform;
+		uint32_t batch;
+		uint32_t pad[ 3 ];
+	};
+
+	struct CullBatch
+	{
+		Diligent::float4 sphere;
+		uint32_t firstInstance;
+		uint32_t argsOffset;
+		uint32_t pad[ 2 ];
+	};
+
+	void FilterOccludedItems();
+	void SortItems();
+	bool ReserveInstances( uint32_t count );
+	void DrawRange( Diligent::IDeviceContext* context, uint32_t firstBatch, uint32_t endBatch,
+		Diligent::RESOURCE_STATE_TRANSITION_MODE transitionMode, DrawListStats* stats );
+	bool CreateCullPipeline();
+	bool ReserveCullBuffers( uint32_t instanceCount, uint32_t batchCount );
+	void UploadCullInputs( Diligent::IDeviceContext* context );
+	bool UsingCulledDraws() const { return m_cullReady && !m_batches.empty(); }
+
+	Diligent::IRenderDevice* m_device = nullptr;
+	MemoryBudget* m_memoryBudget = nullptr;
+
+	std::vector<Mesh> m_meshes;
+	std::vector<Material> m_materials;
+	std::vector< Diligent::RefCntAutoPtr<Diligent::IPipelineState> > m_pipelines;
+	std::map<Diligent::IPipelineState*, uint32_t> m_pipelineIndices;
+
+	std::vector<Item> m_items;
+	std::vector<Item> m_builtItems;		// the items that weren't occluded, sorted by Build
+	std::vector<Item> m_sortScratch;
+	std::vector<Diligent::float4x4> m_transforms;
+	std::vector<Batch> m_batches;
+
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_instanceBuffer;
+	uint32_t m_instanceCapacity = 0;
+	bool m_deferredRecording = false;
+	bool m_instanceBufferIsDefault = false;
+	std::vector<Diligent::float4x4> m_instanceData;		// staging for UpdateBuffer with deferred recording
+
+	DrawListStats m_lastStats;
+
+	const OcclusionCuller* m_occlusionCuller = nullptr;
+	uint32_t m_occludedCount = 0;
+
+	bool m_gpuCulling = false;
+	bool m_cullReady = false;	// Build uploaded this frame's culling inputs
+	Diligent::RefCntAutoPtr<Diligent::IPipelineState> m_cullPipeline;
+	bool m_cullPipelineFailed = false;	// logged once, and not tried again until Shutdown
+	Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_cullBinding;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_cullConstants;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_cullInstances;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_cullBatches;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_culledInstances;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_drawArgs;
+	uint32_t m_cullInstanceCapacity = 0;
+	uint32_t m_cullBatchCapacity = 0;
+	std::vector<CullInstance> m_cullInstanceData;
+	std::vector<CullBatch> m_cullBatchData;
+	std::vector<uint32_t> m_drawArgData;
+};
+
+}
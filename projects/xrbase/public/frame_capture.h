@@ -0,0 +1,136 @@
+#pragma once
+
+#include "texture_readback.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace XRDE
+{
+
+// Receives captured eye images on the capture thread, one call per eye per frame. The frame's data is only
+// valid during the call.
+class ICaptureSink
+{
+public:
+	virtual ~ICaptureSink() {}
+
+	// Called once from the render thread before any frames arrive
+	virtual bool Begin( uint32_t maxWidth, uint32_t maxHeight, Diligent::TEXTURE_FORMAT format ) { return true; }
+	virtual void WriteFrame( const ReadbackFrame& frame ) = 0;
+};
+
+// Writes each eye image to <directory>/capture_<frame>_eye<eye>.ppm, or .raw for formats PPM can't hold
+class CaptureFileSink : public ICaptureSink
+{
+public:
+	explicit CaptureFileSink( const std::string& directory ) : m_directory( directory ) {}
+
+	virtual bool Begin( uint32_t maxWidth, uint32_t maxHeight, Diligent::TEXTURE_FORMAT format ) override;
+	virtual void WriteFrame( const ReadbackFrame& frame ) override;
+
+private:
+	std::string m_directory;
+	bool m_ppm = false;
+};
+
+// Layout of the shared memory written by CaptureSharedMemorySink. The header is followed, at imageOffset, by
+// one image per eye, each imageSize bytes apart, with rows packed imageStride bytes apart.
+//
+// Each eye is guarded by a sequence counter that is odd while the image is being written. Readers should read
+// the sequence, copy the image and header fields, and retry if the sequence was odd or has changed.
+struct CaptureSharedMemoryHeader
+{
+	static const uint32_t k_magic = 0x50435258; // "XRCP"
+	static const uint32_t k_version = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t maxWidth;
+	uint32_t maxHeight;
+	uint32_t format;		// Diligent::TEXTURE_FORMAT
+	uint32_t imageStride;
+	uint64_t imageOffset;
+	uint64_t imageSize;
+
+	struct Eye
+	{
+		std::atomic<uint64_t> sequence;
+		uint64_t frameIndex;
+		uint32_t width;
+		uint32_t height;
+	};
+	Eye eyes[ 2 ];
+};
+
+// Publishes the latest image of each eye in a named shared memory block for a local encoder or viewer to pick
+// up. On Windows it's a named file mapping, elsewhere a POSIX shared memory object.
+class CaptureSharedMemorySink : public ICaptureSink
+{
+public:
+	explicit CaptureSharedMemorySink( const std::string& name ) : m_name( name ) {}
+	virtual ~CaptureSharedMemorySink();
+
+	virtual bool Begin( uint32_t maxWidth, uint32_t maxHeight, Diligent::TEXTURE_FORMAT format ) override;
+	virtual void WriteFrame( const ReadbackFrame& frame ) override;
+
+private:
+	std::string m_name;
+	CaptureSharedMemoryHeader* m_header = nullptr;
+	uint8_t* m_memory = nullptr;
+	size_t m_size = 0;
+	void* m_mapping = nullptr;
+	uint32_t m_bytesPerPixel = 0;
+};
+
+// Captures what the headset was shown without stalling the render thread. Capture copies both eyes of a
+// swapchain image into a TextureReadbackRing before the image goes back to the runtime. Copies the GPU has
+// finished are mapped, without waiting, on a later frame and handed to a capture thread through a lock-free
+// queue. The capture thread passes them to the sink and hands them back to be unmapped.
+//
+// Nothing on the render thread ever waits for the sink. When it falls behind, the staging textures stay
+// mapped, the ring fills up and new frames are dropped.
+class FrameCapture
+{
+public:
+	~FrameCapture() { Shutdown( nullptr ); }
+
+	// depth is the number of eye images that can be in flight or waiting for the sink at once
+	bool Init( Diligent::IRenderDevice* device, const Diligent::TextureDesc& swapchainDesc, std::unique_ptr<ICaptureSink> sink,
+		uint32_t depth = 6 );
+	void Shutdown( Diligent::IDeviceContext* context );
+	bool IsEnabled() const { return m_sink != nullptr; }
+
+	// Call on the render thread after both eyes are rendered into texture and before it's released
+	void Capture( Diligent::IDeviceContext* context, Diligent::ITexture* texture, uint32_t width, uint32_t height );
+
+	// eye images written to the sink, and whole frames dropped because the ring was full
+	uint64_t GetCapturedCount() const { return m_captured.load( std::memory_order_relaxed ); }
+	uint64_t GetDroppedCount() const { return m_dropped; }
+	const TextureReadbackRing& GetRing() const { return m_ring; }
+
+private:
+	void CaptureThread();
+
+	TextureReadbackRing m_ring;
+	std::unique_ptr<ICaptureSink> m_sink;
+	uint64_t m_frameIndex = 0;
+	uint64_t m_dropped = 0;
+
+	// mapped frames go to the capture thread on one queue and come back to be unmapped on the other
+	std::unique_ptr< SpscQueue<ReadbackFrame> > m_mappedFrames;
+	std::unique_ptr< SpscQueue<uint32_t> > m_finishedFrames;
+
+	std::thread m_thread;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+	std::atomic<bool> m_stop { false };
+	std::atomic<uint64_t> m_captured { 0 };
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <ostream>
+
+namespace XRDE
+{
+
+enum class FrameMissCause
+{
+	Cpu,		// the app's own CPU work on the frame took longer than a display period
+	Gpu,		// the GPU took longer than a display period to render the frame
+	Runtime,	// neither, so the runtime or compositor held the frame back
+
+	Count
+};
+
+const char* FrameMissCauseName( FrameMissCause cause );
+
+// One or more display slots that went by without a new frame from the app
+struct FrameMiss
+{
+	uint64_t frameIndex = 0;		// the frame that was late
+	XrTime displayTime = 0;			// the display time it was predicted for
+	uint32_t missedSlots = 0;
+	FrameMissCause cause = FrameMissCause::Runtime;
+	double periodSeconds = 0;
+	double cpuSeconds = 0;			// from xrWaitFrame returning to the next xrWaitFrame call, minus runtimeSeconds
+	double runtimeSeconds = 0;		// blocked in the runtime's other frame and swapchain calls
+	double gpuSeconds = -1;			// negative if the GPU time never came back
+};
+
+struct FramePacingSettings
+{
+	// a frame is CPU or GPU bound if it took more than this fraction of the display period on one of them
+	double boundFraction = 0.9;
+
+	// GPU times arrive a few frames late, so misses wait up to this many frames for theirs before being
+	// classified without it
+	uint32_t gpuWaitFrames = 8;
+};
+
+// Watches the display times the runtime predicts for skipped display slots, works out whether the app's CPU
+// work, the GPU or the runtime was to blame for each one, and keeps track of how long the runtime asks the app
+// not to render.
+class FramePacingAnalyzer
+{
+public:
+	typedef std::function<void( const FrameMiss& miss )> MissCallback;
+
+	void SetSettings( const FramePacingSettings& settings ) { m_settings = settings; }
+	void SetMissCallback( const MissCallback& callback ) { m_missCallback = callback; }
+
+	// Call after every xrWaitFrame with the time before and after the call, in seconds on any clock
+	void FrameWaited( double waitStartSeconds, double waitEndSeconds, const XrFrameState& frameState );
+
+	// Call after xrEndFrame with the time spent in the runtime's other frame calls since xrWaitFrame, and the
+	// GPU profiler's frame index if the frame was rendered and profiled, or -1
+	void FrameEnded( double runtimeSeconds, int64_t gpuFrame );
+
+	// Call whenever a GPU time for a profiled frame comes back
+	void GpuFrameTimed( int64_t gpuFrame, double gpuSeconds );
+
+	// Classifies whatever is still waiting for GPU times
+	void Flush();
+
+	uint64_t GetFrameCount() const { return m_frameCount; }
+	uint64_t GetMissedSlotCount() const { return m_missedSlots; }
+	uint64_t GetMissCount( FrameMissCause cause ) const { return m_misses[ (int)cause ]; }
+	uint32_t GetNoRenderStreak() const { return m_noRenderStreak; }
+
+	void PrintSummary( std::ostream& out ) const;
+
+private:
+	struct Frame
+	{
+		uint64_t index = 0;
+		XrTime displayTime = 0;
+		XrDuration displayPeriod = 0;
+		double waitEndSeconds = 0;
+		double cpuSeconds = -1;			// negative until the next frame's wait starts
+		double runtimeSeconds = 0;
+		int64_t gpuFrame = -1;
+		double gpuSeconds = -1;
+	};
+
+	struct PendingMiss
+	{
+		uint64_t frameIndex;
+		uint32_t missedSlots;
+		uint64_t detectedFrame;
+	};
+
+	Frame* FindFrame( uint64_t index );
+	void ResolvePendingMisses( bool force );
+	void Classify( const Frame& frame, uint32_t missedSlots );
+
+	FramePacingSettings m_settings;
+	MissCallback m_missCallback;
+
+	std::deque<Frame> m_frames;				// the most recent frames, oldest first
+	std::deque<PendingMiss> m_pendingMisses;
+	uint64_t m_frameCount = 0;
+
+	uint64_t m_missedSlots = 0;
+	uint64_t m_misses[ (int)FrameMissCause::Count ] = {};
+	uint64_t m_missedSlotsByCause[ (int)FrameMissCause::Count ] = {};
+	double m_worstMissSeconds = 0;
+
+	uint32_t m_noRenderStreak = 0;
+	uint32_t m_longestNoRenderStreak = 0;
+	uint64_t m_noRenderStreaks = 0;
+	uint64_t m_noRenderFrames = 0;
+};
+
+}
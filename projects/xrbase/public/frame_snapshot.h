@@ -0,0 +1,23 @@
+#pragma once
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+
+#include <vector>
+
+namespace XRDE
+{
+
+// Everything the render thread needs from one step of the simulation. The layout of the arrays is up to the
+// app. Snapshots are reused from frame to frame, so resize the arrays instead of reallocating them.
+struct FrameSnapshot
+{
+	XrTime displayTime = 0;		// the display time the simulation was run for
+	double simulationTime = 0;
+
+	std::vector<Diligent::float4x4> transforms;
+	std::vector<Diligent::float4x4> skinMatrices;
+	std::vector<uint8_t> visibility;
+};
+
+}
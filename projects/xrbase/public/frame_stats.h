@@ -0,0 +1,23 @@
+#pragma once
+
+#include "gpu_profiler.h"
+
+#include <vector>
+
+namespace XRDE
+{
+
+// Timing for the most recent frame XrAppBase has complete numbers for. GPU numbers lag the CPU numbers by
+// the GPU profiler's read back latency.
+struct FrameStatistics
+{
+	double cpuFrameSeconds = 0;		// RunMainFrame start to start
+	double cpuWaitSeconds = 0;		// blocked in xrWaitFrame
+	double cpuWorkSeconds = 0;		// the rest of the frame
+	double displayPeriodSeconds = 0;	// predicted display period, zero if the session isn't running
+	double cpuSubmitSeconds = 0;	// recording both eyes
+	double gpuFrameSeconds = 0;		// everything between GpuProfiler::BeginFrame and EndFrame
+	std::vector<GpuPassTiming> gpuPasses;
+};
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <GLTFLoader.hpp>
+#include <GLTFResourceManager.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace XRDE
+{
+
+// One model the app expects to load. Counts of zero mean "unknown" and the policy will fall back to a single
+// default page for that model and let the pool grow if it turns out to be bigger.
+struct GltfModelManifestEntry
+{
+	std::string path;
+	uint32_t vertexCount = 0;
+	uint32_t skinnedVertexCount = 0;
+	uint32_t indexCount = 0;
+};
+
+// Reads a manifest file with one model per line:
+//    <path> [<vertexCount> <skinnedVertexCount> <indexCount>]
+// Blank lines and lines starting with # are ignored.
+bool LoadGltfModelManifest( const std::string& manifestPath, std::vector<GltfModelManifestEntry>* entries );
+
+enum GltfPool : uint32_t
+{
+	GltfPool_BasicVertexAttribs = 0,
+	GltfPool_SkinVertexAttribs = 1,
+	GltfPool_Indices = 2,
+
+	GltfPool_Count
+};
+
+struct GltfPoolStats
+{
+	const char* name = nullptr;
+	uint64_t committedBytes = 0;	// size of the GPU buffer backing the pool
+	uint64_t usedBytes = 0;			// bytes owned by models that are currently loaded
+	uint64_t highWaterBytes = 0;	// most bytes ever used since the pool was (re)created
+	uint32_t pageCount = 0;			// committedBytes in units of the pool's page size
+	uint32_t liveModels = 0;
+
+	// Fraction of the committed buffer below the high water mark that is not owned by a live model. The
+	// suballocator never moves allocations, so this is space that can only be reclaimed by a trim.
+	float fragmentation = 0.f;
+};
+
+// Decides how large the glTF resource cache pools start out, how they grow, and when they can be reset.
+// Replaces the fixed 16K/16K/8K element pools that XrAppBase used to create.
+class GltfCachePolicy
+{
+public:
+	GltfCachePolicy();
+
+	void AddManifestEntry( const GltfModelManifestEntry& entry );
+	void AddManifestEntries( const std::vector<GltfModelManifestEntry>& entries );
+
+	// Pools grow in pages of this many elements once the initial size is exhausted
+	void SetPageElementCount( GltfPool pool, uint32_t elements ) { m_pageElements[ pool ] = elements; }
+	uint32_t GetPageElementCount( GltfPool pool ) const { return m_pageElements[ pool ]; }
+
+	// Makes the vertex pools raw buffers that GpuSkinning can read the skin attributes from and write the
+	// basic ones to. Takes effect the next time the pools are created.
+	void SetGpuSkinning( bool enabled ) { m_gpuSkinning = enabled; }
+	bool IsGpuSkinningEnabled() const { return m_gpuSkinning; }
+
+	// Fills in the suballocator descriptions for Diligent::GLTF::ResourceManager. The initial size of each pool
+	// covers everything in the manifest rounded up to whole pages.
+	void FillBufferSuballocators( Diligent::BufferSuballocatorCreateInfo* buffers, uint32_t bufferCount ) const;
+
+	// Record a model as loaded or released. Call these with every model that uses the cache so usage stays
+	// accurate.
+	void OnModelLoaded( const Diligent::GLTF::Model* model );
+	void OnModelReleased( const Diligent::GLTF::Model* model );
+	uint32_t GetLiveModelCount() const { return (uint32_t)m_liveModels.size(); }
+
+	// Returns true when no models are alive and a pool grew past its initial size because usage went above the
+	// high water mark it had when the cache was last trimmed. The owner can then recreate the resource manager to
+	// get back to a compact set of pages. A pool that only grew back to the size the app needed before keeps its
+	// pages, since the app is likely to need them again.
+	bool ShouldTrim() const;
+	void OnCacheRecreated();
+
+	void UpdateStats( Diligent::GLTF::ResourceManager* resourceManager, Diligent::IRenderDevice* device,
+		Diligent::IDeviceContext* context );
+	const GltfPoolStats& GetStats( GltfPool pool ) const { return m_stats[ pool ]; }
+	std::string FormatStats() const;
+
+	static uint32_t ElementSize( GltfPool pool );
+
+private:
+	struct ModelUsage
+	{
+		uint64_t bytes[ GltfPool_Count ] = {};
+	};
+	static ModelUsage MeasureModel( const Diligent::GLTF::Model* model );
+
+	uint64_t InitialElementCount( GltfPool pool ) const;
+
+	std::vector<GltfModelManifestEntry> m_manifest;
+	uint32_t m_pageElements[ GltfPool_Count ];
+	std::map< const Diligent::GLTF::Model*, ModelUsage > m_liveModels;
+	GltfPoolStats m_stats[ GltfPool_Count ];
+	uint64_t m_trimHighWaterBytes[ GltfPool_Count ] = {};	// the highest usage seen by any earlier trim
+	bool m_gpuSkinning = false;
+};
+
+}
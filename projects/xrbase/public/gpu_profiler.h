@@ -0,0 +1,95 @@
+#pragma once
+
+#include <RenderDevice.h>
+#include <DeviceContext.h>
+#include <Query.h>
+#include <RefCntAutoPtr.hpp>
+
+#include <string>
+#include <vector>
+
+namespace XRDE
+{
+
+struct GpuPassTiming
+{
+	const char* pass;	// same pointer that was passed to BeginPass
+	int eye;			// -1 for work that isn't specific to an eye
+	double seconds;
+};
+
+// Measures GPU time per pass with Diligent duration queries. Queries for a frame live in one of a ring of
+// query sets and are read back several frames later, so reading them never stalls the CPU. If a result still
+// isn't ready by the time its query set comes around again, that frame's results are dropped.
+class GpuProfiler
+{
+public:
+	// latency is the number of frames between issuing a query and reading it back
+	void Init( Diligent::IRenderDevice* device, uint32_t maxPassesPerFrame = 32, uint32_t latency = 4 );
+	bool IsEnabled() const { return !m_frames.empty(); }
+
+	void BeginFrame( Diligent::IDeviceContext* context );
+	void EndFrame( Diligent::IDeviceContext* context );
+
+	// Returns a handle for EndPass. Passes may nest; each is timed on its own.
+	uint32_t BeginPass( Diligent::IDeviceContext* context, const char* pass, int eye = -1 );
+	void EndPass( Diligent::IDeviceContext* context, uint32_t handle );
+
+	// Results from the most recent frame that has been read back
+	const std::vector<GpuPassTiming>& GetPassTimings() const { return m_results; }
+	double GetFrameSeconds() const { return m_frameSeconds; }
+	double GetPassSeconds( const char* pass, int eye = -1 ) const;
+	uint64_t GetResultFrameIndex() const { return m_resultFrameIndex; }
+
+	// Index of the frame between BeginFrame and EndFrame, to match up with GetResultFrameIndex later
+	uint64_t GetFrameIndex() const { return m_frameIndex; }
+
+private:
+	struct PassQuery
+	{
+		Diligent::RefCntAutoPtr<Diligent::IQuery> query;
+		const char* pass;
+		int eye;
+	};
+
+	struct FrameQueries
+	{
+		Diligent::RefCntAutoPtr<Diligent::IQuery> frameQuery;
+		std::vector<PassQuery> passes;
+		uint32_t passCount = 0;
+		uint64_t frameIndex = 0;
+		bool pending = false;
+	};
+
+	void ReadBack( FrameQueries& frame );
+
+	std::vector<FrameQueries> m_frames;
+	uint64_t m_frameIndex = 0;
+	FrameQueries* m_currentFrame = nullptr;
+
+	std::vector<GpuPassTiming> m_results;
+	double m_frameSeconds = 0;
+	uint64_t m_resultFrameIndex = 0;
+};
+
+// Times everything recorded into the context until the end of the scope
+class GpuProfileScope
+{
+public:
+	GpuProfileScope( GpuProfiler& profiler, Diligent::IDeviceContext* context, const char* pass, int eye = -1 )
+		: m_profiler( profiler ), m_context( context )
+	{
+		m_handle = m_profiler.BeginPass( m_context, pass, eye );
+	}
+	~GpuProfileScope()
+	{
+		m_profiler.EndPass( m_context, m_handle );
+	}
+
+private:
+	GpuProfiler& m_profiler;
+	Diligent::IDeviceContext* m_context;
+	uint32_t m_handle;
+};
+
+}
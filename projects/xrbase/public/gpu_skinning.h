@@ -0,0 +1,105 @@
+#pragma once
+
+#include "memory_budget.h"
+#include "render_graph.h"
+
+#include <RenderDevice.h>
+#include <DeviceContext.h>
+#include <PipelineState.h>
+#include <ShaderResourceBinding.h>
+#include <RefCntAutoPtr.hpp>
+#include <BasicMath.hpp>
+#include <GLTFLoader.hpp>
+
+#include <vector>
+
+namespace XRDE
+{
+
+struct GpuSkinningStats
+{
+	uint32_t modelCount = 0;		// skinned models that are registered
+	uint32_t meshCount = 0;			// meshes skinned by the last Dispatch
+	uint32_t vertexCount = 0;
+};
+
+// Skins glTF models in a compute pass, once per pose instead of once per draw. GLTF_PBR_Renderer always draws
+// from the resource cache's vertex pools, so the skinned positions and normals are written back into the model's
+// own slot in the basic vertex attribute pool, and the bind pose is kept in a copy of that pool. Update zeroes
+// the joint count of every mesh it picks up, so the renderer takes its non-skinned path for both eyes, the mirror
+// and anything else that draws the model until it is posed again.
+//
+// The pools need to be created with GltfCachePolicy::SetGpuSkinning so the compute pass can read and write them.
+// Meshes are picked up when their joint count is non-zero, which Node::UpdateTransforms sets, so a model that
+// isn't posed again is neither skinned again nor drawn with its skin applied twice.
+class GpuSkinning
+{
+public:
+	void Init( Diligent::IRenderDevice* device, MemoryBudget* memoryBudget = nullptr );
+	void Shutdown();
+
+	// Copies the model's bind pose out of the basic attribute pool, so call it right after loading. Models
+	// without skins are ignored.
+	void AddModel( Diligent::IDeviceContext* context, Diligent::GLTF::Model* model, Diligent::IBuffer* basicAttribs );
+	void RemoveModel( const Diligent::GLTF::Model* model );
+
+	// Collects the joint matrices of every mesh that was posed since the last call and uploads them, so it has
+	// to run outside of render passes. Returns true if there is something to dispatch.
+	bool Update( Diligent::IDeviceContext* context, Diligent::IBuffer* basicAttribs, Diligent::IBuffer* skinAttribs );
+
+	// Writes the vertex pool, so it has to come before every pass that draws the models
+	void DeclareResources( RenderGraphPassBuilder& pass ) const;
+	void Dispatch( Diligent::IDeviceContext* context,
+		Diligent::RESOURCE_STATE_TRANSITION_MODE transitionMode = Diligent::RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+
+	const GpuSkinningStats& GetLastStats() const { return m_lastStats; }
+
+private:
+	struct SkinnedMesh
+	{
+		Diligent::GLTF::Node* node;
+		uint32_t firstVertex;		// in the pool
+		uint32_t vertexCount;
+	};
+
+	struct SkinnedModel
+	{
+		const Diligent::GLTF::Model* model;
+		std::vector<SkinnedMesh> meshes;
+	};
+
+	// matches the structure in the skinning shader
+	struct SkinChunk
+	{
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstJoint;
+		uint32_t pad;
+	};
+
+	bool CreatePipeline();
+	bool SyncBindPose( Diligent::IDeviceContext* context, Diligent::IBuffer* basicAttribs );
+	bool ReserveBuffers( uint32_t jointCount, uint32_t chunkCount );
+
+	Diligent::IRenderDevice* m_device = nullptr;
+	MemoryBudget* m_memoryBudget = nullptr;
+
+	std::vector<SkinnedModel> m_models;
+
+	Diligent::RefCntAutoPtr<Diligent::IPipelineState> m_pipeline;
+	Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> m_binding;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_basicAttribs;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_skinAttribs;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_bindPose;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_joints;
+	Diligent::RefCntAutoPtr<Diligent::IBuffer> m_chunks;
+	uint32_t m_jointCapacity = 0;
+	uint32_t m_chunkCapacity = 0;
+	bool m_bindingDirty = true;
+
+	std::vector<Diligent::float4x4> m_jointData;
+	std::vector<SkinChunk> m_chunkData;
+	GpuSkinningStats m_lastStats;
+};
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+
+namespace XRDE
+{
+	// Returns the joint this one hangs off of in the XR_EXT_hand_tracking hierarchy. The wrist is its own parent.
+	XrHandJointEXT GetParentJoint( XrHandJointEXT joint );
+
+	// Converts stage space joint locations into transforms relative to each joint's parent
+	void JointsToParentFromLocations( const XrHandJointLocationEXT jointLocations[ XR_HAND_JOINT_COUNT_EXT ],
+		Diligent::float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ] );
+}
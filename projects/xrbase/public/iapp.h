@@ -14,6 +14,7 @@ public:
 	virtual bool Initialize( HWND hwnd ) = 0;
 	virtual void WindowResize( uint32_t width, uint32_t height ) = 0;
 	virtual void RunMainFrame() = 0;
+	virtual void KeyPressed( wchar_t key ) {}
 
 };
 
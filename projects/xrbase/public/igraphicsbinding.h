@@ -29,6 +29,11 @@ public:
 	virtual Diligent::IEngineFactory* GetEngineFactory() = 0;
 	virtual Diligent::IRenderDevice* GetRenderDevice() = 0;
 	virtual Diligent::IDeviceContext* GetImmediateContext() = 0;
+
+	// Deferred contexts for recording command lists on worker threads. The count must be set before CreateDevice.
+	virtual void SetDeferredContextCount( uint32_t count ) = 0;
+	virtual uint32_t GetDeferredContextCount() = 0;
+	virtual Diligent::IDeviceContext* GetDeferredContext( uint32_t index ) = 0;
 	virtual std::vector<int64_t> GetRequestedColorFormats() = 0;
 	virtual std::vector<int64_t> GetRequestedDepthFormats() = 0;
 	virtual void* GetSessionBinding() = 0;
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace XRDE
+{
+
+enum class TraceChannelKind : uint8_t
+{
+	FrameState = 1,
+	Views,
+	SessionState,
+	BooleanAction,
+	FloatAction,
+	Vector2Action,
+	SpaceLocation,
+	HandJoints,
+	ViewConfiguration,
+};
+
+// Records everything the app reads from the runtime so a session can be replayed without one.
+//
+// Each source of data (the frame loop, the views, one action on one subaction path, one hand...) gets a
+// channel. A channel's records are replayed in the order they were recorded, independently of every other
+// channel, so data read on different threads doesn't have to be read in the same interleaving on replay. Each
+// channel must only be read or written by one thread at a time.
+//
+// Values are quantized (0.1mm positions, 1/32767 quaternion components and action values) and stored as
+// variable length deltas from the previous record on the same channel. A hand with all 26 joints tracked
+// typically takes a few hundred bytes per sample, so 1kHz of hand data is well under a megabyte a second.
+// Channels are buffered in memory and written to the file in chunks.
+class InputTrace
+{
+public:
+	static const uint32_t k_invalidChannel = ~0u;
+
+	~InputTrace() { Close(); }
+
+	bool StartRecording( const std::string& path );
+	bool StartReplay( const std::string& path );
+	void Close();
+
+	bool IsRecording() const { return m_file != nullptr; }
+	bool IsReplaying() const { return m_replaying; }
+
+	// Returns the id of a channel, creating it if it doesn't exist yet. Safe to call from any thread. Records on
+	// k_invalidChannel are dropped and replays from it fail.
+	uint32_t GetChannel( TraceChannelKind kind, const std::string& name );
+
+	// The Replay functions return false when the channel has no more records. Output structures must have
+	// their type set, just like they would for the runtime.
+	void RecordFrameState( uint32_t channel, const XrFrameState& frameState );
+	bool ReplayFrameState( uint32_t channel, XrFrameState* frameState );
+
+	void RecordViews( uint32_t channel, XrResult result, const XrViewState& viewState, uint32_t viewCount, const XrView* views );
+	bool ReplayViews( uint32_t channel, XrResult* result, XrViewState* viewState, uint32_t viewCapacity, uint32_t* viewCount, XrView* views );
+
+	void RecordSessionStates( uint32_t channel, const std::vector<XrSessionState>& states );
+	bool ReplaySessionStates( uint32_t channel, std::vector<XrSessionState>* states );
+
+	void RecordBooleanAction( uint32_t channel, XrResult result, const XrActionStateBoolean& state );
+	bool ReplayBooleanAction( uint32_t channel, XrResult* result, XrActionStateBoolean* state );
+	void RecordFloatAction( uint32_t channel, XrResult result, const XrActionStateFloat& state );
+	bool ReplayFloatAction( uint32_t channel, XrResult* result, XrActionStateFloat* state );
+	void RecordVector2Action( uint32_t channel, XrResult result, const XrActionStateVector2f& state );
+	bool ReplayVector2Action( uint32_t channel, XrResult* result, XrActionStateVector2f* state );
+
+	void RecordSpaceLocation( uint32_t channel, XrResult result, const XrSpaceLocation& location );
+	bool ReplaySpaceLocation( uint32_t channel, XrResult* result, XrSpaceLocation* location );
+
+	// Always XR_HAND_JOINT_COUNT_EXT joints
+	void RecordHandJoints( uint32_t channel, XrResult result, const XrHandJointLocationsEXT& locations );
+	bool ReplayHandJoints( uint32_t channel, XrResult* result, XrHandJointLocationsEXT* locations );
+
+	// The recommended view sizes, recorded once so offline replays can size their eye textures
+	void RecordViewConfiguration( uint32_t channel, uint32_t viewCount, const XrViewConfigurationView* views );
+	bool ReplayViewConfiguration( uint32_t channel, uint32_t viewCapacity, uint32_t* viewCount, XrViewConfigurationView* views );
+
+	uint64_t GetRecordedBytes() const { return m_bytesWritten; }
+
+private:
+	struct Channel
+	{
+		uint32_t id = 0;
+		TraceChannelKind kind = TraceChannelKind::FrameState;
+		std::string name;
+		std::vector<uint8_t> data;
+		size_t readOffset = 0;
+		uint32_t pendingRecords = 0;
+		std::vector<int64_t> previous;	// last value written or read in each delta slot
+	};
+
+	Channel& BeginRecord( uint32_t channel );
+	void EndRecord( Channel& channel );
+	Channel* BeginReplay( uint32_t channel );
+
+	static void PutVarint( Channel& channel, uint64_t value );
+	static void PutSigned( Channel& channel, int64_t value );
+	static void PutDelta( Channel& channel, uint32_t slot, int64_t value );
+	static bool GetVarint( Channel& channel, uint64_t* value );
+	static bool GetSigned( Channel& channel, int64_t* value );
+	static bool GetDelta( Channel& channel, uint32_t slot, int64_t* value );
+
+	static void PutPose( Channel& channel, uint32_t slot, const XrPosef& pose );
+	static bool GetPose( Channel& channel, uint32_t slot, XrPosef* pose );
+
+	void WriteChunk( uint32_t id, Channel& channel );
+	void WriteBytes( const void* data, size_t size );
+
+	// Fixed size so channels can be looked up without a lock while another thread adds one
+	static const uint32_t k_maxChannels = 256;
+
+	std::mutex m_mutex;
+	std::unique_ptr<Channel> m_channels[ k_maxChannels ];
+	uint32_t m_channelCount = 0;
+	std::map<std::pair<TraceChannelKind, std::string>, uint32_t> m_channelIds;
+	FILE* m_file = nullptr;
+	bool m_replaying = false;
+	uint64_t m_bytesWritten = 0;
+};
+
+// The trace that Action and XrAppBase record to or replay from, or null when there isn't one
+void SetActiveInputTrace( InputTrace* trace );
+InputTrace* ActiveInputTrace();
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace XRDE
+{
+
+// Counts outstanding jobs. Pass the same counter to several Run calls and then Wait on it to join them.
+class JobCounter
+{
+	friend class JobSystem;
+public:
+	bool IsDone() const { return m_count.load( std::memory_order_acquire ) == 0; }
+
+private:
+	std::atomic<uint32_t> m_count { 0 };
+};
+
+struct JobTiming
+{
+	const char* name;
+	uint32_t threadIndex;
+	double startSeconds;	// relative to when the job system was initialized
+	double endSeconds;
+};
+
+// Small work stealing job system. Every thread has its own deque of jobs; a thread pops its own newest job
+// first and steals the oldest job from another thread when its own deque is empty. Thread 0 belongs to
+// whoever calls Run/Wait from outside the job system, which is normally the main thread.
+class JobSystem
+{
+public:
+	typedef std::function<void()> JobFunction;
+
+	~JobSystem();
+
+	// workerCount does not include the main thread. Zero makes Run execute jobs inline.
+	void Init( uint32_t workerCount );
+	void Shutdown();
+
+	uint32_t GetThreadCount() const { return (uint32_t)m_queues.size(); }
+
+	// name must point to a string that outlives the job, usually a literal
+	void Run( const char* name, JobFunction job, JobCounter* counter = nullptr );
+
+	// Runs queued jobs on the calling thread until the counter reaches zero
+	void Wait( JobCounter& counter );
+
+	// Returns and clears the timings of every job that has finished since the last call
+	std::vector<JobTiming> CollectTimings();
+
+private:
+	struct Job
+	{
+		const char* name;
+		JobFunction function;
+		JobCounter* counter;
+	};
+
+	struct ThreadQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::vector<JobTiming> timings;
+	};
+
+	uint32_t CurrentThreadIndex() const;
+	bool PopOrSteal( uint32_t threadIndex, Job* job );
+	void Execute( uint32_t threadIndex, Job& job );
+	void WorkerThread( uint32_t threadIndex );
+	double Now() const;
+
+	std::vector< std::unique_ptr<ThreadQueue> > m_queues;
+	std::vector< std::thread > m_workers;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<uint32_t> m_queuedJobs { 0 };
+	bool m_shutdown = false;
+
+	std::chrono::high_resolution_clock::time_point m_startTime;
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <openxr/openxr.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+namespace XRDE
+{
+
+// Converts the app's clock to XrTime so app timestamps can be compared with the display times the runtime
+// predicts. It uses XR_KHR_win32_convert_performance_counter_time with QueryPerformanceCounter on Windows, and
+// XR_KHR_convert_timespec_time with CLOCK_MONOTONIC elsewhere. The instance has to have the extension enabled.
+class XrClock
+{
+public:
+	// The extension XrClock needs on this platform
+	static const char* GetExtensionName();
+
+	bool Init( XrInstance instance );
+	bool IsAvailable() const { return m_convert != nullptr; }
+
+	// The app clock, in its own ticks
+	static int64_t Now();
+
+	// Asks the runtime what XrTime it is now. ToXrTime extrapolates from the most recent calibration, so
+	// converting doesn't call into the runtime.
+	bool Calibrate();
+	XrTime ToXrTime( int64_t appTime ) const;
+
+private:
+	XrInstance m_instance = XR_NULL_HANDLE;
+	PFN_xrVoidFunction m_convert = nullptr;
+	double m_nanosecondsPerTick = 1.0;
+	int64_t m_calibrationAppTime = 0;
+	XrTime m_calibrationXrTime = 0;
+};
+
+// How long before its predicted display time each step of a frame happened, in seconds. Negative if the step
+// didn't happen for this frame.
+struct FrameLatency
+{
+	XrTime displayTime = 0;
+	double poseToDisplay = -1;		// the earliest pose sampled for this display time
+	double viewsToDisplay = -1;		// xrLocateViews for the eyes that were rendered
+	double recordToDisplay = -1;	// the start of recording the eyes
+	double endFrameToDisplay = -1;	// the call to xrEndFrame
+};
+
+// Latencies in fixed buckets, so a tracker that runs for a whole session keeps the same few counters instead of
+// every sample. Percentiles are accurate to a bucket, and latencies outside the range count in the end buckets.
+class LatencyHistogram
+{
+public:
+	void Record( double seconds );
+
+	uint64_t GetCount() const { return m_count; }
+	double GetMax() const { return m_max; }
+
+	// In seconds, the middle of the bucket the sample at fraction of the way through the sorted samples is in
+	double Percentile( double fraction ) const;
+
+private:
+	static const int32_t k_bucketMicroseconds = 50;
+	static const int32_t k_lowestMicroseconds = -20000;		// after the display time, when a frame is late
+	static const uint32_t k_bucketCount = 4000;				// up to 180 ms before it
+
+	uint32_t m_buckets[ k_bucketCount ] = {};
+	uint64_t m_count = 0;
+	double m_max = 0;
+};
+
+// Timestamps the steps between sampling poses and submitting a frame and measures how long before the frame's
+// predicted display time each of them happened. Poses may be sampled on any thread, and are matched to frames
+// by the display time they were sampled for.
+class LatencyTracker
+{
+public:
+	bool Init( XrInstance instance );
+	bool IsEnabled() const { return m_clock.IsAvailable(); }
+
+	// Call right before sampling poses for a display time, from any thread
+	void PoseSampled( XrTime displayTime );
+
+	// Call from the render thread as the frame for displayTime is rendered and submitted
+	void ViewsSampled( XrTime displayTime );
+	void RecordStarted( XrTime displayTime );
+	void FrameEnded( XrTime displayTime );
+
+	const FrameLatency& GetLastFrame() const { return m_lastFrame; }
+	void PrintSummary( std::ostream& out ) const;
+
+private:
+	struct PendingFrame
+	{
+		int64_t firstPose = INT64_MAX;
+		int64_t views = 0;
+		int64_t recordStart = 0;
+	};
+
+	double LatencySeconds( XrTime displayTime, int64_t appTime ) const;
+
+	XrClock m_clock;
+	std::mutex m_mutex;
+	std::map<XrTime, PendingFrame> m_pendingFrames;
+
+	FrameLatency m_lastFrame;
+	LatencyHistogram m_poseToDisplay;
+	LatencyHistogram m_viewsToDisplay;
+	LatencyHistogram m_recordToDisplay;
+	LatencyHistogram m_endFrameToDisplay;
+};
+
+// The tracker that Action and XrAppBase report pose samples to, or null when there isn't one
+void SetActiveLatencyTracker( LatencyTracker* tracker );
+LatencyTracker* ActiveLatencyTracker();
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+#include <GLTFLoader.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace XRDE
+{
+
+// maxPixelError is how far, in pixels of the eye images, a level may move the surface before a finer level is
+// drawn. A coarser level is only picked once its error is below maxPixelError * ( 1 - hysteresis ), so an
+// instance that sits right at a switching distance doesn't flip back and forth as the head moves.
+struct LodSettings
+{
+	float maxPixelError = 4.f;
+	float hysteresis = 0.25f;
+};
+
+struct LodStats
+{
+	uint32_t chainCount = 0;
+	uint32_t instanceCount = 0;
+	uint32_t switchCount = 0;			// levels that changed in the last Update
+	uint64_t fullTriangleCount = 0;		// what the instances would draw with every chain at its finest level
+	uint64_t selectedTriangleCount = 0;	// what they draw per eye with the levels Update picked
+
+	// the chained part of selectedTriangleCount by level, 0 being the finest
+	std::vector<uint64_t> levelTriangleCounts;
+};
+
+// Picks a level of detail for every glTF mesh that has them, once per frame for both eyes. Levels are nodes
+// named <name>_LOD0, <name>_LOD1 and so on under the same parent, the way exporters and offline simplifiers
+// write LOD groups. The lowest number is the finest level. Every level is drawn with the finest level's node,
+// so the levels have to share its transform and skin; chains where they don't are left alone.
+//
+// GLTF_PBR_Renderer draws every mesh of a model, so the coarser levels' primitives are taken out of their own
+// nodes and Apply swaps the chosen level's primitives into the finest level's mesh. The primitives index the
+// model's shared vertices, so nothing is uploaded when a level changes. Call Apply for an instance right before
+// rendering the model for it.
+//
+// A level's error is the distance its simplification moves the surface, in mesh space. Unless SetLevelError
+// says otherwise, it's the mean edge length the level's triangles would have if they covered the mesh's
+// bounding sphere, which is more than the surface really moves for most simplified meshes.
+class LodSelector
+{
+public:
+	static const uint32_t k_invalidHandle = UINT32_MAX;
+
+	// Finds the chains in a model. Takes the coarser levels out of their nodes, so anything that measures the
+	// model's primitives has to run before AddModel and after RemoveModel, which puts them back.
+	void AddModel( Diligent::GLTF::Model* model );
+	void RemoveModel( const Diligent::GLTF::Model* model );
+	uint32_t GetChainCount( const Diligent::GLTF::Model* model ) const;
+
+	// node is the finest level's node, and level 0 is always drawn exactly
+	void SetLevelError( const Diligent::GLTF::Node* node, uint32_t level, float meters );
+
+	// Every place a model is drawn at gets an instance. transform is the RenderInfo::ModelTransform it's
+	// drawn with.
+	uint32_t AddInstance( const Diligent::GLTF::Model* model, const Diligent::float4x4& transform = Diligent::float4x4::Identity() );
+	void RemoveInstance( uint32_t instance );
+	void SetTransform( uint32_t instance, const Diligent::float4x4& transform );
+
+	void SetSettings( const LodSettings& settings ) { m_settings = settings; }
+	const LodSettings& GetSettings() const { return m_settings; }
+
+	// Picks every instance's levels from the point between the eyes, so both eyes draw the same ones. The
+	// error is measured in pixels of the eye images, eyeWidth by eyeHeight across each eye's field of view.
+	// Mesh transforms have to be up to date.
+	void Update( const XrView views[ 2 ], uint32_t eyeWidth, uint32_t eyeHeight );
+
+	// Installs the instance's levels in its model
+	void Apply( uint32_t instance );
+
+	const LodStats& GetLastStats() const { return m_lastStats; }
+
+private:
+	struct Level
+	{
+		Diligent::GLTF::Node* node;
+		// empty while the level is installed in the chain's mesh
+		std::vector< std::unique_ptr<Diligent::GLTF::Primitive> > primitives;
+		uint32_t triangleCount;
+		float error;
+	};
+
+	struct Chain
+	{
+		Diligent::GLTF::Mesh* mesh;		// the finest level's, which draws whichever level is installed
+		std::vector<Level> levels;
+		uint32_t installed = 0;
+		Diligent::float3 boundsCenter;
+		float boundsRadius;
+	};
+
+	struct LodModel
+	{
+		Diligent::GLTF::Model* model;
+		std::vector<Chain> chains;
+		uint32_t fixedTriangleCount = 0;	// in meshes without levels
+	};
+
+	struct Instance
+	{
+		LodModel* model = nullptr;
+		Diligent::float4x4 transform;
+		std::vector<uint8_t> levels;	// per chain
+		bool active = false;
+	};
+
+	static uint32_t CountTriangles( const Diligent::GLTF::Mesh& mesh );
+	void Install( Chain& chain, uint32_t level );
+
+	LodSettings m_settings;
+	std::vector< std::unique_ptr<LodModel> > m_models;
+	std::vector<Instance> m_instances;
+	LodStats m_lastStats;
+};
+
+}
@@ -90,7 +90,13 @@ LRESULT CALLBACK MessageProc( HWND wnd, UINT message, WPARAM wParam, LPARAM lPar
 
 	case WM_CHAR:
 		if ( wParam == VK_ESCAPE )
+		{
 			PostQuitMessage( 0 );
+		}
+		else if ( g_pTheApp )
+		{
+			g_pTheApp->KeyPressed( (wchar_t)wParam );
+		}
 		return 0;
 
 	case WM_DESTROY:
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <RenderDevice.h>
+#include <Texture.h>
+#include <Buffer.h>
+
+#include <string>
+#include <map>
+#include <functional>
+
+namespace XRDE
+{
+
+enum class MemoryCategory : uint32_t
+{
+	SwapchainColor,
+	SwapchainDepth,
+	GltfBuffers,
+	TextureAtlas,
+	EnvironmentMaps,
+	ConstantBuffers,
+	AppBuffers,
+	AppTextures,
+	Other,
+
+	Count
+};
+
+const char* MemoryCategoryName( MemoryCategory category );
+
+enum class MemoryLocation : uint32_t
+{
+	Gpu,
+	Cpu,
+
+	Count
+};
+
+struct MemoryCategoryTotals
+{
+	uint64_t bytes = 0;
+	uint32_t resourceCount = 0;
+};
+
+struct AdapterMemoryInfo
+{
+	uint64_t localBytes = 0;
+	uint64_t hostVisibleBytes = 0;
+	uint64_t unifiedBytes = 0;
+};
+
+// Keeps track of every resource the app creates along with its size. Resources are keyed by a pointer so
+// registering the same resource again updates its size instead of counting it twice.
+class MemoryBudget
+{
+public:
+	void Init( Diligent::IRenderDevice* device );
+
+	void Register( const void* key, const std::string& name, MemoryCategory category, uint64_t bytes,
+		MemoryLocation location = MemoryLocation::Gpu );
+	void RegisterTexture( Diligent::ITexture* texture, MemoryCategory category );
+	void RegisterBuffer( Diligent::IBuffer* buffer, MemoryCategory category );
+	void Unregister( const void* key );
+	void UnregisterCategory( MemoryCategory category );
+
+	// Budgets of 0 are unlimited. Exceeding a budget logs a warning and calls the over-budget callback once
+	// until usage drops back under the budget.
+	void SetBudget( MemoryLocation location, uint64_t bytes );
+	uint64_t GetBudget( MemoryLocation location ) const { return m_budget[ (uint32_t)location ]; }
+	void SetOverBudgetCallback( std::function<void( MemoryLocation, uint64_t used, uint64_t budget )> callback )
+	{
+		m_overBudgetCallback = callback;
+	}
+
+	uint64_t GetTotal( MemoryLocation location ) const { return m_total[ (uint32_t)location ]; }
+	MemoryCategoryTotals GetCategoryTotals( MemoryCategory category, MemoryLocation location = MemoryLocation::Gpu ) const;
+	const AdapterMemoryInfo& GetAdapterMemory() const { return m_adapterMemory; }
+
+	std::string FormatReport() const;
+
+	static uint64_t TextureSize( const Diligent::TextureDesc& desc );
+
+private:
+	struct Entry
+	{
+		std::string name;
+		MemoryCategory category;
+		MemoryLocation location;
+		uint64_t bytes;
+	};
+
+	void CheckBudget( MemoryLocation location );
+
+	std::map< const void*, Entry > m_entries;
+	MemoryCategoryTotals m_totals[ (uint32_t)MemoryLocation::Count ][ (uint32_t)MemoryCategory::Count ];
+	uint64_t m_total[ (uint32_t)MemoryLocation::Count ] = {};
+	uint64_t m_budget[ (uint32_t)MemoryLocation::Count ] = {};
+	bool m_overBudget[ (uint32_t)MemoryLocation::Count ] = {};
+	AdapterMemoryInfo m_adapterMemory;
+	std::function<void( MemoryLocation, uint64_t, uint64_t )> m_overBudgetCallback;
+};
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+
+#include <vector>
+
+namespace XRDE
+{
+
+struct OcclusionCullerStats
+{
+	uint32_t occluderCount = 0;
+	uint32_t triangleCount = 0;		// occluder triangles in front of the near plane
+	double rasterizeSeconds = 0;	// from the start of the first job to the end of the last one
+};
+
+// CPU occlusion culling. A small set of occluder meshes is rasterized into a low resolution depth buffer, four
+// pixels at a time with SSE, and bounding boxes are tested against it. Nothing is read back from the GPU.
+//
+// Both eyes share one depth buffer, rendered from a view just behind them whose frustum contains both eye
+// frusta. The screen is split into bands of rows and every band is rasterized by its own job, so the jobs
+// never write to the same pixels. Rasterize can run while the caller waits for something else, usually
+// xrWaitFrame; it copies the submitted occluders, so they can be resubmitted while the jobs run.
+//
+// Occluders should be simple and lie inside what they stand for: a pixel counts as covered when a triangle
+// covers its center. Register occluder meshes before the first Rasterize.
+class OcclusionCuller
+{
+public:
+	static const uint32_t k_invalidHandle = UINT32_MAX;
+	static const uint32_t k_defaultWidth = 256;
+	static const uint32_t k_defaultHeight = 128;
+
+	// The width is rounded up to a multiple of four
+	void Init( uint32_t width = k_defaultWidth, uint32_t height = k_defaultHeight );
+
+	// Front faces are counter clockwise, as in glTF. The back faces of closed meshes never decide what is
+	// visible, so they are skipped unless the mesh is two sided, like a lone wall.
+	uint32_t AddOccluderMesh( const Diligent::float3* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		bool twoSided = false );
+
+	void ClearOccluders();
+	void SubmitOccluder( uint32_t mesh, const Diligent::float4x4& objectToStage );
+	uint32_t GetOccluderCount() const { return (uint32_t)m_occluders.size(); }
+
+	// Sets up the combined view of both eyes. views are in stage space.
+	void SetViews( const XrView views[ 2 ], float nearClip, float farClip );
+
+	// Or any stage-to-clip transform with a [0,1] depth range, for tests and benchmarks
+	void SetViewProjection( const Diligent::float4x4& stageToClip );
+
+	// Queues the rasterization on the job system. Wait on the counter before testing anything.
+	void Rasterize( JobSystem& jobs, JobCounter& counter );
+
+	// False until something has been rasterized
+	bool IsReady() const { return m_ready; }
+
+	// Whether any part of a stage space box might be visible. Boxes that reach in front of the near plane or
+	// lie entirely outside the combined view always are.
+	bool IsBoxVisible( const Diligent::float3& boxMin, const Diligent::float3& boxMax ) const;
+
+	// Written by the last job, so only read it after waiting
+	const OcclusionCullerStats& GetLastStats() const { return m_lastStats; }
+
+	// Depth in [0,1] per pixel, row 0 at the top, for debug views
+	const float* GetDepthBuffer() const { return m_depth.data(); }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+
+private:
+	struct OccluderMesh
+	{
+		std::vector<Diligent::float3> positions;
+		std::vector<uint32_t> indices;
+		bool twoSided;
+	};
+
+	struct Occluder
+	{
+		uint32_t mesh;
+		Diligent::float4x4 objectToStage;
+	};
+
+	// a triangle ready to rasterize: three edge functions and a depth plane in pixels, and its pixel bounds
+	struct Triangle
+	{
+		float edgeA[ 3 ];
+		float edgeB[ 3 ];
+		float edgeC[ 3 ];
+		float depthA;
+		float depthB;
+		float depthC;
+		int32_t minX;
+		int32_t maxX;
+		int32_t minY;
+		int32_t maxY;
+	};
+
+	void SetupTriangles( uint32_t firstOccluder, uint32_t occluderCount, std::vector<Triangle>* triangles ) const;
+	void RasterizeBand( uint32_t firstRow, uint32_t rowCount );
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	std::vector<float> m_depth;
+
+	std::vector<OccluderMesh> m_meshes;
+	std::vector<Occluder> m_occluders;
+
+	// what the jobs work on, copied when they are queued
+	std::vector<Occluder> m_rasterOccluders;
+	Diligent::float4x4 m_rasterStageToClip;
+	std::vector< std::vector<Triangle> > m_setupTriangles;
+
+	Diligent::float4x4 m_stageToClip;
+	bool m_ready = false;
+	OcclusionCullerStats m_lastStats;
+};
+
+}
@@ -5,6 +5,7 @@
 
 namespace XRDE
 {
+	// With a null instance these use a table local to the process instead of the runtime
 	XrPath StringToPath( XrInstance instance, const std::string& pathString );
 	std::string PathToString( XrInstance instance, XrPath path );
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// Turn off the XRBASE_PROFILE_ZONES CMake option to compile every zone out
+#ifndef XRDE_PROFILE_ZONES
+#	define XRDE_PROFILE_ZONES 1
+#endif
+
+namespace XRDE
+{
+
+// CPU profiling zones for finding out where a frame went. Each thread writes begin and end events into its own
+// ring buffer without taking locks, and the rings can be written out as a Chrome trace, which chrome://tracing
+// and ui.perfetto.dev can open, at any time. Nothing is recorded outside of StartProfileCapture and
+// StopProfileCapture. When a thread's ring is full, its oldest events are overwritten.
+//
+// Zone names are stored as pointers, so they have to be string literals or otherwise outlive the capture.
+
+void StartProfileCapture();
+void StopProfileCapture();
+
+// Names the calling thread in the trace
+void SetProfileThreadName( const char* name );
+
+// Writes everything the rings still hold. Safe to call while threads are recording.
+bool WriteProfileTrace( const std::string& path );
+
+extern std::atomic<bool> g_profileCapturing;
+inline bool IsProfileCapturing() { return g_profileCapturing.load( std::memory_order_acquire ); }
+
+void BeginProfileZone( const char* name );
+void EndProfileZone( const char* name );
+
+// Records a zone from construction to the end of the scope. A zone that began during a capture always ends.
+class ProfileZone
+{
+public:
+	explicit ProfileZone( const char* name ) : m_name( IsProfileCapturing() ? name : nullptr )
+	{
+		if ( m_name )
+		{
+			BeginProfileZone( m_name );
+		}
+	}
+	~ProfileZone()
+	{
+		if ( m_name )
+		{
+			EndProfileZone( m_name );
+		}
+	}
+
+private:
+	const char* m_name;
+};
+
+}
+
+#if XRDE_PROFILE_ZONES
+#	define XRDE_PROFILE_CONCAT_INNER( a, b ) a##b
+#	define XRDE_PROFILE_CONCAT( a, b ) XRDE_PROFILE_CONCAT_INNER( a, b )
+#	define XRDE_PROFILE_ZONE( name ) XRDE::ProfileZone XRDE_PROFILE_CONCAT( profileZone, __LINE__ )( name )
+#	define XRDE_PROFILE_FUNCTION() XRDE_PROFILE_ZONE( __FUNCTION__ )
+#	define XRDE_PROFILE_THREAD_NAME( name ) XRDE::SetProfileThreadName( name )
+#else
+#	define XRDE_PROFILE_ZONE( name ) ( (void)0 )
+#	define XRDE_PROFILE_FUNCTION() ( (void)0 )
+#	define XRDE_PROFILE_THREAD_NAME( name ) ( (void)0 )
+#endif
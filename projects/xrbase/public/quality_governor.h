@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace XRDE
+{
+
+enum class QualityKnobCost
+{
+	Cpu,
+	Gpu,
+	Both,
+};
+
+// Something the governor can turn down. Level 0 is full quality and each level above that is cheaper. The
+// apply function is called with the new level whenever the governor changes it.
+struct QualityKnobDesc
+{
+	std::string name;
+	int priority = 0;		// knobs with lower priority are turned down first and restored last
+	int levelCount = 2;
+	QualityKnobCost cost = QualityKnobCost::Gpu;
+	std::function<void( int level )> apply;
+};
+
+struct QualityGovernorSettings
+{
+	float targetHeadroom = 0.1f;	// keep the busier of CPU and GPU at least this fraction under the frame budget
+	float restoreHysteresis = 0.1f;	// and only restore quality once it is this much further under the target
+	float smoothing = 0.1f;			// weight of the newest frame in the moving average of frame times
+	int degradeFrames = 5;			// consecutive frames over the target before turning something down
+	int restoreFrames = 90;			// consecutive frames with spare headroom before restoring something
+	int cooldownFrames = 30;		// frames to let a change settle before making another one
+};
+
+// Closed loop controller that keeps frame times under the display period by trading quality for time
+class QualityGovernor
+{
+public:
+	void SetSettings( const QualityGovernorSettings& settings ) { m_settings = settings; }
+	const QualityGovernorSettings& GetSettings() const { return m_settings; }
+
+	void SetEnabled( bool enabled ) { m_enabled = enabled; }
+	bool IsEnabled() const { return m_enabled; }
+
+	// Returns an id for GetKnobLevel/SetKnobLevel. The knob starts at level 0.
+	uint32_t RegisterKnob( const QualityKnobDesc& desc );
+	int GetKnobLevel( uint32_t knob ) const { return m_knobs[ knob ].level; }
+	void SetKnobLevel( uint32_t knob, int level );
+
+	// Call once per frame. A period of zero (no frame from the runtime this time) is ignored.
+	void Update( double displayPeriodSeconds, double cpuSeconds, double gpuSeconds );
+
+	double GetSmoothedCpuSeconds() const { return m_cpuSeconds; }
+	double GetSmoothedGpuSeconds() const { return m_gpuSeconds; }
+
+private:
+	struct Knob
+	{
+		QualityKnobDesc desc;
+		int level = 0;
+	};
+
+	bool Degrade( bool cpuBound, bool gpuBound );
+	bool Restore();
+	static bool Affects( const Knob& knob, bool cpuBound, bool gpuBound );
+
+	QualityGovernorSettings m_settings;
+	bool m_enabled = false;
+	std::vector<Knob> m_knobs;
+
+	double m_cpuSeconds = 0;
+	double m_gpuSeconds = 0;
+	bool m_haveSample = false;
+	int m_overFrames = 0;
+	int m_underFrames = 0;
+	int m_cooldown = 0;
+};
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "gpu_profiler.h"
+#include "memory_budget.h"
+
+#include <RenderDevice.h>
+#include <DeviceContext.h>
+#include <RenderPass.h>
+#include <Framebuffer.h>
+#include <RefCntAutoPtr.hpp>
+
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace XRDE
+{
+
+enum class AttachmentLoad
+{
+	Load,		// keep what's there
+	Clear,		// clear to the attachment's clear value when the pass begins
+	Discard,	// the pass overwrites every pixel it cares about
+};
+
+class RenderGraph;
+
+// Declares what one pass renders to and uses. Only valid inside the setup function passed to AddPass.
+class RenderGraphPassBuilder
+{
+public:
+	// Render targets. view defaults to the texture's default view of that type, pass one to render to a single
+	// slice of an array.
+	void WriteColor( uint32_t resource, AttachmentLoad load, const float clearColor[ 4 ] = nullptr,
+		Diligent::ITextureView* view = nullptr );
+	void WriteDepth( uint32_t resource, AttachmentLoad load, float clearDepth = 1.f, Diligent::ITextureView* view = nullptr );
+
+	// Everything else the pass touches, in the state it needs it in. Objects that haven't been imported into the
+	// graph are imported without a final state.
+	void Read( uint32_t resource, Diligent::RESOURCE_STATE state );
+	void Read( Diligent::ITexture* texture, Diligent::RESOURCE_STATE state );
+	void Read( Diligent::IBuffer* buffer, Diligent::RESOURCE_STATE state );
+	void Write( uint32_t resource, Diligent::RESOURCE_STATE state );
+	void Write( Diligent::ITexture* texture, Diligent::RESOURCE_STATE state );
+	void Write( Diligent::IBuffer* buffer, Diligent::RESOURCE_STATE state );
+
+	// Runs on the immediate context before the pass's barriers and before its render pass begins. Mapping
+	// dynamic buffers, updating buffers and anything else that isn't allowed inside a render pass goes here.
+	void SetPrepare( const std::function<void( Diligent::IDeviceContext* context )>& prepare );
+
+	// Passes that execute command lists can't run inside a render pass. Their render targets are bound with
+	// SetRenderTargets instead, and Clear loads become explicit clears.
+	void BindWithoutRenderPass();
+
+	// Times the pass, barriers and all, with the graph's profiler
+	void SetProfileName( const char* name, int eye = -1 );
+
+	RenderGraph& GetGraph() { return m_graph; }
+
+private:
+	friend class RenderGraph;
+	RenderGraphPassBuilder( RenderGraph& graph, uint32_t pass ) : m_graph( graph ), m_pass( pass ) {}
+
+	RenderGraph& m_graph;
+	uint32_t m_pass;
+};
+
+// A per-frame list of passes that declare the resources they use. Execute works out every state transition the
+// frame needs up front and issues them in as few batches as it can: resources whose first use in the frame
+// needs a new state are all transitioned in one batch before the first pass, later changes in one batch per
+// pass, and imported resources go to their final states in one batch at the end. Passes with render targets run
+// in Diligent render passes with load-op clears. Since every resource is already in the right state, the
+// passes themselves can use RESOURCE_STATE_TRANSITION_MODE_VERIFY or NONE everywhere.
+//
+// Transient textures only exist for the passes that use them. Transients with the same description whose
+// lifetimes in the frame don't overlap share a texture, and the textures are kept from frame to frame.
+class RenderGraph
+{
+public:
+	static const uint32_t k_invalidResource = UINT32_MAX;
+
+	typedef std::function<void( RenderGraphPassBuilder& pass )> SetupFunction;
+	typedef std::function<void( Diligent::IDeviceContext* context )> ExecuteFunction;
+
+	void Init( Diligent::IRenderDevice* device, MemoryBudget* memoryBudget = nullptr, GpuProfiler* profiler = nullptr );
+	void Shutdown();
+
+	// Starts a new frame. Handles from the previous frame are no longer valid.
+	void Reset();
+
+	// Resources that live outside the graph. They must be in a known state, and are left in finalState after
+	// the graph runs, or in whatever state the last pass used if it's RESOURCE_STATE_UNKNOWN. Importing the
+	// same object again returns the same handle.
+	uint32_t ImportTexture( Diligent::ITexture* texture, Diligent::RESOURCE_STATE finalState = Diligent::RESOURCE_STATE_UNKNOWN );
+	uint32_t ImportBuffer( Diligent::IBuffer* buffer, Diligent::RESOURCE_STATE finalState = Diligent::RESOURCE_STATE_UNKNOWN );
+
+	// A texture that only lives for this frame. Its content is undefined before the first pass that writes it.
+	uint32_t CreateTransientTexture( const Diligent::TextureDesc& desc );
+
+	// Passes run in the order they're added. setup runs right away, execute during Execute. The name is used for
+	// profiling zones, so it has to outlive the frame like one.
+	void AddPass( const char* name, const SetupFunction& setup, const ExecuteFunction& execute );
+
+	// The texture behind a handle. Transients only have one while the graph is executing.
+	Diligent::ITexture* GetTexture( uint32_t resource ) const;
+
+	void Execute( Diligent::IDeviceContext* context );
+
+	// Transition batches and barriers issued by the last Execute, and transient textures created so far
+	uint32_t GetLastBatchCount() const { return m_lastBatchCount; }
+	uint32_t GetLastBarrierCount() const { return m_lastBarrierCount; }
+	uint32_t GetTransientTextureCount() const { return (uint32_t)m_transientPool.size(); }
+
+private:
+	friend class RenderGraphPassBuilder;
+
+	struct Resource
+	{
+		Diligent::ITexture* texture = nullptr;
+		Diligent::IBuffer* buffer = nullptr;
+		Diligent::RESOURCE_STATE finalState = Diligent::RESOURCE_STATE_UNKNOWN;
+		bool transient = false;
+		Diligent::TextureDesc transientDesc;
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+		bool written = false;
+	};
+
+	struct Attachment
+	{
+		uint32_t resource;
+		Diligent::ITextureView* view;
+		AttachmentLoad load;
+		float clear[ 4 ];
+	};
+
+	struct Use
+	{
+		uint32_t resource;
+		Diligent::RESOURCE_STATE state;
+		bool write;
+	};
+
+	struct Pass
+	{
+		const char* name;
+		ExecuteFunction execute;
+		std::function<void( Diligent::IDeviceContext* context )> prepare;
+		std::vector<Attachment> colors;
+		Attachment depth = { k_invalidResource };
+		std::vector<Use> uses;
+		bool useRenderPass = true;
+		const char* profileName = nullptr;
+		int profileEye = -1;
+
+		uint32_t firstBarrier = 0;
+		uint32_t barrierCount = 0;
+	};
+
+	struct TransientTexture
+	{
+		Diligent::RefCntAutoPtr<Diligent::ITexture> texture;
+		uint32_t busyUntilPass = 0;		// the last pass of the transient using it this frame
+		bool usedThisFrame = false;		// until the next frame's allocation, which trims the idle ones first
+		uint32_t idleFrames = 0;
+	};
+
+	typedef std::tuple< std::vector<Diligent::TEXTURE_FORMAT>, Diligent::TEXTURE_FORMAT, std::vector<AttachmentLoad>, AttachmentLoad,
+		uint32_t > RenderPassKey;
+	typedef std::vector<Diligent::ITextureView*> FramebufferKey;
+
+	uint32_t AddResource( const Resource& resource );
+	void AddUse( uint32_t pass, uint32_t resource, Diligent::RESOURCE_STATE state, bool write );
+	void AllocateTransients();
+	void PlanTransitions();
+	void TrimTransients();
+	Diligent::ITextureView* GetAttachmentView( const Attachment& attachment, Diligent::TEXTURE_VIEW_TYPE type ) const;
+	void BeginPass( Diligent::IDeviceContext* context, Pass& pass );
+	Diligent::IRenderPass* GetRenderPass( const Pass& pass, const std::vector<Diligent::ITextureView*>& views );
+	Diligent::IFramebuffer* GetFramebuffer( Diligent::IRenderPass* renderPass, const std::vector<Diligent::ITextureView*>& views );
+	void IssueBarriers( Diligent::IDeviceContext* context, uint32_t first, uint32_t count );
+
+	Diligent::IRenderDevice* m_device = nullptr;
+	MemoryBudget* m_memoryBudget = nullptr;
+	GpuProfiler* m_profiler = nullptr;
+
+	std::vector<Resource> m_resources;
+	std::map<Diligent::IDeviceObject*, uint32_t> m_imported;
+	std::vector<Pass> m_passes;
+
+	// every barrier of the frame, the start batch first and the end batch last, with each pass's in between
+	std::vector<Diligent::StateTransitionDesc> m_barriers;
+	uint32_t m_startBarrierCount = 0;
+	uint32_t m_endBarrierCount = 0;
+
+	std::vector<TransientTexture> m_transientPool;
+	std::vector<uint32_t> m_transientAssignment;	// resource index to pool index, for transients
+
+	std::map< RenderPassKey, Diligent::RefCntAutoPtr<Diligent::IRenderPass> > m_renderPasses;
+	std::map< std::pair<Diligent::IRenderPass*, FramebufferKey>, Diligent::RefCntAutoPtr<Diligent::IFramebuffer> > m_framebuffers;
+
+	uint32_t m_lastBatchCount = 0;
+	uint32_t m_lastBarrierCount = 0;
+};
+
+}
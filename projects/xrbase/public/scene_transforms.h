@@ -0,0 +1,104 @@
+#pragma once
+
+#include "job_system.h"
+
+#include <BasicMath.hpp>
+#include <GLTFLoader.hpp>
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace XRDE
+{
+
+struct SceneTransformStats
+{
+	uint32_t nodeCount = 0;
+	uint32_t levelCount = 0;
+	uint32_t updatedNodeCount = 0;		// world matrices the last Update recomputed
+	uint32_t updatedSkinCount = 0;		// skinned meshes whose joint matrices it recomputed
+};
+
+// World transforms for glTF node hierarchies, recomputed only where something moved. Replaces calling
+// Node::UpdateTransforms on every root, which walks up to the root again for every node it visits.
+//
+// The nodes of every registered hierarchy are flattened into arrays ordered by depth, so each level only depends
+// on the one before it, and every node keeps the index of its parent. Moving a node marks it dirty, and Update
+// passes the flag down to the children while it walks the levels, starting at the shallowest dirty one. Levels
+// with many nodes are split into batches on the job system. The results land where GLTF_PBR_Renderer reads them:
+// the mesh matrix of every node with a mesh, and the joint matrices of skins that have a moved joint.
+//
+// Add and remove hierarchies from the main thread. MarkDirty only writes the node's own flag, so jobs can call it
+// for different nodes at the same time, as long as Update isn't running.
+class SceneTransforms
+{
+public:
+	static const uint32_t k_invalidIndex = UINT32_MAX;
+
+	void AddModel( Diligent::GLTF::Model* model );
+	void RemoveModel( const Diligent::GLTF::Model* model );
+
+	// For nodes built outside of a model, such as generated scenes. They have no skins.
+	void AddHierarchy( Diligent::GLTF::Node* root );
+	void RemoveHierarchy( const Diligent::GLTF::Node* root );
+
+	// Call after changing a node's Matrix, Translation, Rotation or Scale. Nodes that were added since the last
+	// Update are updated anyway, so these are ignored.
+	void MarkDirty( const Diligent::GLTF::Node* node );
+	void MarkModelDirty( const Diligent::GLTF::Model* model );
+
+	// The index is faster to mark with, but only stays valid while the layout version stays the same. It changes
+	// in the first Update after hierarchies are added or removed.
+	uint32_t FindNode( const Diligent::GLTF::Node* node ) const;
+	void MarkDirty( uint32_t index );
+	uint32_t GetLayoutVersion() const { return m_layoutVersion; }
+
+	void Update( JobSystem& jobs );
+
+	// Model space, as of the last Update
+	const Diligent::float4x4& GetWorldMatrix( uint32_t index ) const { return m_world[ index ]; }
+	const SceneTransformStats& GetLastStats() const { return m_lastStats; }
+
+private:
+	struct Hierarchy
+	{
+		const void* key;
+		Diligent::GLTF::Model* model;		// for the skins, null for bare hierarchies
+		std::vector<Diligent::GLTF::Node*> roots;
+	};
+
+	struct SkinnedMesh
+	{
+		uint32_t node;
+		const Diligent::GLTF::Skin* skin;
+		uint32_t firstJoint;		// into m_skinJoints
+		uint32_t jointCount;
+	};
+
+	void Remove( const void* key );
+	void Rebuild();
+	uint32_t UpdateNodes( uint32_t begin, uint32_t end );
+	uint32_t UpdateSkins( uint32_t begin, uint32_t end );
+
+	std::vector<Hierarchy> m_hierarchies;
+	bool m_layoutDirty = false;
+	uint32_t m_layoutVersion = 0;
+
+	// one entry per node, shallowest level first
+	std::vector<Diligent::GLTF::Node*> m_nodes;
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_levels;
+	std::vector<uint8_t> m_dirty;
+	std::vector<Diligent::float4x4> m_world;
+	std::vector<uint32_t> m_levelStarts;	// one past the last level too
+	std::unordered_map<const Diligent::GLTF::Node*, uint32_t> m_nodeIndices;
+
+	std::vector<SkinnedMesh> m_skinnedMeshes;
+	std::vector<uint32_t> m_skinJoints;
+
+	std::atomic<uint32_t> m_firstDirtyLevel { k_invalidIndex };
+	SceneTransformStats m_lastStats;
+};
+
+}
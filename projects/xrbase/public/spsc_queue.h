@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace XRDE
+{
+
+// Bounded lock-free queue from one producer thread to one consumer thread. Push fails instead of waiting when
+// the queue is full, and Pop fails when it's empty.
+template< typename T >
+class SpscQueue
+{
+public:
+	explicit SpscQueue( uint32_t capacity = 16 ) : m_items( capacity + 1 ) {}
+
+	// Only call from the producer thread
+	bool Push( const T& item )
+	{
+		uint32_t tail = m_tail.load( std::memory_order_relaxed );
+		uint32_t next = Next( tail );
+		if ( next == m_head.load( std::memory_order_acquire ) )
+			return false;
+
+		m_items[ tail ] = item;
+		m_tail.store( next, std::memory_order_release );
+		return true;
+	}
+
+	// Only call from the consumer thread
+	bool Pop( T* item )
+	{
+		uint32_t head = m_head.load( std::memory_order_relaxed );
+		if ( head == m_tail.load( std::memory_order_acquire ) )
+			return false;
+
+		*item = m_items[ head ];
+		m_head.store( Next( head ), std::memory_order_release );
+		return true;
+	}
+
+	bool IsEmpty() const { return m_head.load( std::memory_order_acquire ) == m_tail.load( std::memory_order_acquire ); }
+
+private:
+	uint32_t Next( uint32_t index ) const { return index + 1 == m_items.size() ? 0 : index + 1; }
+
+	// one slot is always left empty to tell a full queue from an empty one
+	std::vector<T> m_items;
+	alignas( 64 ) std::atomic<uint32_t> m_head { 0 };
+	alignas( 64 ) std::atomic<uint32_t> m_tail { 0 };
+};
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <RenderDevice.h>
+#include <DeviceContext.h>
+#include <Texture.h>
+#include <Fence.h>
+#include <RefCntAutoPtr.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace XRDE
+{
+
+// One array slice of a texture, copied back to the CPU. data is only valid during the callback it's passed to.
+struct ReadbackFrame
+{
+	uint64_t frameIndex = 0;
+	uint32_t arraySlice = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	Diligent::TEXTURE_FORMAT format = Diligent::TEX_FORMAT_UNKNOWN;
+	const uint8_t* data = nullptr;
+	uint32_t stride = 0;
+};
+
+typedef std::function<void( const ReadbackFrame& frame )> ReadbackConsumer;
+
+// Copies textures into a ring of CPU readable staging textures and maps them once the GPU has finished the
+// copy, usually a few frames later, so reading them back doesn't stall the CPU. A fence signalled after each
+// copy says when it's done. If every staging texture is still waiting to be read, Enqueue drops the copy.
+//
+// Copies can either be read and released in one go with Poll/WaitForOldest, or left mapped with MapOldest so
+// another thread can read them and released later with ReleaseOldest. Don't mix the two on one ring.
+class TextureReadbackRing
+{
+public:
+	// depth is the number of copies that can be in flight at once
+	bool Init( Diligent::IRenderDevice* device, uint32_t width, uint32_t height, Diligent::TEXTURE_FORMAT format, uint32_t depth = 4 );
+	void Shutdown();
+	bool IsInitialized() const { return !m_slots.empty(); }
+
+	// Copies the top left width x height texels of one array slice of source. The source is transitioned to the
+	// copy source state. Returns false without copying anything if the ring is full.
+	bool Enqueue( Diligent::IDeviceContext* context, Diligent::ITexture* source, uint32_t arraySlice, uint32_t width, uint32_t height,
+		uint64_t frameIndex );
+
+	// Passes every copy the GPU has finished to consume, oldest first, without waiting
+	void Poll( Diligent::IDeviceContext* context, const ReadbackConsumer& consume );
+
+	// Waits for the oldest copy in flight and passes it to consume. Returns false if nothing is in flight.
+	bool WaitForOldest( Diligent::IDeviceContext* context, const ReadbackConsumer& consume );
+
+	// Waits for and reads back everything in flight
+	void Drain( Diligent::IDeviceContext* context, const ReadbackConsumer& consume );
+
+	// Maps the oldest copy that isn't mapped yet if the GPU has finished it, without waiting. The frame stays
+	// valid, and its staging texture stays out of the ring, until ReleaseOldest. Mapped copies are released in
+	// the order they were mapped.
+	bool MapOldest( Diligent::IDeviceContext* context, ReadbackFrame* frame );
+	void ReleaseOldest( Diligent::IDeviceContext* context );
+	uint32_t GetMappedCount() const { return m_mapped; }
+
+	uint32_t GetDepth() const { return (uint32_t)m_slots.size(); }
+	Diligent::ITexture* GetStagingTexture( uint32_t index ) const { return m_slots[ index ].staging; }
+	uint32_t GetInFlightCount() const { return m_inFlight; }
+	uint64_t GetDroppedCount() const { return m_dropped; }
+	uint64_t GetReadCount() const { return m_read; }
+
+private:
+	struct Slot
+	{
+		Diligent::RefCntAutoPtr<Diligent::ITexture> staging;
+		uint64_t fenceValue = 0;
+		uint64_t frameIndex = 0;
+		uint32_t arraySlice = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	bool ReadBack( Diligent::IDeviceContext* context, Slot& slot, const ReadbackConsumer& consume );
+
+	std::vector<Slot> m_slots;
+	Diligent::RefCntAutoPtr<Diligent::IFence> m_fence;
+	Diligent::TEXTURE_FORMAT m_format = Diligent::TEX_FORMAT_UNKNOWN;
+	uint64_t m_fenceValue = 0;
+	uint32_t m_oldest = 0;
+	uint32_t m_inFlight = 0;	// including the mapped ones
+	uint32_t m_mapped = 0;
+	uint64_t m_dropped = 0;
+	uint64_t m_read = 0;
+};
+
+// True for the 8 bit RGBA and BGRA formats WriteReadbackFrame writes as PPM
+bool CanWriteAsPpm( Diligent::TEXTURE_FORMAT format );
+
+// Writes 8 bit RGBA and BGRA frames as binary PPM images and anything else as raw texels preceded by a small
+// header (width, height, format and row size as 32 bit integers)
+bool WriteReadbackFrame( const std::string& path, const ReadbackFrame& frame );
+
+}
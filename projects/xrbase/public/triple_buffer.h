@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace XRDE
+{
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread. The writer always has a
+// buffer to write into and the reader always has a complete buffer to read from; neither ever waits on the
+// other. Values that the reader never picks up are simply overwritten.
+template< typename T >
+class TripleBuffer
+{
+public:
+	// Only call these from the writer thread
+	T& WriteBuffer() { return m_buffers[ m_writeIndex ]; }
+	void Publish()
+	{
+		uint8_t previous = m_middle.exchange( (uint8_t)( m_writeIndex | k_freshBit ), std::memory_order_acq_rel );
+		m_writeIndex = previous & k_indexMask;
+	}
+
+	// Only call these from the reader thread. Acquire returns true if a newer value was published since the
+	// last call, in which case ReadBuffer now returns that value.
+	bool Acquire()
+	{
+		if ( ( m_middle.load( std::memory_order_relaxed ) & k_freshBit ) == 0 )
+			return false;
+
+		uint8_t previous = m_middle.exchange( m_readIndex, std::memory_order_acq_rel );
+		m_readIndex = previous & k_indexMask;
+		return true;
+	}
+	const T& ReadBuffer() const { return m_buffers[ m_readIndex ]; }
+
+private:
+	static const uint8_t k_indexMask = 0x3;
+	static const uint8_t k_freshBit = 0x4;
+
+	T m_buffers[ 3 ];
+	std::atomic<uint8_t> m_middle { 1 };
+	uint8_t m_writeIndex = 0;
+	uint8_t m_readIndex = 2;
+};
+
+}
@@ -50,6 +50,33 @@
 #include <GLTF_PBR_Renderer.hpp>
 
 #include "iapp.h"
+#include "gltf_cache_policy.h"
+#include "gpu_skinning.h"
+#include "scene_transforms.h"
+#include "animation_system.h"
+#include "lod_selector.h"
+#include "memory_budget.h"
+#include "command_recorder.h"
+#include "job_system.h"
+#include "triple_buffer.h"
+#include "frame_snapshot.h"
+#include "gpu_profiler.h"
+#include "frame_stats.h"
+#include "quality_governor.h"
+#include "input_trace.h"
+#include "texture_readback.h"
+#include "frame_capture.h"
+#include "profile_zones.h"
+#include "frame_pacing.h"
+#include "latency_tracker.h"
+#include "composition_layers.h"
+#include "render_graph.h"
+#include "draw_list.h"
+#include "occlusion_culler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define CHECK_XR_RESULT( res ) \
 	do { \
@@ -83,10 +110,21 @@ public:
 	virtual void Render() = 0;
 	virtual void Update( double currTime, double elapsedTime, XrTime displayTime ) = 0;
 
+	// With -threaded-sim, apps that support it run their simulation on a separate thread instead of in Update.
+	// SimulateSnapshot runs on that thread and must only write to the snapshot. The render thread calls
+	// ApplySnapshot with the latest snapshot after each xrWaitFrame, before any eyes are rendered.
+	virtual bool SupportsThreadedSimulation() { return false; }
+	virtual void SimulateSnapshot( double currTime, double elapsedTime, XrTime displayTime, XRDE::FrameSnapshot& snapshot ) {}
+	virtual void ApplySnapshot( const XRDE::FrameSnapshot& snapshot ) {}
+
 	void Present();
 
 	virtual void WindowResize( uint32_t Width, uint32_t Height ) override;
 
+	// With -profile-trace <file>, CPU profiling zones are recorded from startup and written to the file as a
+	// Chrome trace at exit. Pressing P in the mirror window writes what has been recorded so far.
+	virtual void KeyPressed( wchar_t key ) override;
+
 	Diligent::RENDER_DEVICE_TYPE GetDeviceType() const { return m_DeviceType; }
 
 	void ProcessOpenXrEvents();
@@ -94,18 +132,154 @@ public:
 	bool ShouldWait() const;
 
 	bool RunXrFrame( XrTime *displayTime );
+
+	// RenderEye runs inside a render pass that has already cleared the eye buffers, where state transitions
+	// aren't allowed. Declare everything it reads other than the eye buffers in DeclareEyeResources so the
+	// render graph has it in the right state before the pass begins, and bind it all with
+	// RESOURCE_STATE_TRANSITION_MODE_VERIFY.
 	virtual bool RenderEye( int eye ) = 0;
+	virtual void DeclareEyeResources( int eye, XRDE::RenderGraphPassBuilder& pass ) {}
 	virtual void UpdateEyeTransforms( float4x4 eyeToProj, float4x4 stageToEye, XrView& view ) {};
 
+	// GLTF_PBR_Renderer binds its buffers and resources with state transitions, so glTF models are drawn here
+	// instead, in a pass of their own after RenderEye that isn't a render pass. XrAppBase adds the pass while a
+	// model loaded with LoadGltfModel is alive, and has the glTF cache and the camera and light constants ready
+	// before it.
+	virtual void RenderEyeGltf( int eye ) {}
+
+	// Apps with a lot of draws can split them into chunks that are recorded on worker threads after RenderEye.
+	// Run with -record-threads <N> to create the deferred contexts. PrepareEyeDrawChunks runs on the immediate
+	// context first and has to transition everything the chunks use, see DeferredCommandRecorder.
+	virtual uint32_t GetEyeDrawChunkCount( int eye ) { return 0; }
+	virtual void PrepareEyeDrawChunks( int eye, Diligent::IDeviceContext* immediateContext ) {}
+	virtual void RecordEyeDrawChunks( int eye, Diligent::IDeviceContext* context, uint32_t firstChunk, uint32_t chunkCount ) {}
+	XRDE::DeferredCommandRecorder& GetCommandRecorder() { return m_commandRecorder; }
+
+	// Update can fan work out over this and must wait for it before returning. Run with -job-threads <N> to
+	// override the number of worker threads.
+	XRDE::JobSystem& GetJobSystem() { return m_jobSystem; }
+	const std::vector<XRDE::JobTiming>& GetLastFrameJobTimings() const { return m_lastFrameJobTimings; }
+
+	// Per pass and per eye GPU times are available from the profiler. Apps can time their own passes inside
+	// RenderEye with XRDE::GpuProfileScope.
+	XRDE::GpuProfiler& GetGpuProfiler() { return m_gpuProfiler; }
+	const XRDE::FrameStatistics& GetFrameStatistics() const { return m_frameStats; }
+
+	// Called when the runtime skipped one or more display slots because a frame was late, once the frame's GPU
+	// time is known. Apps can shed load here when the miss was CPU or GPU bound. A summary of every miss is
+	// printed at exit.
+	virtual void OnFrameMissed( const XRDE::FrameMiss& miss ) {}
+	const XRDE::FramePacingAnalyzer& GetFramePacing() const { return m_framePacing; }
+
+	// How long before its predicted display time each step of the last frame happened. Only measured when the
+	// runtime can convert the app's clock to XrTime; the distributions are printed at exit.
+	const XRDE::LatencyTracker& GetLatencyTracker() const { return m_latencyTracker; }
+
+	// CPU time spent submitting both eyes in the last frame, in seconds
+	double GetLastSubmitCpuTime() const { return m_lastSubmitCpuTime; }
+
+	// Run with -quality-governor to let the governor turn knobs down when frames run long, and
+	// -quality-headroom <percent> to change how far under the display period it aims. XrAppBase registers
+	// render scale and mirror rate knobs. Apps register their own in Initialize after calling the base.
+	XRDE::QualityGovernor& GetQualityGovernor() { return m_qualityGovernor; }
+
+	// Run with -record-trace <file> to record everything read from the runtime, and -replay-trace <file> to play
+	// it back instead of asking the runtime. Replays aren't paced by xrWaitFrame and don't submit frames, so
+	// they run as fast as the app can render. The app exits when the replay reaches the end of the trace.
+	bool IsReplayingTrace() const { return m_inputTrace.IsReplaying(); }
+
+	// Add -offline to a replay to run it without a runtime at all. The eyes are rendered into textures the app
+	// owns, sized from the view configuration in the trace, and the desktop mirror is skipped. With
+	// -offline-output <dir>, which implies -offline, every eye image is read back through a staging ring and
+	// written to the directory.
+	bool IsOffline() const { return m_offline; }
+
+	// Run with -capture <dir> to write what the headset shows to image files, or -capture-shm <name> to publish
+	// it in shared memory for a local encoder. Capturing never stalls a frame, it drops frames instead.
+	const XRDE::FrameCapture& GetFrameCapture() const { return m_frameCapture; }
+
+	// Quad and cylinder layers submitted on top of the eyes. Add them in PostSession, once the session exists, and
+	// mark them dirty when their content changes. Layers aren't shown in replays.
+	XRDE::CompositionLayerManager& GetCompositionLayers() { return m_compositionLayers; }
+
+	// Meshes drawn through the draw list are sorted by state and instanced. Register meshes and materials once,
+	// submit items from Update or ApplySnapshot, and call Draw from RenderEye. XrAppBase builds the list before
+	// the eyes render and declares its buffers to the render graph.
+	XRDE::DrawList& GetDrawList() { return m_drawList; }
+
+	// The mirror can only draw the list in frames whose eyes built it, because the instances are uploaded to a
+	// buffer that's discarded every frame
+	bool WasDrawListBuiltThisFrame() const { return m_drawListBuilt; }
+
+	// Run with -occlusion-cull to leave draw list items hidden behind occluders out of the frame. Register
+	// occluder meshes in Initialize and submit occluders next to the draw list items. The occluders are
+	// rasterized on the job system from the previous frame's views while xrWaitFrame blocks, so newly
+	// uncovered items show up a frame late.
+	XRDE::OcclusionCuller& GetOcclusionCuller() { return m_occlusionCuller; }
+
+	// xrLocateHandJointsEXT with the hand tracker for this hand, in stage space, through the input trace
+	XrResult LocateHandJointLocations( int hand, XrTime time, XrHandJointLocationsEXT* locations );
+
+	// The part of the eye swapchain images that is rendered to this frame
+	uint32_t GetEyeRenderWidth() const;
+	uint32_t GetEyeRenderHeight() const;
+
 	bool IsExtensionActive( const std::string& extensionName );
 
+	// With -gpu-skinning, skinned models are skinned in a compute pass once per pose and drawn unskinned by
+	// every pass after it.
 	std::unique_ptr<Diligent::GLTF::Model> LoadGltfModel( const std::string& path );
+	void ReleaseGltfModel( std::unique_ptr<Diligent::GLTF::Model>& model );
+	const XRDE::GpuSkinningStats& GetGpuSkinningStats() const { return m_gpuSkinning.GetLastStats(); }
+
+	// Loaded models are registered here. After moving a node, mark it dirty instead of calling
+	// Node::UpdateTransforms; XrAppBase updates what moved before the eyes and the mirror are drawn.
+	XRDE::SceneTransforms& GetSceneTransforms() { return m_sceneTransforms; }
+
+	// Add an instance for every loaded model that should play an animation, and give it bounds so it can be
+	// sampled less often when it's far away or out of view. XrAppBase samples the instances that are due on the
+	// render thread every frame, after xrWaitFrame and before the eyes are drawn, from the last frame's views.
+	XRDE::AnimationSystem& GetAnimationSystem() { return m_animations; }
+
+	// Loaded models with <name>_LOD<n> nodes draw one level per mesh. Add an instance for every place a model is
+	// drawn and Apply it before rendering there; XrAppBase picks the levels once per frame for both eyes.
+	XRDE::LodSelector& GetLodSelector() { return m_lodSelector; }
+
+	// Models the app plans to load. Used to size the glTF resource cache before anything is loaded.
+	virtual std::vector<XRDE::GltfModelManifestEntry> GetGltfModelManifest() { return {}; }
+
+	// Recreates the glTF resource cache at its initial size if no models are using it. Returns true if
+	// the cache was recreated.
+	bool TrimGltfResourceCache();
+	void UpdateGltfCacheStats();
+	const XRDE::GltfPoolStats& GetGltfPoolStats( XRDE::GltfPool pool ) const { return m_gltfCachePolicy.GetStats( pool ); }
+
+	// Every resource XrAppBase creates is registered here. Apps should register their own resources too.
+	XRDE::MemoryBudget& GetMemoryBudget() { return m_memoryBudget; }
 	void SetPbrEnvironmentMap( const std::string& environmentMapPath );
 
 protected:
 	void CreateGLTFResourceCache();
 	void CreateGltfRenderer();
 	void UpdateGltfBuffers( float4x4 eyeToProj, float4x4 stageToEye, XrView& view, float nearClip, float farClip );
+	void RenderEyeChunks( int eye, Diligent::ITextureView* eyeBuffer, Diligent::ITextureView* depthBuffer );
+	void DeclareGltfResources( XRDE::RenderGraphPassBuilder& pass );
+	bool UpdateGpuSkinning( Diligent::IDeviceContext* context );
+	void RegisterQualityKnobs();
+	bool StartInputTrace();
+	void FinishReplay();
+	bool CreateOfflineEyeTextures();
+	bool StartFrameCapture();
+	void ReadBackOfflineEyes( Diligent::ITexture* colorTexture );
+	void WriteOfflineFrame( const XRDE::ReadbackFrame& frame );
+	void CreateEyeViews( Diligent::ITexture* texture, Diligent::TEXTURE_VIEW_TYPE viewType,
+		std::vector< Diligent::RefCntAutoPtr<Diligent::ITextureView> > eyeViews[ 2 ] );
+	XrResult LocateViews( XrTime displayTime, XrViewState* viewState, uint32_t viewCapacity, uint32_t* viewCount, XrView* views );
+	void SetEyeViewport( Diligent::IDeviceContext* context );
+	void UpdateAnimations( double elapsedTime );
+	void StartSimulationThread();
+	void StopSimulationThread();
+	void SimulationThread();
 
 	Diligent::float4x4							  m_ViewToProj;
 
@@ -116,9 +290,84 @@ protected:
 	std::vector< Diligent::RefCntAutoPtr<Diligent::ITextureView> >  m_rpEyeDepthViews[ 2 ];
 	Diligent::RENDER_DEVICE_TYPE			m_DeviceType = Diligent::RENDER_DEVICE_TYPE_D3D11;
 	std::unique_ptr<IGraphicsBinding> m_pGraphicsBinding;
+	XRDE::DeferredCommandRecorder m_commandRecorder;
+	uint32_t m_recordingThreadCount = 0;
+	double m_lastSubmitCpuTime = 0;
+	XRDE::JobSystem m_jobSystem;
+	int32_t m_jobThreadCount = -1;
+	std::vector<XRDE::JobTiming> m_lastFrameJobTimings;
+
+	bool m_threadedSimulation = false;
+	std::thread m_simulationThread;
+	std::mutex m_simulationMutex;
+	std::condition_variable m_simulationWake;
+	bool m_stopSimulation = false;
+	XrTime m_renderDisplayTime = 0;
+	XrDuration m_renderDisplayPeriod = 0;
+	XRDE::TripleBuffer<XRDE::FrameSnapshot> m_snapshots;
+	bool m_haveSnapshot = false;
+
+	XRDE::GpuProfiler m_gpuProfiler;
+	XRDE::FrameStatistics m_frameStats;
+	double m_lastWaitFrameSeconds = 0;
+	double m_lastDisplayPeriodSeconds = 0;
+	XRDE::FramePacingAnalyzer m_framePacing;
+	XRDE::LatencyTracker m_latencyTracker;
+	double m_frameRuntimeSeconds = 0;
+
+	XRDE::QualityGovernor m_qualityGovernor;
+	float m_renderScale = 1.f;
+	uint32_t m_mirrorInterval = 1;
+	uint64_t m_mirrorFrame = 0;
+
+	XRDE::InputTrace m_inputTrace;
+	std::string m_recordTracePath;
+	std::string m_replayTracePath;
+	uint32_t m_traceFrameChannel = XRDE::InputTrace::k_invalidChannel;
+	uint32_t m_traceViewsChannel = XRDE::InputTrace::k_invalidChannel;
+	uint32_t m_traceSessionChannel = XRDE::InputTrace::k_invalidChannel;
+	uint32_t m_traceHandChannels[ 2 ] = { XRDE::InputTrace::k_invalidChannel, XRDE::InputTrace::k_invalidChannel };
+	uint32_t m_traceViewConfigChannel = XRDE::InputTrace::k_invalidChannel;
+	XrTime m_replayFirstDisplayTime = 0;
+	uint64_t m_replayFrameCount = 0;
+	double m_replayStartTime = 0;
+
+	bool m_offline = false;
+	std::string m_offlineOutputPath;
+	uint32_t m_offlineImageIndex = 0;
+	Diligent::TextureDesc m_offlineDepthDesc;
+	XRDE::TextureReadbackRing m_offlineReadback;
+	uint64_t m_offlineFramesWritten = 0;
+
+	XRDE::FrameCapture m_frameCapture;
+	std::string m_captureDirectory;
+	std::string m_captureSharedMemoryName;
+
+	std::string m_profileTracePath;
+
+	XRDE::CompositionLayerManager m_compositionLayers;
+	std::vector<XrCompositionLayerBaseHeader*> m_frameLayers;
+	XRDE::RenderGraph m_renderGraph;
+	XRDE::DrawList m_drawList;
+	bool m_drawListBuilt = false;
+
+	bool m_occlusionCulling = false;
+	XRDE::OcclusionCuller m_occlusionCuller;
+	XRDE::JobCounter m_occlusionJobs;
+	XrView m_lastViews[ 2 ] = { { XR_TYPE_VIEW }, { XR_TYPE_VIEW } };
+	bool m_haveLastViews = false;
 
 	Diligent::RefCntAutoPtr<Diligent::GLTF::ResourceManager> m_pResourceMgr;
 	Diligent::GLTF::ResourceCacheUseInfo           m_CacheUseInfo;
+	XRDE::GltfCachePolicy m_gltfCachePolicy;
+	bool m_gltfCachePolicyInitialized = false;
+	XRDE::GpuSkinning m_gpuSkinning;
+	XRDE::SceneTransforms m_sceneTransforms;
+	XRDE::AnimationSystem m_animations;
+	XrTime m_lastAnimationDisplayTime = 0;
+	bool m_animatedThisFrame = false;
+	XRDE::LodSelector m_lodSelector;
+	XRDE::MemoryBudget m_memoryBudget;
 	Diligent::GLTF_PBR_Renderer::ResourceCacheBindings m_CacheBindings;
 	std::unique_ptr< Diligent::GLTF_PBR_Renderer > m_gltfRenderer;
 	Diligent::RefCntAutoPtr<Diligent::ITextureView> m_pEnvironmentMapSRV;
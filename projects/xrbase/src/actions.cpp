@@ -2,9 +2,20 @@
 
 #include "actions.h"
 #include "graphics_utilities.h"
+#include "latency_tracker.h"
+
+#include <algorithm>
 
 using namespace XRDE;
 
+// Offline replays have no instance or session. Their input all comes from the trace, so there's nothing to
+// create or attach.
+static bool IsOfflineReplay( uint64_t handle )
+{
+	InputTrace* trace = ActiveInputTrace();
+	return handle == 0 && trace && trace->IsReplaying();
+}
+
 ActionSet::ActionSet( const std::string& name, const std::string& localizedName, uint32_t priority )
 {
 	m_createInfo = { XR_TYPE_ACTION_SET_CREATE_INFO };
@@ -15,6 +26,9 @@ ActionSet::ActionSet( const std::string& name, const std::string& localizedName,
 
 XrResult ActionSet::Init( XrInstance instance )
 {
+	if ( IsOfflineReplay( (uint64_t)instance ) )
+		return XR_SUCCESS;
+
 	XrResult res = xrCreateActionSet( instance, &m_createInfo, &m_handle );
 	if ( XR_FAILED( res ) )
 		return res;
@@ -32,6 +46,9 @@ XrResult ActionSet::Init( XrInstance instance )
 
 XrResult ActionSet::SessionInit( XrSession session )
 {
+	if ( IsOfflineReplay( (uint64_t)session ) )
+		return XR_SUCCESS;
+
 	for ( auto& action : m_actions )
 	{
 		if ( action->ActionType() != XR_ACTION_TYPE_POSE_INPUT )
@@ -109,24 +126,77 @@ XrResult Action::CreateSpaces( XrSession session )
 }
 
 
+uint32_t Action::TraceChannel( InputTrace* trace, TraceChannelKind kind, XrPath subactionPath )
+{
+	// Paths and handles change from run to run, so channels are named by action name and subaction index
+	std::lock_guard<std::mutex> lock( m_traceMutex );
+	auto i = m_traceChannels.find( subactionPath );
+	if ( i != m_traceChannels.end() )
+		return i->second;
+
+	std::string name = m_createInfo.actionName;
+	auto subaction = std::find( m_subactionPaths.begin(), m_subactionPaths.end(), subactionPath );
+	name += subaction == m_subactionPaths.end() ? "/all" : "/" + std::to_string( subaction - m_subactionPaths.begin() );
+
+	uint32_t channel = trace->GetChannel( kind, name );
+	m_traceChannels[ subactionPath ] = channel;
+	return channel;
+}
+
+
 XrResult Action::LocateSpace( XrSpace baseSpace, XrTime time, XrPath subactionPath, XrSpaceLocation* location )
 {
+	InputTrace* trace = ActiveInputTrace();
+	uint32_t channel = trace ? TraceChannel( trace, TraceChannelKind::SpaceLocation, subactionPath ) : InputTrace::k_invalidChannel;
+	if ( trace && trace->IsReplaying() )
+	{
+		XrResult res;
+		if ( !trace->ReplaySpaceLocation( channel, &res, location ) )
+			return XR_ERROR_HANDLE_INVALID;
+		return res;
+	}
+
 	auto i = m_spaces.find( subactionPath );
 	if ( i == m_spaces.end() )
 		return XR_ERROR_HANDLE_INVALID;
 
-	return xrLocateSpace( i->second, baseSpace, time, location );
+	if ( LatencyTracker* latency = ActiveLatencyTracker() )
+	{
+		latency->PoseSampled( time );
+	}
+	XrResult res = xrLocateSpace( i->second, baseSpace, time, location );
+	if ( trace )
+	{
+		trace->RecordSpaceLocation( channel, res, *location );
+	}
+	return res;
 }
 
 
 bool Action::GetBooleanState( XrSession session, XrPath subactionPath )
 {
-	XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
-	getInfo.action = Handle();
-	getInfo.subactionPath = subactionPath;
-
 	XrActionStateBoolean getState = { XR_TYPE_ACTION_STATE_BOOLEAN };
-	if ( XR_FAILED( xrGetActionStateBoolean( session, &getInfo, &getState ) ) )
+	XrResult res = XR_ERROR_HANDLE_INVALID;
+
+	InputTrace* trace = ActiveInputTrace();
+	uint32_t channel = trace ? TraceChannel( trace, TraceChannelKind::BooleanAction, subactionPath ) : InputTrace::k_invalidChannel;
+	if ( trace && trace->IsReplaying() )
+	{
+		trace->ReplayBooleanAction( channel, &res, &getState );
+	}
+	else
+	{
+		XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
+		getInfo.action = Handle();
+		getInfo.subactionPath = subactionPath;
+		res = xrGetActionStateBoolean( session, &getInfo, &getState );
+		if ( trace )
+		{
+			trace->RecordBooleanAction( channel, res, getState );
+		}
+	}
+
+	if ( XR_FAILED( res ) )
 		return false;
 
 	return getState.currentState;
@@ -134,12 +204,28 @@ bool Action::GetBooleanState( XrSession session, XrPath subactionPath )
 
 float Action::GetFloatState( XrSession session, XrPath subactionPath )
 {
-	XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
-	getInfo.action = Handle();
-	getInfo.subactionPath = subactionPath;
+	XrActionStateFloat getState = { XR_TYPE_ACTION_STATE_FLOAT };
+	XrResult res = XR_ERROR_HANDLE_INVALID;
 
-	XrActionStateFloat getState = { XR_TYPE_ACTION_STATE_BOOLEAN };
-	if ( XR_FAILED( xrGetActionStateFloat( session, &getInfo, &getState ) ) )
+	InputTrace* trace = ActiveInputTrace();
+	uint32_t channel = trace ? TraceChannel( trace, TraceChannelKind::FloatAction, subactionPath ) : InputTrace::k_invalidChannel;
+	if ( trace && trace->IsReplaying() )
+	{
+		trace->ReplayFloatAction( channel, &res, &getState );
+	}
+	else
+	{
+		XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
+		getInfo.action = Handle();
+		getInfo.subactionPath = subactionPath;
+		res = xrGetActionStateFloat( session, &getInfo, &getState );
+		if ( trace )
+		{
+			trace->RecordFloatAction( channel, res, getState );
+		}
+	}
+
+	if ( XR_FAILED( res ) )
 		return 0.f;
 
 	return getState.currentState;
@@ -148,12 +234,28 @@ float Action::GetFloatState( XrSession session, XrPath subactionPath )
 
 Diligent::float2 Action::GetVector2State( XrSession session, XrPath subactionPath )
 {
-	XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
-	getInfo.action = Handle();
-	getInfo.subactionPath = subactionPath;
-
 	XrActionStateVector2f getState = { XR_TYPE_ACTION_STATE_VECTOR2F};
-	if ( XR_FAILED( xrGetActionStateVector2f( session, &getInfo, &getState ) ) )
+	XrResult res = XR_ERROR_HANDLE_INVALID;
+
+	InputTrace* trace = ActiveInputTrace();
+	uint32_t channel = trace ? TraceChannel( trace, TraceChannelKind::Vector2Action, subactionPath ) : InputTrace::k_invalidChannel;
+	if ( trace && trace->IsReplaying() )
+	{
+		trace->ReplayVector2Action( channel, &res, &getState );
+	}
+	else
+	{
+		XrActionStateGetInfo getInfo = { XR_TYPE_ACTION_STATE_GET_INFO };
+		getInfo.action = Handle();
+		getInfo.subactionPath = subactionPath;
+		res = xrGetActionStateVector2f( session, &getInfo, &getState );
+		if ( trace )
+		{
+			trace->RecordVector2Action( channel, res, getState );
+		}
+	}
+
+	if ( XR_FAILED( res ) )
 		return { 0.f, 0.f };
 
 	return { getState.currentState.x, getState.currentState.y };
@@ -161,6 +263,9 @@ Diligent::float2 Action::GetVector2State( XrSession session, XrPath subactionPat
 
 void Action::ApplyHapticFeedback( XrSession session, XrPath subactionPath, float durationSeconds, float frequency, float amplitude )
 {
+	if ( IsOfflineReplay( (uint64_t)session ) )
+		return;
+
 	XrHapticActionInfo actionInfo = { XR_TYPE_HAPTIC_ACTION_INFO };
 	actionInfo.action = Handle();
 	actionInfo.subactionPath = subactionPath;
@@ -174,6 +279,9 @@ void Action::ApplyHapticFeedback( XrSession session, XrPath subactionPath, float
 
 void Action::StopApplyingHapticFeecback( XrSession session, XrPath subactionPath )
 {
+	if ( IsOfflineReplay( (uint64_t)session ) )
+		return;
+
 	XrHapticActionInfo actionInfo = { XR_TYPE_HAPTIC_ACTION_INFO };
 	actionInfo.action = Handle();
 	actionInfo.subactionPath = subactionPath;
@@ -220,6 +328,9 @@ std::vector< XrActionSuggestedBinding > Action::CollectBindings( XrPath interact
 
 XrResult XRDE::SuggestBindings( XrInstance instance, XrPath interactionProfile, const std::vector<const ActionSet*>& actionSets )
 {
+	if ( IsOfflineReplay( (uint64_t)instance ) )
+		return XR_SUCCESS;
+
 	std::vector<XrActionSuggestedBinding> bindings;
 	for ( const ActionSet* actionSet : actionSets )
 	{
@@ -239,7 +350,7 @@ XrResult XRDE::SuggestBindings( XrInstance instance, XrPath interactionProfile,
 
 XrResult XRDE::AttachActionSets( XrSession session, const std::vector< const ActionSet*>& actionSets )
 {
-	if ( actionSets.empty() )
+	if ( actionSets.empty() || IsOfflineReplay( (uint64_t)session ) )
 		return XR_SUCCESS;
 
 	std::vector<XrActionSet> actionSetHandles;
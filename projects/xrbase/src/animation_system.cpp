@@ -0,0 +1,497 @@
+#include "animation_system.h"
+#include "profile_zones.h"
+
+#include "graphics_utilities.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// instances sampled per job
+static const uint32_t k_instancesPerJob = 8;
+
+static const float4 k_identityRotation = { 0, 0, 0, 1.f };
+
+void AnimationSystem::Init( SceneTransforms* transforms )
+{
+	m_transforms = transforms;
+	m_transformsVersion = UINT32_MAX;
+}
+
+
+uint32_t AnimationSystem::AddInstance( GLTF::Model* model, uint32_t animationIndex, bool loop )
+{
+	if ( !model || animationIndex >= model->Animations.size() )
+		return k_invalidHandle;
+
+	return CreateInstance( &model->Animations[ animationIndex ], model, loop );
+}
+
+
+uint32_t AnimationSystem::AddInstance( const GLTF::Animation* animation, bool loop )
+{
+	if ( !animation )
+		return k_invalidHandle;
+
+	return CreateInstance( animation, animation, loop );
+}
+
+
+uint32_t AnimationSystem::CreateInstance( const GLTF::Animation* animation, const void* owner, bool loop )
+{
+	uint32_t handle = 0;
+	while ( handle < (uint32_t)m_instances.size() && m_instances[ handle ].active )
+	{
+		handle++;
+	}
+	if ( handle == (uint32_t)m_instances.size() )
+	{
+		m_instances.emplace_back();
+	}
+
+	Instance& instance = m_instances[ handle ];
+	instance = Instance();
+	instance.owner = owner;
+	instance.active = true;
+	instance.loop = loop;
+	if ( animation->Start <= animation->End )
+	{
+		instance.start = animation->Start;
+		instance.end = animation->End;
+	}
+	instance.time = instance.start;
+	instance.phase = handle;
+	instance.firstChannel = (uint32_t)m_channels.size();
+
+	// the rotations go last so each kind is interpolated in one run
+	for ( bool rotations : { false, true } )
+	{
+		for ( const GLTF::AnimationChannel& source : animation->Channels )
+		{
+			bool rotation = source.PathType == GLTF::AnimationChannel::PATH_TYPE::ROTATION;
+			if ( rotation != rotations || !source.node || source.SamplerIndex >= animation->Samplers.size() )
+				continue;
+
+			const GLTF::AnimationSampler& sampler = animation->Samplers[ source.SamplerIndex ];
+			bool cubic = sampler.Interpolation == GLTF::AnimationSampler::INTERPOLATION_TYPE::CUBICSPLINE;
+			Channel channel;
+			channel.times = sampler.Inputs.data();
+			channel.values = sampler.OutputsVec4.data();
+			channel.keyCount = (uint32_t)sampler.Inputs.size();
+			channel.valueStride = cubic ? 3 : 1;
+			channel.valueOffset = cubic ? 1 : 0;
+			channel.step = sampler.Interpolation == GLTF::AnimationSampler::INTERPOLATION_TYPE::STEP;
+			channel.node = source.node;
+			channel.nodeIndex = m_transforms ? m_transforms->FindNode( source.node ) : SceneTransforms::k_invalidIndex;
+			if ( rotation )
+			{
+				channel.path = ChannelPath_Rotation;
+			}
+			else
+			{
+				channel.path = source.PathType == GLTF::AnimationChannel::PATH_TYPE::SCALE ? ChannelPath_Scale : ChannelPath_Translation;
+			}
+			if ( !channel.keyCount || sampler.OutputsVec4.size() < (size_t)channel.keyCount * channel.valueStride )
+				continue;
+
+			m_channels.push_back( channel );
+			m_keyIndices.push_back( 0 );
+			if ( rotation )
+			{
+				instance.rotationChannelCount++;
+			}
+			else
+			{
+				instance.vectorChannelCount++;
+			}
+		}
+	}
+	return handle;
+}
+
+
+void AnimationSystem::RemoveInstance( uint32_t instance )
+{
+	if ( instance >= m_instances.size() || !m_instances[ instance ].active )
+		return;
+
+	Instance& removed = m_instances[ instance ];
+	removed.active = false;
+	m_deadChannelCount += removed.vectorChannelCount + removed.rotationChannelCount;
+	if ( m_deadChannelCount * 2 > m_channels.size() )
+	{
+		CompactChannels();
+	}
+}
+
+
+void AnimationSystem::RemoveModel( const GLTF::Model* model )
+{
+	for ( uint32_t i = 0; i < (uint32_t)m_instances.size(); i++ )
+	{
+		if ( m_instances[ i ].active && m_instances[ i ].owner == model )
+		{
+			RemoveInstance( i );
+		}
+	}
+}
+
+
+void AnimationSystem::CompactChannels()
+{
+	std::vector<Channel> channels;
+	std::vector<uint32_t> keyIndices;
+	channels.reserve( m_channels.size() - m_deadChannelCount );
+	keyIndices.reserve( m_channels.size() - m_deadChannelCount );
+	for ( Instance& instance : m_instances )
+	{
+		if ( !instance.active )
+			continue;
+
+		uint32_t count = instance.vectorChannelCount + instance.rotationChannelCount;
+		uint32_t first = (uint32_t)channels.size();
+		channels.insert( channels.end(), m_channels.begin() + instance.firstChannel, m_channels.begin() + instance.firstChannel + count );
+		keyIndices.insert( keyIndices.end(), m_keyIndices.begin() + instance.firstChannel, m_keyIndices.begin() + instance.firstChannel + count );
+		instance.firstChannel = first;
+	}
+	m_channels.swap( channels );
+	m_keyIndices.swap( keyIndices );
+	m_deadChannelCount = 0;
+}
+
+
+void AnimationSystem::SetTime( uint32_t instance, float seconds )
+{
+	if ( instance < m_instances.size() )
+	{
+		m_instances[ instance ].time = seconds;
+	}
+}
+
+
+void AnimationSystem::SetSpeed( uint32_t instance, float speed )
+{
+	if ( instance < m_instances.size() )
+	{
+		m_instances[ instance ].speed = speed;
+	}
+}
+
+
+void AnimationSystem::SetBounds( uint32_t instance, const float3& center, float radius )
+{
+	if ( instance < m_instances.size() )
+	{
+		m_instances[ instance ].boundsCenter = center;
+		m_instances[ instance ].boundsRadius = radius;
+	}
+}
+
+
+void AnimationSystem::SetViews( const XrView views[ 2 ] )
+{
+	for ( int eye = 0; eye < 2; eye++ )
+	{
+		m_stageToEye[ eye ] = matrixFromPose( views[ eye ].pose ).Inverse();
+
+		// the side planes go through the eye, and the view looks down -z
+		const XrFovf& fov = views[ eye ].fov;
+		m_eyePlanes[ eye ][ 0 ] = float4( cosf( fov.angleLeft ), 0, sinf( fov.angleLeft ), 0 );
+		m_eyePlanes[ eye ][ 1 ] = float4( -cosf( fov.angleRight ), 0, -sinf( fov.angleRight ), 0 );
+		m_eyePlanes[ eye ][ 2 ] = float4( 0, -cosf( fov.angleUp ), -sinf( fov.angleUp ), 0 );
+		m_eyePlanes[ eye ][ 3 ] = float4( 0, cosf( fov.angleDown ), sinf( fov.angleDown ), 0 );
+	}
+	m_viewerPosition = ( vectorFromXrVector( views[ 0 ].pose.position ) + vectorFromXrVector( views[ 1 ].pose.position ) ) * 0.5f;
+	m_haveViews = true;
+}
+
+
+uint32_t AnimationSystem::UpdateInterval( const Instance& instance ) const
+{
+	if ( !m_haveViews || instance.boundsRadius <= 0 )
+		return 1;
+
+	bool visible = false;
+	for ( int eye = 0; eye < 2 && !visible; eye++ )
+	{
+		float4 center = float4( instance.boundsCenter, 1.f ) * m_stageToEye[ eye ];
+		visible = true;
+		for ( int p = 0; p < 4 && visible; p++ )
+		{
+			const float4& plane = m_eyePlanes[ eye ][ p ];
+			visible = plane.x * center.x + plane.y * center.y + plane.z * center.z >= -instance.boundsRadius;
+		}
+	}
+	if ( !visible )
+		return std::max( m_lodSettings.offscreenInterval, 1u );
+
+	float distance = length( instance.boundsCenter - m_viewerPosition );
+	float size = instance.boundsRadius / std::max( distance, 1e-3f );
+	uint32_t interval = 1;
+	float threshold = m_lodSettings.fullRateSize;
+	while ( size < threshold && interval < m_lodSettings.maxInterval )
+	{
+		interval *= 2;
+		threshold *= 0.5f;
+	}
+	return interval;
+}
+
+
+// Finds the keys around the time for every channel, starting from the key each channel was at last time
+void AnimationSystem::GatherKeys( uint32_t firstChannel, uint32_t channelCount, float time, SampleScratch* scratch )
+{
+	for ( uint32_t c = 0; c < channelCount; c++ )
+	{
+		const Channel& channel = m_channels[ firstChannel + c ];
+		uint32_t& key = m_keyIndices[ firstChannel + c ];
+		const float* times = channel.times;
+		uint32_t last = channel.keyCount - 1;
+		float weight = 0;
+		if ( time <= times[ 0 ] || !last )
+		{
+			key = 0;
+		}
+		else if ( time >= times[ last ] )
+		{
+			key = last;
+		}
+		else
+		{
+			// looping or seeking backwards is the only case that needs a search
+			if ( key >= last || times[ key ] > time )
+			{
+				key = (uint32_t)( std::upper_bound( times, times + last, time ) - times ) - 1;
+			}
+			while ( times[ key + 1 ] <= time )
+			{
+				key++;
+			}
+			weight = channel.step ? 0.f : ( time - times[ key ] ) / ( times[ key + 1 ] - times[ key ] );
+		}
+
+		uint32_t next = std::min( key + 1, last );
+		scratch->from[ c ] = channel.values[ key * channel.valueStride + channel.valueOffset ];
+		scratch->to[ c ] = channel.values[ next * channel.valueStride + channel.valueOffset ];
+		scratch->weights[ c ] = weight;
+	}
+}
+
+
+static void LerpVectors( const float4* from, const float4* to, const float* weights, float4* results, uint32_t count )
+{
+	for ( uint32_t c = 0; c < count; c += 4 )
+	{
+		__m128 x0 = _mm_loadu_ps( &from[ c ].x );
+		__m128 y0 = _mm_loadu_ps( &from[ c + 1 ].x );
+		__m128 z0 = _mm_loadu_ps( &from[ c + 2 ].x );
+		__m128 w0 = _mm_loadu_ps( &from[ c + 3 ].x );
+		__m128 x1 = _mm_loadu_ps( &to[ c ].x );
+		__m128 y1 = _mm_loadu_ps( &to[ c + 1 ].x );
+		__m128 z1 = _mm_loadu_ps( &to[ c + 2 ].x );
+		__m128 w1 = _mm_loadu_ps( &to[ c + 3 ].x );
+		_MM_TRANSPOSE4_PS( x0, y0, z0, w0 );
+		_MM_TRANSPOSE4_PS( x1, y1, z1, w1 );
+
+		__m128 t = _mm_loadu_ps( &weights[ c ] );
+		__m128 x = _mm_add_ps( x0, _mm_mul_ps( _mm_sub_ps( x1, x0 ), t ) );
+		__m128 y = _mm_add_ps( y0, _mm_mul_ps( _mm_sub_ps( y1, y0 ), t ) );
+		__m128 z = _mm_add_ps( z0, _mm_mul_ps( _mm_sub_ps( z1, z0 ), t ) );
+		__m128 w = _mm_add_ps( w0, _mm_mul_ps( _mm_sub_ps( w1, w0 ), t ) );
+
+		_MM_TRANSPOSE4_PS( x, y, z, w );
+		_mm_storeu_ps( &results[ c ].x, x );
+		_mm_storeu_ps( &results[ c + 1 ].x, y );
+		_mm_storeu_ps( &results[ c + 2 ].x, z );
+		_mm_storeu_ps( &results[ c + 3 ].x, w );
+	}
+}
+
+
+// Normalized lerp along the shorter arc. The weight is bent with a polynomial in the angle between the two
+// rotations so the result follows slerp to within about 0.1 degrees, without the trigonometry.
+static void InterpolateRotations( const float4* from, const float4* to, const float* weights, float4* results, uint32_t count )
+{
+	const __m128 signBit = _mm_set1_ps( -0.f );
+	const __m128 half = _mm_set1_ps( 0.5f );
+	const __m128 one = _mm_set1_ps( 1.f );
+	for ( uint32_t c = 0; c < count; c += 4 )
+	{
+		__m128 x0 = _mm_loadu_ps( &from[ c ].x );
+		__m128 y0 = _mm_loadu_ps( &from[ c + 1 ].x );
+		__m128 z0 = _mm_loadu_ps( &from[ c + 2 ].x );
+		__m128 w0 = _mm_loadu_ps( &from[ c + 3 ].x );
+		__m128 x1 = _mm_loadu_ps( &to[ c ].x );
+		__m128 y1 = _mm_loadu_ps( &to[ c + 1 ].x );
+		__m128 z1 = _mm_loadu_ps( &to[ c + 2 ].x );
+		__m128 w1 = _mm_loadu_ps( &to[ c + 3 ].x );
+		_MM_TRANSPOSE4_PS( x0, y0, z0, w0 );
+		_MM_TRANSPOSE4_PS( x1, y1, z1, w1 );
+
+		__m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x0, x1 ), _mm_mul_ps( y0, y1 ) ),
+			_mm_add_ps( _mm_mul_ps( z0, z1 ), _mm_mul_ps( w0, w1 ) ) );
+		__m128 flip = _mm_and_ps( d, signBit );
+		x1 = _mm_xor_ps( x1, flip );
+		y1 = _mm_xor_ps( y1, flip );
+		z1 = _mm_xor_ps( z1, flip );
+		w1 = _mm_xor_ps( w1, flip );
+		d = _mm_andnot_ps( signBit, d );
+
+		// t + t * ( t - 0.5 ) * ( t - 1 ) * ( A * ( t - 0.5 )^2 + B ), with A and B fitted over the cosine
+		__m128 t = _mm_loadu_ps( &weights[ c ] );
+		__m128 a = _mm_add_ps( _mm_set1_ps( 3.55645f ), _mm_mul_ps( d, _mm_set1_ps( -1.43519f ) ) );
+		a = _mm_add_ps( _mm_set1_ps( -3.2452f ), _mm_mul_ps( d, a ) );
+		a = _mm_add_ps( _mm_set1_ps( 1.0904f ), _mm_mul_ps( d, a ) );
+		__m128 b = _mm_add_ps( _mm_set1_ps( -1.06021f ), _mm_mul_ps( d, _mm_set1_ps( 0.215638f ) ) );
+		b = _mm_add_ps( _mm_set1_ps( 0.848013f ), _mm_mul_ps( d, b ) );
+		__m128 centered = _mm_sub_ps( t, half );
+		__m128 k = _mm_add_ps( _mm_mul_ps( a, _mm_mul_ps( centered, centered ) ), b );
+		t = _mm_add_ps( t, _mm_mul_ps( _mm_mul_ps( t, centered ), _mm_mul_ps( _mm_sub_ps( t, one ), k ) ) );
+
+		__m128 x = _mm_add_ps( x0, _mm_mul_ps( _mm_sub_ps( x1, x0 ), t ) );
+		__m128 y = _mm_add_ps( y0, _mm_mul_ps( _mm_sub_ps( y1, y0 ), t ) );
+		__m128 z = _mm_add_ps( z0, _mm_mul_ps( _mm_sub_ps( z1, z0 ), t ) );
+		__m128 w = _mm_add_ps( w0, _mm_mul_ps( _mm_sub_ps( w1, w0 ), t ) );
+		__m128 lengthSquared = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ),
+			_mm_add_ps( _mm_mul_ps( z, z ), _mm_mul_ps( w, w ) ) );
+		__m128 scale = _mm_div_ps( one, _mm_sqrt_ps( lengthSquared ) );
+		x = _mm_mul_ps( x, scale );
+		y = _mm_mul_ps( y, scale );
+		z = _mm_mul_ps( z, scale );
+		w = _mm_mul_ps( w, scale );
+
+		_MM_TRANSPOSE4_PS( x, y, z, w );
+		_mm_storeu_ps( &results[ c ].x, x );
+		_mm_storeu_ps( &results[ c + 1 ].x, y );
+		_mm_storeu_ps( &results[ c + 2 ].x, z );
+		_mm_storeu_ps( &results[ c + 3 ].x, w );
+	}
+}
+
+
+void AnimationSystem::SampleInstance( uint32_t index, SampleScratch* scratch )
+{
+	const Instance& instance = m_instances[ index ];
+	uint32_t vectorCount = instance.vectorChannelCount;
+	uint32_t rotationCount = instance.rotationChannelCount;
+	uint32_t count = vectorCount + rotationCount;
+	if ( !count )
+		return;
+
+	// room for the last group of four to run past the end, on identity rotations that normalize cleanly
+	uint32_t padded = count + 4;
+	if ( scratch->from.size() < padded )
+	{
+		scratch->from.resize( padded );
+		scratch->to.resize( padded );
+		scratch->weights.resize( padded );
+		scratch->results.resize( padded );
+	}
+	std::fill( scratch->from.begin() + count, scratch->from.begin() + padded, k_identityRotation );
+	std::fill( scratch->to.begin() + count, scratch->to.begin() + padded, k_identityRotation );
+	std::fill( scratch->weights.begin() + count, scratch->weights.begin() + padded, 0.f );
+
+	GatherKeys( instance.firstChannel, count, instance.time, scratch );
+
+	// the vectors run into the first rotations, which are then written again
+	LerpVectors( scratch->from.data(), scratch->to.data(), scratch->weights.data(), scratch->results.data(), vectorCount );
+	InterpolateRotations( scratch->from.data() + vectorCount, scratch->to.data() + vectorCount, scratch->weights.data() + vectorCount,
+		scratch->results.data() + vectorCount, rotationCount );
+
+	for ( uint32_t c = 0; c < count; c++ )
+	{
+		const Channel& channel = m_channels[ instance.firstChannel + c ];
+		const float4& result = scratch->results[ c ];
+		switch ( channel.path )
+		{
+		case ChannelPath_Translation: channel.node->Translation = float3( result.x, result.y, result.z ); break;
+		case ChannelPath_Rotation: channel.node->Rotation.q = result; break;
+		case ChannelPath_Scale: channel.node->Scale = float3( result.x, result.y, result.z ); break;
+		}
+		if ( m_transforms )
+		{
+			m_transforms->MarkDirty( channel.nodeIndex );
+		}
+	}
+}
+
+
+void AnimationSystem::Update( JobSystem& jobs, double elapsedSeconds )
+{
+	XRDE_PROFILE_FUNCTION();
+	m_frameIndex++;
+	m_lastStats = AnimationStats();
+
+	// node indices change when the scene transforms rebuild their layout
+	if ( m_transforms && m_transforms->GetLayoutVersion() != m_transformsVersion )
+	{
+		for ( Channel& channel : m_channels )
+		{
+			channel.nodeIndex = m_transforms->FindNode( channel.node );
+		}
+		m_transformsVersion = m_transforms->GetLayoutVersion();
+	}
+
+	m_dueInstances.clear();
+	for ( uint32_t i = 0; i < (uint32_t)m_instances.size(); i++ )
+	{
+		Instance& instance = m_instances[ i ];
+		if ( !instance.active )
+			continue;
+
+		m_lastStats.instanceCount++;
+		instance.time += (float)elapsedSeconds * instance.speed;
+		float duration = instance.end - instance.start;
+		if ( instance.loop && duration > 0 )
+		{
+			instance.time = instance.start + fmodf( instance.time - instance.start, duration );
+			if ( instance.time < instance.start )
+			{
+				instance.time += duration;
+			}
+		}
+		else
+		{
+			instance.time = std::min( std::max( instance.time, instance.start ), instance.end );
+		}
+
+		if ( ( m_frameIndex + instance.phase ) % UpdateInterval( instance ) == 0 )
+		{
+			m_dueInstances.push_back( i );
+			m_lastStats.sampledChannelCount += instance.vectorChannelCount + instance.rotationChannelCount;
+		}
+	}
+	m_lastStats.sampledInstanceCount = (uint32_t)m_dueInstances.size();
+
+	uint32_t jobCount = ( (uint32_t)m_dueInstances.size() + k_instancesPerJob - 1 ) / k_instancesPerJob;
+	if ( m_scratch.size() < std::max( jobCount, 1u ) )
+	{
+		m_scratch.resize( std::max( jobCount, 1u ) );
+	}
+	if ( jobCount < 2 || jobs.GetThreadCount() < 2 )
+	{
+		for ( uint32_t instance : m_dueInstances )
+		{
+			SampleInstance( instance, &m_scratch[ 0 ] );
+		}
+		return;
+	}
+
+	JobCounter sampleJobs;
+	for ( uint32_t job = 0; job < jobCount; job++ )
+	{
+		jobs.Run( "Sample animations", [ this, job ]
+			{
+				uint32_t end = std::min( (uint32_t)m_dueInstances.size(), ( job + 1 ) * k_instancesPerJob );
+				for ( uint32_t i = job * k_instancesPerJob; i < end; i++ )
+				{
+					SampleInstance( m_dueInstances[ i ], &m_scratch[ job ] );
+				}
+			}, &sampleJobs );
+	}
+	jobs.Wait( sampleJobs );
+}
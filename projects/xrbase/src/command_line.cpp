@@ -0,0 +1,42 @@
+#include "command_line.h"
+
+#include <cstring>
+
+using namespace XRDE;
+
+// A trailing space in the token ends it
+static const char* FindCommandLineToken( const std::string& cmdLine, const char* token )
+{
+	size_t length = strlen( token );
+	for ( size_t pos = cmdLine.find( token ); pos != std::string::npos; pos = cmdLine.find( token, pos + 1 ) )
+	{
+		bool starts = pos == 0 || cmdLine[ pos - 1 ] == ' ';
+		bool ends = token[ length - 1 ] == ' ' || pos + length == cmdLine.size() || cmdLine[ pos + length ] == ' ';
+		if ( starts && ends )
+			return cmdLine.c_str() + pos;
+	}
+	return nullptr;
+}
+
+bool XRDE::HasCommandLineFlag( const std::string& cmdLine, const char* flag )
+{
+	return FindCommandLineToken( cmdLine, flag ) != nullptr;
+}
+
+bool XRDE::GetCommandLineValue( const std::string& cmdLine, const char* key, std::string* value )
+{
+	const auto* pos = FindCommandLineToken( cmdLine, key );
+	if ( pos == nullptr )
+		return false;
+
+	pos += strlen( key );
+	while ( *pos == ' ' )
+		pos++;
+
+	const auto* end = pos;
+	while ( *end && *end != ' ' )
+		end++;
+
+	*value = std::string( pos, end );
+	return true;
+}
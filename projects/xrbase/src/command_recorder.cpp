@@ -0,0 +1,168 @@
+#include "command_recorder.h"
+#include "profile_zones.h"
+
+#include <algorithm>
+
+using namespace XRDE;
+using namespace Diligent;
+
+DeferredCommandRecorder::~DeferredCommandRecorder()
+{
+	Shutdown();
+}
+
+
+void DeferredCommandRecorder::Init( const std::vector<IDeviceContext*>& deferredContexts )
+{
+	Shutdown();
+
+	m_shutdown = false;
+	m_generation = 0;
+	for ( IDeviceContext* context : deferredContexts )
+	{
+		m_contexts.push_back( RefCntAutoPtr<IDeviceContext>( context ) );
+	}
+	m_commandLists.resize( m_contexts.size() );
+	m_activeContexts = (uint32_t)m_contexts.size();
+
+	for ( uint32_t i = 0; i < m_contexts.size(); i++ )
+	{
+		m_workers.emplace_back( &DeferredCommandRecorder::WorkerThread, this, i );
+	}
+}
+
+
+void DeferredCommandRecorder::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_shutdown = true;
+	}
+	m_workReady.notify_all();
+
+	for ( std::thread& worker : m_workers )
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_commandLists.clear();
+	m_contexts.clear();
+	m_activeContexts = 0;
+}
+
+
+void DeferredCommandRecorder::SetActiveContextCount( uint32_t count )
+{
+	m_activeContexts = std::min( count, (uint32_t)m_contexts.size() );
+}
+
+
+void DeferredCommandRecorder::RecordAndExecute( IDeviceContext* immediateContext, uint32_t chunkCount,
+	const SetupFunction& setup, const RecordFunction& record )
+{
+	if ( m_activeContexts == 0 )
+	{
+		// nothing to fan out to, so just record on the immediate context
+		setup( immediateContext );
+		record( immediateContext, 0, chunkCount );
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_chunkCount = chunkCount;
+		m_recordingContexts = m_activeContexts;
+		m_setup = &setup;
+		m_record = &record;
+		m_pendingWorkers = (uint32_t)m_workers.size();
+		m_generation++;
+	}
+	m_workReady.notify_all();
+
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_workDone.wait( lock, [ this ] { return m_pendingWorkers == 0; } );
+		m_setup = nullptr;
+		m_record = nullptr;
+	}
+
+	std::vector<ICommandList*> commandLists;
+	for ( auto& commandList : m_commandLists )
+	{
+		if ( commandList )
+		{
+			commandLists.push_back( commandList );
+		}
+	}
+
+	if ( !commandLists.empty() )
+	{
+		immediateContext->ExecuteCommandLists( (Uint32)commandLists.size(), commandLists.data() );
+	}
+
+	for ( auto& commandList : m_commandLists )
+	{
+		commandList.Release();
+	}
+}
+
+
+void DeferredCommandRecorder::FinishFrame()
+{
+	for ( auto& context : m_contexts )
+	{
+		context->FinishFrame();
+	}
+}
+
+
+void DeferredCommandRecorder::WorkerThread( uint32_t workerIndex )
+{
+	XRDE_PROFILE_THREAD_NAME( "Command recorder" );
+	uint64_t lastGeneration = 0;
+	while ( true )
+	{
+		uint32_t chunkCount;
+		uint32_t workerCount;
+		const SetupFunction* setup;
+		const RecordFunction* record;
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_workReady.wait( lock, [ & ] { return m_shutdown || m_generation != lastGeneration; } );
+			if ( m_shutdown )
+				return;
+
+			lastGeneration = m_generation;
+			chunkCount = m_chunkCount;
+			workerCount = m_recordingContexts;
+			setup = m_setup;
+			record = m_record;
+		}
+
+		// contiguous ranges keep the draws in order when the lists are executed in worker order, and the
+		// inactive workers get none
+		uint32_t firstChunk = 0;
+		uint32_t endChunk = 0;
+		if ( workerIndex < workerCount )
+		{
+			firstChunk = (uint32_t)( (uint64_t)chunkCount * workerIndex / workerCount );
+			endChunk = (uint32_t)( (uint64_t)chunkCount * ( workerIndex + 1 ) / workerCount );
+		}
+
+		if ( endChunk > firstChunk )
+		{
+			XRDE_PROFILE_ZONE( "Record chunks" );
+			IDeviceContext* context = m_contexts[ workerIndex ];
+			context->Begin( 0 );
+			( *setup )( context );
+			( *record )( context, firstChunk, endChunk - firstChunk );
+			context->FinishCommandList( &m_commandLists[ workerIndex ] );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_pendingWorkers--;
+		}
+		m_workDone.notify_one();
+	}
+}
@@ -0,0 +1,312 @@
+#include "composition_layers.h"
+#include "profile_zones.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace XRDE;
+using namespace Diligent;
+
+void CompositionLayerManager::Init( XrSession session, XrSpace stageSpace, IGraphicsBinding* graphicsBinding,
+	MemoryBudget* memoryBudget, int64_t format, bool cylinderSupported )
+{
+	Shutdown();
+	m_session = session;
+	m_stageSpace = stageSpace;
+	m_graphicsBinding = graphicsBinding;
+	m_memoryBudget = memoryBudget;
+	m_format = format;
+	m_cylinderSupported = cylinderSupported;
+}
+
+
+void CompositionLayerManager::Shutdown()
+{
+	for ( std::unique_ptr<Layer>& layer : m_layers )
+	{
+		if ( layer )
+		{
+			DestroyLayer( *layer );
+		}
+	}
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_layers.clear();
+	m_session = XR_NULL_HANDLE;
+}
+
+
+uint32_t CompositionLayerManager::AddLayer( const CompositionLayerDesc& desc, const CompositionLayerRenderFn& render )
+{
+	if ( !IsInitialized() )
+		return k_invalidLayer;
+
+	if ( desc.shape == CompositionLayerShape::Cylinder && !m_cylinderSupported )
+	{
+		std::cerr << "Cylinder layers need " << XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME << "\n";
+		return k_invalidLayer;
+	}
+
+	XrSwapchainCreateInfo createInfo = { XR_TYPE_SWAPCHAIN_CREATE_INFO };
+	createInfo.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT | XR_SWAPCHAIN_USAGE_SAMPLED_BIT;
+	createInfo.format = m_format;
+	createInfo.sampleCount = 1;
+	createInfo.width = desc.width;
+	createInfo.height = desc.height;
+	createInfo.faceCount = 1;
+	createInfo.arraySize = 1;
+	createInfo.mipCount = 1;
+
+	std::unique_ptr<Layer> layer = std::make_unique<Layer>();
+	layer->desc = desc;
+	layer->render = render;
+	if ( XR_FAILED( xrCreateSwapchain( m_session, &createInfo, &layer->swapchain ) ) )
+	{
+		std::cerr << "Unable to create a " << desc.width << "x" << desc.height << " composition layer swapchain\n";
+		return k_invalidLayer;
+	}
+
+	layer->textures = m_graphicsBinding->ReadImagesFromSwapchain( layer->swapchain );
+	for ( RefCntAutoPtr<ITexture>& pTexture : layer->textures )
+	{
+		TextureViewDesc viewDesc;
+		viewDesc.ViewType = TEXTURE_VIEW_RENDER_TARGET;
+		RefCntAutoPtr<ITextureView> pTarget;
+		if ( pTexture )
+		{
+			pTexture->CreateView( viewDesc, &pTarget );
+		}
+		if ( !pTarget )
+		{
+			std::cerr << "Unable to create render targets for a composition layer swapchain\n";
+			DestroyLayer( *layer );
+			return k_invalidLayer;
+		}
+		layer->targets.push_back( pTarget );
+
+		if ( m_memoryBudget )
+		{
+			m_memoryBudget->RegisterTexture( pTexture, MemoryCategory::SwapchainColor );
+		}
+	}
+
+	XrCompositionLayerFlags flags = 0;
+	if ( desc.alphaBlend )
+	{
+		flags |= XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+		if ( !desc.premultipliedAlpha )
+		{
+			flags |= XR_COMPOSITION_LAYER_UNPREMULTIPLIED_ALPHA_BIT;
+		}
+	}
+
+	XrSwapchainSubImage subImage = {};
+	subImage.swapchain = layer->swapchain;
+	subImage.imageRect = { { 0, 0 }, { (int32_t)desc.width, (int32_t)desc.height } };
+	subImage.imageArrayIndex = 0;
+	XrSpace space = desc.space != XR_NULL_HANDLE ? desc.space : m_stageSpace;
+
+	layer->quad.layerFlags = flags;
+	layer->quad.space = space;
+	layer->quad.eyeVisibility = desc.eyeVisibility;
+	layer->quad.subImage = subImage;
+	layer->quad.pose = desc.pose;
+	layer->quad.size = desc.size;
+
+	layer->cylinder.layerFlags = flags;
+	layer->cylinder.space = space;
+	layer->cylinder.eyeVisibility = desc.eyeVisibility;
+	layer->cylinder.subImage = subImage;
+	layer->cylinder.pose = desc.pose;
+	layer->cylinder.radius = desc.radius;
+	layer->cylinder.centralAngle = desc.centralAngle;
+	layer->cylinder.aspectRatio = desc.aspectRatio;
+
+	// reuse the slot of a removed layer so adding and removing panels doesn't grow the list forever
+	std::lock_guard<std::mutex> lock( m_mutex );
+	for ( uint32_t i = 0; i < (uint32_t)m_layers.size(); i++ )
+	{
+		if ( !m_layers[ i ] )
+		{
+			m_layers[ i ] = std::move( layer );
+			return i;
+		}
+	}
+	m_layers.push_back( std::move( layer ) );
+	return (uint32_t)m_layers.size() - 1;
+}
+
+
+void CompositionLayerManager::RemoveLayer( uint32_t layer )
+{
+	if ( Layer* l = GetLayer( layer ) )
+	{
+		DestroyLayer( *l );
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_layers[ layer ].reset();
+	}
+}
+
+
+void CompositionLayerManager::DestroyLayer( Layer& layer )
+{
+	if ( m_memoryBudget )
+	{
+		for ( RefCntAutoPtr<ITexture>& pTexture : layer.textures )
+		{
+			m_memoryBudget->Unregister( pTexture.RawPtr() );
+		}
+	}
+	layer.targets.clear();
+	layer.textures.clear();
+	if ( layer.swapchain != XR_NULL_HANDLE )
+	{
+		xrDestroySwapchain( layer.swapchain );
+		layer.swapchain = XR_NULL_HANDLE;
+	}
+}
+
+
+CompositionLayerManager::Layer* CompositionLayerManager::GetLayer( uint32_t layer )
+{
+	return layer < m_layers.size() ? m_layers[ layer ].get() : nullptr;
+}
+
+
+void CompositionLayerManager::MarkDirty( uint32_t layer )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( Layer* l = GetLayer( layer ) )
+	{
+		l->dirty.store( true, std::memory_order_relaxed );
+	}
+}
+
+
+void CompositionLayerManager::SetPose( uint32_t layer, const XrPosef& pose )
+{
+	if ( Layer* l = GetLayer( layer ) )
+	{
+		// moving a layer doesn't need new content, the compositor puts the old image in the new place
+		l->desc.pose = pose;
+		l->quad.pose = pose;
+		l->cylinder.pose = pose;
+	}
+}
+
+
+void CompositionLayerManager::SetVisible( uint32_t layer, bool visible )
+{
+	if ( Layer* l = GetLayer( layer ) )
+	{
+		l->visible = visible;
+	}
+}
+
+
+bool CompositionLayerManager::UpdateLayers( IDeviceContext* context, XrTime displayTime )
+{
+	XRDE_PROFILE_FUNCTION();
+	bool ok = true;
+	for ( std::unique_ptr<Layer>& layer : m_layers )
+	{
+		if ( !layer )
+			continue;
+
+		layer->renderedThisFrame = false;
+
+		// hidden layers keep their dirty flag and catch up when they're shown again
+		if ( !layer->visible || !layer->dirty.load( std::memory_order_relaxed ) )
+			continue;
+
+		XrDuration interval = (XrDuration)std::llround( layer->desc.minUpdateInterval * 1e9 );
+		if ( layer->hasContent && displayTime - layer->lastRenderTime < interval )
+			continue;
+
+		layer->dirty.store( false, std::memory_order_relaxed );
+		if ( !RenderLayer( context, *layer ) )
+		{
+			ok = false;
+			continue;
+		}
+		layer->lastRenderTime = displayTime;
+	}
+	return ok;
+}
+
+
+bool CompositionLayerManager::RenderLayer( IDeviceContext* context, Layer& layer )
+{
+	uint32_t index;
+	XrSwapchainImageAcquireInfo acquireInfo = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+	if ( XR_FAILED( xrAcquireSwapchainImage( layer.swapchain, &acquireInfo, &index ) ) )
+		return false;
+
+	XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+	waitInfo.timeout = XR_INFINITE_DURATION;
+	XrSwapchainImageReleaseInfo releaseInfo = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+	if ( XR_FAILED( xrWaitSwapchainImage( layer.swapchain, &waitInfo ) ) )
+	{
+		// an acquired image has to be released even if it was never waited on, or the next acquire fails
+		xrReleaseSwapchainImage( layer.swapchain, &releaseInfo );
+		return false;
+	}
+
+	// SetRenderTargets also sets the viewport to the whole image
+	ITextureView* target = layer.targets[ index ];
+	context->SetRenderTargets( 1, &target, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	context->ClearRenderTarget( target, layer.desc.clearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+
+	if ( layer.render )
+	{
+		layer.render( context, target, layer.desc.width, layer.desc.height );
+	}
+
+	// the runtime expects the image back in the state it handed it over in
+	StateTransitionDesc transition;
+	transition.pResource = layer.textures[ index ];
+	transition.NewState = RESOURCE_STATE_RENDER_TARGET;
+	transition.Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
+	context->TransitionResourceStates( 1, &transition );
+
+	if ( XR_FAILED( xrReleaseSwapchainImage( layer.swapchain, &releaseInfo ) ) )
+		return false;
+
+	layer.hasContent = true;
+	layer.renderedThisFrame = true;
+	m_renderCount++;
+	return true;
+}
+
+
+void CompositionLayerManager::AppendLayers( std::vector<XrCompositionLayerBaseHeader*>& layers )
+{
+	for ( std::unique_ptr<Layer>& layer : m_layers )
+	{
+		if ( !layer || !layer->visible || !layer->hasContent )
+			continue;
+
+		if ( !layer->renderedThisFrame )
+		{
+			m_reuseCount++;
+		}
+
+		if ( layer->desc.shape == CompositionLayerShape::Cylinder )
+		{
+			layers.push_back( (XrCompositionLayerBaseHeader*)&layer->cylinder );
+		}
+		else
+		{
+			layers.push_back( (XrCompositionLayerBaseHeader*)&layer->quad );
+		}
+	}
+}
+
+
+void CompositionLayerManager::PrintSummary( std::ostream& out ) const
+{
+	uint64_t submitted = m_renderCount + m_reuseCount;
+	if ( !submitted )
+		return;
+
+	out << "Composition layers: rendered " << m_renderCount << " of " << submitted << " layer submissions\n";
+}
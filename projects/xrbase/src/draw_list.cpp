@@ -0,0 +1,822 @@
+#include "draw_list.h"
+#include "profile_zones.h"
+
+#include <MapHelper.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// sort key layout, most significant first: pipeline, material, mesh
+static const uint32_t k_pipelineBits = 16;
+static const uint32_t k_materialBits = 24;
+static const uint32_t k_meshBits = 24;
+
+static const uint32_t k_minInstanceCapacity = 256;
+
+// one indirect draw per batch: DrawIndexedIndirect needs five uints and DrawIndirect four, both have the instance
+// count second
+static const uint32_t k_drawArgsStride = 5 * sizeof( uint32_t );
+static const uint32_t k_cullGroupSize = 64;
+
+struct CullConstants
+{
+	float4 planes[ 10 ];	// five per eye, the near plane isn't tested
+	uint32_t instanceCount;
+	uint32_t pad[ 3 ];
+};
+
+static const char* k_cullShader = R"(
+struct CullInstance
+{
+    float4 Row0;
+    float4 Row1;
+    float4 Row2;
+    float4 Row3;
+    uint4  Batch;
+};
+
+struct CullBatch
+{
+    float4 Sphere;
+    uint4  FirstInstanceArgsOffset;
+};
+
+cbuffer CullConstants
+{
+    float4 g_Planes[10];
+    uint4  g_InstanceCount;
+};
+
+StructuredBuffer<CullInstance> g_Instances;
+StructuredBuffer<CullBatch>    g_Batches;
+RWByteAddressBuffer            g_CulledInstances;
+RWByteAddressBuffer            g_DrawArgs;
+
+[numthreads(64, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= g_InstanceCount.x)
+        return;
+
+    CullInstance Inst = g_Instances[DTid.x];
+    CullBatch Batch = g_Batches[Inst.Batch.x];
+    if (Batch.Sphere.w > 0.0)
+    {
+        // a uniform bound on the scale keeps the sphere conservative under non-uniform scaling
+        float4x4 ObjectToWorld = float4x4(Inst.Row0, Inst.Row1, Inst.Row2, Inst.Row3);
+        float3 Center = mul(float4(Batch.Sphere.xyz, 1.0), ObjectToWorld).xyz;
+        float Scale = sqrt(max(dot(Inst.Row0.xyz, Inst.Row0.xyz), max(dot(Inst.Row1.xyz, Inst.Row1.xyz), dot(Inst.Row2.xyz, Inst.Row2.xyz))));
+        float Radius = Batch.Sphere.w * Scale;
+
+        bool InLeft = true;
+        bool InRight = true;
+        for (uint p = 0; p < 5; p++)
+        {
+            InLeft  = InLeft  && dot(g_Planes[p].xyz, Center) + g_Planes[p].w >= -Radius;
+            InRight = InRight && dot(g_Planes[p + 5].xyz, Center) + g_Planes[p + 5].w >= -Radius;
+        }
+        if (!InLeft && !InRight)
+            return;
+    }
+
+    uint Slot;
+    g_DrawArgs.InterlockedAdd(Batch.FirstInstanceArgsOffset.y + 4, 1, Slot);
+    uint Dst = (Batch.FirstInstanceArgsOffset.x + Slot) * 64;
+    g_CulledInstances.Store4(Dst +  0, asuint(Inst.Row0));
+    g_CulledInstances.Store4(Dst + 16, asuint(Inst.Row1));
+    g_CulledInstances.Store4(Dst + 32, asuint(Inst.Row2));
+    g_CulledInstances.Store4(Dst + 48, asuint(Inst.Row3));
+}
+)";
+
+// The frustum planes of a row-vector stage-to-clip transform, pointing inwards and normalized. A point p is inside
+// when dot( p, column 3 ) +- dot( p, column i ) >= 0.
+static void ExtractFrustumPlanes( const float4x4& viewProj, float4 planes[ 5 ] )
+{
+	float4 columns[ 4 ];
+	for ( int c = 0; c < 4; c++ )
+	{
+		columns[ c ] = float4( viewProj[ 0 ][ c ], viewProj[ 1 ][ c ], viewProj[ 2 ][ c ], viewProj[ 3 ][ c ] );
+	}
+
+	planes[ 0 ] = columns[ 3 ] + columns[ 0 ];	// left
+	planes[ 1 ] = columns[ 3 ] - columns[ 0 ];	// right
+	planes[ 2 ] = columns[ 3 ] + columns[ 1 ];	// bottom
+	planes[ 3 ] = columns[ 3 ] - columns[ 1 ];	// top
+	planes[ 4 ] = columns[ 3 ] - columns[ 2 ];	// far
+	for ( int p = 0; p < 5; p++ )
+	{
+		float len = length( float3( planes[ p ].x, planes[ p ].y, planes[ p ].z ) );
+		if ( len > 0 )
+		{
+			planes[ p ] = planes[ p ] / len;
+		}
+	}
+}
+
+void DrawList::Init( IRenderDevice* device, MemoryBudget* memoryBudget )
+{
+	Shutdown();
+	m_device = device;
+	m_memoryBudget = memoryBudget;
+}
+
+
+void DrawList::Shutdown()
+{
+	if ( m_memoryBudget && m_instanceBuffer )
+	{
+		m_memoryBudget->Unregister( m_instanceBuffer.RawPtr() );
+	}
+	m_instanceBuffer.Release();
+	m_instanceCapacity = 0;
+
+	if ( m_memoryBudget )
+	{
+		for ( IBuffer* buffer : { m_cullInstances.RawPtr(), m_cullBatches.RawPtr(), m_culledInstances.RawPtr(), m_drawArgs.RawPtr() } )
+		{
+			if ( buffer )
+			{
+				m_memoryBudget->Unregister( buffer );
+			}
+		}
+	}
+	m_cullInstances.Release();
+	m_cullBatches.Release();
+	m_culledInstances.Release();
+	m_drawArgs.Release();
+	m_cullBinding.Release();
+	m_cullConstants.Release();
+	m_cullPipeline.Release();
+	m_cullPipelineFailed = false;
+	m_cullInstanceCapacity = 0;
+	m_cullBatchCapacity = 0;
+	m_cullReady = false;
+
+	Clear();
+	m_builtItems.clear();
+	m_batches.clear();
+	m_meshes.clear();
+	m_materials.clear();
+	m_pipelines.clear();
+	m_pipelineIndices.clear();
+	m_device = nullptr;
+}
+
+
+uint32_t DrawList::AddMesh( const DrawListMesh& desc )
+{
+	if ( m_meshes.size() >= ( 1ull << k_meshBits ) || desc.vertexBufferCount > DrawListMesh::k_maxVertexBuffers )
+		return k_invalidHandle;
+
+	Mesh mesh;
+	mesh.desc = desc;
+	for ( uint32_t i = 0; i < desc.vertexBufferCount; i++ )
+	{
+		mesh.references[ i ] = desc.vertexBuffers[ i ];
+	}
+	mesh.references[ DrawListMesh::k_maxVertexBuffers ] = desc.indexBuffer;
+	m_meshes.push_back( mesh );
+	return (uint32_t)m_meshes.size() - 1;
+}
+
+
+uint32_t DrawList::AddMaterial( IPipelineState* pipeline, IShaderResourceBinding* binding, uint32_t instanceBufferSlot )
+{
+	if ( !pipeline || m_materials.size() >= ( 1ull << k_materialBits ) )
+		return k_invalidHandle;
+
+	auto i = m_pipelineIndices.find( pipeline );
+	if ( i == m_pipelineIndices.end() )
+	{
+		if ( m_pipelines.size() >= ( 1ull << k_pipelineBits ) )
+			return k_invalidHandle;
+
+		m_pipelines.push_back( RefCntAutoPtr<IPipelineState>( pipeline ) );
+		i = m_pipelineIndices.insert( std::make_pair( pipeline, (uint32_t)m_pipelines.size() - 1 ) ).first;
+	}
+
+	Material material;
+	material.pipeline = i->second;
+	material.binding = binding;
+	material.instanceBufferSlot = instanceBufferSlot;
+	m_materials.push_back( material );
+	return (uint32_t)m_materials.size() - 1;
+}
+
+
+void DrawList::GetInstanceLayoutElements( uint32_t firstInput, uint32_t bufferSlot, LayoutElement elements[ 4 ] )
+{
+	for ( uint32_t row = 0; row < 4; row++ )
+	{
+		elements[ row ] = LayoutElement( firstInput + row, bufferSlot, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE );
+	}
+}
+
+
+void DrawList::Clear()
+{
+	m_items.clear();
+	m_transforms.clear();
+}
+
+
+void DrawList::Submit( uint32_t mesh, uint32_t material, const float4x4& objectToWorld )
+{
+	if ( mesh >= m_meshes.size() || material >= m_materials.size() )
+		return;
+
+	Item item;
+	item.key = ( (uint64_t)m_materials[ material ].pipeline << ( k_materialBits + k_meshBits ) )
+		| ( (uint64_t)material << k_meshBits )
+		| mesh;
+	item.index = (uint32_t)m_transforms.size();
+	m_items.push_back( item );
+	m_transforms.push_back( objectToWorld );
+}
+
+
+void DrawList::SortItems()
+{
+	// LSD radix sort, a byte at a time. All eight histograms are built in one pass over the keys, and bytes
+	// that are the same in every key are skipped, which with few pipelines and materials is most of them.
+	uint32_t count = (uint32_t)m_builtItems.size();
+	uint32_t histograms[ 8 ][ 256 ] = {};
+	for ( const Item& item : m_builtItems )
+	{
+		for ( uint32_t digit = 0; digit < 8; digit++ )
+		{
+			histograms[ digit ][ ( item.key >> ( digit * 8 ) ) & 0xff ]++;
+		}
+	}
+
+	m_sortScratch.resize( count );
+	for ( uint32_t digit = 0; digit < 8; digit++ )
+	{
+		uint32_t* histogram = histograms[ digit ];
+		if ( histogram[ ( m_builtItems[ 0 ].key >> ( digit * 8 ) ) & 0xff ] == count )
+			continue;
+
+		uint32_t offset = 0;
+		for ( uint32_t bucket = 0; bucket < 256; bucket++ )
+		{
+			uint32_t bucketCount = histogram[ bucket ];
+			histogram[ bucket ] = offset;
+			offset += bucketCount;
+		}
+
+		for ( const Item& item : m_builtItems )
+		{
+			m_sortScratch[ histogram[ ( item.key >> ( digit * 8 ) ) & 0xff ]++ ] = item;
+		}
+		m_builtItems.swap( m_sortScratch );
+	}
+}
+
+
+bool DrawList::ReserveInstances( uint32_t count )
+{
+	if ( count <= m_instanceCapacity && m_instanceBuffer && m_instanceBufferIsDefault == m_deferredRecording )
+		return true;
+
+	uint32_t capacity = std::max( m_instanceCapacity, k_minInstanceCapacity );
+	while ( capacity < count )
+	{
+		capacity *= 2;
+	}
+
+	if ( m_memoryBudget && m_instanceBuffer )
+	{
+		m_memoryBudget->Unregister( m_instanceBuffer.RawPtr() );
+	}
+	m_instanceBuffer.Release();
+	m_instanceCapacity = 0;
+
+	BufferDesc desc;
+	desc.Name = "Draw list instance transforms";
+	desc.Usage = m_deferredRecording ? USAGE_DEFAULT : USAGE_DYNAMIC;
+	desc.BindFlags = BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = m_deferredRecording ? CPU_ACCESS_NONE : CPU_ACCESS_WRITE;
+	desc.uiSizeInBytes = capacity * sizeof( float4x4 );
+	m_device->CreateBuffer( desc, nullptr, &m_instanceBuffer );
+	if ( !m_instanceBuffer )
+	{
+		std::cerr << "Unable to create a draw list instance buffer for " << capacity << " instances\n";
+		return false;
+	}
+	if ( m_memoryBudget )
+	{
+		m_memoryBudget->RegisterBuffer( m_instanceBuffer, MemoryCategory::AppBuffers );
+	}
+	m_instanceCapacity = capacity;
+	m_instanceBufferIsDefault = m_deferredRecording;
+	return true;
+}
+
+
+bool DrawList::CreateCullPipeline()
+{
+	if ( m_cullPipeline )
+		return true;
+	// a device that can't build it won't on the next frame either, so Build stays on the unculled path
+	if ( m_cullPipelineFailed )
+		return false;
+
+	ShaderCreateInfo shaderCI;
+	shaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+	shaderCI.UseCombinedTextureSamplers = true;
+	shaderCI.Desc.ShaderType = SHADER_TYPE_COMPUTE;
+	shaderCI.Desc.Name = "Draw list cull CS";
+	shaderCI.EntryPoint = "main";
+	shaderCI.Source = k_cullShader;
+	RefCntAutoPtr<IShader> shader;
+	m_device->CreateShader( shaderCI, &shader );
+	if ( !shader )
+	{
+		std::cerr << "Unable to compile the draw list culling shader, drawing without GPU culling\n";
+		m_cullPipelineFailed = true;
+		return false;
+	}
+
+	ShaderResourceVariableDesc vars[] =
+	{
+		{ SHADER_TYPE_COMPUTE, "g_Instances", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE },
+		{ SHADER_TYPE_COMPUTE, "g_Batches", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE },
+		{ SHADER_TYPE_COMPUTE, "g_CulledInstances", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE },
+		{ SHADER_TYPE_COMPUTE, "g_DrawArgs", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE },
+	};
+
+	ComputePipelineStateCreateInfo psoCI;
+	psoCI.PSODesc.Name = "Draw list cull PSO";
+	psoCI.PSODesc.PipelineType = PIPELINE_TYPE_COMPUTE;
+	psoCI.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+	psoCI.PSODesc.ResourceLayout.Variables = vars;
+	psoCI.PSODesc.ResourceLayout.NumVariables = _countof( vars );
+	psoCI.pCS = shader;
+	m_device->CreateComputePipelineState( psoCI, &m_cullPipeline );
+	if ( !m_cullPipeline )
+	{
+		std::cerr << "Unable to create the draw list culling pipeline, drawing without GPU culling\n";
+		m_cullPipelineFailed = true;
+		return false;
+	}
+
+	BufferDesc desc;
+	desc.Name = "Draw list cull constants";
+	desc.Usage = USAGE_DYNAMIC;
+	desc.BindFlags = BIND_UNIFORM_BUFFER;
+	desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+	desc.uiSizeInBytes = sizeof( CullConstants );
+	m_device->CreateBuffer( desc, nullptr, &m_cullConstants );
+	if ( !m_cullConstants )
+	{
+		m_cullPipeline.Release();
+		return false;
+	}
+	m_cullPipeline->GetStaticVariableByName( SHADER_TYPE_COMPUTE, "CullConstants" )->Set( m_cullConstants );
+	return true;
+}
+
+
+static RefCntAutoPtr<IBuffer> CreateCullBuffer( IRenderDevice* device, MemoryBudget* memoryBudget, const char* name,
+	BIND_FLAGS bindFlags, BUFFER_MODE mode, uint32_t stride, uint32_t count )
+{
+	BufferDesc desc;
+	desc.Name = name;
+	desc.Usage = USAGE_DEFAULT;
+	desc.BindFlags = bindFlags;
+	desc.Mode = mode;
+	desc.ElementByteStride = stride;
+	desc.uiSizeInBytes = stride * count;
+	RefCntAutoPtr<IBuffer> buffer;
+	device->CreateBuffer( desc, nullptr, &buffer );
+	if ( !buffer )
+	{
+		std::cerr << "Unable to create the " << name << " buffer for " << count << " elements\n";
+	}
+	else if ( memoryBudget )
+	{
+		memoryBudget->RegisterBuffer( buffer, MemoryCategory::AppBuffers );
+	}
+	return buffer;
+}
+
+
+bool DrawList::ReserveCullBuffers( uint32_t instanceCount, uint32_t batchCount )
+{
+	if ( !CreateCullPipeline() )
+		return false;
+
+	bool changed = false;
+	if ( instanceCount > m_cullInstanceCapacity || !m_cullInstances || !m_culledInstances )
+	{
+		uint32_t capacity = std::max( m_cullInstanceCapacity, k_minInstanceCapacity );
+		while ( capacity < instanceCount )
+		{
+			capacity *= 2;
+		}
+
+		for ( IBuffer* buffer : { m_cullInstances.RawPtr(), m_culledInstances.RawPtr() } )
+		{
+			if ( m_memoryBudget && buffer )
+			{
+				m_memoryBudget->Unregister( buffer );
+			}
+		}
+		m_cullInstanceCapacity = 0;
+		m_cullInstances = CreateCullBuffer( m_device, m_memoryBudget, "Draw list cull instances",
+			BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof( CullInstance ), capacity );
+		m_culledInstances = CreateCullBuffer( m_device, m_memoryBudget, "Draw list culled instances",
+			BIND_VERTEX_BUFFER | BIND_UNORDERED_ACCESS, BUFFER_MODE_RAW, sizeof( float4x4 ), capacity );
+		if ( !m_cullInstances || !m_culledInstances )
+			return false;
+		m_cullInstanceCapacity = capacity;
+		changed = true;
+	}
+
+	if ( batchCount > m_cullBatchCapacity || !m_cullBatches || !m_drawArgs )
+	{
+		uint32_t capacity = std::max( m_cullBatchCapacity, 64u );
+		while ( capacity < batchCount )
+		{
+			capacity *= 2;
+		}
+
+		for ( IBuffer* buffer : { m_cullBatches.RawPtr(), m_drawArgs.RawPtr() } )
+		{
+			if ( m_memoryBudget && buffer )
+			{
+				m_memoryBudget->Unregister( buffer );
+			}
+		}
+		m_cullBatchCapacity = 0;
+		m_cullBatches = CreateCullBuffer( m_device, m_memoryBudget, "Draw list cull batches",
+			BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof( CullBatch ), capacity );
+		m_drawArgs = CreateCullBuffer( m_device, m_memoryBudget, "Draw list indirect args",
+			BIND_INDIRECT_DRAW_ARGS | BIND_UNORDERED_ACCESS, BUFFER_MODE_RAW, k_drawArgsStride, capacity );
+		if ( !m_cullBatches || !m_drawArgs )
+			return false;
+		m_cullBatchCapacity = capacity;
+		changed = true;
+	}
+
+	// mutable variables can only be set once per binding, so new buffers need a new one
+	if ( changed || !m_cullBinding )
+	{
+		m_cullBinding.Release();
+		m_cullPipeline->CreateShaderResourceBinding( &m_cullBinding, true );
+		m_cullBinding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_Instances" )->Set( m_cullInstances->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_cullBinding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_Batches" )->Set( m_cullBatches->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_cullBinding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_CulledInstances" )->Set( m_culledInstances->GetDefaultView( BUFFER_VIEW_UNORDERED_ACCESS ) );
+		m_cullBinding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_DrawArgs" )->Set( m_drawArgs->GetDefaultView( BUFFER_VIEW_UNORDERED_ACCESS ) );
+	}
+	return true;
+}
+
+
+void DrawList::UploadCullInputs( IDeviceContext* context )
+{
+	XRDE_PROFILE_FUNCTION();
+	uint32_t instanceCount = (uint32_t)m_builtItems.size();
+	uint32_t batchCount = (uint32_t)m_batches.size();
+	if ( !ReserveCullBuffers( instanceCount, batchCount ) )
+		return;
+
+	m_cullInstanceData.resize( instanceCount );
+	m_cullBatchData.resize( batchCount );
+	m_drawArgData.assign( batchCount * k_drawArgsStride / sizeof( uint32_t ), 0 );
+	for ( uint32_t b = 0; b < batchCount; b++ )
+	{
+		const Batch& batch = m_batches[ b ];
+		const DrawListMesh& mesh = m_meshes[ batch.mesh ].desc;
+		CullBatch& cullBatch = m_cullBatchData[ b ];
+		cullBatch.sphere = float4( mesh.boundsCenter, mesh.boundsRadius );
+		cullBatch.firstInstance = batch.firstInstance;
+		cullBatch.argsOffset = b * k_drawArgsStride;
+
+		// the instance counts start at zero and the culling shader counts the visible instances into them
+		uint32_t* args = &m_drawArgData[ b * k_drawArgsStride / sizeof( uint32_t ) ];
+		args[ 0 ] = mesh.indexCount;
+		if ( mesh.indexBuffer )
+		{
+			args[ 2 ] = mesh.firstIndex;
+			args[ 3 ] = mesh.baseVertex;
+			args[ 4 ] = batch.firstInstance;
+		}
+		else
+		{
+			args[ 2 ] = mesh.baseVertex;
+			args[ 3 ] = batch.firstInstance;
+		}
+
+		for ( uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; i++ )
+		{
+			CullInstance& instance = m_cullInstanceData[ i ];
+			instance.transform = m_transforms[ m_builtItems[ i ].index ];
+			instance.batch = b;
+		}
+	}
+
+	context->UpdateBuffer( m_cullInstances, 0, instanceCount * sizeof( CullInstance ), m_cullInstanceData.data(),
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	context->UpdateBuffer( m_cullBatches, 0, batchCount * sizeof( CullBatch ), m_cullBatchData.data(),
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	context->UpdateBuffer( m_drawArgs, 0, batchCount * k_drawArgsStride, m_drawArgData.data(),
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	m_cullReady = true;
+}
+
+
+void DrawList::FilterOccludedItems()
+{
+	XRDE_PROFILE_FUNCTION();
+	m_builtItems.clear();
+	for ( const Item& item : m_items )
+	{
+		// the box around the bounding sphere, which grows with the largest scale in the transform
+		const DrawListMesh& mesh = m_meshes[ item.key & ( ( 1ull << k_meshBits ) - 1 ) ].desc;
+		if ( mesh.boundsRadius > 0 )
+		{
+			const float4x4& m = m_transforms[ item.index ];
+			float4 center = float4( mesh.boundsCenter, 1.f ) * m;
+			float scale = sqrtf( std::max( { m.m00 * m.m00 + m.m01 * m.m01 + m.m02 * m.m02,
+				m.m10 * m.m10 + m.m11 * m.m11 + m.m12 * m.m12,
+				m.m20 * m.m20 + m.m21 * m.m21 + m.m22 * m.m22 } ) );
+			float3 extent( mesh.boundsRadius * scale, mesh.boundsRadius * scale, mesh.boundsRadius * scale );
+			float3 position( center.x, center.y, center.z );
+			if ( !m_occlusionCuller->IsBoxVisible( position - extent, position + extent ) )
+			{
+				m_occludedCount++;
+				continue;
+			}
+		}
+		m_builtItems.push_back( item );
+	}
+}
+
+
+void DrawList::Build( IDeviceContext* context )
+{
+	XRDE_PROFILE_FUNCTION();
+	m_batches.clear();
+	m_cullReady = false;
+	m_occludedCount = 0;
+	if ( m_occlusionCuller && m_occlusionCuller->IsReady() )
+	{
+		FilterOccludedItems();
+	}
+	else
+	{
+		m_builtItems = m_items;
+	}
+	if ( m_builtItems.empty() )
+		return;
+
+	SortItems();
+
+	// items with the same key share a mesh and a material, so each run of them is one draw
+	uint64_t meshMask = ( 1ull << k_meshBits ) - 1;
+	uint64_t materialMask = ( 1ull << k_materialBits ) - 1;
+	for ( uint32_t i = 0; i < (uint32_t)m_builtItems.size(); i++ )
+	{
+		const Item& item = m_builtItems[ i ];
+		if ( i == 0 || item.key != m_builtItems[ i - 1 ].key )
+		{
+			Batch batch;
+			batch.mesh = (uint32_t)( item.key & meshMask );
+			batch.material = (uint32_t)( ( item.key >> k_meshBits ) & materialMask );
+			batch.firstInstance = i;
+			batch.instanceCount = 0;
+			m_batches.push_back( batch );
+		}
+		m_batches.back().instanceCount++;
+	}
+
+	if ( m_gpuCulling )
+	{
+		UploadCullInputs( context );
+		if ( m_cullReady )
+			return;
+
+		// without the culling buffers every item is drawn from the instance buffer, as if culling were off
+	}
+
+	if ( !ReserveInstances( (uint32_t)m_builtItems.size() ) )
+	{
+		m_batches.clear();
+		return;
+	}
+
+	// the rows are read as they are, which is what mul( position, transform ) in HLSL expects
+	if ( m_instanceBufferIsDefault )
+	{
+		m_instanceData.resize( m_builtItems.size() );
+		for ( uint32_t i = 0; i < (uint32_t)m_builtItems.size(); i++ )
+		{
+			m_instanceData[ i ] = m_transforms[ m_builtItems[ i ].index ];
+		}
+		context->UpdateBuffer( m_instanceBuffer, 0, (Uint32)( m_instanceData.size() * sizeof( float4x4 ) ), m_instanceData.data(),
+			RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+		return;
+	}
+
+	MapHelper<float4x4> instanceMap( context, m_instanceBuffer, MAP_WRITE, MAP_FLAG_DISCARD );
+	float4x4* instances = instanceMap;
+	if ( !instances )
+	{
+		m_batches.clear();
+		return;
+	}
+
+	for ( uint32_t i = 0; i < (uint32_t)m_builtItems.size(); i++ )
+	{
+		memcpy( &instances[ i ], &m_transforms[ m_builtItems[ i ].index ], sizeof( float4x4 ) );
+	}
+}
+
+
+void DrawList::DeclareResources( RenderGraphPassBuilder& pass ) const
+{
+	for ( const Batch& batch : m_batches )
+	{
+		const DrawListMesh& mesh = m_meshes[ batch.mesh ].desc;
+		for ( uint32_t i = 0; i < mesh.vertexBufferCount; i++ )
+		{
+			pass.Read( mesh.vertexBuffers[ i ], RESOURCE_STATE_VERTEX_BUFFER );
+		}
+		pass.Read( mesh.indexBuffer, RESOURCE_STATE_INDEX_BUFFER );
+	}
+
+	if ( !UsingCulledDraws() && m_instanceBufferIsDefault && !m_batches.empty() )
+	{
+		pass.Read( m_instanceBuffer, RESOURCE_STATE_VERTEX_BUFFER );
+	}
+	if ( UsingCulledDraws() )
+	{
+		pass.Read( m_culledInstances, RESOURCE_STATE_VERTEX_BUFFER );
+		pass.Read( m_drawArgs, RESOURCE_STATE_INDIRECT_ARGUMENT );
+	}
+}
+
+
+void DrawList::DeclareCullResources( RenderGraphPassBuilder& pass ) const
+{
+	if ( !UsingCulledDraws() )
+		return;
+
+	pass.Read( m_cullInstances, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Read( m_cullBatches, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Write( m_culledInstances, RESOURCE_STATE_UNORDERED_ACCESS );
+	pass.Write( m_drawArgs, RESOURCE_STATE_UNORDERED_ACCESS );
+}
+
+
+void DrawList::Cull( IDeviceContext* context, const float4x4 viewProj[ 2 ] )
+{
+	if ( !UsingCulledDraws() )
+		return;
+
+	XRDE_PROFILE_FUNCTION();
+	{
+		MapHelper<CullConstants> constants( context, m_cullConstants, MAP_WRITE, MAP_FLAG_DISCARD );
+		ExtractFrustumPlanes( viewProj[ 0 ], &constants->planes[ 0 ] );
+		ExtractFrustumPlanes( viewProj[ 1 ], &constants->planes[ 5 ] );
+		constants->instanceCount = (uint32_t)m_builtItems.size();
+	}
+
+	context->SetPipelineState( m_cullPipeline );
+	context->CommitShaderResources( m_cullBinding, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+	DispatchComputeAttribs attribs( ( (uint32_t)m_builtItems.size() + k_cullGroupSize - 1 ) / k_cullGroupSize, 1, 1 );
+	context->DispatchCompute( attribs );
+}
+
+
+void DrawList::Draw( IDeviceContext* context, RESOURCE_STATE_TRANSITION_MODE transitionMode )
+{
+	XRDE_PROFILE_FUNCTION();
+	m_lastStats = DrawListStats();
+	m_lastStats.itemCount = (uint32_t)m_items.size();
+	m_lastStats.occludedCount = m_occludedCount;
+	DrawRange( context, 0, (uint32_t)m_batches.size(), transitionMode, &m_lastStats );
+}
+
+
+void DrawList::DrawBatches( IDeviceContext* context, uint32_t firstBatch, uint32_t batchCount,
+	RESOURCE_STATE_TRANSITION_MODE transitionMode )
+{
+	// recorded on several threads at once, so the stats stay local
+	DrawListStats stats;
+	uint32_t endBatch = std::min( firstBatch + batchCount, (uint32_t)m_batches.size() );
+	DrawRange( context, std::min( firstBatch, endBatch ), endBatch, transitionMode, &stats );
+}
+
+
+void DrawList::DrawRange( IDeviceContext* context, uint32_t firstBatch, uint32_t endBatch,
+	RESOURCE_STATE_TRANSITION_MODE transitionMode, DrawListStats* stats )
+{
+	uint32_t pipeline = k_invalidHandle;
+	uint32_t material = k_invalidHandle;
+	uint32_t mesh = k_invalidHandle;
+	uint32_t instanceSlot = k_invalidHandle;
+	bool culled = UsingCulledDraws();
+	IBuffer* instanceBuffer = culled ? m_culledInstances.RawPtr() : m_instanceBuffer.RawPtr();
+	for ( uint32_t b = firstBatch; b < endBatch; b++ )
+	{
+		const Batch& batch = m_batches[ b ];
+		const Material& m = m_materials[ batch.material ];
+		if ( m.pipeline != pipeline )
+		{
+			pipeline = m.pipeline;
+			context->SetPipelineState( m_pipelines[ pipeline ] );
+			stats->pipelineChanges++;
+
+			// setting a pipeline unbinds its resources, so the material has to be committed again
+			material = k_invalidHandle;
+		}
+		if ( batch.material != material )
+		{
+			material = batch.material;
+			if ( m.binding )
+			{
+				context->CommitShaderResources( m.binding, transitionMode );
+			}
+			stats->bindingChanges++;
+		}
+
+		// the instance buffer stays bound across draws, each one starts at its own first instance
+		const DrawListMesh& meshDesc = m_meshes[ batch.mesh ].desc;
+		if ( batch.mesh != mesh || m.instanceBufferSlot != instanceSlot )
+		{
+			mesh = batch.mesh;
+			instanceSlot = m.instanceBufferSlot;
+
+			IBuffer* buffers[ DrawListMesh::k_maxVertexBuffers + 1 ] = {};
+			Uint32 offsets[ DrawListMesh::k_maxVertexBuffers + 1 ] = {};
+			uint32_t bufferCount = meshDesc.vertexBufferCount;
+			std::copy( meshDesc.vertexBuffers, meshDesc.vertexBuffers + bufferCount, buffers );
+			std::copy( meshDesc.vertexOffsets, meshDesc.vertexOffsets + bufferCount, offsets );
+			if ( instanceSlot <= DrawListMesh::k_maxVertexBuffers )
+			{
+				buffers[ instanceSlot ] = instanceBuffer;
+				offsets[ instanceSlot ] = 0;
+				bufferCount = std::max( bufferCount, instanceSlot + 1 );
+			}
+			context->SetVertexBuffers( 0, bufferCount, buffers, offsets, transitionMode, SET_VERTEX_BUFFERS_FLAG_RESET );
+			if ( meshDesc.indexBuffer )
+			{
+				context->SetIndexBuffer( meshDesc.indexBuffer, 0, transitionMode );
+			}
+			stats->meshChanges++;
+		}
+
+		if ( culled )
+		{
+			// the instance count and first instance come from the args the culling shader wrote
+			if ( meshDesc.indexBuffer )
+			{
+				DrawIndexedIndirectAttribs attribs;
+				attribs.IndexType = meshDesc.indexType;
+				attribs.IndirectDrawArgsOffset = b * k_drawArgsStride;
+				attribs.IndirectAttribsBufferStateTransitionMode = transitionMode;
+				attribs.Flags = DRAW_FLAG_VERIFY_ALL;
+				context->DrawIndexedIndirect( attribs, m_drawArgs );
+			}
+			else
+			{
+				DrawIndirectAttribs attribs;
+				attribs.IndirectDrawArgsOffset = b * k_drawArgsStride;
+				attribs.IndirectAttribsBufferStateTransitionMode = transitionMode;
+				attribs.Flags = DRAW_FLAG_VERIFY_ALL;
+				context->DrawIndirect( attribs, m_drawArgs );
+			}
+		}
+		else if ( meshDesc.indexBuffer )
+		{
+			DrawIndexedAttribs attribs;
+			attribs.IndexType = meshDesc.indexType;
+			attribs.NumIndices = meshDesc.indexCount;
+			attribs.FirstIndexLocation = meshDesc.firstIndex;
+			attribs.BaseVertex = meshDesc.baseVertex;
+			attribs.NumInstances = batch.instanceCount;
+			attribs.FirstInstanceLocation = batch.firstInstance;
+			attribs.Flags = DRAW_FLAG_VERIFY_ALL;
+			context->DrawIndexed( attribs );
+		}
+		else
+		{
+			DrawAttribs attribs;
+			attribs.NumVertices = meshDesc.indexCount;
+			attribs.StartVertexLocation = meshDesc.baseVertex;
+			attribs.NumInstances = batch.instanceCount;
+			attribs.FirstInstanceLocation = batch.firstInstance;
+			attribs.Flags = DRAW_FLAG_VERIFY_ALL;
+			context->Draw( attribs );
+		}
+		stats->drawCount++;
+	}
+}
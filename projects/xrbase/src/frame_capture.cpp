@@ -0,0 +1,275 @@
+#include "frame_capture.h"
+#include "profile_zones.h"
+
+#include <GraphicsAccessories.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+using namespace XRDE;
+using namespace Diligent;
+
+bool CaptureFileSink::Begin( uint32_t maxWidth, uint32_t maxHeight, TEXTURE_FORMAT format )
+{
+	std::error_code error;
+	std::filesystem::create_directories( m_directory, error );
+	if ( error )
+	{
+		std::cerr << "Unable to create capture directory " << m_directory << ": " << error.message() << "\n";
+		return false;
+	}
+
+	m_ppm = CanWriteAsPpm( format );
+	return true;
+}
+
+
+void CaptureFileSink::WriteFrame( const ReadbackFrame& frame )
+{
+	char name[ 64 ];
+	snprintf( name, sizeof( name ), "/capture_%06llu_eye%u.%s", (unsigned long long)frame.frameIndex, frame.arraySlice,
+		m_ppm ? "ppm" : "raw" );
+	WriteReadbackFrame( m_directory + name, frame );
+}
+
+
+CaptureSharedMemorySink::~CaptureSharedMemorySink()
+{
+	if ( !m_memory )
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile( m_memory );
+	CloseHandle( (HANDLE)m_mapping );
+#else
+	munmap( m_memory, m_size );
+	shm_unlink( m_name.c_str() );
+#endif
+}
+
+
+bool CaptureSharedMemorySink::Begin( uint32_t maxWidth, uint32_t maxHeight, TEXTURE_FORMAT format )
+{
+	const TextureFormatAttribs& attribs = GetTextureFormatAttribs( format );
+	m_bytesPerPixel = attribs.ComponentSize * attribs.NumComponents;
+
+	// keep the images page aligned for whoever uploads them
+	const uint64_t imageOffset = 4096;
+	static_assert( sizeof( CaptureSharedMemoryHeader ) <= imageOffset, "capture header doesn't fit before the images" );
+	const uint32_t imageStride = maxWidth * m_bytesPerPixel;
+	const uint64_t imageSize = (uint64_t)imageStride * maxHeight;
+	m_size = (size_t)( imageOffset + 2 * imageSize );
+
+#ifdef _WIN32
+	HANDLE mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)( (uint64_t)m_size >> 32 ),
+		(DWORD)m_size, m_name.c_str() );
+	if ( !mapping )
+	{
+		std::cerr << "Unable to create shared memory " << m_name << " for capture: " << GetLastError() << "\n";
+		return false;
+	}
+	m_mapping = mapping;
+	m_memory = (uint8_t*)MapViewOfFile( mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_size );
+#else
+	// POSIX shared memory names have to start with a slash
+	if ( m_name.empty() || m_name[ 0 ] != '/' )
+	{
+		m_name = "/" + m_name;
+	}
+	int fd = shm_open( m_name.c_str(), O_CREAT | O_RDWR, 0600 );
+	if ( fd < 0 )
+	{
+		std::cerr << "Unable to create shared memory " << m_name << " for capture\n";
+		return false;
+	}
+	void* memory = MAP_FAILED;
+	if ( ftruncate( fd, (off_t)m_size ) == 0 )
+	{
+		memory = mmap( nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	}
+	close( fd );
+	m_memory = memory == MAP_FAILED ? nullptr : (uint8_t*)memory;
+#endif
+	if ( !m_memory )
+	{
+		std::cerr << "Unable to map shared memory " << m_name << " for capture\n";
+		return false;
+	}
+
+	m_header = (CaptureSharedMemoryHeader*)m_memory;
+	m_header->version = CaptureSharedMemoryHeader::k_version;
+	m_header->maxWidth = maxWidth;
+	m_header->maxHeight = maxHeight;
+	m_header->format = (uint32_t)format;
+	m_header->imageStride = imageStride;
+	m_header->imageOffset = imageOffset;
+	m_header->imageSize = imageSize;
+	for ( CaptureSharedMemoryHeader::Eye& eye : m_header->eyes )
+	{
+		eye.sequence.store( 0, std::memory_order_relaxed );
+		eye.frameIndex = 0;
+		eye.width = 0;
+		eye.height = 0;
+	}
+
+	// readers wait for the magic number before trusting anything else
+	std::atomic_thread_fence( std::memory_order_release );
+	m_header->magic = CaptureSharedMemoryHeader::k_magic;
+	return true;
+}
+
+
+void CaptureSharedMemorySink::WriteFrame( const ReadbackFrame& frame )
+{
+	if ( !m_header )
+		return;
+
+	CaptureSharedMemoryHeader::Eye& eye = m_header->eyes[ frame.arraySlice & 1 ];
+	uint8_t* image = m_memory + m_header->imageOffset + ( frame.arraySlice & 1 ) * m_header->imageSize;
+	uint32_t width = std::min( frame.width, m_header->maxWidth );
+	uint32_t height = std::min( frame.height, m_header->maxHeight );
+
+	uint64_t sequence = eye.sequence.load( std::memory_order_relaxed );
+	eye.sequence.store( sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	for ( uint32_t y = 0; y < height; y++ )
+	{
+		memcpy( image + (size_t)y * m_header->imageStride, frame.data + (size_t)y * frame.stride, (size_t)width * m_bytesPerPixel );
+	}
+	eye.frameIndex = frame.frameIndex;
+	eye.width = width;
+	eye.height = height;
+
+	eye.sequence.store( sequence + 2, std::memory_order_release );
+}
+
+
+bool FrameCapture::Init( IRenderDevice* device, const TextureDesc& swapchainDesc, std::unique_ptr<ICaptureSink> sink, uint32_t depth )
+{
+	if ( !sink || depth < 2 )
+		return false;
+
+	if ( !m_ring.Init( device, swapchainDesc.Width, swapchainDesc.Height, swapchainDesc.Format, depth ) )
+		return false;
+
+	if ( !sink->Begin( swapchainDesc.Width, swapchainDesc.Height, swapchainDesc.Format ) )
+	{
+		m_ring.Shutdown();
+		return false;
+	}
+
+	// every mapped frame is either in the first queue or with the capture thread, so neither queue can overflow
+	m_mappedFrames = std::make_unique< SpscQueue<ReadbackFrame> >( depth );
+	m_finishedFrames = std::make_unique< SpscQueue<uint32_t> >( depth );
+	m_sink = std::move( sink );
+	m_frameIndex = 0;
+	m_dropped = 0;
+	m_stop = false;
+	m_thread = std::thread( &FrameCapture::CaptureThread, this );
+	return true;
+}
+
+
+void FrameCapture::Shutdown( IDeviceContext* context )
+{
+	if ( m_thread.joinable() )
+	{
+		m_stop = true;
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	if ( context )
+	{
+		while ( m_ring.GetMappedCount() )
+		{
+			m_ring.ReleaseOldest( context );
+		}
+	}
+	m_ring.Shutdown();
+	m_mappedFrames.reset();
+	m_finishedFrames.reset();
+	m_sink.reset();
+}
+
+
+void FrameCapture::Capture( IDeviceContext* context, ITexture* texture, uint32_t width, uint32_t height )
+{
+	if ( !m_sink )
+		return;
+
+	// unmap whatever the capture thread is done with, oldest first
+	uint32_t finished;
+	while ( m_finishedFrames->Pop( &finished ) )
+	{
+		m_ring.ReleaseOldest( context );
+	}
+
+	// keep the eyes of a frame together, it's both or neither
+	if ( m_ring.GetDepth() - m_ring.GetInFlightCount() >= 2 )
+	{
+		for ( uint32_t eye = 0; eye < 2; eye++ )
+		{
+			m_ring.Enqueue( context, texture, eye, width, height, m_frameIndex );
+		}
+	}
+	else
+	{
+		m_dropped++;
+	}
+	m_frameIndex++;
+
+	bool mappedAny = false;
+	ReadbackFrame frame;
+	while ( m_ring.MapOldest( context, &frame ) )
+	{
+		m_mappedFrames->Push( frame );
+		mappedAny = true;
+	}
+	if ( mappedAny )
+	{
+		m_wake.notify_one();
+	}
+}
+
+
+void FrameCapture::CaptureThread()
+{
+	XRDE_PROFILE_THREAD_NAME( "Frame capture" );
+	while ( true )
+	{
+		ReadbackFrame frame;
+		if ( m_mappedFrames->Pop( &frame ) )
+		{
+			{
+				XRDE_PROFILE_ZONE( "Write captured frame" );
+				m_sink->WriteFrame( frame );
+			}
+			m_captured.fetch_add( 1, std::memory_order_relaxed );
+			m_finishedFrames->Push( 0 );
+			continue;
+		}
+
+		if ( m_stop )
+			return;
+
+		// the render thread never takes this lock, so the timeout covers a wake that lands before the wait
+		std::unique_lock<std::mutex> lock( m_wakeMutex );
+		m_wake.wait_for( lock, std::chrono::milliseconds( 2 ) );
+	}
+}
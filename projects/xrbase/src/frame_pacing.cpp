@@ -0,0 +1,204 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace XRDE;
+
+// enough frames to look up the late frame of every pending miss
+static const size_t k_frameHistory = 32;
+
+const char* XRDE::FrameMissCauseName( FrameMissCause cause )
+{
+	switch ( cause )
+	{
+	case FrameMissCause::Cpu: return "CPU";
+	case FrameMissCause::Gpu: return "GPU";
+	case FrameMissCause::Runtime: return "Runtime";
+	default: return "Unknown";
+	}
+}
+
+
+void FramePacingAnalyzer::FrameWaited( double waitStartSeconds, double waitEndSeconds, const XrFrameState& frameState )
+{
+	Frame* previous = m_frames.empty() ? nullptr : &m_frames.back();
+	if ( previous )
+	{
+		// everything the app did between getting the previous frame and asking for this one
+		previous->cpuSeconds = std::max( 0.0, waitStartSeconds - previous->waitEndSeconds - previous->runtimeSeconds );
+
+		// display times in between the two predictions are slots the previous frame didn't make it to
+		if ( previous->displayPeriod > 0 && frameState.predictedDisplayTime > previous->displayTime )
+		{
+			double slots = (double)( frameState.predictedDisplayTime - previous->displayTime ) / (double)previous->displayPeriod;
+			uint32_t missedSlots = (uint32_t)std::max( 0.0, std::floor( slots + 0.5 ) - 1.0 );
+			if ( missedSlots )
+			{
+				m_pendingMisses.push_back( { previous->index, missedSlots, m_frameCount } );
+			}
+		}
+	}
+
+	Frame frame;
+	frame.index = m_frameCount++;
+	frame.displayTime = frameState.predictedDisplayTime;
+	frame.displayPeriod = frameState.predictedDisplayPeriod;
+	frame.waitEndSeconds = waitEndSeconds;
+	m_frames.push_back( frame );
+	if ( m_frames.size() > k_frameHistory )
+	{
+		m_frames.pop_front();
+	}
+
+	if ( frameState.shouldRender )
+	{
+		m_noRenderStreak = 0;
+	}
+	else
+	{
+		if ( m_noRenderStreak++ == 0 )
+		{
+			m_noRenderStreaks++;
+		}
+		m_noRenderFrames++;
+		m_longestNoRenderStreak = std::max( m_longestNoRenderStreak, m_noRenderStreak );
+	}
+
+	ResolvePendingMisses( false );
+}
+
+
+void FramePacingAnalyzer::FrameEnded( double runtimeSeconds, int64_t gpuFrame )
+{
+	if ( m_frames.empty() )
+		return;
+
+	m_frames.back().runtimeSeconds = runtimeSeconds;
+	m_frames.back().gpuFrame = gpuFrame;
+}
+
+
+void FramePacingAnalyzer::GpuFrameTimed( int64_t gpuFrame, double gpuSeconds )
+{
+	if ( gpuFrame < 0 )
+		return;
+
+	for ( auto frame = m_frames.rbegin(); frame != m_frames.rend(); ++frame )
+	{
+		if ( frame->gpuFrame == gpuFrame )
+		{
+			frame->gpuSeconds = gpuSeconds;
+			break;
+		}
+	}
+	ResolvePendingMisses( false );
+}
+
+
+void FramePacingAnalyzer::Flush()
+{
+	ResolvePendingMisses( true );
+}
+
+
+FramePacingAnalyzer::Frame* FramePacingAnalyzer::FindFrame( uint64_t index )
+{
+	if ( m_frames.empty() || index < m_frames.front().index || index > m_frames.back().index )
+		return nullptr;
+
+	return &m_frames[ (size_t)( index - m_frames.front().index ) ];
+}
+
+
+void FramePacingAnalyzer::ResolvePendingMisses( bool force )
+{
+	// misses are classified in order, so the callback always hears about them in the order they happened
+	while ( !m_pendingMisses.empty() )
+	{
+		const PendingMiss& pending = m_pendingMisses.front();
+		Frame* frame = FindFrame( pending.frameIndex );
+		if ( frame )
+		{
+			bool waitingForGpu = frame->gpuFrame >= 0 && frame->gpuSeconds < 0;
+			if ( waitingForGpu && !force && m_frameCount - pending.detectedFrame < m_settings.gpuWaitFrames )
+				return;
+
+			Classify( *frame, pending.missedSlots );
+		}
+		m_pendingMisses.pop_front();
+	}
+}
+
+
+void FramePacingAnalyzer::Classify( const Frame& frame, uint32_t missedSlots )
+{
+	FrameMiss miss;
+	miss.frameIndex = frame.index;
+	miss.displayTime = frame.displayTime;
+	miss.missedSlots = missedSlots;
+	miss.periodSeconds = (double)frame.displayPeriod * 1e-9;
+	miss.cpuSeconds = std::max( 0.0, frame.cpuSeconds );
+	miss.runtimeSeconds = frame.runtimeSeconds;
+	miss.gpuSeconds = frame.gpuSeconds;
+
+	// blame whichever of our processors ran furthest over the period, and the runtime if neither did
+	double budget = miss.periodSeconds * m_settings.boundFraction;
+	double cpuOver = miss.cpuSeconds / budget;
+	double gpuOver = miss.gpuSeconds / budget;
+	if ( gpuOver > 1.0 && gpuOver >= cpuOver )
+	{
+		miss.cause = FrameMissCause::Gpu;
+	}
+	else if ( cpuOver > 1.0 )
+	{
+		miss.cause = FrameMissCause::Cpu;
+	}
+	else
+	{
+		miss.cause = FrameMissCause::Runtime;
+	}
+
+	m_missedSlots += missedSlots;
+	m_misses[ (int)miss.cause ]++;
+	m_missedSlotsByCause[ (int)miss.cause ] += missedSlots;
+	m_worstMissSeconds = std::max( m_worstMissSeconds, missedSlots * miss.periodSeconds );
+
+	if ( m_missCallback )
+	{
+		m_missCallback( miss );
+	}
+}
+
+
+void FramePacingAnalyzer::PrintSummary( std::ostream& out ) const
+{
+	if ( !m_frameCount )
+		return;
+
+	uint64_t slots = m_frameCount + m_missedSlots;
+	out << "Frame pacing: " << m_frameCount << " frames, " << m_missedSlots << " missed display slots ("
+		<< std::fixed << std::setprecision( 2 ) << 100.0 * m_missedSlots / slots << "%)";
+	if ( m_missedSlots )
+	{
+		out << ", worst gap " << std::setprecision( 1 ) << m_worstMissSeconds * 1000.0 << "ms";
+	}
+	out << "\n";
+
+	for ( int cause = 0; cause < (int)FrameMissCause::Count; cause++ )
+	{
+		if ( !m_misses[ cause ] )
+			continue;
+
+		out << "  " << std::setw( 8 ) << std::left << FrameMissCauseName( (FrameMissCause)cause ) << std::right
+			<< m_misses[ cause ] << " misses, " << m_missedSlotsByCause[ cause ] << " slots\n";
+	}
+
+	if ( m_noRenderFrames )
+	{
+		out << "  Told not to render for " << m_noRenderFrames << " frames in " << m_noRenderStreaks
+			<< " streaks, the longest " << m_longestNoRenderStreak << " frames\n";
+	}
+	out << std::defaultfloat;
+}
@@ -0,0 +1,253 @@
+#include "gltf_cache_policy.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const char* k_poolNames[ GltfPool_Count ] =
+{
+	"GLTF basic vertex attribs buffer",
+	"GLTF skin attribs buffer",
+	"GLTF index buffer",
+};
+
+bool XRDE::LoadGltfModelManifest( const std::string& manifestPath, std::vector<GltfModelManifestEntry>* entries )
+{
+	std::ifstream file( manifestPath );
+	if ( !file.is_open() )
+		return false;
+
+	std::string line;
+	while ( std::getline( file, line ) )
+	{
+		if ( line.empty() || line[ 0 ] == '#' )
+			continue;
+
+		std::istringstream lineStream( line );
+		GltfModelManifestEntry entry;
+		if ( !( lineStream >> entry.path ) )
+			continue;
+
+		lineStream >> entry.vertexCount >> entry.skinnedVertexCount >> entry.indexCount;
+		entries->push_back( entry );
+	}
+
+	return true;
+}
+
+
+GltfCachePolicy::GltfCachePolicy()
+{
+	// These match the fixed sizes the cache used to be created with
+	m_pageElements[ GltfPool_BasicVertexAttribs ] = 16 << 10;
+	m_pageElements[ GltfPool_SkinVertexAttribs ] = 16 << 10;
+	m_pageElements[ GltfPool_Indices ] = 8 << 10;
+
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		m_stats[ pool ].name = k_poolNames[ pool ];
+	}
+}
+
+
+uint32_t GltfCachePolicy::ElementSize( GltfPool pool )
+{
+	switch ( pool )
+	{
+	case GltfPool_BasicVertexAttribs: return sizeof( GLTF::Model::VertexBasicAttribs );
+	case GltfPool_SkinVertexAttribs: return sizeof( GLTF::Model::VertexSkinAttribs );
+	case GltfPool_Indices: return sizeof( Uint32 );
+	default: return 0;
+	}
+}
+
+
+void GltfCachePolicy::AddManifestEntry( const GltfModelManifestEntry& entry )
+{
+	m_manifest.push_back( entry );
+}
+
+void GltfCachePolicy::AddManifestEntries( const std::vector<GltfModelManifestEntry>& entries )
+{
+	m_manifest.insert( m_manifest.end(), entries.begin(), entries.end() );
+}
+
+
+uint64_t GltfCachePolicy::InitialElementCount( GltfPool pool ) const
+{
+	uint64_t elements = 0;
+	for ( const GltfModelManifestEntry& entry : m_manifest )
+	{
+		uint32_t count = 0;
+		switch ( pool )
+		{
+		case GltfPool_BasicVertexAttribs: count = entry.vertexCount; break;
+		case GltfPool_SkinVertexAttribs: count = entry.skinnedVertexCount; break;
+		case GltfPool_Indices: count = entry.indexCount; break;
+		default: break;
+		}
+
+		// unknown models get a page to themselves
+		elements += count ? count : m_pageElements[ pool ];
+	}
+
+	// round up to whole pages, and always start with at least one
+	uint64_t page = m_pageElements[ pool ];
+	uint64_t pages = std::max<uint64_t>( 1, ( elements + page - 1 ) / page );
+	return pages * page;
+}
+
+
+void GltfCachePolicy::FillBufferSuballocators( BufferSuballocatorCreateInfo* buffers, uint32_t bufferCount ) const
+{
+	for ( uint32_t pool = 0; pool < GltfPool_Count && pool < bufferCount; pool++ )
+	{
+		BufferSuballocatorCreateInfo& info = buffers[ pool ];
+		info.Desc.Name = k_poolNames[ pool ];
+		info.Desc.BindFlags = pool == GltfPool_Indices ? BIND_INDEX_BUFFER : BIND_VERTEX_BUFFER;
+		info.Desc.Usage = USAGE_DEFAULT;
+		if ( m_gpuSkinning && pool != GltfPool_Indices )
+		{
+			info.Desc.BindFlags |= pool == GltfPool_BasicVertexAttribs ? BIND_UNORDERED_ACCESS : BIND_SHADER_RESOURCE;
+			info.Desc.Mode = BUFFER_MODE_RAW;
+			info.Desc.ElementByteStride = ElementSize( (GltfPool)pool );
+		}
+		info.Desc.uiSizeInBytes = static_cast<Uint32>( InitialElementCount( (GltfPool)pool ) * ElementSize( (GltfPool)pool ) );
+
+		// when the pool runs out the suballocator grows the buffer a page at a time instead of failing
+		info.ExpansionSize = m_pageElements[ pool ] * ElementSize( (GltfPool)pool );
+	}
+}
+
+
+GltfCachePolicy::ModelUsage GltfCachePolicy::MeasureModel( const GLTF::Model* model )
+{
+	ModelUsage usage;
+	if ( !model )
+		return usage;
+
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	for ( const GLTF::Node* node : model->LinearNodes )
+	{
+		if ( !node->Mesh )
+			continue;
+
+		for ( const auto& primitive : node->Mesh->Primitives )
+		{
+			vertexCount += primitive->VertexCount;
+			indexCount += primitive->IndexCount;
+		}
+	}
+
+	// The loader writes skin attributes for every vertex when the cache is in use, skinned or not
+	usage.bytes[ GltfPool_BasicVertexAttribs ] = vertexCount * ElementSize( GltfPool_BasicVertexAttribs );
+	usage.bytes[ GltfPool_SkinVertexAttribs ] = vertexCount * ElementSize( GltfPool_SkinVertexAttribs );
+	usage.bytes[ GltfPool_Indices ] = indexCount * ElementSize( GltfPool_Indices );
+	return usage;
+}
+
+
+void GltfCachePolicy::OnModelLoaded( const GLTF::Model* model )
+{
+	if ( !model )
+		return;
+
+	ModelUsage usage = MeasureModel( model );
+	m_liveModels[ model ] = usage;
+
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		GltfPoolStats& stats = m_stats[ pool ];
+		stats.usedBytes += usage.bytes[ pool ];
+		stats.liveModels++;
+
+		// Allocations are never moved, so anything freed below the current top of the pool stays a hole
+		// until every model is gone. Approximate the top as the high water mark.
+		stats.highWaterBytes = std::max( stats.highWaterBytes, stats.usedBytes );
+	}
+}
+
+
+void GltfCachePolicy::OnModelReleased( const GLTF::Model* model )
+{
+	auto i = m_liveModels.find( model );
+	if ( i == m_liveModels.end() )
+		return;
+
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		GltfPoolStats& stats = m_stats[ pool ];
+		stats.usedBytes -= std::min( stats.usedBytes, i->second.bytes[ pool ] );
+		if ( stats.liveModels )
+			stats.liveModels--;
+	}
+	m_liveModels.erase( i );
+}
+
+
+bool GltfCachePolicy::ShouldTrim() const
+{
+	if ( !m_liveModels.empty() )
+		return false;
+
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		// with no live models nothing is fragmented, so only pages the pool grew by can be given back
+		const GltfPoolStats& stats = m_stats[ pool ];
+		uint64_t initialBytes = InitialElementCount( (GltfPool)pool ) * ElementSize( (GltfPool)pool );
+		uint64_t previousHighWater = std::max( initialBytes, m_trimHighWaterBytes[ pool ] );
+		if ( stats.committedBytes > initialBytes && stats.highWaterBytes > previousHighWater )
+			return true;
+	}
+	return false;
+}
+
+
+void GltfCachePolicy::OnCacheRecreated()
+{
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		GltfPoolStats& stats = m_stats[ pool ];
+		m_trimHighWaterBytes[ pool ] = std::max( m_trimHighWaterBytes[ pool ], stats.highWaterBytes );
+		stats.usedBytes = 0;
+		stats.highWaterBytes = 0;
+		stats.liveModels = 0;
+		stats.fragmentation = 0.f;
+	}
+	m_liveModels.clear();
+}
+
+
+void GltfCachePolicy::UpdateStats( GLTF::ResourceManager* resourceManager, IRenderDevice* device, IDeviceContext* context )
+{
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		GltfPoolStats& stats = m_stats[ pool ];
+		IBuffer* buffer = resourceManager ? resourceManager->GetBuffer( pool, device, context ) : nullptr;
+		stats.committedBytes = buffer ? buffer->GetDesc().uiSizeInBytes : 0;
+
+		uint64_t pageBytes = (uint64_t)m_pageElements[ pool ] * ElementSize( (GltfPool)pool );
+		stats.pageCount = pageBytes ? (uint32_t)( ( stats.committedBytes + pageBytes - 1 ) / pageBytes ) : 0;
+
+		uint64_t holes = stats.highWaterBytes - std::min( stats.highWaterBytes, stats.usedBytes );
+		stats.fragmentation = stats.committedBytes ? (float)holes / (float)stats.committedBytes : 0.f;
+	}
+}
+
+
+std::string GltfCachePolicy::FormatStats() const
+{
+	std::ostringstream out;
+	for ( uint32_t pool = 0; pool < GltfPool_Count; pool++ )
+	{
+		const GltfPoolStats& stats = m_stats[ pool ];
+		out << stats.name << ": " << stats.usedBytes << " / " << stats.committedBytes << " bytes used in "
+			<< stats.pageCount << " pages, " << stats.liveModels << " live models, "
+			<< (int)( stats.fragmentation * 100.f ) << "% fragmented\n";
+	}
+	return out.str();
+}
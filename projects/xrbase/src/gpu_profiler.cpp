@@ -0,0 +1,137 @@
+#include "gpu_profiler.h"
+
+#include <cstring>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_invalidPass = ~0u;
+
+void GpuProfiler::Init( IRenderDevice* device, uint32_t maxPassesPerFrame, uint32_t latency )
+{
+	m_frames.clear();
+	m_currentFrame = nullptr;
+
+	if ( !device || !device->GetDeviceInfo().Features.DurationQueries )
+		return;
+
+	QueryDesc queryDesc;
+	queryDesc.Type = QUERY_TYPE_DURATION;
+
+	m_frames.resize( latency );
+	for ( FrameQueries& frame : m_frames )
+	{
+		queryDesc.Name = "GPU profiler frame query";
+		device->CreateQuery( queryDesc, &frame.frameQuery );
+
+		frame.passes.resize( maxPassesPerFrame );
+		queryDesc.Name = "GPU profiler pass query";
+		for ( PassQuery& pass : frame.passes )
+		{
+			device->CreateQuery( queryDesc, &pass.query );
+		}
+	}
+}
+
+
+void GpuProfiler::BeginFrame( IDeviceContext* context )
+{
+	if ( m_frames.empty() )
+		return;
+
+	// this query set was last used `latency` frames ago, so its results should be in by now
+	FrameQueries& frame = m_frames[ m_frameIndex % m_frames.size() ];
+	if ( frame.pending )
+	{
+		ReadBack( frame );
+	}
+
+	frame.frameIndex = m_frameIndex;
+	frame.passCount = 0;
+	frame.pending = false;
+	m_currentFrame = &frame;
+
+	context->BeginQuery( frame.frameQuery );
+}
+
+
+void GpuProfiler::EndFrame( IDeviceContext* context )
+{
+	if ( !m_currentFrame )
+		return;
+
+	context->EndQuery( m_currentFrame->frameQuery );
+	m_currentFrame->pending = true;
+	m_currentFrame = nullptr;
+	m_frameIndex++;
+}
+
+
+uint32_t GpuProfiler::BeginPass( IDeviceContext* context, const char* pass, int eye )
+{
+	if ( !m_currentFrame || m_currentFrame->passCount >= m_currentFrame->passes.size() )
+		return k_invalidPass;
+
+	uint32_t handle = m_currentFrame->passCount++;
+	PassQuery& passQuery = m_currentFrame->passes[ handle ];
+	passQuery.pass = pass;
+	passQuery.eye = eye;
+	context->BeginQuery( passQuery.query );
+	return handle;
+}
+
+
+void GpuProfiler::EndPass( IDeviceContext* context, uint32_t handle )
+{
+	if ( !m_currentFrame || handle == k_invalidPass )
+		return;
+
+	context->EndQuery( m_currentFrame->passes[ handle ].query );
+}
+
+
+void GpuProfiler::ReadBack( FrameQueries& frame )
+{
+	frame.pending = false;
+
+	// Don't invalidate until every query in the frame is ready so a partial frame can't replace a whole one
+	QueryDataDuration frameData;
+	if ( !frame.frameQuery->GetData( &frameData, sizeof( frameData ), false ) )
+		return;
+
+	std::vector<GpuPassTiming> results;
+	results.reserve( frame.passCount );
+	for ( uint32_t i = 0; i < frame.passCount; i++ )
+	{
+		QueryDataDuration passData;
+		if ( !frame.passes[ i ].query->GetData( &passData, sizeof( passData ), false ) )
+			return;
+
+		double seconds = passData.Frequency ? (double)passData.Duration / (double)passData.Frequency : 0;
+		results.push_back( { frame.passes[ i ].pass, frame.passes[ i ].eye, seconds } );
+	}
+
+	frame.frameQuery->Invalidate();
+	for ( uint32_t i = 0; i < frame.passCount; i++ )
+	{
+		frame.passes[ i ].query->Invalidate();
+	}
+
+	m_results = std::move( results );
+	m_frameSeconds = frameData.Frequency ? (double)frameData.Duration / (double)frameData.Frequency : 0;
+	m_resultFrameIndex = frame.frameIndex;
+}
+
+
+double GpuProfiler::GetPassSeconds( const char* pass, int eye ) const
+{
+	double seconds = 0;
+	for ( const GpuPassTiming& timing : m_results )
+	{
+		if ( timing.eye == eye && strcmp( timing.pass, pass ) == 0 )
+		{
+			seconds += timing.seconds;
+		}
+	}
+	return seconds;
+}
@@ -0,0 +1,382 @@
+#include "gpu_skinning.h"
+#include "gltf_cache_policy.h"
+#include "profile_zones.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_skinGroupSize = 64;
+static const uint32_t k_minJointCapacity = 256;
+static const uint32_t k_minChunkCapacity = 256;
+
+// One group per chunk of up to 64 vertices of one mesh. The vertex pools are read as raw buffers in the loader's
+// layouts: position, normal and two uvs in the basic attributes, four joints and four weights as floats in the
+// skin attributes. Joint matrices are four float4 rows each, applied to row vectors like the PBR renderer does.
+static const char* k_skinningShader = R"(
+struct SkinChunk
+{
+    uint4 FirstVertexCountFirstJoint;
+};
+
+StructuredBuffer<SkinChunk> g_Chunks;
+StructuredBuffer<float4>    g_Joints;
+ByteAddressBuffer           g_BindPose;
+ByteAddressBuffer           g_SkinAttribs;
+RWByteAddressBuffer         g_Vertices;
+
+[numthreads(64, 1, 1)]
+void main(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    uint4 Chunk = g_Chunks[Gid.x].FirstVertexCountFirstJoint;
+    if (GTid.x >= Chunk.y)
+        return;
+
+    uint Vertex = Chunk.x + GTid.x;
+    uint Basic = Vertex * 40;
+    float3 Pos    = asfloat(g_BindPose.Load3(Basic));
+    float3 Normal = asfloat(g_BindPose.Load3(Basic + 12));
+    uint4  Joints  = (uint4)asfloat(g_SkinAttribs.Load4(Vertex * 32));
+    float4 Weights = asfloat(g_SkinAttribs.Load4(Vertex * 32 + 16));
+
+    float4 Row0 = float4(0.0, 0.0, 0.0, 0.0);
+    float4 Row1 = Row0;
+    float4 Row2 = Row0;
+    float4 Row3 = Row0;
+    for (uint i = 0; i < 4; i++)
+    {
+        uint Joint = (Chunk.z + Joints[i]) * 4;
+        Row0 += Weights[i] * g_Joints[Joint + 0];
+        Row1 += Weights[i] * g_Joints[Joint + 1];
+        Row2 += Weights[i] * g_Joints[Joint + 2];
+        Row3 += Weights[i] * g_Joints[Joint + 3];
+    }
+
+    // the renderer normalizes after its own transform, so the normal is left as it comes out
+    float3 SkinnedPos    = Pos.x * Row0.xyz + Pos.y * Row1.xyz + Pos.z * Row2.xyz + Row3.xyz;
+    float3 SkinnedNormal = Normal.x * Row0.xyz + Normal.y * Row1.xyz + Normal.z * Row2.xyz;
+    g_Vertices.Store3(Basic, asuint(SkinnedPos));
+    g_Vertices.Store3(Basic + 12, asuint(SkinnedNormal));
+}
+)";
+
+void GpuSkinning::Init( IRenderDevice* device, MemoryBudget* memoryBudget )
+{
+	Shutdown();
+	m_device = device;
+	m_memoryBudget = memoryBudget;
+}
+
+
+void GpuSkinning::Shutdown()
+{
+	if ( m_memoryBudget )
+	{
+		for ( IBuffer* buffer : { m_bindPose.RawPtr(), m_joints.RawPtr(), m_chunks.RawPtr() } )
+		{
+			if ( buffer )
+			{
+				m_memoryBudget->Unregister( buffer );
+			}
+		}
+	}
+
+	m_models.clear();
+	m_binding.Release();
+	m_pipeline.Release();
+	m_basicAttribs.Release();
+	m_skinAttribs.Release();
+	m_bindPose.Release();
+	m_joints.Release();
+	m_chunks.Release();
+	m_jointCapacity = 0;
+	m_chunkCapacity = 0;
+	m_bindingDirty = true;
+	m_jointData.clear();
+	m_chunkData.clear();
+	m_lastStats = GpuSkinningStats();
+}
+
+
+static RefCntAutoPtr<IBuffer> CreateSkinningBuffer( IRenderDevice* device, MemoryBudget* memoryBudget, const char* name,
+	BUFFER_MODE mode, uint32_t stride, uint32_t size )
+{
+	BufferDesc desc;
+	desc.Name = name;
+	desc.Usage = USAGE_DEFAULT;
+	desc.BindFlags = BIND_SHADER_RESOURCE;
+	desc.Mode = mode;
+	desc.ElementByteStride = stride;
+	desc.uiSizeInBytes = size;
+	RefCntAutoPtr<IBuffer> buffer;
+	device->CreateBuffer( desc, nullptr, &buffer );
+	if ( !buffer )
+	{
+		std::cerr << "Unable to create the " << name << " buffer with " << size << " bytes\n";
+	}
+	else if ( memoryBudget )
+	{
+		memoryBudget->RegisterBuffer( buffer, MemoryCategory::AppBuffers );
+	}
+	return buffer;
+}
+
+
+bool GpuSkinning::CreatePipeline()
+{
+	if ( m_pipeline )
+		return true;
+
+	ShaderCreateInfo shaderCI;
+	shaderCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
+	shaderCI.UseCombinedTextureSamplers = true;
+	shaderCI.Desc.ShaderType = SHADER_TYPE_COMPUTE;
+	shaderCI.Desc.Name = "Skinning CS";
+	shaderCI.EntryPoint = "main";
+	shaderCI.Source = k_skinningShader;
+	RefCntAutoPtr<IShader> shader;
+	m_device->CreateShader( shaderCI, &shader );
+	if ( !shader )
+	{
+		std::cerr << "Unable to compile the skinning shader\n";
+		return false;
+	}
+
+	ComputePipelineStateCreateInfo psoCI;
+	psoCI.PSODesc.Name = "Skinning PSO";
+	psoCI.PSODesc.PipelineType = PIPELINE_TYPE_COMPUTE;
+	psoCI.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE;
+	psoCI.pCS = shader;
+	m_device->CreateComputePipelineState( psoCI, &m_pipeline );
+	if ( !m_pipeline )
+	{
+		std::cerr << "Unable to create the skinning pipeline\n";
+		return false;
+	}
+	return true;
+}
+
+
+// The bind pose is kept at the same offsets as in the pool, so it grows along with the pool and the suballocator
+// never has to tell anyone where a model went
+bool GpuSkinning::SyncBindPose( IDeviceContext* context, IBuffer* basicAttribs )
+{
+	uint32_t size = basicAttribs->GetDesc().uiSizeInBytes;
+	if ( basicAttribs == m_basicAttribs && m_bindPose && m_bindPose->GetDesc().uiSizeInBytes >= size )
+		return true;
+
+	m_basicAttribs = basicAttribs;
+	m_bindingDirty = true;
+	if ( m_bindPose && m_bindPose->GetDesc().uiSizeInBytes >= size )
+		return true;
+
+	RefCntAutoPtr<IBuffer> bindPose = CreateSkinningBuffer( m_device, m_memoryBudget, "Skinning bind pose", BUFFER_MODE_RAW,
+		GltfCachePolicy::ElementSize( GltfPool_BasicVertexAttribs ), size );
+	if ( !bindPose )
+		return false;
+
+	if ( m_bindPose )
+	{
+		context->CopyBuffer( m_bindPose, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+			bindPose, 0, m_bindPose->GetDesc().uiSizeInBytes, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+		if ( m_memoryBudget )
+		{
+			m_memoryBudget->Unregister( m_bindPose );
+		}
+	}
+	m_bindPose = bindPose;
+	return true;
+}
+
+
+void GpuSkinning::AddModel( IDeviceContext* context, GLTF::Model* model, IBuffer* basicAttribs )
+{
+	if ( !model || model->Skins.empty() || !basicAttribs || !m_device )
+		return;
+
+	if ( !CreatePipeline() || !SyncBindPose( context, basicAttribs ) )
+		return;
+
+	// the loader appends a node's vertices in the same call that adds it to LinearNodes, so the meshes follow
+	// each other in that order from the model's base vertex
+	SkinnedModel skinned;
+	skinned.model = model;
+	uint32_t firstVertex = model->GetBaseVertex();
+	uint32_t vertex = firstVertex;
+	for ( GLTF::Node* node : model->LinearNodes )
+	{
+		if ( !node->Mesh )
+			continue;
+
+		uint32_t vertexCount = 0;
+		for ( const auto& primitive : node->Mesh->Primitives )
+		{
+			vertexCount += primitive->VertexCount;
+		}
+		skinned.meshes.push_back( { node, vertex, vertexCount } );
+		vertex += vertexCount;
+	}
+
+	uint32_t stride = GltfCachePolicy::ElementSize( GltfPool_BasicVertexAttribs );
+	if ( vertex > firstVertex )
+	{
+		context->CopyBuffer( basicAttribs, firstVertex * stride, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+			m_bindPose, firstVertex * stride, ( vertex - firstVertex ) * stride, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	}
+	m_models.push_back( std::move( skinned ) );
+	m_lastStats.modelCount = (uint32_t)m_models.size();
+}
+
+
+void GpuSkinning::RemoveModel( const GLTF::Model* model )
+{
+	m_models.erase( std::remove_if( m_models.begin(), m_models.end(),
+		[ model ]( const SkinnedModel& skinned ) { return skinned.model == model; } ), m_models.end() );
+	m_lastStats.modelCount = (uint32_t)m_models.size();
+}
+
+
+bool GpuSkinning::ReserveBuffers( uint32_t jointCount, uint32_t chunkCount )
+{
+	if ( jointCount > m_jointCapacity || !m_joints )
+	{
+		uint32_t capacity = std::max( m_jointCapacity, k_minJointCapacity );
+		while ( capacity < jointCount )
+		{
+			capacity *= 2;
+		}
+
+		if ( m_memoryBudget && m_joints )
+		{
+			m_memoryBudget->Unregister( m_joints );
+		}
+		m_jointCapacity = 0;
+		m_joints = CreateSkinningBuffer( m_device, m_memoryBudget, "Skinning joints", BUFFER_MODE_STRUCTURED,
+			sizeof( float4 ), capacity * sizeof( float4x4 ) );
+		if ( !m_joints )
+			return false;
+		m_jointCapacity = capacity;
+		m_bindingDirty = true;
+	}
+
+	if ( chunkCount > m_chunkCapacity || !m_chunks )
+	{
+		uint32_t capacity = std::max( m_chunkCapacity, k_minChunkCapacity );
+		while ( capacity < chunkCount )
+		{
+			capacity *= 2;
+		}
+
+		if ( m_memoryBudget && m_chunks )
+		{
+			m_memoryBudget->Unregister( m_chunks );
+		}
+		m_chunkCapacity = 0;
+		m_chunks = CreateSkinningBuffer( m_device, m_memoryBudget, "Skinning chunks", BUFFER_MODE_STRUCTURED,
+			sizeof( SkinChunk ), capacity * sizeof( SkinChunk ) );
+		if ( !m_chunks )
+			return false;
+		m_chunkCapacity = capacity;
+		m_bindingDirty = true;
+	}
+	return true;
+}
+
+
+bool GpuSkinning::Update( IDeviceContext* context, IBuffer* basicAttribs, IBuffer* skinAttribs )
+{
+	m_jointData.clear();
+	m_chunkData.clear();
+	if ( m_models.empty() || !basicAttribs || !skinAttribs )
+		return false;
+
+	XRDE_PROFILE_FUNCTION();
+	uint32_t meshCount = 0;
+	uint32_t vertexCount = 0;
+	for ( SkinnedModel& skinned : m_models )
+	{
+		for ( SkinnedMesh& mesh : skinned.meshes )
+		{
+			auto& transforms = mesh.node->Mesh->Transforms;
+			if ( transforms.jointcount <= 0 || !mesh.vertexCount )
+				continue;
+
+			uint32_t firstJoint = (uint32_t)m_jointData.size();
+			m_jointData.insert( m_jointData.end(), transforms.jointMatrix, transforms.jointMatrix + transforms.jointcount );
+			transforms.jointcount = 0;
+
+			for ( uint32_t v = 0; v < mesh.vertexCount; v += k_skinGroupSize )
+			{
+				m_chunkData.push_back( { mesh.firstVertex + v, std::min( k_skinGroupSize, mesh.vertexCount - v ), firstJoint, 0 } );
+			}
+			meshCount++;
+			vertexCount += mesh.vertexCount;
+		}
+	}
+	if ( m_chunkData.empty() )
+		return false;
+
+	if ( skinAttribs != m_skinAttribs )
+	{
+		m_skinAttribs = skinAttribs;
+		m_bindingDirty = true;
+	}
+	if ( !SyncBindPose( context, basicAttribs ) || !ReserveBuffers( (uint32_t)m_jointData.size(), (uint32_t)m_chunkData.size() ) )
+	{
+		m_chunkData.clear();
+		return false;
+	}
+
+	context->UpdateBuffer( m_joints, 0, (Uint32)( m_jointData.size() * sizeof( float4x4 ) ), m_jointData.data(),
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+	context->UpdateBuffer( m_chunks, 0, (Uint32)( m_chunkData.size() * sizeof( SkinChunk ) ), m_chunkData.data(),
+		RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+
+	// mutable variables can only be set once per binding, so new buffers need a new one
+	if ( m_bindingDirty )
+	{
+		m_binding.Release();
+		m_pipeline->CreateShaderResourceBinding( &m_binding, true );
+		m_binding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_Chunks" )->Set( m_chunks->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_binding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_Joints" )->Set( m_joints->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_binding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_BindPose" )->Set( m_bindPose->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_binding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_SkinAttribs" )->Set( m_skinAttribs->GetDefaultView( BUFFER_VIEW_SHADER_RESOURCE ) );
+		m_binding->GetVariableByName( SHADER_TYPE_COMPUTE, "g_Vertices" )->Set( m_basicAttribs->GetDefaultView( BUFFER_VIEW_UNORDERED_ACCESS ) );
+		m_bindingDirty = false;
+	}
+
+	m_lastStats.meshCount = meshCount;
+	m_lastStats.vertexCount = vertexCount;
+	return true;
+}
+
+
+void GpuSkinning::DeclareResources( RenderGraphPassBuilder& pass ) const
+{
+	if ( m_chunkData.empty() )
+		return;
+
+	pass.Read( m_chunks, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Read( m_joints, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Read( m_bindPose, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Read( m_skinAttribs, RESOURCE_STATE_SHADER_RESOURCE );
+	pass.Write( m_basicAttribs, RESOURCE_STATE_UNORDERED_ACCESS );
+}
+
+
+void GpuSkinning::Dispatch( IDeviceContext* context, RESOURCE_STATE_TRANSITION_MODE transitionMode )
+{
+	if ( m_chunkData.empty() )
+		return;
+
+	XRDE_PROFILE_FUNCTION();
+	context->SetPipelineState( m_pipeline );
+	context->CommitShaderResources( m_binding, transitionMode );
+	DispatchComputeAttribs attribs( (uint32_t)m_chunkData.size(), 1, 1 );
+	context->DispatchCompute( attribs );
+
+	// the poses are applied, so the next Update only picks up meshes that move again
+	m_chunkData.clear();
+}
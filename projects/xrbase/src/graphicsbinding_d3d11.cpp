@@ -37,18 +37,34 @@ XrResult GraphicsBinding_D3D11::CreateDevice( XrInstance instance, XrSystemId sy
 	auto* pFactoryD3D11 = GetEngineFactoryD3D11();
 	m_pEngineFactory = pFactoryD3D11;
 
-	FETCH_AND_DEFINE_XR_FUNCTION( m_instance, xrGetD3D11GraphicsRequirementsKHR );
-	XrGraphicsRequirementsD3D11KHR graphicsRequirements = { XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR };
-	XrResult res = xrGetD3D11GraphicsRequirementsKHR( m_instance, m_systemId, &graphicsRequirements );
-	if ( XR_FAILED( res ) )
+	EngineD3D11CreateInfo EngineCI;
+
+	// without an instance (offline replays) there's no runtime to have an opinion, so use the default adapter
+	if ( m_instance != XR_NULL_HANDLE )
 	{
-		return res;
+		FETCH_AND_DEFINE_XR_FUNCTION( m_instance, xrGetD3D11GraphicsRequirementsKHR );
+		XrGraphicsRequirementsD3D11KHR graphicsRequirements = { XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR };
+		XrResult res = xrGetD3D11GraphicsRequirementsKHR( m_instance, m_systemId, &graphicsRequirements );
+		if ( XR_FAILED( res ) )
+		{
+			return res;
+		}
+		EngineCI.AdapterId = GetAdapterIndexFromLuid( graphicsRequirements.adapterLuid );
 	}
-
-	EngineD3D11CreateInfo EngineCI;
-	EngineCI.AdapterId = GetAdapterIndexFromLuid( graphicsRequirements.adapterLuid );
 	EngineCI.GraphicsAPIVersion = Version { 11, 0 };
-	pFactoryD3D11->CreateDeviceAndContextsD3D11( EngineCI, &m_pDevice, &m_pImmediateContext );
+	EngineCI.NumDeferredContexts = m_deferredContextCount;
+	EngineCI.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+	EngineCI.Features.DurationQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+
+	// the immediate context comes first, followed by the deferred contexts
+	std::vector<IDeviceContext*> contexts( 1 + m_deferredContextCount, nullptr );
+	pFactoryD3D11->CreateDeviceAndContextsD3D11( EngineCI, &m_pDevice, contexts.data() );
+	m_pImmediateContext.Attach( contexts[ 0 ] );
+	for ( uint32_t i = 0; i < m_deferredContextCount; i++ )
+	{
+		m_pDeferredContexts.emplace_back();
+		m_pDeferredContexts.back().Attach( contexts[ 1 + i ] );
+	}
 
 	m_d3d11Binding = new XrGraphicsBindingD3D11KHR( { XR_TYPE_GRAPHICS_BINDING_D3D11_KHR } );
 	m_d3d11Binding->device = GetD3D11Device()->GetD3D11Device();
@@ -22,6 +22,9 @@ public:
 	virtual Diligent::IEngineFactory* GetEngineFactory() override;
 	virtual Diligent::IRenderDevice* GetRenderDevice() override { return m_pDevice.RawPtr(); }
 	virtual Diligent::IDeviceContext* GetImmediateContext() override { return m_pImmediateContext.RawPtr(); }
+	virtual void SetDeferredContextCount( uint32_t count ) override { m_deferredContextCount = count; }
+	virtual uint32_t GetDeferredContextCount() override { return (uint32_t)m_pDeferredContexts.size(); }
+	virtual Diligent::IDeviceContext* GetDeferredContext( uint32_t index ) override { return m_pDeferredContexts[ index ].RawPtr(); }
 	virtual std::vector<int64_t> GetRequestedColorFormats() override;
 	virtual std::vector<int64_t> GetRequestedDepthFormats() override;
 	virtual void* GetSessionBinding() override;
@@ -34,6 +37,8 @@ private:
 	Diligent::RefCntAutoPtr<Diligent::IEngineFactoryD3D11>         m_pEngineFactory;
 	Diligent::RefCntAutoPtr<Diligent::IRenderDevice>  m_pDevice;
 	Diligent::RefCntAutoPtr<Diligent::IDeviceContext> m_pImmediateContext;
+	std::vector< Diligent::RefCntAutoPtr<Diligent::IDeviceContext> > m_pDeferredContexts;
+	uint32_t m_deferredContextCount = 0;
 
 	XrInstance m_instance = XR_NULL_HANDLE;
 	XrSystemId m_systemId;
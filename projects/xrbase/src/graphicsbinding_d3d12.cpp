@@ -41,18 +41,34 @@ XrResult GraphicsBinding_D3D12::CreateDevice( XrInstance instance, XrSystemId sy
 	auto* pFactoryD3D12 = GetEngineFactoryD3D12();
 	m_pEngineFactory = pFactoryD3D12;
 
-	FETCH_AND_DEFINE_XR_FUNCTION( m_instance, xrGetD3D12GraphicsRequirementsKHR );
-	XrGraphicsRequirementsD3D12KHR graphicsRequirements = { XR_TYPE_GRAPHICS_REQUIREMENTS_D3D12_KHR };
-	XrResult res = xrGetD3D12GraphicsRequirementsKHR( m_instance, m_systemId, &graphicsRequirements );
-	if ( XR_FAILED( res ) )
+	EngineD3D12CreateInfo EngineCI;
+
+	// without an instance (offline replays) there's no runtime to have an opinion, so use the default adapter
+	if ( m_instance != XR_NULL_HANDLE )
 	{
-		return res;
+		FETCH_AND_DEFINE_XR_FUNCTION( m_instance, xrGetD3D12GraphicsRequirementsKHR );
+		XrGraphicsRequirementsD3D12KHR graphicsRequirements = { XR_TYPE_GRAPHICS_REQUIREMENTS_D3D12_KHR };
+		XrResult res = xrGetD3D12GraphicsRequirementsKHR( m_instance, m_systemId, &graphicsRequirements );
+		if ( XR_FAILED( res ) )
+		{
+			return res;
+		}
+		EngineCI.AdapterId = GetAdapterIndexFromLuid( graphicsRequirements.adapterLuid );
 	}
-
-	EngineD3D12CreateInfo EngineCI;
-	EngineCI.AdapterId = GetAdapterIndexFromLuid( graphicsRequirements.adapterLuid );
 	EngineCI.GraphicsAPIVersion = Version { 11, 0 };
-	pFactoryD3D12->CreateDeviceAndContextsD3D12( EngineCI, &m_pDevice, &m_pImmediateContext );
+	EngineCI.NumDeferredContexts = m_deferredContextCount;
+	EngineCI.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+	EngineCI.Features.DurationQueries = DEVICE_FEATURE_STATE_OPTIONAL;
+
+	// the immediate context comes first, followed by the deferred contexts
+	std::vector<IDeviceContext*> contexts( 1 + m_deferredContextCount, nullptr );
+	pFactoryD3D12->CreateDeviceAndContextsD3D12( EngineCI, &m_pDevice, contexts.data() );
+	m_pImmediateContext.Attach( contexts[ 0 ] );
+	for ( uint32_t i = 0; i < m_deferredContextCount; i++ )
+	{
+		m_pDeferredContexts.emplace_back();
+		m_pDeferredContexts.back().Attach( contexts[ 1 + i ] );
+	}
 
 	m_d3d12Binding = new XrGraphicsBindingD3D12KHR( { XR_TYPE_GRAPHICS_BINDING_D3D12_KHR } );
 	m_d3d12Binding->device = GetD3D12Device()->GetD3D12Device();
@@ -0,0 +1,782 @@
+#include "input_trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace XRDE;
+
+static const char k_traceMagic[ 8 ] = { 'X', 'R', 'T', 'R', 'A', 'C', 'E', '1' };
+static const uint8_t k_chunkChannel = 1;
+static const uint8_t k_chunkData = 2;
+
+// Channels are written out once they've buffered this much
+static const size_t k_chunkSize = 16 * 1024;
+
+static const float k_positionScale = 10000.f;	// 0.1mm
+static const float k_unitScale = 32767.f;		// quaternion components and action values
+static const float k_angleScale = 100000.f;		// fov angles and joint radii
+
+static InputTrace* s_activeTrace = nullptr;
+
+void XRDE::SetActiveInputTrace( InputTrace* trace )
+{
+	s_activeTrace = trace;
+}
+
+InputTrace* XRDE::ActiveInputTrace()
+{
+	return s_activeTrace;
+}
+
+
+static int64_t Quantize( float value, float scale )
+{
+	// runtimes are allowed to leave garbage in poses they don't mark as valid
+	if ( !std::isfinite( value ) || fabsf( value ) > 1e6f )
+		return 0;
+
+	return (int64_t)llroundf( value * scale );
+}
+
+static float Dequantize( int64_t value, float scale )
+{
+	return (float)value / scale;
+}
+
+
+bool InputTrace::StartRecording( const std::string& path )
+{
+	Close();
+
+#ifdef _WIN32
+	if ( fopen_s( &m_file, path.c_str(), "wb" ) != 0 )
+	{
+		m_file = nullptr;
+	}
+#else
+	m_file = fopen( path.c_str(), "wb" );
+#endif
+	if ( !m_file )
+	{
+		std::cerr << "Unable to open " << path << " to record an input trace\n";
+		return false;
+	}
+
+	WriteBytes( k_traceMagic, sizeof( k_traceMagic ) );
+	return true;
+}
+
+
+bool InputTrace::StartReplay( const std::string& path )
+{
+	Close();
+
+	FILE* file = nullptr;
+#ifdef _WIN32
+	if ( fopen_s( &file, path.c_str(), "rb" ) != 0 )
+	{
+		file = nullptr;
+	}
+#else
+	file = fopen( path.c_str(), "rb" );
+#endif
+	if ( !file )
+	{
+		std::cerr << "Unable to open input trace " << path << "\n";
+		return false;
+	}
+
+	std::vector<uint8_t> contents;
+	uint8_t buffer[ 64 * 1024 ];
+	size_t read;
+	while ( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+	{
+		contents.insert( contents.end(), buffer, buffer + read );
+	}
+	fclose( file );
+
+	if ( contents.size() < sizeof( k_traceMagic ) || memcmp( contents.data(), k_traceMagic, sizeof( k_traceMagic ) ) != 0 )
+	{
+		std::cerr << path << " is not an input trace\n";
+		return false;
+	}
+
+	// Parse the chunks with a scratch channel so the varint helpers can be reused
+	Channel parser;
+	parser.data = std::move( contents );
+	parser.readOffset = sizeof( k_traceMagic );
+	while ( parser.readOffset < parser.data.size() )
+	{
+		uint8_t chunkType = parser.data[ parser.readOffset++ ];
+		uint64_t id;
+		if ( !GetVarint( parser, &id ) || id >= k_maxChannels )
+			break;
+
+		if ( chunkType == k_chunkChannel )
+		{
+			uint64_t nameLength;
+			if ( parser.readOffset >= parser.data.size() )
+				break;
+			TraceChannelKind kind = (TraceChannelKind)parser.data[ parser.readOffset++ ];
+			if ( !GetVarint( parser, &nameLength ) || parser.readOffset + nameLength > parser.data.size() )
+				break;
+
+			auto channel = std::make_unique<Channel>();
+			channel->id = (uint32_t)id;
+			channel->kind = kind;
+			channel->name.assign( (const char*)&parser.data[ parser.readOffset ], (size_t)nameLength );
+			parser.readOffset += (size_t)nameLength;
+
+			m_channelIds[ { kind, channel->name } ] = (uint32_t)id;
+			m_channels[ id ] = std::move( channel );
+			m_channelCount = std::max( m_channelCount, (uint32_t)id + 1 );
+		}
+		else if ( chunkType == k_chunkData )
+		{
+			uint64_t size;
+			if ( !GetVarint( parser, &size ) || parser.readOffset + size > parser.data.size() || !m_channels[ id ] )
+				break;
+
+			std::vector<uint8_t>& data = m_channels[ id ]->data;
+			data.insert( data.end(), parser.data.begin() + parser.readOffset, parser.data.begin() + parser.readOffset + (size_t)size );
+			parser.readOffset += (size_t)size;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if ( parser.readOffset != parser.data.size() )
+	{
+		std::cerr << "Input trace " << path << " is truncated or corrupt, replaying what could be read\n";
+	}
+
+	m_replaying = true;
+	return true;
+}
+
+
+void InputTrace::Close()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_file )
+	{
+		for ( uint32_t i = 0; i < m_channelCount; i++ )
+		{
+			if ( m_channels[ i ] && !m_channels[ i ]->data.empty() )
+			{
+				WriteChunk( i, *m_channels[ i ] );
+			}
+		}
+		fclose( m_file );
+		m_file = nullptr;
+	}
+
+	for ( uint32_t i = 0; i < m_channelCount; i++ )
+	{
+		m_channels[ i ].reset();
+	}
+	m_channelCount = 0;
+	m_channelIds.clear();
+	m_replaying = false;
+	m_bytesWritten = 0;
+}
+
+
+uint32_t InputTrace::GetChannel( TraceChannelKind kind, const std::string& name )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto i = m_channelIds.find( { kind, name } );
+	if ( i != m_channelIds.end() )
+		return i->second;
+
+	if ( m_channelCount >= k_maxChannels )
+	{
+		std::cerr << "Too many input trace channels, dropping " << name << "\n";
+		return k_invalidChannel;
+	}
+
+	uint32_t id = m_channelCount++;
+	auto channel = std::make_unique<Channel>();
+	channel->id = id;
+	channel->kind = kind;
+	channel->name = name;
+	m_channelIds[ { kind, name } ] = id;
+
+	if ( m_file )
+	{
+		Channel header;
+		header.data.push_back( k_chunkChannel );
+		PutVarint( header, id );
+		header.data.push_back( (uint8_t)kind );
+		PutVarint( header, name.size() );
+		header.data.insert( header.data.end(), name.begin(), name.end() );
+		WriteBytes( header.data.data(), header.data.size() );
+	}
+
+	m_channels[ id ] = std::move( channel );
+	return id;
+}
+
+
+void InputTrace::WriteBytes( const void* data, size_t size )
+{
+	fwrite( data, 1, size, m_file );
+	m_bytesWritten += size;
+}
+
+
+void InputTrace::WriteChunk( uint32_t id, Channel& channel )
+{
+	Channel header;
+	header.data.push_back( k_chunkData );
+	PutVarint( header, id );
+	PutVarint( header, channel.data.size() );
+	WriteBytes( header.data.data(), header.data.size() );
+	WriteBytes( channel.data.data(), channel.data.size() );
+	channel.data.clear();
+}
+
+
+InputTrace::Channel& InputTrace::BeginRecord( uint32_t channel )
+{
+	return *m_channels[ channel ];
+}
+
+
+void InputTrace::EndRecord( Channel& channel )
+{
+	if ( channel.data.size() < k_chunkSize )
+		return;
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_file )
+	{
+		WriteChunk( channel.id, channel );
+	}
+}
+
+
+InputTrace::Channel* InputTrace::BeginReplay( uint32_t channel )
+{
+	if ( !m_replaying || channel >= m_channelCount || !m_channels[ channel ] )
+		return nullptr;
+
+	Channel* c = m_channels[ channel ].get();
+	if ( c->readOffset >= c->data.size() )
+		return nullptr;
+
+	return c;
+}
+
+
+void InputTrace::PutVarint( Channel& channel, uint64_t value )
+{
+	while ( value >= 0x80 )
+	{
+		channel.data.push_back( (uint8_t)( value | 0x80 ) );
+		value >>= 7;
+	}
+	channel.data.push_back( (uint8_t)value );
+}
+
+
+void InputTrace::PutSigned( Channel& channel, int64_t value )
+{
+	// zigzag so small negative numbers stay small
+	PutVarint( channel, ( (uint64_t)value << 1 ) ^ (uint64_t)( value >> 63 ) );
+}
+
+
+void InputTrace::PutDelta( Channel& channel, uint32_t slot, int64_t value )
+{
+	if ( slot >= channel.previous.size() )
+	{
+		channel.previous.resize( slot + 1, 0 );
+	}
+	PutSigned( channel, value - channel.previous[ slot ] );
+	channel.previous[ slot ] = value;
+}
+
+
+bool InputTrace::GetVarint( Channel& channel, uint64_t* value )
+{
+	uint64_t result = 0;
+	for ( uint32_t shift = 0; shift < 64; shift += 7 )
+	{
+		if ( channel.readOffset >= channel.data.size() )
+			return false;
+
+		uint8_t byte = channel.data[ channel.readOffset++ ];
+		result |= (uint64_t)( byte & 0x7f ) << shift;
+		if ( ( byte & 0x80 ) == 0 )
+		{
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool InputTrace::GetSigned( Channel& channel, int64_t* value )
+{
+	uint64_t encoded;
+	if ( !GetVarint( channel, &encoded ) )
+		return false;
+
+	*value = (int64_t)( encoded >> 1 ) ^ -(int64_t)( encoded & 1 );
+	return true;
+}
+
+
+bool InputTrace::GetDelta( Channel& channel, uint32_t slot, int64_t* value )
+{
+	int64_t delta;
+	if ( !GetSigned( channel, &delta ) )
+		return false;
+
+	if ( slot >= channel.previous.size() )
+	{
+		channel.previous.resize( slot + 1, 0 );
+	}
+	channel.previous[ slot ] += delta;
+	*value = channel.previous[ slot ];
+	return true;
+}
+
+
+void InputTrace::PutPose( Channel& channel, uint32_t slot, const XrPosef& pose )
+{
+	PutDelta( channel, slot + 0, Quantize( pose.position.x, k_positionScale ) );
+	PutDelta( channel, slot + 1, Quantize( pose.position.y, k_positionScale ) );
+	PutDelta( channel, slot + 2, Quantize( pose.position.z, k_positionScale ) );
+	PutDelta( channel, slot + 3, Quantize( pose.orientation.x, k_unitScale ) );
+	PutDelta( channel, slot + 4, Quantize( pose.orientation.y, k_unitScale ) );
+	PutDelta( channel, slot + 5, Quantize( pose.orientation.z, k_unitScale ) );
+	PutDelta( channel, slot + 6, Quantize( pose.orientation.w, k_unitScale ) );
+}
+
+
+bool InputTrace::GetPose( Channel& channel, uint32_t slot, XrPosef* pose )
+{
+	int64_t v[ 7 ];
+	for ( uint32_t i = 0; i < 7; i++ )
+	{
+		if ( !GetDelta( channel, slot + i, &v[ i ] ) )
+			return false;
+	}
+
+	pose->position = { Dequantize( v[ 0 ], k_positionScale ), Dequantize( v[ 1 ], k_positionScale ), Dequantize( v[ 2 ], k_positionScale ) };
+
+	float x = Dequantize( v[ 3 ], k_unitScale ), y = Dequantize( v[ 4 ], k_unitScale );
+	float z = Dequantize( v[ 5 ], k_unitScale ), w = Dequantize( v[ 6 ], k_unitScale );
+	float length = sqrtf( x * x + y * y + z * z + w * w );
+	if ( length > 0 )
+	{
+		pose->orientation = { x / length, y / length, z / length, w / length };
+	}
+	else
+	{
+		pose->orientation = { 0, 0, 0, 1.f };
+	}
+	return true;
+}
+
+
+void InputTrace::RecordFrameState( uint32_t channel, const XrFrameState& frameState )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutDelta( c, 0, frameState.predictedDisplayTime );
+	PutDelta( c, 1, frameState.predictedDisplayPeriod );
+	PutVarint( c, frameState.shouldRender ? 1 : 0 );
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayFrameState( uint32_t channel, XrFrameState* frameState )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t displayTime, period;
+	uint64_t shouldRender;
+	if ( !GetDelta( *c, 0, &displayTime ) || !GetDelta( *c, 1, &period ) || !GetVarint( *c, &shouldRender ) )
+		return false;
+
+	frameState->predictedDisplayTime = displayTime;
+	frameState->predictedDisplayPeriod = period;
+	frameState->shouldRender = shouldRender ? XR_TRUE : XR_FALSE;
+	return true;
+}
+
+
+void InputTrace::RecordViews( uint32_t channel, XrResult result, const XrViewState& viewState, uint32_t viewCount, const XrView* views )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	if ( XR_SUCCEEDED( result ) )
+	{
+		PutVarint( c, viewState.viewStateFlags );
+		PutVarint( c, viewCount );
+		for ( uint32_t i = 0; i < viewCount; i++ )
+		{
+			uint32_t slot = i * 11;
+			PutPose( c, slot, views[ i ].pose );
+			PutDelta( c, slot + 7, Quantize( views[ i ].fov.angleLeft, k_angleScale ) );
+			PutDelta( c, slot + 8, Quantize( views[ i ].fov.angleRight, k_angleScale ) );
+			PutDelta( c, slot + 9, Quantize( views[ i ].fov.angleUp, k_angleScale ) );
+			PutDelta( c, slot + 10, Quantize( views[ i ].fov.angleDown, k_angleScale ) );
+		}
+	}
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayViews( uint32_t channel, XrResult* result, XrViewState* viewState, uint32_t viewCapacity, uint32_t* viewCount, XrView* views )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res;
+	if ( !GetSigned( *c, &res ) )
+		return false;
+	*result = (XrResult)res;
+	*viewCount = 0;
+	if ( XR_FAILED( *result ) )
+		return true;
+
+	uint64_t flags, count;
+	if ( !GetVarint( *c, &flags ) || !GetVarint( *c, &count ) )
+		return false;
+	viewState->viewStateFlags = flags;
+
+	for ( uint32_t i = 0; i < count; i++ )
+	{
+		uint32_t slot = i * 11;
+		XrView view;
+		int64_t fov[ 4 ];
+		if ( !GetPose( *c, slot, &view.pose ) )
+			return false;
+		for ( uint32_t j = 0; j < 4; j++ )
+		{
+			if ( !GetDelta( *c, slot + 7 + j, &fov[ j ] ) )
+				return false;
+		}
+
+		// still have to read the views that don't fit to keep the deltas in step
+		if ( i < viewCapacity )
+		{
+			views[ i ].pose = view.pose;
+			views[ i ].fov = { Dequantize( fov[ 0 ], k_angleScale ), Dequantize( fov[ 1 ], k_angleScale ),
+				Dequantize( fov[ 2 ], k_angleScale ), Dequantize( fov[ 3 ], k_angleScale ) };
+		}
+	}
+	*viewCount = (uint32_t)count;
+	if ( count > viewCapacity )
+	{
+		*result = XR_ERROR_SIZE_INSUFFICIENT;
+	}
+	return true;
+}
+
+
+void InputTrace::RecordSessionStates( uint32_t channel, const std::vector<XrSessionState>& states )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutVarint( c, states.size() );
+	for ( XrSessionState state : states )
+	{
+		PutVarint( c, (uint64_t)state );
+	}
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplaySessionStates( uint32_t channel, std::vector<XrSessionState>* states )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	uint64_t count;
+	if ( !GetVarint( *c, &count ) )
+		return false;
+
+	states->clear();
+	for ( uint64_t i = 0; i < count; i++ )
+	{
+		uint64_t state;
+		if ( !GetVarint( *c, &state ) )
+			return false;
+		states->push_back( (XrSessionState)state );
+	}
+	return true;
+}
+
+
+// Shared by all the action state types: result, flags and last change time
+static uint64_t ActionFlags( XrBool32 active, XrBool32 changed, XrBool32 current )
+{
+	return ( active ? 1 : 0 ) | ( changed ? 2 : 0 ) | ( current ? 4 : 0 );
+}
+
+
+void InputTrace::RecordBooleanAction( uint32_t channel, XrResult result, const XrActionStateBoolean& state )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	PutVarint( c, ActionFlags( state.isActive, state.changedSinceLastSync, state.currentState ) );
+	PutDelta( c, 0, state.lastChangeTime );
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayBooleanAction( uint32_t channel, XrResult* result, XrActionStateBoolean* state )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res, lastChangeTime;
+	uint64_t flags;
+	if ( !GetSigned( *c, &res ) || !GetVarint( *c, &flags ) || !GetDelta( *c, 0, &lastChangeTime ) )
+		return false;
+
+	*result = (XrResult)res;
+	state->isActive = ( flags & 1 ) ? XR_TRUE : XR_FALSE;
+	state->changedSinceLastSync = ( flags & 2 ) ? XR_TRUE : XR_FALSE;
+	state->currentState = ( flags & 4 ) ? XR_TRUE : XR_FALSE;
+	state->lastChangeTime = lastChangeTime;
+	return true;
+}
+
+
+void InputTrace::RecordFloatAction( uint32_t channel, XrResult result, const XrActionStateFloat& state )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	PutVarint( c, ActionFlags( state.isActive, state.changedSinceLastSync, XR_FALSE ) );
+	PutDelta( c, 0, state.lastChangeTime );
+	PutDelta( c, 1, Quantize( state.currentState, k_unitScale ) );
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayFloatAction( uint32_t channel, XrResult* result, XrActionStateFloat* state )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res, lastChangeTime, value;
+	uint64_t flags;
+	if ( !GetSigned( *c, &res ) || !GetVarint( *c, &flags ) || !GetDelta( *c, 0, &lastChangeTime ) || !GetDelta( *c, 1, &value ) )
+		return false;
+
+	*result = (XrResult)res;
+	state->isActive = ( flags & 1 ) ? XR_TRUE : XR_FALSE;
+	state->changedSinceLastSync = ( flags & 2 ) ? XR_TRUE : XR_FALSE;
+	state->lastChangeTime = lastChangeTime;
+	state->currentState = Dequantize( value, k_unitScale );
+	return true;
+}
+
+
+void InputTrace::RecordVector2Action( uint32_t channel, XrResult result, const XrActionStateVector2f& state )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	PutVarint( c, ActionFlags( state.isActive, state.changedSinceLastSync, XR_FALSE ) );
+	PutDelta( c, 0, state.lastChangeTime );
+	PutDelta( c, 1, Quantize( state.currentState.x, k_unitScale ) );
+	PutDelta( c, 2, Quantize( state.currentState.y, k_unitScale ) );
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayVector2Action( uint32_t channel, XrResult* result, XrActionStateVector2f* state )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res, lastChangeTime, x, y;
+	uint64_t flags;
+	if ( !GetSigned( *c, &res ) || !GetVarint( *c, &flags ) || !GetDelta( *c, 0, &lastChangeTime )
+		|| !GetDelta( *c, 1, &x ) || !GetDelta( *c, 2, &y ) )
+		return false;
+
+	*result = (XrResult)res;
+	state->isActive = ( flags & 1 ) ? XR_TRUE : XR_FALSE;
+	state->changedSinceLastSync = ( flags & 2 ) ? XR_TRUE : XR_FALSE;
+	state->lastChangeTime = lastChangeTime;
+	state->currentState = { Dequantize( x, k_unitScale ), Dequantize( y, k_unitScale ) };
+	return true;
+}
+
+
+void InputTrace::RecordSpaceLocation( uint32_t channel, XrResult result, const XrSpaceLocation& location )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	if ( XR_SUCCEEDED( result ) )
+	{
+		PutVarint( c, location.locationFlags );
+		PutPose( c, 0, location.pose );
+	}
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplaySpaceLocation( uint32_t channel, XrResult* result, XrSpaceLocation* location )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res;
+	if ( !GetSigned( *c, &res ) )
+		return false;
+	*result = (XrResult)res;
+	if ( XR_FAILED( *result ) )
+		return true;
+
+	uint64_t flags;
+	if ( !GetVarint( *c, &flags ) || !GetPose( *c, 0, &location->pose ) )
+		return false;
+	location->locationFlags = flags;
+	return true;
+}
+
+
+void InputTrace::RecordHandJoints( uint32_t channel, XrResult result, const XrHandJointLocationsEXT& locations )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutSigned( c, result );
+	if ( XR_SUCCEEDED( result ) )
+	{
+		PutVarint( c, locations.isActive ? 1 : 0 );
+		if ( locations.isActive )
+		{
+			for ( uint32_t joint = 0; joint < XR_HAND_JOINT_COUNT_EXT; joint++ )
+			{
+				const XrHandJointLocationEXT& location = locations.jointLocations[ joint ];
+				uint32_t slot = joint * 8;
+				PutVarint( c, location.locationFlags );
+				PutPose( c, slot, location.pose );
+				PutDelta( c, slot + 7, Quantize( location.radius, k_angleScale ) );
+			}
+		}
+	}
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayHandJoints( uint32_t channel, XrResult* result, XrHandJointLocationsEXT* locations )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	int64_t res;
+	if ( !GetSigned( *c, &res ) )
+		return false;
+	*result = (XrResult)res;
+	if ( XR_FAILED( *result ) )
+		return true;
+
+	uint64_t isActive;
+	if ( !GetVarint( *c, &isActive ) )
+		return false;
+	locations->isActive = isActive ? XR_TRUE : XR_FALSE;
+	if ( !isActive )
+		return true;
+
+	for ( uint32_t joint = 0; joint < XR_HAND_JOINT_COUNT_EXT; joint++ )
+	{
+		XrHandJointLocationEXT& location = locations->jointLocations[ joint ];
+		uint32_t slot = joint * 8;
+		uint64_t flags;
+		int64_t radius;
+		if ( !GetVarint( *c, &flags ) || !GetPose( *c, slot, &location.pose ) || !GetDelta( *c, slot + 7, &radius ) )
+			return false;
+
+		location.locationFlags = flags;
+		location.radius = Dequantize( radius, k_angleScale );
+	}
+	return true;
+}
+
+
+void InputTrace::RecordViewConfiguration( uint32_t channel, uint32_t viewCount, const XrViewConfigurationView* views )
+{
+	if ( !m_file || channel == k_invalidChannel )
+		return;
+
+	Channel& c = BeginRecord( channel );
+	PutVarint( c, viewCount );
+	for ( uint32_t i = 0; i < viewCount; i++ )
+	{
+		PutVarint( c, views[ i ].recommendedImageRectWidth );
+		PutVarint( c, views[ i ].recommendedImageRectHeight );
+		PutVarint( c, views[ i ].recommendedSwapchainSampleCount );
+	}
+	EndRecord( c );
+}
+
+
+bool InputTrace::ReplayViewConfiguration( uint32_t channel, uint32_t viewCapacity, uint32_t* viewCount, XrViewConfigurationView* views )
+{
+	Channel* c = BeginReplay( channel );
+	if ( !c )
+		return false;
+
+	uint64_t count;
+	if ( !GetVarint( *c, &count ) )
+		return false;
+
+	*viewCount = (uint32_t)count;
+	for ( uint64_t i = 0; i < count; i++ )
+	{
+		uint64_t width, height, samples;
+		if ( !GetVarint( *c, &width ) || !GetVarint( *c, &height ) || !GetVarint( *c, &samples ) )
+			return false;
+		if ( i >= viewCapacity )
+			continue;
+
+		views[ i ].recommendedImageRectWidth = (uint32_t)width;
+		views[ i ].recommendedImageRectHeight = (uint32_t)height;
+		views[ i ].recommendedSwapchainSampleCount = (uint32_t)samples;
+	}
+	return true;
+}
@@ -0,0 +1,205 @@
+#include "job_system.h"
+#include "profile_zones.h"
+
+using namespace XRDE;
+
+// Which job system the current thread is a worker of, and its queue in that system
+static thread_local const JobSystem* t_jobSystem = nullptr;
+static thread_local uint32_t t_threadIndex = 0;
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+
+void JobSystem::Init( uint32_t workerCount )
+{
+	Shutdown();
+
+	m_shutdown = false;
+	m_startTime = std::chrono::high_resolution_clock::now();
+
+	// queue 0 is for the threads outside the job system
+	for ( uint32_t i = 0; i < workerCount + 1; i++ )
+	{
+		m_queues.push_back( std::make_unique<ThreadQueue>() );
+	}
+
+	for ( uint32_t i = 1; i < workerCount + 1; i++ )
+	{
+		m_workers.emplace_back( &JobSystem::WorkerThread, this, i );
+	}
+}
+
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_shutdown = true;
+	}
+	m_wake.notify_all();
+
+	for ( std::thread& worker : m_workers )
+	{
+		worker.join();
+	}
+	m_workers.clear();
+	m_queues.clear();
+	m_queuedJobs = 0;
+}
+
+
+double JobSystem::Now() const
+{
+	return std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - m_startTime ).count();
+}
+
+
+uint32_t JobSystem::CurrentThreadIndex() const
+{
+	return t_jobSystem == this ? t_threadIndex : 0;
+}
+
+
+void JobSystem::Run( const char* name, JobFunction function, JobCounter* counter )
+{
+	if ( counter )
+	{
+		counter->m_count.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	Job job = { name, std::move( function ), counter };
+	if ( m_workers.empty() )
+	{
+		Execute( 0, job );
+		return;
+	}
+
+	ThreadQueue& queue = *m_queues[ CurrentThreadIndex() ];
+	{
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		queue.jobs.push_back( std::move( job ) );
+	}
+
+	{
+		// taking the lock keeps a worker from missing the wakeup between checking and going to sleep
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_queuedJobs.fetch_add( 1 );
+	}
+	m_wake.notify_one();
+}
+
+
+bool JobSystem::PopOrSteal( uint32_t threadIndex, Job* job )
+{
+	// newest job from our own queue first, it's most likely to have warm caches
+	{
+		ThreadQueue& queue = *m_queues[ threadIndex ];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if ( !queue.jobs.empty() )
+		{
+			*job = std::move( queue.jobs.back() );
+			queue.jobs.pop_back();
+			m_queuedJobs.fetch_sub( 1 );
+			return true;
+		}
+	}
+
+	// then the oldest job from everybody else
+	uint32_t queueCount = (uint32_t)m_queues.size();
+	for ( uint32_t offset = 1; offset < queueCount; offset++ )
+	{
+		ThreadQueue& victim = *m_queues[ ( threadIndex + offset ) % queueCount ];
+		std::lock_guard<std::mutex> lock( victim.mutex );
+		if ( !victim.jobs.empty() )
+		{
+			*job = std::move( victim.jobs.front() );
+			victim.jobs.pop_front();
+			m_queuedJobs.fetch_sub( 1 );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void JobSystem::Execute( uint32_t threadIndex, Job& job )
+{
+	double start = Now();
+	{
+		XRDE_PROFILE_ZONE( job.name );
+		job.function();
+	}
+	double end = Now();
+
+	if ( !m_queues.empty() )
+	{
+		ThreadQueue& queue = *m_queues[ threadIndex ];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		queue.timings.push_back( { job.name, threadIndex, start, end } );
+	}
+
+	// the timing has to be recorded before the counter lets the waiter move on
+	if ( job.counter )
+	{
+		job.counter->m_count.fetch_sub( 1, std::memory_order_release );
+	}
+}
+
+
+void JobSystem::Wait( JobCounter& counter )
+{
+	uint32_t threadIndex = CurrentThreadIndex();
+	while ( !counter.IsDone() )
+	{
+		Job job;
+		if ( !m_queues.empty() && PopOrSteal( threadIndex, &job ) )
+		{
+			Execute( threadIndex, job );
+		}
+		else
+		{
+			// whatever we're waiting on is running on another thread
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+void JobSystem::WorkerThread( uint32_t threadIndex )
+{
+	t_jobSystem = this;
+	t_threadIndex = threadIndex;
+	XRDE_PROFILE_THREAD_NAME( "Job worker" );
+
+	while ( true )
+	{
+		Job job;
+		if ( PopOrSteal( threadIndex, &job ) )
+		{
+			Execute( threadIndex, job );
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( m_sleepMutex );
+		m_wake.wait( lock, [ this ] { return m_shutdown || m_queuedJobs.load() > 0; } );
+		if ( m_shutdown )
+			return;
+	}
+}
+
+
+std::vector<JobTiming> JobSystem::CollectTimings()
+{
+	std::vector<JobTiming> timings;
+	for ( auto& queue : m_queues )
+	{
+		std::lock_guard<std::mutex> lock( queue->mutex );
+		timings.insert( timings.end(), queue->timings.begin(), queue->timings.end() );
+		queue->timings.clear();
+	}
+	return timings;
+}
@@ -0,0 +1,254 @@
+#include "latency_tracker.h"
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <Windows.h>
+#	define XR_USE_PLATFORM_WIN32
+#else
+#	include <time.h>
+#	define XR_USE_TIMESPEC
+#endif
+#include <openxr/openxr_platform.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace XRDE;
+
+static LatencyTracker* s_activeLatencyTracker = nullptr;
+
+void XRDE::SetActiveLatencyTracker( LatencyTracker* tracker )
+{
+	s_activeLatencyTracker = tracker;
+}
+
+LatencyTracker* XRDE::ActiveLatencyTracker()
+{
+	return s_activeLatencyTracker;
+}
+
+
+const char* XrClock::GetExtensionName()
+{
+#ifdef _WIN32
+	return XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME;
+#else
+	return XR_KHR_CONVERT_TIMESPEC_TIME_EXTENSION_NAME;
+#endif
+}
+
+
+bool XrClock::Init( XrInstance instance )
+{
+	m_instance = instance;
+	m_convert = nullptr;
+#ifdef _WIN32
+	const char* convertName = "xrConvertWin32PerformanceCounterToTimeKHR";
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency( &frequency );
+	m_nanosecondsPerTick = 1e9 / (double)frequency.QuadPart;
+#else
+	const char* convertName = "xrConvertTimespecTimeToTimeKHR";
+	m_nanosecondsPerTick = 1.0;
+#endif
+	if ( XR_FAILED( xrGetInstanceProcAddr( instance, convertName, &m_convert ) ) )
+	{
+		m_convert = nullptr;
+		return false;
+	}
+	return Calibrate();
+}
+
+
+int64_t XrClock::Now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return counter.QuadPart;
+#else
+	timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+
+bool XrClock::Calibrate()
+{
+	if ( !m_convert )
+		return false;
+
+	int64_t appTime = Now();
+	XrTime xrTime;
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	counter.QuadPart = appTime;
+	XrResult res = ( (PFN_xrConvertWin32PerformanceCounterToTimeKHR)m_convert )( m_instance, &counter, &xrTime );
+#else
+	timespec time;
+	time.tv_sec = (time_t)( appTime / 1000000000 );
+	time.tv_nsec = (long)( appTime % 1000000000 );
+	XrResult res = ( (PFN_xrConvertTimespecTimeToTimeKHR)m_convert )( m_instance, &time, &xrTime );
+#endif
+	if ( XR_FAILED( res ) )
+		return false;
+
+	m_calibrationAppTime = appTime;
+	m_calibrationXrTime = xrTime;
+	return true;
+}
+
+
+XrTime XrClock::ToXrTime( int64_t appTime ) const
+{
+	return m_calibrationXrTime + (XrTime)( (double)( appTime - m_calibrationAppTime ) * m_nanosecondsPerTick );
+}
+
+
+void LatencyHistogram::Record( double seconds )
+{
+	int64_t bucket = ( (int64_t)floor( seconds * 1e6 ) - k_lowestMicroseconds ) / k_bucketMicroseconds;
+	m_buckets[ std::min<int64_t>( std::max<int64_t>( bucket, 0 ), k_bucketCount - 1 ) ]++;
+	m_max = m_count == 0 ? seconds : std::max( m_max, seconds );
+	m_count++;
+}
+
+
+double LatencyHistogram::Percentile( double fraction ) const
+{
+	uint64_t target = (uint64_t)( fraction * (double)( m_count - 1 ) );
+	uint64_t seen = 0;
+	for ( uint32_t bucket = 0; bucket < k_bucketCount; bucket++ )
+	{
+		seen += m_buckets[ bucket ];
+		if ( seen > target )
+		{
+			double middle = ( k_lowestMicroseconds + ( bucket + 0.5 ) * k_bucketMicroseconds ) * 1e-6;
+			return std::min( middle, m_max );
+		}
+	}
+	return m_max;
+}
+
+
+bool LatencyTracker::Init( XrInstance instance )
+{
+	return m_clock.Init( instance );
+}
+
+
+void LatencyTracker::PoseSampled( XrTime displayTime )
+{
+	if ( !IsEnabled() )
+		return;
+
+	int64_t now = XrClock::Now();
+	std::lock_guard<std::mutex> lock( m_mutex );
+	PendingFrame& frame = m_pendingFrames[ displayTime ];
+	frame.firstPose = std::min( frame.firstPose, now );
+}
+
+
+void LatencyTracker::ViewsSampled( XrTime displayTime )
+{
+	if ( !IsEnabled() )
+		return;
+
+	int64_t now = XrClock::Now();
+	std::lock_guard<std::mutex> lock( m_mutex );
+	PendingFrame& frame = m_pendingFrames[ displayTime ];
+	frame.views = now;
+	frame.firstPose = std::min( frame.firstPose, now );
+}
+
+
+void LatencyTracker::RecordStarted( XrTime displayTime )
+{
+	if ( !IsEnabled() )
+		return;
+
+	int64_t now = XrClock::Now();
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_pendingFrames[ displayTime ].recordStart = now;
+}
+
+
+void LatencyTracker::FrameEnded( XrTime displayTime )
+{
+	if ( !IsEnabled() )
+		return;
+
+	int64_t now = XrClock::Now();
+	PendingFrame frame;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		auto i = m_pendingFrames.find( displayTime );
+		if ( i != m_pendingFrames.end() )
+		{
+			frame = i->second;
+		}
+
+		// anything older belongs to frames that were never submitted, later ones are the simulation working ahead
+		m_pendingFrames.erase( m_pendingFrames.begin(), m_pendingFrames.upper_bound( displayTime ) );
+	}
+
+	// once a frame keeps the conversion from drifting, and it's one call into the runtime
+	m_clock.Calibrate();
+
+	m_lastFrame = FrameLatency();
+	m_lastFrame.displayTime = displayTime;
+	m_lastFrame.endFrameToDisplay = LatencySeconds( displayTime, now );
+	m_endFrameToDisplay.Record( m_lastFrame.endFrameToDisplay );
+	if ( frame.firstPose != INT64_MAX )
+	{
+		m_lastFrame.poseToDisplay = LatencySeconds( displayTime, frame.firstPose );
+		m_poseToDisplay.Record( m_lastFrame.poseToDisplay );
+	}
+	if ( frame.views )
+	{
+		m_lastFrame.viewsToDisplay = LatencySeconds( displayTime, frame.views );
+		m_viewsToDisplay.Record( m_lastFrame.viewsToDisplay );
+	}
+	if ( frame.recordStart )
+	{
+		m_lastFrame.recordToDisplay = LatencySeconds( displayTime, frame.recordStart );
+		m_recordToDisplay.Record( m_lastFrame.recordToDisplay );
+	}
+}
+
+
+double LatencyTracker::LatencySeconds( XrTime displayTime, int64_t appTime ) const
+{
+	return (double)( displayTime - m_clock.ToXrTime( appTime ) ) * 1e-9;
+}
+
+
+void LatencyTracker::PrintSummary( std::ostream& out ) const
+{
+	if ( m_endFrameToDisplay.GetCount() == 0 )
+		return;
+
+	out << "Latency to predicted display over " << m_endFrameToDisplay.GetCount() << " frames (ms)\n";
+	out << std::fixed << std::setprecision( 2 );
+	out << "  " << std::setw( 14 ) << std::left << "from" << std::right << std::setw( 8 ) << "p50" << std::setw( 8 ) << "p90"
+		<< std::setw( 8 ) << "p99" << std::setw( 8 ) << "max" << "\n";
+
+	auto printRow = [ &out ]( const char* name, const LatencyHistogram& samples )
+	{
+		if ( samples.GetCount() == 0 )
+			return;
+
+		out << "  " << std::setw( 14 ) << std::left << name << std::right << std::setw( 8 ) << samples.Percentile( 0.5 ) * 1000.0
+			<< std::setw( 8 ) << samples.Percentile( 0.9 ) * 1000.0 << std::setw( 8 ) << samples.Percentile( 0.99 ) * 1000.0
+			<< std::setw( 8 ) << samples.GetMax() * 1000.0 << "\n";
+	};
+	printRow( "pose sample", m_poseToDisplay );
+	printRow( "views sample", m_viewsToDisplay );
+	printRow( "record start", m_recordToDisplay );
+	printRow( "xrEndFrame", m_endFrameToDisplay );
+	out << std::defaultfloat;
+}
@@ -0,0 +1,347 @@
+#include "lod_selector.h"
+#include "profile_zones.h"
+
+#include "graphics_utilities.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <string>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// a level's triangles, as equilateral triangles covering a sphere of radius r, have edges of r * sqrt( k / count )
+static const float k_sphereEdgeFactor = 16.f * PI_F / sqrtf( 3.f );
+
+// levels are stored as bytes per instance
+static const size_t k_maxLevels = 256;
+
+// "<base>_LOD<n>" or "LOD<n>"
+static bool ParseLodName( const std::string& name, std::string* base, uint32_t* level )
+{
+	size_t lastLetter = name.find_last_not_of( "0123456789" );
+	if ( lastLetter == std::string::npos || lastLetter < 2 || lastLetter + 1 == name.size() || name.size() - lastLetter > 4 )
+		return false;
+
+	size_t lod = lastLetter - 2;
+	if ( toupper( name[ lod ] ) != 'L' || toupper( name[ lod + 1 ] ) != 'O' || toupper( name[ lod + 2 ] ) != 'D' )
+		return false;
+	if ( lod > 0 && name[ lod - 1 ] != '_' )
+		return false;
+
+	*base = name.substr( 0, lod > 0 ? lod - 1 : 0 );
+	*level = (uint32_t)std::stoul( name.substr( lastLetter + 1 ) );
+	return true;
+}
+
+
+// every level is drawn with the finest level's node
+static bool CanShareNode( const std::vector< std::pair<uint32_t, GLTF::Node*> >& levels )
+{
+	const GLTF::Node* finest = levels[ 0 ].second;
+	float4x4 finestMatrix = finest->LocalMatrix();
+	for ( size_t i = 1; i < levels.size(); i++ )
+	{
+		const GLTF::Node* node = levels[ i ].second;
+		if ( node->SkinIndex != finest->SkinIndex )
+			return false;
+
+		float4x4 matrix = node->LocalMatrix();
+		for ( int r = 0; r < 4; r++ )
+		{
+			for ( int c = 0; c < 4; c++ )
+			{
+				if ( fabsf( matrix[ r ][ c ] - finestMatrix[ r ][ c ] ) > 1e-4f )
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+static float MaxScale( const float4x4& m )
+{
+	float scale = 0;
+	for ( int r = 0; r < 3; r++ )
+	{
+		scale = std::max( scale, length( float3( m[ r ][ 0 ], m[ r ][ 1 ], m[ r ][ 2 ] ) ) );
+	}
+	return scale;
+}
+
+
+uint32_t LodSelector::CountTriangles( const GLTF::Mesh& mesh )
+{
+	uint32_t triangles = 0;
+	for ( const auto& primitive : mesh.Primitives )
+	{
+		triangles += ( primitive->IndexCount > 0 ? primitive->IndexCount : primitive->VertexCount ) / 3;
+	}
+	return triangles;
+}
+
+
+void LodSelector::AddModel( GLTF::Model* model )
+{
+	if ( !model || GetChainCount( model ) > 0 )
+		return;
+
+	std::map< std::pair<const GLTF::Node*, std::string>, std::vector< std::pair<uint32_t, GLTF::Node*> > > groups;
+	uint32_t totalTriangles = 0;
+	for ( GLTF::Node* node : model->LinearNodes )
+	{
+		if ( !node->Mesh )
+			continue;
+
+		totalTriangles += CountTriangles( *node->Mesh );
+		std::string base;
+		uint32_t level;
+		if ( ParseLodName( node->Name, &base, &level ) )
+		{
+			groups[ { node->Parent, base } ].push_back( { level, node } );
+		}
+	}
+
+	std::unique_ptr<LodModel> lodModel = std::make_unique<LodModel>();
+	lodModel->model = model;
+	uint32_t chainedTriangles = 0;
+	for ( auto& group : groups )
+	{
+		auto& nodes = group.second;
+		if ( nodes.size() < 2 || nodes.size() > k_maxLevels )
+			continue;
+
+		std::sort( nodes.begin(), nodes.end(),
+			[]( const std::pair<uint32_t, GLTF::Node*>& a, const std::pair<uint32_t, GLTF::Node*>& b ) { return a.first < b.first; } );
+		if ( !CanShareNode( nodes ) )
+			continue;
+
+		GLTF::Mesh* mesh = nodes[ 0 ].second->Mesh.get();
+		float3 extent = mesh->BB.Max - mesh->BB.Min;
+		if ( extent.x < 0 || extent.y < 0 || extent.z < 0 || length( extent ) <= 0 )
+			continue;
+
+		Chain chain;
+		chain.mesh = mesh;
+		chain.boundsCenter = ( mesh->BB.Min + mesh->BB.Max ) * 0.5f;
+		chain.boundsRadius = length( extent ) * 0.5f;
+		for ( size_t i = 0; i < nodes.size(); i++ )
+		{
+			GLTF::Node* node = nodes[ i ].second;
+			Level level;
+			level.node = node;
+			level.triangleCount = CountTriangles( *node->Mesh );
+			level.error = 0;
+			if ( i > 0 )
+			{
+				float edge = chain.boundsRadius * sqrtf( k_sphereEdgeFactor / (float)std::max( level.triangleCount, 1u ) );
+				level.error = std::max( chain.levels.back().error, edge );
+				level.primitives = std::move( node->Mesh->Primitives );
+				node->Mesh->Primitives.clear();
+			}
+			chainedTriangles += level.triangleCount;
+			chain.levels.push_back( std::move( level ) );
+		}
+		lodModel->chains.push_back( std::move( chain ) );
+	}
+
+	// models without chains are kept too, so their instances still count in the stats
+	lodModel->fixedTriangleCount = totalTriangles - chainedTriangles;
+	m_models.push_back( std::move( lodModel ) );
+}
+
+
+void LodSelector::RemoveModel( const GLTF::Model* model )
+{
+	auto found = std::find_if( m_models.begin(), m_models.end(),
+		[ model ]( const std::unique_ptr<LodModel>& lodModel ) { return lodModel->model == model; } );
+	if ( found == m_models.end() )
+		return;
+
+	for ( Chain& chain : ( *found )->chains )
+	{
+		Install( chain, 0 );
+		for ( size_t i = 1; i < chain.levels.size(); i++ )
+		{
+			chain.levels[ i ].node->Mesh->Primitives = std::move( chain.levels[ i ].primitives );
+		}
+	}
+	for ( Instance& instance : m_instances )
+	{
+		if ( instance.model == found->get() )
+		{
+			instance = Instance();
+		}
+	}
+	m_models.erase( found );
+}
+
+
+uint32_t LodSelector::GetChainCount( const GLTF::Model* model ) const
+{
+	for ( const std::unique_ptr<LodModel>& lodModel : m_models )
+	{
+		if ( lodModel->model == model )
+			return (uint32_t)lodModel->chains.size();
+	}
+	return 0;
+}
+
+
+void LodSelector::SetLevelError( const GLTF::Node* node, uint32_t level, float meters )
+{
+	for ( std::unique_ptr<LodModel>& lodModel : m_models )
+	{
+		for ( Chain& chain : lodModel->chains )
+		{
+			if ( chain.levels[ 0 ].node == node && level > 0 && level < chain.levels.size() )
+			{
+				chain.levels[ level ].error = std::max( meters, 0.f );
+				return;
+			}
+		}
+	}
+}
+
+
+uint32_t LodSelector::AddInstance( const GLTF::Model* model, const float4x4& transform )
+{
+	auto found = std::find_if( m_models.begin(), m_models.end(),
+		[ model ]( const std::unique_ptr<LodModel>& lodModel ) { return lodModel->model == model; } );
+	if ( found == m_models.end() )
+		return k_invalidHandle;
+
+	uint32_t handle = 0;
+	while ( handle < (uint32_t)m_instances.size() && m_instances[ handle ].active )
+	{
+		handle++;
+	}
+	if ( handle == (uint32_t)m_instances.size() )
+	{
+		m_instances.emplace_back();
+	}
+
+	Instance& instance = m_instances[ handle ];
+	instance.model = found->get();
+	instance.transform = transform;
+	instance.levels.assign( instance.model->chains.size(), 0 );
+	instance.active = true;
+	return handle;
+}
+
+
+void LodSelector::RemoveInstance( uint32_t instance )
+{
+	if ( instance < m_instances.size() )
+	{
+		m_instances[ instance ] = Instance();
+	}
+}
+
+
+void LodSelector::SetTransform( uint32_t instance, const float4x4& transform )
+{
+	if ( instance < m_instances.size() && m_instances[ instance ].active )
+	{
+		m_instances[ instance ].transform = transform;
+	}
+}
+
+
+void LodSelector::Update( const XrView views[ 2 ], uint32_t eyeWidth, uint32_t eyeHeight )
+{
+	XRDE_PROFILE_FUNCTION();
+	// keeps the per level vector's capacity
+	std::vector<uint64_t> levelTriangleCounts = std::move( m_lastStats.levelTriangleCounts );
+	levelTriangleCounts.clear();
+	m_lastStats = LodStats();
+	m_lastStats.levelTriangleCounts = std::move( levelTriangleCounts );
+	for ( const std::unique_ptr<LodModel>& lodModel : m_models )
+	{
+		m_lastStats.chainCount += (uint32_t)lodModel->chains.size();
+	}
+
+	// the sharper eye decides, from the point between them, so both get the same levels
+	float3 viewer = ( vectorFromXrVector( views[ 0 ].pose.position ) + vectorFromXrVector( views[ 1 ].pose.position ) ) * 0.5f;
+	float pixelsPerMeter = 0;
+	for ( int eye = 0; eye < 2; eye++ )
+	{
+		const XrFovf& fov = views[ eye ].fov;
+		pixelsPerMeter = std::max( pixelsPerMeter, (float)eyeWidth / std::max( tanf( fov.angleRight ) - tanf( fov.angleLeft ), 1e-3f ) );
+		pixelsPerMeter = std::max( pixelsPerMeter, (float)eyeHeight / std::max( tanf( fov.angleUp ) - tanf( fov.angleDown ), 1e-3f ) );
+	}
+	// the error allowed one meter away
+	float allowedPerMeter = m_settings.maxPixelError / std::max( pixelsPerMeter, 1.f );
+
+	for ( Instance& instance : m_instances )
+	{
+		if ( !instance.active )
+			continue;
+
+		m_lastStats.instanceCount++;
+		m_lastStats.fullTriangleCount += instance.model->fixedTriangleCount;
+		m_lastStats.selectedTriangleCount += instance.model->fixedTriangleCount;
+		for ( size_t c = 0; c < instance.model->chains.size(); c++ )
+		{
+			const Chain& chain = instance.model->chains[ c ];
+			float4x4 meshToStage = chain.mesh->Transforms.matrix * instance.transform;
+			float4 center = float4( chain.boundsCenter, 1.f ) * meshToStage;
+			float scale = MaxScale( meshToStage );
+			float distance = length( float3( center.x, center.y, center.z ) - viewer ) - chain.boundsRadius * scale;
+
+			// in mesh space, and nothing at all from inside the bounds
+			float allowed = distance > 0 && scale > 0 ? allowedPerMeter * distance / scale : 0;
+			uint32_t level = instance.levels[ c ];
+			while ( level > 0 && chain.levels[ level ].error > allowed )
+			{
+				level--;
+			}
+			float coarserAllowed = allowed * ( 1.f - m_settings.hysteresis );
+			while ( level + 1 < chain.levels.size() && chain.levels[ level + 1 ].error <= coarserAllowed )
+			{
+				level++;
+			}
+
+			if ( level != instance.levels[ c ] )
+			{
+				instance.levels[ c ] = (uint8_t)level;
+				m_lastStats.switchCount++;
+			}
+			m_lastStats.fullTriangleCount += chain.levels[ 0 ].triangleCount;
+			m_lastStats.selectedTriangleCount += chain.levels[ level ].triangleCount;
+			if ( m_lastStats.levelTriangleCounts.size() <= level )
+			{
+				m_lastStats.levelTriangleCounts.resize( level + 1, 0 );
+			}
+			m_lastStats.levelTriangleCounts[ level ] += chain.levels[ level ].triangleCount;
+		}
+	}
+}
+
+
+void LodSelector::Install( Chain& chain, uint32_t level )
+{
+	if ( chain.installed == level )
+		return;
+
+	// the installed level's primitives go back to its slot, and the chosen level's come out of theirs
+	std::swap( chain.mesh->Primitives, chain.levels[ chain.installed ].primitives );
+	std::swap( chain.mesh->Primitives, chain.levels[ level ].primitives );
+	chain.installed = level;
+}
+
+
+void LodSelector::Apply( uint32_t instance )
+{
+	if ( instance >= m_instances.size() || !m_instances[ instance ].active )
+		return;
+
+	Instance& applied = m_instances[ instance ];
+	for ( size_t c = 0; c < applied.model->chains.size(); c++ )
+	{
+		Install( applied.model->chains[ c ], applied.levels[ c ] );
+	}
+}
@@ -0,0 +1,199 @@
+#include "memory_budget.h"
+
+#include <GraphicsAccessories.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+
+using namespace XRDE;
+using namespace Diligent;
+
+const char* XRDE::MemoryCategoryName( MemoryCategory category )
+{
+	switch ( category )
+	{
+	case MemoryCategory::SwapchainColor: return "Swapchain color";
+	case MemoryCategory::SwapchainDepth: return "Swapchain depth";
+	case MemoryCategory::GltfBuffers: return "glTF buffers";
+	case MemoryCategory::TextureAtlas: return "Texture atlas";
+	case MemoryCategory::EnvironmentMaps: return "Environment maps";
+	case MemoryCategory::ConstantBuffers: return "Constant buffers";
+	case MemoryCategory::AppBuffers: return "App buffers";
+	case MemoryCategory::AppTextures: return "App textures";
+	case MemoryCategory::Other: return "Other";
+	default: return "Unknown";
+	}
+}
+
+static const char* MemoryLocationName( MemoryLocation location )
+{
+	return location == MemoryLocation::Gpu ? "GPU" : "CPU";
+}
+
+
+void MemoryBudget::Init( IRenderDevice* device )
+{
+	if ( !device )
+		return;
+
+	const GraphicsAdapterInfo& adapterInfo = device->GetAdapterInfo();
+	m_adapterMemory.localBytes = adapterInfo.Memory.LocalMemory;
+	m_adapterMemory.hostVisibleBytes = adapterInfo.Memory.HostVisibleMemory;
+	m_adapterMemory.unifiedBytes = adapterInfo.Memory.UnifiedMemory;
+}
+
+
+uint64_t MemoryBudget::TextureSize( const TextureDesc& desc )
+{
+	uint64_t bytes = 0;
+	for ( Uint32 mip = 0; mip < desc.MipLevels; mip++ )
+	{
+		// MipSize already includes the depth of 3D textures
+		bytes += GetMipLevelProperties( desc, mip ).MipSize;
+	}
+
+	if ( desc.Type != RESOURCE_DIM_TEX_3D )
+		bytes *= desc.ArraySize;
+
+	return bytes * std::max( 1u, desc.SampleCount );
+}
+
+
+void MemoryBudget::Register( const void* key, const std::string& name, MemoryCategory category, uint64_t bytes,
+	MemoryLocation location )
+{
+	if ( !key )
+		return;
+
+	Unregister( key );
+
+	m_entries[ key ] = { name, category, location, bytes };
+	MemoryCategoryTotals& totals = m_totals[ (uint32_t)location ][ (uint32_t)category ];
+	totals.bytes += bytes;
+	totals.resourceCount++;
+	m_total[ (uint32_t)location ] += bytes;
+
+	CheckBudget( location );
+}
+
+
+void MemoryBudget::RegisterTexture( ITexture* texture, MemoryCategory category )
+{
+	if ( !texture )
+		return;
+
+	const TextureDesc& desc = texture->GetDesc();
+	Register( texture, desc.Name ? desc.Name : "", category, TextureSize( desc ),
+		desc.Usage == USAGE_STAGING ? MemoryLocation::Cpu : MemoryLocation::Gpu );
+}
+
+
+void MemoryBudget::RegisterBuffer( IBuffer* buffer, MemoryCategory category )
+{
+	if ( !buffer )
+		return;
+
+	const BufferDesc& desc = buffer->GetDesc();
+	Register( buffer, desc.Name ? desc.Name : "", category, desc.uiSizeInBytes,
+		desc.Usage == USAGE_STAGING ? MemoryLocation::Cpu : MemoryLocation::Gpu );
+}
+
+
+void MemoryBudget::Unregister( const void* key )
+{
+	auto i = m_entries.find( key );
+	if ( i == m_entries.end() )
+		return;
+
+	const Entry& entry = i->second;
+	MemoryCategoryTotals& totals = m_totals[ (uint32_t)entry.location ][ (uint32_t)entry.category ];
+	totals.bytes -= entry.bytes;
+	totals.resourceCount--;
+	m_total[ (uint32_t)entry.location ] -= entry.bytes;
+	MemoryLocation location = entry.location;
+	m_entries.erase( i );
+
+	CheckBudget( location );
+}
+
+
+void MemoryBudget::UnregisterCategory( MemoryCategory category )
+{
+	for ( auto i = m_entries.begin(); i != m_entries.end(); )
+	{
+		auto next = std::next( i );
+		if ( i->second.category == category )
+		{
+			Unregister( i->first );
+		}
+		i = next;
+	}
+}
+
+
+void MemoryBudget::SetBudget( MemoryLocation location, uint64_t bytes )
+{
+	m_budget[ (uint32_t)location ] = bytes;
+	m_overBudget[ (uint32_t)location ] = false;
+	CheckBudget( location );
+}
+
+
+void MemoryBudget::CheckBudget( MemoryLocation location )
+{
+	uint32_t index = (uint32_t)location;
+	uint64_t budget = m_budget[ index ];
+	bool overBudget = budget != 0 && m_total[ index ] > budget;
+	if ( overBudget && !m_overBudget[ index ] )
+	{
+		std::cerr << MemoryLocationName( location ) << " memory over budget: " << m_total[ index ] << " bytes used, "
+			<< budget << " bytes budgeted\n" << FormatReport();
+
+		if ( m_overBudgetCallback )
+		{
+			m_overBudgetCallback( location, m_total[ index ], budget );
+		}
+	}
+	m_overBudget[ index ] = overBudget;
+}
+
+
+MemoryCategoryTotals MemoryBudget::GetCategoryTotals( MemoryCategory category, MemoryLocation location ) const
+{
+	return m_totals[ (uint32_t)location ][ (uint32_t)category ];
+}
+
+
+std::string MemoryBudget::FormatReport() const
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision( 2 );
+	for ( uint32_t location = 0; location < (uint32_t)MemoryLocation::Count; location++ )
+	{
+		out << MemoryLocationName( (MemoryLocation)location ) << ": " << m_total[ location ] / ( 1024.0 * 1024.0 ) << " MB";
+		if ( m_budget[ location ] )
+		{
+			out << " of " << m_budget[ location ] / ( 1024.0 * 1024.0 ) << " MB budget";
+		}
+		out << "\n";
+
+		for ( uint32_t category = 0; category < (uint32_t)MemoryCategory::Count; category++ )
+		{
+			const MemoryCategoryTotals& totals = m_totals[ location ][ category ];
+			if ( !totals.resourceCount )
+				continue;
+
+			out << "    " << MemoryCategoryName( (MemoryCategory)category ) << ": " << totals.bytes / ( 1024.0 * 1024.0 )
+				<< " MB in " << totals.resourceCount << " resources\n";
+		}
+	}
+
+	if ( m_adapterMemory.localBytes )
+	{
+		out << "Adapter local memory: " << m_adapterMemory.localBytes / ( 1024.0 * 1024.0 ) << " MB\n";
+	}
+	return out.str();
+}
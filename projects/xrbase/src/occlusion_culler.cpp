@@ -0,0 +1,389 @@
+#include "occlusion_culler.h"
+
+#include <GraphicsTypes.h>
+#include "graphics_utilities.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// vertices closer than this in clip space w are treated as crossing the near plane
+static const float k_minClipW = 1e-5f;
+
+// bands smaller than this cost more to queue than to rasterize
+static const uint32_t k_minBandRows = 8;
+
+// occluders set up per job
+static const uint32_t k_occludersPerSetupJob = 64;
+
+void OcclusionCuller::Init( uint32_t width, uint32_t height )
+{
+	m_width = std::max( ( width + 3 ) & ~3u, 4u );
+	m_height = std::max( height, 1u );
+	m_depth.assign( m_width * m_height, 1.f );
+	m_ready = false;
+}
+
+
+uint32_t OcclusionCuller::AddOccluderMesh( const float3* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	bool twoSided )
+{
+	if ( !positions || !indices || indexCount % 3 != 0 )
+		return k_invalidHandle;
+
+	for ( uint32_t i = 0; i < indexCount; i++ )
+	{
+		if ( indices[ i ] >= vertexCount )
+			return k_invalidHandle;
+	}
+
+	OccluderMesh mesh;
+	mesh.positions.assign( positions, positions + vertexCount );
+	mesh.indices.assign( indices, indices + indexCount );
+	mesh.twoSided = twoSided;
+	m_meshes.push_back( std::move( mesh ) );
+	return (uint32_t)m_meshes.size() - 1;
+}
+
+
+void OcclusionCuller::ClearOccluders()
+{
+	m_occluders.clear();
+}
+
+
+void OcclusionCuller::SubmitOccluder( uint32_t mesh, const float4x4& objectToStage )
+{
+	if ( mesh >= m_meshes.size() )
+		return;
+
+	Occluder occluder;
+	occluder.mesh = mesh;
+	occluder.objectToStage = objectToStage;
+	m_occluders.push_back( occluder );
+}
+
+
+void OcclusionCuller::SetViews( const XrView views[ 2 ], float nearClip, float farClip )
+{
+	// the combined view looks where the left eye looks, from between the eyes
+	XrPosef pose = views[ 0 ].pose;
+	pose.position.x = ( views[ 0 ].pose.position.x + views[ 1 ].pose.position.x ) * 0.5f;
+	pose.position.y = ( views[ 0 ].pose.position.y + views[ 1 ].pose.position.y ) * 0.5f;
+	pose.position.z = ( views[ 0 ].pose.position.z + views[ 1 ].pose.position.z ) * 0.5f;
+	float4x4 combinedToStage = matrixFromPose( pose );
+	float4x4 stageToCombined = combinedToStage.Inverse();
+
+	// widen the field of view to take in the corners of both eye frusta, which also covers canted displays
+	float tanLeft = 0, tanRight = 0, tanUp = 0, tanDown = 0;
+	float3 eyePositions[ 2 ];
+	for ( int eye = 0; eye < 2; eye++ )
+	{
+		float4x4 eyeToCombined = matrixFromPose( views[ eye ].pose ) * stageToCombined;
+		eyePositions[ eye ] = float3( eyeToCombined.m30, eyeToCombined.m31, eyeToCombined.m32 );
+
+		const XrFovf& fov = views[ eye ].fov;
+		float tanX[ 2 ] = { tanf( fov.angleLeft ), tanf( fov.angleRight ) };
+		float tanY[ 2 ] = { tanf( fov.angleDown ), tanf( fov.angleUp ) };
+		for ( int corner = 0; corner < 4; corner++ )
+		{
+			float4 direction = float4( tanX[ corner & 1 ], tanY[ corner >> 1 ], -1.f, 0.f ) * eyeToCombined;
+			float forward = std::max( -direction.z, 1e-3f );
+			tanLeft = std::min( tanLeft, direction.x / forward );
+			tanRight = std::max( tanRight, direction.x / forward );
+			tanDown = std::min( tanDown, direction.y / forward );
+			tanUp = std::max( tanUp, direction.y / forward );
+		}
+	}
+
+	// Back off until both eyes are inside the widened frustum. It then contains both eye frusta, since they
+	// start inside it and point in directions it covers.
+	float back = std::max( eyePositions[ 0 ].z, eyePositions[ 1 ].z );
+	for ( const float3& p : eyePositions )
+	{
+		if ( p.x > 0 && tanRight > 0 )
+			back = std::max( back, p.z + p.x / tanRight );
+		if ( p.x < 0 && tanLeft < 0 )
+			back = std::max( back, p.z + p.x / tanLeft );
+		if ( p.y > 0 && tanUp > 0 )
+			back = std::max( back, p.z + p.y / tanUp );
+		if ( p.y < 0 && tanDown < 0 )
+			back = std::max( back, p.z + p.y / tanDown );
+	}
+
+	// nothing between the new origin and the eyes' near planes can be seen, and it mustn't occlude anything
+	float eyeDepth = back - std::max( eyePositions[ 0 ].z, eyePositions[ 1 ].z );
+	float4x4 stageToOrigin = ( float4x4::Translation( 0, 0, back ) * combinedToStage ).Inverse();
+	float4x4 originToClip;
+	float4x4_CreateProjection( &originToClip, RENDER_DEVICE_TYPE_D3D11, tanLeft, tanRight, tanUp, tanDown,
+		eyeDepth + nearClip, farClip + back );
+	m_stageToClip = stageToOrigin * originToClip;
+}
+
+
+void OcclusionCuller::SetViewProjection( const float4x4& stageToClip )
+{
+	m_stageToClip = stageToClip;
+}
+
+
+void OcclusionCuller::Rasterize( JobSystem& jobs, JobCounter& counter )
+{
+	m_rasterOccluders = m_occluders;
+	m_rasterStageToClip = m_stageToClip;
+	m_ready = true;
+
+	jobs.Run( "Occlusion culling",
+		[ this, &jobs ]
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			// each setup job writes its own triangle list, and every band job reads all of them
+			uint32_t occluderCount = (uint32_t)m_rasterOccluders.size();
+			uint32_t setupJobCount = std::max( 1u, ( occluderCount + k_occludersPerSetupJob - 1 ) / k_occludersPerSetupJob );
+			m_setupTriangles.resize( setupJobCount );
+			JobCounter setupJobs;
+			for ( uint32_t i = 0; i < setupJobCount; i++ )
+			{
+				jobs.Run( "Occluder setup",
+					[ this, i, occluderCount ]
+					{
+						uint32_t first = i * k_occludersPerSetupJob;
+						uint32_t count = std::min( k_occludersPerSetupJob, occluderCount - std::min( first, occluderCount ) );
+						SetupTriangles( first, count, &m_setupTriangles[ i ] );
+					}, &setupJobs );
+			}
+			jobs.Wait( setupJobs );
+
+			uint32_t bandCount = std::max( 1u, std::min( jobs.GetThreadCount() * 2, m_height / k_minBandRows ) );
+			uint32_t bandRows = ( m_height + bandCount - 1 ) / bandCount;
+			JobCounter bandJobs;
+			for ( uint32_t firstRow = 0; firstRow < m_height; firstRow += bandRows )
+			{
+				uint32_t rowCount = std::min( bandRows, m_height - firstRow );
+				jobs.Run( "Occluder band",
+					[ this, firstRow, rowCount ]
+					{
+						RasterizeBand( firstRow, rowCount );
+					}, &bandJobs );
+			}
+			jobs.Wait( bandJobs );
+
+			OcclusionCullerStats stats;
+			stats.occluderCount = occluderCount;
+			for ( const std::vector<Triangle>& triangles : m_setupTriangles )
+			{
+				stats.triangleCount += (uint32_t)triangles.size();
+			}
+			stats.rasterizeSeconds = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - start ).count();
+			m_lastStats = stats;
+		}, &counter );
+}
+
+
+void OcclusionCuller::SetupTriangles( uint32_t firstOccluder, uint32_t occluderCount, std::vector<Triangle>* triangles ) const
+{
+	triangles->clear();
+
+	float halfWidth = m_width * 0.5f;
+	float halfHeight = m_height * 0.5f;
+	std::vector<float4> screen;
+	for ( uint32_t o = firstOccluder; o < firstOccluder + occluderCount; o++ )
+	{
+		const Occluder& occluder = m_rasterOccluders[ o ];
+		const OccluderMesh& mesh = m_meshes[ occluder.mesh ];
+		float4x4 objectToClip = occluder.objectToStage * m_rasterStageToClip;
+
+		// pixels with row 0 at the top, w < 0 marks vertices behind the near plane
+		screen.resize( mesh.positions.size() );
+		for ( size_t v = 0; v < mesh.positions.size(); v++ )
+		{
+			float4 clip = float4( mesh.positions[ v ], 1.f ) * objectToClip;
+			if ( clip.w < k_minClipW || clip.z < 0 )
+			{
+				screen[ v ] = float4( 0, 0, 0, -1.f );
+				continue;
+			}
+			float invW = 1.f / clip.w;
+			screen[ v ] = float4( ( clip.x * invW + 1.f ) * halfWidth, ( 1.f - clip.y * invW ) * halfHeight, clip.z * invW, 1.f );
+		}
+
+		for ( size_t i = 0; i < mesh.indices.size(); i += 3 )
+		{
+			// Triangles crossing the near plane are dropped rather than clipped. That only ever makes occluders
+			// smaller, which is safe.
+			const float4& v0 = screen[ mesh.indices[ i ] ];
+			const float4& v1 = screen[ mesh.indices[ i + 1 ] ];
+			const float4& v2 = screen[ mesh.indices[ i + 2 ] ];
+			if ( v0.w < 0 || v1.w < 0 || v2.w < 0 )
+				continue;
+
+			// rows go down the screen, so counter clockwise triangles come out with a negative area
+			float area = ( v1.x - v0.x ) * ( v2.y - v0.y ) - ( v2.x - v0.x ) * ( v1.y - v0.y );
+			if ( fabsf( area ) < 1e-6f || ( area > 0 && !mesh.twoSided ) )
+				continue;
+
+			Triangle t;
+			t.minX = std::max( 0, (int32_t)floorf( std::min( { v0.x, v1.x, v2.x } ) ) );
+			t.maxX = std::min( (int32_t)m_width - 1, (int32_t)floorf( std::max( { v0.x, v1.x, v2.x } ) ) );
+			t.minY = std::max( 0, (int32_t)floorf( std::min( { v0.y, v1.y, v2.y } ) ) );
+			t.maxY = std::min( (int32_t)m_height - 1, (int32_t)floorf( std::max( { v0.y, v1.y, v2.y } ) ) );
+			if ( t.minX > t.maxX || t.minY > t.maxY )
+				continue;
+
+			// Edge k is opposite vertex k and is zero along that edge. Divided by the signed area, the three of
+			// them are the barycentric coordinates, which interpolate z/w linearly in screen space.
+			const float4* v[ 3 ] = { &v0, &v1, &v2 };
+			float invArea = 1.f / area;
+			t.depthA = t.depthB = t.depthC = 0;
+			for ( int k = 0; k < 3; k++ )
+			{
+				const float4& a = *v[ ( k + 1 ) % 3 ];
+				const float4& b = *v[ ( k + 2 ) % 3 ];
+				float edgeA = ( a.y - b.y ) * invArea;
+				float edgeB = ( b.x - a.x ) * invArea;
+				float edgeC = ( a.x * b.y - a.y * b.x ) * invArea;
+				t.depthA += edgeA * v[ k ]->z;
+				t.depthB += edgeB * v[ k ]->z;
+				t.depthC += edgeC * v[ k ]->z;
+
+				// both windings come out positive inside, so occluders don't need consistent winding
+				t.edgeA[ k ] = edgeA;
+				t.edgeB[ k ] = edgeB;
+				t.edgeC[ k ] = edgeC;
+			}
+			triangles->push_back( t );
+		}
+	}
+}
+
+
+void OcclusionCuller::RasterizeBand( uint32_t firstRow, uint32_t rowCount )
+{
+	std::fill( m_depth.begin() + firstRow * m_width, m_depth.begin() + ( firstRow + rowCount ) * m_width, 1.f );
+
+	const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+	const __m128 zero = _mm_setzero_ps();
+	int32_t bandMin = (int32_t)firstRow;
+	int32_t bandMax = (int32_t)( firstRow + rowCount ) - 1;
+	for ( const std::vector<Triangle>& triangles : m_setupTriangles )
+	{
+		for ( const Triangle& t : triangles )
+		{
+			if ( t.maxY < bandMin || t.minY > bandMax )
+				continue;
+
+			__m128 edgeA[ 3 ], edgeStep[ 3 ];
+			for ( int k = 0; k < 3; k++ )
+			{
+				edgeA[ k ] = _mm_set1_ps( t.edgeA[ k ] );
+				edgeStep[ k ] = _mm_set1_ps( t.edgeA[ k ] * 4.f );
+			}
+			__m128 depthA = _mm_set1_ps( t.depthA );
+			__m128 depthStep = _mm_set1_ps( t.depthA * 4.f );
+
+			int32_t minY = std::max( t.minY, bandMin );
+			int32_t maxY = std::min( t.maxY, bandMax );
+			for ( int32_t y = minY; y <= maxY; y++ )
+			{
+				// Solve each edge for where it crosses the row, so long thin triangles only visit the pixels
+				// they cover rather than their whole bounding box
+				float py = y + 0.5f;
+				float edgeRow[ 3 ];
+				float spanMin = (float)t.minX;
+				float spanMax = (float)t.maxX;
+				for ( int k = 0; k < 3; k++ )
+				{
+					edgeRow[ k ] = t.edgeB[ k ] * py + t.edgeC[ k ];
+					float crossing = -edgeRow[ k ] / t.edgeA[ k ] - 0.5f;
+					if ( t.edgeA[ k ] > 0 )
+						spanMin = std::max( spanMin, crossing );
+					else if ( t.edgeA[ k ] < 0 )
+						spanMax = std::min( spanMax, crossing );
+					else if ( edgeRow[ k ] < 0 )
+						spanMax = -1.f;
+				}
+				if ( spanMin > spanMax )
+					continue;
+
+				// four pixels at a time, starting from a multiple of four so the loads line up with the rows
+				int32_t minX = std::max( t.minX, (int32_t)ceilf( spanMin ) ) & ~3;
+				int32_t maxX = std::min( t.maxX, (int32_t)floorf( spanMax ) );
+				__m128 x = _mm_add_ps( _mm_set1_ps( (float)minX ), laneOffsets );
+				__m128 edge0 = _mm_add_ps( _mm_mul_ps( edgeA[ 0 ], x ), _mm_set1_ps( edgeRow[ 0 ] ) );
+				__m128 edge1 = _mm_add_ps( _mm_mul_ps( edgeA[ 1 ], x ), _mm_set1_ps( edgeRow[ 1 ] ) );
+				__m128 edge2 = _mm_add_ps( _mm_mul_ps( edgeA[ 2 ], x ), _mm_set1_ps( edgeRow[ 2 ] ) );
+				__m128 depth = _mm_add_ps( _mm_mul_ps( depthA, x ), _mm_set1_ps( t.depthB * py + t.depthC ) );
+
+				float* row = &m_depth[ y * m_width ];
+				for ( int32_t px = minX; px <= maxX; px += 4 )
+				{
+					__m128 inside = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( edge0, zero ), _mm_cmpge_ps( edge1, zero ) ),
+						_mm_cmpge_ps( edge2, zero ) );
+					if ( _mm_movemask_ps( inside ) )
+					{
+						__m128 old = _mm_loadu_ps( row + px );
+						__m128 nearer = _mm_min_ps( old, depth );
+						_mm_storeu_ps( row + px, _mm_or_ps( _mm_and_ps( inside, nearer ), _mm_andnot_ps( inside, old ) ) );
+					}
+					edge0 = _mm_add_ps( edge0, edgeStep[ 0 ] );
+					edge1 = _mm_add_ps( edge1, edgeStep[ 1 ] );
+					edge2 = _mm_add_ps( edge2, edgeStep[ 2 ] );
+					depth = _mm_add_ps( depth, depthStep );
+				}
+			}
+		}
+	}
+}
+
+
+bool OcclusionCuller::IsBoxVisible( const float3& boxMin, const float3& boxMax ) const
+{
+	if ( !m_ready )
+		return true;
+
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for ( int corner = 0; corner < 8; corner++ )
+	{
+		float4 position( corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z, 1.f );
+		float4 clip = position * m_rasterStageToClip;
+		if ( clip.w < k_minClipW || clip.z < 0 )
+			return true;
+
+		float invW = 1.f / clip.w;
+		float x = ( clip.x * invW + 1.f ) * m_width * 0.5f;
+		float y = ( 1.f - clip.y * invW ) * m_height * 0.5f;
+		minX = std::min( minX, x );
+		maxX = std::max( maxX, x );
+		minY = std::min( minY, y );
+		maxY = std::max( maxY, y );
+		minZ = std::min( minZ, clip.z * invW );
+	}
+
+	if ( maxX < 0 || maxY < 0 || minX >= m_width || minY >= m_height )
+		return true;
+
+	// Every pixel the box might touch has to have an occluder in front of the box's nearest point. Rounding
+	// the left edge down to a multiple of four only tests extra pixels, which is safe.
+	int32_t x0 = std::max( 0, (int32_t)floorf( minX ) ) & ~3;
+	int32_t x1 = std::min( (int32_t)m_width - 1, (int32_t)floorf( maxX ) );
+	int32_t y0 = std::max( 0, (int32_t)floorf( minY ) );
+	int32_t y1 = std::min( (int32_t)m_height - 1, (int32_t)floorf( maxY ) );
+	__m128 boxDepth = _mm_set1_ps( minZ );
+	for ( int32_t y = y0; y <= y1; y++ )
+	{
+		const float* row = &m_depth[ y * m_width ];
+		for ( int32_t x = x0; x <= x1; x += 4 )
+		{
+			if ( _mm_movemask_ps( _mm_cmpgt_ps( _mm_loadu_ps( row + x ), boxDepth ) ) )
+				return true;
+		}
+	}
+	return false;
+}
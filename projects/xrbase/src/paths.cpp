@@ -1,12 +1,32 @@
 #include "paths.h"
 
 #include <vector>
+#include <map>
+#include <mutex>
 
 using namespace XRDE;
 
+// Without an instance (offline replays) paths come from this table instead of the runtime, so they are still
+// unique and can be turned back into strings
+static std::mutex g_localPathMutex;
+static std::map<std::string, XrPath> g_localPaths;
+static std::vector<std::string> g_localPathStrings;
 
 XrPath XRDE::StringToPath( XrInstance instance, const std::string& pathString )
 {
+	if ( instance == XR_NULL_HANDLE )
+	{
+		std::lock_guard<std::mutex> lock( g_localPathMutex );
+		auto i = g_localPaths.find( pathString );
+		if ( i != g_localPaths.end() )
+			return i->second;
+
+		g_localPathStrings.push_back( pathString );
+		XrPath path = (XrPath)g_localPathStrings.size();
+		g_localPaths[ pathString ] = path;
+		return path;
+	}
+
 	XrPath path;
 	if( XR_FAILED( xrStringToPath( instance, pathString.c_str(), &path ) ) )
 		return XR_NULL_PATH;
@@ -21,6 +41,14 @@ std::string XRDE::PathToString( XrInstance instance, XrPath path )
 		return "XR_NULL_PATH";
 	}
 
+	if ( instance == XR_NULL_HANDLE )
+	{
+		std::lock_guard<std::mutex> lock( g_localPathMutex );
+		if ( path > g_localPathStrings.size() )
+			return "UNKNOWN";
+		return g_localPathStrings[ path - 1 ];
+	}
+
 	std::vector<char> buf;
 	buf.resize( 128 );
 	uint32_t requiredSize;
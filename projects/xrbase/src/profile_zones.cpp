@@ -0,0 +1,204 @@
+#include "profile_zones.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace XRDE;
+
+std::atomic<bool> XRDE::g_profileCapturing { false };
+
+namespace
+{
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t nanoseconds;	// since the first capture started
+		bool begin;
+	};
+
+	// 64k events is a few seconds of the busiest threads
+	const uint64_t k_eventsPerThread = 1 << 16;
+
+	struct ProfileThread
+	{
+		std::unique_ptr<ProfileEvent[]> events = std::make_unique<ProfileEvent[]>( k_eventsPerThread );
+		std::atomic<uint64_t> written { 0 };
+		uint32_t id = 0;
+		std::string name;
+	};
+}
+
+// Threads only take the lock the first time they record, to add their ring. The rings outlive their threads so
+// a trace still has the events of threads that have finished.
+static std::mutex g_profileThreadsMutex;
+static std::vector< std::unique_ptr<ProfileThread> > g_profileThreads;
+static thread_local ProfileThread* t_profileThread = nullptr;
+static thread_local const char* t_profileThreadName = nullptr;
+static std::chrono::steady_clock::time_point g_profileStart;
+static std::once_flag g_profileStartOnce;
+
+static ProfileThread* GetProfileThread()
+{
+	if ( !t_profileThread )
+	{
+		std::lock_guard<std::mutex> lock( g_profileThreadsMutex );
+		g_profileThreads.push_back( std::make_unique<ProfileThread>() );
+		t_profileThread = g_profileThreads.back().get();
+		t_profileThread->id = (uint32_t)g_profileThreads.size();
+		if ( t_profileThreadName )
+		{
+			t_profileThread->name = t_profileThreadName;
+		}
+	}
+	return t_profileThread;
+}
+
+
+static void RecordProfileEvent( const char* name, bool begin )
+{
+	ProfileThread* thread = GetProfileThread();
+	uint64_t index = thread->written.load( std::memory_order_relaxed );
+	ProfileEvent& event = thread->events[ index % k_eventsPerThread ];
+	event.name = name;
+	event.nanoseconds = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - g_profileStart ).count();
+	event.begin = begin;
+	thread->written.store( index + 1, std::memory_order_release );
+}
+
+
+void XRDE::StartProfileCapture()
+{
+	// every capture shares one time base so the rings can be written out together
+	std::call_once( g_profileStartOnce, [] { g_profileStart = std::chrono::steady_clock::now(); } );
+	g_profileCapturing = true;
+}
+
+
+void XRDE::StopProfileCapture()
+{
+	g_profileCapturing = false;
+}
+
+
+void XRDE::SetProfileThreadName( const char* name )
+{
+	// threads that never record don't need a ring, so the name waits until they do
+	t_profileThreadName = name;
+	if ( t_profileThread )
+	{
+		std::lock_guard<std::mutex> lock( g_profileThreadsMutex );
+		t_profileThread->name = name;
+	}
+}
+
+
+void XRDE::BeginProfileZone( const char* name )
+{
+	RecordProfileEvent( name, true );
+}
+
+
+void XRDE::EndProfileZone( const char* name )
+{
+	RecordProfileEvent( name, false );
+}
+
+
+static void WriteJsonString( FILE* file, const char* text )
+{
+	fputc( '"', file );
+	for ( const char* c = text; *c; c++ )
+	{
+		if ( *c == '"' || *c == '\\' )
+		{
+			fputc( '\\', file );
+			fputc( *c, file );
+		}
+		else if ( (unsigned char)*c < 0x20 )
+		{
+			fprintf( file, "\\u%04x", (unsigned)*c );
+		}
+		else
+		{
+			fputc( *c, file );
+		}
+	}
+	fputc( '"', file );
+}
+
+
+bool XRDE::WriteProfileTrace( const std::string& path )
+{
+	FILE* file = nullptr;
+	if ( fopen_s( &file, path.c_str(), "w" ) != 0 || !file )
+	{
+		std::cerr << "Unable to open " << path << " to write the profile trace\n";
+		return false;
+	}
+
+	fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	fprintf( file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"xrbase\"}}" );
+
+	std::lock_guard<std::mutex> lock( g_profileThreadsMutex );
+	std::vector<ProfileEvent> events;
+	for ( const std::unique_ptr<ProfileThread>& thread : g_profileThreads )
+	{
+		if ( !thread->name.empty() )
+		{
+			fprintf( file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->id );
+			WriteJsonString( file, thread->name.c_str() );
+			fprintf( file, "}}" );
+		}
+
+		// copy the ring, then throw away anything the thread may have overwritten while it was being copied
+		uint64_t end = thread->written.load( std::memory_order_acquire );
+		uint64_t begin = end > k_eventsPerThread ? end - k_eventsPerThread : 0;
+		events.clear();
+		for ( uint64_t i = begin; i < end; i++ )
+		{
+			events.push_back( thread->events[ i % k_eventsPerThread ] );
+		}
+		uint64_t written = thread->written.load( std::memory_order_acquire );
+		uint64_t firstIntact = written + 1 > k_eventsPerThread ? written + 1 - k_eventsPerThread : 0;
+		size_t skip = (size_t)( std::max( begin, firstIntact ) - begin );
+
+		// the ring can start in the middle of a zone, drop ends whose begins are gone
+		uint32_t depth = 0;
+		for ( size_t i = std::min( skip, events.size() ); i < events.size(); i++ )
+		{
+			const ProfileEvent& event = events[ i ];
+			if ( event.begin )
+			{
+				depth++;
+			}
+			else if ( depth )
+			{
+				depth--;
+			}
+			else
+			{
+				continue;
+			}
+
+			fprintf( file, ",\n{\"name\":" );
+			WriteJsonString( file, event.name );
+			fprintf( file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", event.begin ? 'B' : 'E', event.nanoseconds / 1000.0,
+				thread->id );
+		}
+	}
+	fprintf( file, "\n]}\n" );
+
+	bool ok = ferror( file ) == 0;
+	fclose( file );
+	if ( !ok )
+	{
+		std::cerr << "Unable to write the profile trace to " << path << "\n";
+	}
+	return ok;
+}
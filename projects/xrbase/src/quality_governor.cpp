@@ -0,0 +1,153 @@
+#include "quality_governor.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace XRDE;
+
+uint32_t QualityGovernor::RegisterKnob( const QualityKnobDesc& desc )
+{
+	Knob knob;
+	knob.desc = desc;
+	m_knobs.push_back( knob );
+	return (uint32_t)m_knobs.size() - 1;
+}
+
+
+void QualityGovernor::SetKnobLevel( uint32_t knob, int level )
+{
+	Knob& k = m_knobs[ knob ];
+	level = std::max( 0, std::min( level, k.desc.levelCount - 1 ) );
+	if ( level == k.level )
+		return;
+
+	k.level = level;
+	if ( k.desc.apply )
+	{
+		k.desc.apply( level );
+	}
+}
+
+
+bool QualityGovernor::Affects( const Knob& knob, bool cpuBound, bool gpuBound )
+{
+	switch ( knob.desc.cost )
+	{
+	case QualityKnobCost::Cpu: return cpuBound;
+	case QualityKnobCost::Gpu: return gpuBound;
+	default: return true;
+	}
+}
+
+
+bool QualityGovernor::Degrade( bool cpuBound, bool gpuBound )
+{
+	// lowest priority first, and only knobs that help with whatever we're bound by
+	const Knob* best = nullptr;
+	for ( const Knob& knob : m_knobs )
+	{
+		if ( knob.level >= knob.desc.levelCount - 1 || !Affects( knob, cpuBound, gpuBound ) )
+			continue;
+
+		if ( !best || knob.desc.priority < best->desc.priority )
+		{
+			best = &knob;
+		}
+	}
+
+	if ( !best )
+		return false;
+
+	uint32_t index = (uint32_t)( best - &m_knobs[ 0 ] );
+	SetKnobLevel( index, best->level + 1 );
+	std::cerr << "Quality governor: lowering " << best->desc.name << " to level " << best->level << "\n";
+	return true;
+}
+
+
+bool QualityGovernor::Restore()
+{
+	// highest priority first, the reverse of the order they were turned down in
+	const Knob* best = nullptr;
+	for ( const Knob& knob : m_knobs )
+	{
+		if ( knob.level == 0 )
+			continue;
+
+		if ( !best || knob.desc.priority > best->desc.priority )
+		{
+			best = &knob;
+		}
+	}
+
+	if ( !best )
+		return false;
+
+	uint32_t index = (uint32_t)( best - &m_knobs[ 0 ] );
+	SetKnobLevel( index, best->level - 1 );
+	std::cerr << "Quality governor: raising " << best->desc.name << " to level " << best->level << "\n";
+	return true;
+}
+
+
+void QualityGovernor::Update( double displayPeriodSeconds, double cpuSeconds, double gpuSeconds )
+{
+	if ( displayPeriodSeconds <= 0 )
+		return;
+
+	if ( !m_haveSample )
+	{
+		m_cpuSeconds = cpuSeconds;
+		m_gpuSeconds = gpuSeconds;
+		m_haveSample = true;
+	}
+	else
+	{
+		m_cpuSeconds += ( cpuSeconds - m_cpuSeconds ) * m_settings.smoothing;
+		m_gpuSeconds += ( gpuSeconds - m_gpuSeconds ) * m_settings.smoothing;
+	}
+
+	if ( !m_enabled )
+		return;
+
+	if ( m_cooldown > 0 )
+	{
+		m_cooldown--;
+		return;
+	}
+
+	double target = displayPeriodSeconds * ( 1.0 - m_settings.targetHeadroom );
+	double restoreTarget = displayPeriodSeconds * ( 1.0 - m_settings.targetHeadroom - m_settings.restoreHysteresis );
+	double busiest = std::max( m_cpuSeconds, m_gpuSeconds );
+
+	if ( busiest > target )
+	{
+		m_underFrames = 0;
+		if ( ++m_overFrames >= m_settings.degradeFrames )
+		{
+			m_overFrames = 0;
+			if ( Degrade( m_cpuSeconds > target, m_gpuSeconds > target ) )
+			{
+				m_cooldown = m_settings.cooldownFrames;
+			}
+		}
+	}
+	else if ( busiest < restoreTarget )
+	{
+		m_overFrames = 0;
+		if ( ++m_underFrames >= m_settings.restoreFrames )
+		{
+			m_underFrames = 0;
+			if ( Restore() )
+			{
+				m_cooldown = m_settings.cooldownFrames;
+			}
+		}
+	}
+	else
+	{
+		// inside the hysteresis band, leave everything alone
+		m_overFrames = 0;
+		m_underFrames = 0;
+	}
+}
@@ -0,0 +1,678 @@
+#include "render_graph.h"
+#include "profile_zones.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// transient textures nobody has asked for in this many frames are released
+static const uint32_t k_transientIdleFrames = 120;
+
+void RenderGraphPassBuilder::WriteColor( uint32_t resource, AttachmentLoad load, const float clearColor[ 4 ], ITextureView* view )
+{
+	RenderGraph::Attachment attachment = { resource, view, load, { 0, 0, 0, 0 } };
+	if ( clearColor )
+	{
+		std::copy( clearColor, clearColor + 4, attachment.clear );
+	}
+	m_graph.m_passes[ m_pass ].colors.push_back( attachment );
+	m_graph.AddUse( m_pass, resource, RESOURCE_STATE_RENDER_TARGET, true );
+}
+
+
+void RenderGraphPassBuilder::WriteDepth( uint32_t resource, AttachmentLoad load, float clearDepth, ITextureView* view )
+{
+	RenderGraph::Attachment attachment = { resource, view, load, { clearDepth, 0, 0, 0 } };
+	m_graph.m_passes[ m_pass ].depth = attachment;
+	m_graph.AddUse( m_pass, resource, RESOURCE_STATE_DEPTH_WRITE, true );
+}
+
+
+void RenderGraphPassBuilder::Read( uint32_t resource, RESOURCE_STATE state )
+{
+	m_graph.AddUse( m_pass, resource, state, false );
+}
+
+
+void RenderGraphPassBuilder::Read( ITexture* texture, RESOURCE_STATE state )
+{
+	if ( texture )
+	{
+		Read( m_graph.ImportTexture( texture ), state );
+	}
+}
+
+
+void RenderGraphPassBuilder::Read( IBuffer* buffer, RESOURCE_STATE state )
+{
+	if ( buffer )
+	{
+		Read( m_graph.ImportBuffer( buffer ), state );
+	}
+}
+
+
+void RenderGraphPassBuilder::Write( uint32_t resource, RESOURCE_STATE state )
+{
+	m_graph.AddUse( m_pass, resource, state, true );
+}
+
+
+void RenderGraphPassBuilder::Write( ITexture* texture, RESOURCE_STATE state )
+{
+	if ( texture )
+	{
+		Write( m_graph.ImportTexture( texture ), state );
+	}
+}
+
+
+void RenderGraphPassBuilder::Write( IBuffer* buffer, RESOURCE_STATE state )
+{
+	if ( buffer )
+	{
+		Write( m_graph.ImportBuffer( buffer ), state );
+	}
+}
+
+
+void RenderGraphPassBuilder::SetPrepare( const std::function<void( IDeviceContext* context )>& prepare )
+{
+	m_graph.m_passes[ m_pass ].prepare = prepare;
+}
+
+
+void RenderGraphPassBuilder::BindWithoutRenderPass()
+{
+	m_graph.m_passes[ m_pass ].useRenderPass = false;
+}
+
+
+void RenderGraphPassBuilder::SetProfileName( const char* name, int eye )
+{
+	m_graph.m_passes[ m_pass ].profileName = name;
+	m_graph.m_passes[ m_pass ].profileEye = eye;
+}
+
+
+void RenderGraph::Init( IRenderDevice* device, MemoryBudget* memoryBudget, GpuProfiler* profiler )
+{
+	Shutdown();
+	m_device = device;
+	m_memoryBudget = memoryBudget;
+	m_profiler = profiler;
+}
+
+
+void RenderGraph::Shutdown()
+{
+	Reset();
+	m_framebuffers.clear();
+	m_renderPasses.clear();
+	if ( m_memoryBudget )
+	{
+		for ( TransientTexture& transient : m_transientPool )
+		{
+			m_memoryBudget->Unregister( transient.texture.RawPtr() );
+		}
+	}
+	m_transientPool.clear();
+	m_device = nullptr;
+}
+
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_imported.clear();
+	m_passes.clear();
+	m_barriers.clear();
+	m_transientAssignment.clear();
+}
+
+
+uint32_t RenderGraph::AddResource( const Resource& resource )
+{
+	m_resources.push_back( resource );
+	return (uint32_t)m_resources.size() - 1;
+}
+
+
+uint32_t RenderGraph::ImportTexture( ITexture* texture, RESOURCE_STATE finalState )
+{
+	if ( !texture )
+		return k_invalidResource;
+
+	auto i = m_imported.find( texture );
+	if ( i != m_imported.end() )
+	{
+		if ( finalState != RESOURCE_STATE_UNKNOWN )
+		{
+			m_resources[ i->second ].finalState = finalState;
+		}
+		return i->second;
+	}
+
+	Resource resource;
+	resource.texture = texture;
+	resource.finalState = finalState;
+	uint32_t handle = AddResource( resource );
+	m_imported[ texture ] = handle;
+	return handle;
+}
+
+
+uint32_t RenderGraph::ImportBuffer( IBuffer* buffer, RESOURCE_STATE finalState )
+{
+	if ( !buffer )
+		return k_invalidResource;
+
+	auto i = m_imported.find( buffer );
+	if ( i != m_imported.end() )
+	{
+		if ( finalState != RESOURCE_STATE_UNKNOWN )
+		{
+			m_resources[ i->second ].finalState = finalState;
+		}
+		return i->second;
+	}
+
+	Resource resource;
+	resource.buffer = buffer;
+	resource.finalState = finalState;
+	uint32_t handle = AddResource( resource );
+	m_imported[ buffer ] = handle;
+	return handle;
+}
+
+
+uint32_t RenderGraph::CreateTransientTexture( const TextureDesc& desc )
+{
+	Resource resource;
+	resource.transient = true;
+	resource.transientDesc = desc;
+	return AddResource( resource );
+}
+
+
+void RenderGraph::AddPass( const char* name, const SetupFunction& setup, const ExecuteFunction& execute )
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	m_passes.push_back( std::move( pass ) );
+
+	RenderGraphPassBuilder builder( *this, (uint32_t)m_passes.size() - 1 );
+	if ( setup )
+	{
+		setup( builder );
+	}
+}
+
+
+void RenderGraph::AddUse( uint32_t pass, uint32_t resource, RESOURCE_STATE state, bool write )
+{
+	if ( resource >= m_resources.size() )
+		return;
+
+	Resource& r = m_resources[ resource ];
+	if ( r.transient && !write && !r.written )
+	{
+		std::cerr << "Render graph pass " << m_passes[ pass ].name << " reads a transient texture before anything writes it\n";
+	}
+	r.firstPass = std::min( r.firstPass, pass );
+	r.lastPass = std::max( r.lastPass, pass );
+	r.written |= write;
+
+	m_passes[ pass ].uses.push_back( { resource, state, write } );
+}
+
+
+ITexture* RenderGraph::GetTexture( uint32_t resource ) const
+{
+	if ( resource >= m_resources.size() )
+		return nullptr;
+
+	const Resource& r = m_resources[ resource ];
+	if ( !r.transient )
+		return r.texture;
+
+	if ( resource >= m_transientAssignment.size() || m_transientAssignment[ resource ] == UINT32_MAX )
+		return nullptr;
+
+	return m_transientPool[ m_transientAssignment[ resource ] ].texture;
+}
+
+
+static bool IsSameTexture( const TextureDesc& a, const TextureDesc& b )
+{
+	return a.Type == b.Type && a.Width == b.Width && a.Height == b.Height && a.ArraySize == b.ArraySize
+		&& a.Format == b.Format && a.MipLevels == b.MipLevels && a.SampleCount == b.SampleCount
+		&& a.BindFlags == b.BindFlags && a.Usage == b.Usage;
+}
+
+
+void RenderGraph::AllocateTransients()
+{
+	TrimTransients();
+	for ( TransientTexture& transient : m_transientPool )
+	{
+		transient.usedThisFrame = false;
+	}
+
+	// hand out textures in the order the transients are first used, so one can move on to the next transient
+	// as soon as the last pass of the previous one is done with it
+	std::vector<uint32_t> transients;
+	for ( uint32_t i = 0; i < (uint32_t)m_resources.size(); i++ )
+	{
+		if ( m_resources[ i ].transient && m_resources[ i ].firstPass != UINT32_MAX )
+		{
+			transients.push_back( i );
+		}
+	}
+	std::sort( transients.begin(), transients.end(),
+		[ this ]( uint32_t a, uint32_t b ) { return m_resources[ a ].firstPass < m_resources[ b ].firstPass; } );
+
+	m_transientAssignment.assign( m_resources.size(), UINT32_MAX );
+	for ( uint32_t resource : transients )
+	{
+		const Resource& r = m_resources[ resource ];
+		uint32_t assigned = UINT32_MAX;
+		for ( uint32_t i = 0; i < (uint32_t)m_transientPool.size(); i++ )
+		{
+			TransientTexture& transient = m_transientPool[ i ];
+			if ( ( !transient.usedThisFrame || transient.busyUntilPass < r.firstPass )
+				&& IsSameTexture( transient.texture->GetDesc(), r.transientDesc ) )
+			{
+				assigned = i;
+				break;
+			}
+		}
+
+		if ( assigned == UINT32_MAX )
+		{
+			TransientTexture transient;
+			m_device->CreateTexture( r.transientDesc, nullptr, &transient.texture );
+			if ( !transient.texture )
+			{
+				std::cerr << "Unable to create a " << r.transientDesc.Width << "x" << r.transientDesc.Height
+					<< " transient render graph texture\n";
+				continue;
+			}
+			if ( m_memoryBudget )
+			{
+				m_memoryBudget->RegisterTexture( transient.texture, MemoryCategory::Other );
+			}
+			m_transientPool.push_back( transient );
+			assigned = (uint32_t)m_transientPool.size() - 1;
+		}
+
+		TransientTexture& transient = m_transientPool[ assigned ];
+		transient.usedThisFrame = true;
+		transient.busyUntilPass = r.lastPass;
+		transient.idleFrames = 0;
+		m_transientAssignment[ resource ] = assigned;
+	}
+}
+
+
+void RenderGraph::PlanTransitions()
+{
+	struct ObjectState
+	{
+		RESOURCE_STATE state;
+		bool used;			// by an earlier pass, so the object can't be transitioned at the start any more
+		uint32_t lastPass;	// to spot one pass asking for two states
+	};
+	std::map<IDeviceObject*, ObjectState> states;
+
+	auto getObject = [ this ]( uint32_t resource ) -> IDeviceObject*
+	{
+		const Resource& r = m_resources[ resource ];
+		return r.buffer ? (IDeviceObject*)r.buffer : (IDeviceObject*)GetTexture( resource );
+	};
+	auto getState = [ this ]( uint32_t resource, IDeviceObject* object )
+	{
+		const Resource& r = m_resources[ resource ];
+		return r.buffer ? r.buffer->GetState() : ( (ITexture*)object )->GetState();
+	};
+	auto makeBarrier = []( IDeviceObject* object, RESOURCE_STATE state )
+	{
+		StateTransitionDesc barrier;
+		barrier.pResource = object;
+		barrier.NewState = state;
+		barrier.Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
+		return barrier;
+	};
+
+	std::vector<StateTransitionDesc> startBarriers;
+	std::vector< std::vector<StateTransitionDesc> > passBarriers( m_passes.size() );
+	for ( uint32_t p = 0; p < (uint32_t)m_passes.size(); p++ )
+	{
+		for ( const Use& use : m_passes[ p ].uses )
+		{
+			IDeviceObject* object = getObject( use.resource );
+			if ( !object )
+				continue;
+
+			auto i = states.find( object );
+			if ( i == states.end() )
+			{
+				i = states.insert( std::make_pair( object, ObjectState { getState( use.resource, object ), false, UINT32_MAX } ) ).first;
+			}
+
+			ObjectState& state = i->second;
+			if ( state.state != use.state )
+			{
+				if ( state.lastPass == p )
+				{
+					std::cerr << "Render graph pass " << m_passes[ p ].name << " uses a resource in two different states\n";
+				}
+
+				if ( state.used )
+				{
+					passBarriers[ p ].push_back( makeBarrier( object, use.state ) );
+				}
+				else
+				{
+					startBarriers.push_back( makeBarrier( object, use.state ) );
+				}
+				state.state = use.state;
+			}
+			state.used = true;
+			state.lastPass = p;
+		}
+	}
+
+	std::vector<StateTransitionDesc> endBarriers;
+	for ( uint32_t resource = 0; resource < (uint32_t)m_resources.size(); resource++ )
+	{
+		const Resource& r = m_resources[ resource ];
+		if ( r.transient || r.finalState == RESOURCE_STATE_UNKNOWN )
+			continue;
+
+		IDeviceObject* object = getObject( resource );
+		auto i = states.find( object );
+		RESOURCE_STATE state = i != states.end() ? i->second.state : getState( resource, object );
+		if ( state != r.finalState )
+		{
+			endBarriers.push_back( makeBarrier( object, r.finalState ) );
+		}
+	}
+
+	m_barriers = startBarriers;
+	m_startBarrierCount = (uint32_t)startBarriers.size();
+	for ( uint32_t p = 0; p < (uint32_t)m_passes.size(); p++ )
+	{
+		m_passes[ p ].firstBarrier = (uint32_t)m_barriers.size();
+		m_passes[ p ].barrierCount = (uint32_t)passBarriers[ p ].size();
+		m_barriers.insert( m_barriers.end(), passBarriers[ p ].begin(), passBarriers[ p ].end() );
+	}
+	m_endBarrierCount = (uint32_t)endBarriers.size();
+	m_barriers.insert( m_barriers.end(), endBarriers.begin(), endBarriers.end() );
+}
+
+
+void RenderGraph::IssueBarriers( IDeviceContext* context, uint32_t first, uint32_t count )
+{
+	if ( !count )
+		return;
+
+	context->TransitionResourceStates( count, &m_barriers[ first ] );
+	m_lastBatchCount++;
+}
+
+
+ITextureView* RenderGraph::GetAttachmentView( const Attachment& attachment, TEXTURE_VIEW_TYPE type ) const
+{
+	if ( attachment.view )
+		return attachment.view;
+
+	ITexture* texture = GetTexture( attachment.resource );
+	return texture ? texture->GetDefaultView( type ) : nullptr;
+}
+
+
+IRenderPass* RenderGraph::GetRenderPass( const Pass& pass, const std::vector<ITextureView*>& views )
+{
+	std::vector<TEXTURE_FORMAT> colorFormats;
+	std::vector<AttachmentLoad> colorLoads;
+	for ( uint32_t i = 0; i < (uint32_t)pass.colors.size(); i++ )
+	{
+		colorFormats.push_back( views[ i ]->GetDesc().Format );
+		colorLoads.push_back( pass.colors[ i ].load );
+	}
+	bool hasDepth = views.size() > pass.colors.size();
+	TEXTURE_FORMAT depthFormat = hasDepth ? views.back()->GetDesc().Format : TEX_FORMAT_UNKNOWN;
+	uint32_t sampleCount = views.front()->GetTexture()->GetDesc().SampleCount;
+
+	RenderPassKey key( colorFormats, depthFormat, colorLoads, hasDepth ? pass.depth.load : AttachmentLoad::Discard, sampleCount );
+	auto i = m_renderPasses.find( key );
+	if ( i != m_renderPasses.end() )
+		return i->second;
+
+	auto loadOp = []( AttachmentLoad load )
+	{
+		switch ( load )
+		{
+		case AttachmentLoad::Clear: return ATTACHMENT_LOAD_OP_CLEAR;
+		case AttachmentLoad::Discard: return ATTACHMENT_LOAD_OP_DISCARD;
+		default: return ATTACHMENT_LOAD_OP_LOAD;
+		}
+	};
+
+	// the graph has already put every attachment in the state the subpass uses, so the render pass doesn't
+	// transition anything itself
+	std::vector<RenderPassAttachmentDesc> attachments( views.size() );
+	std::vector<AttachmentReference> colorRefs( pass.colors.size() );
+	for ( uint32_t a = 0; a < (uint32_t)views.size(); a++ )
+	{
+		bool depth = hasDepth && a == views.size() - 1;
+		RESOURCE_STATE state = depth ? RESOURCE_STATE_DEPTH_WRITE : RESOURCE_STATE_RENDER_TARGET;
+		RenderPassAttachmentDesc& attachment = attachments[ a ];
+		attachment.Format = views[ a ]->GetDesc().Format;
+		attachment.SampleCount = (Uint8)sampleCount;
+		attachment.LoadOp = loadOp( depth ? pass.depth.load : pass.colors[ a ].load );
+		attachment.StoreOp = ATTACHMENT_STORE_OP_STORE;
+		attachment.StencilLoadOp = depth ? attachment.LoadOp : ATTACHMENT_LOAD_OP_DISCARD;
+		attachment.StencilStoreOp = depth ? ATTACHMENT_STORE_OP_STORE : ATTACHMENT_STORE_OP_DISCARD;
+		attachment.InitialState = state;
+		attachment.FinalState = state;
+		if ( !depth )
+		{
+			colorRefs[ a ] = { a, state };
+		}
+	}
+	AttachmentReference depthRef = { (Uint32)views.size() - 1, RESOURCE_STATE_DEPTH_WRITE };
+
+	SubpassDesc subpass;
+	subpass.RenderTargetAttachmentCount = (Uint32)colorRefs.size();
+	subpass.pRenderTargetAttachments = colorRefs.empty() ? nullptr : colorRefs.data();
+	subpass.pDepthStencilAttachment = hasDepth ? &depthRef : nullptr;
+
+	RenderPassDesc desc;
+	desc.Name = "Render graph pass";
+	desc.AttachmentCount = (Uint32)attachments.size();
+	desc.pAttachments = attachments.data();
+	desc.SubpassCount = 1;
+	desc.pSubpasses = &subpass;
+
+	RefCntAutoPtr<IRenderPass> renderPass;
+	m_device->CreateRenderPass( desc, &renderPass );
+	if ( !renderPass )
+	{
+		std::cerr << "Unable to create a render pass for render graph pass " << pass.name << "\n";
+		return nullptr;
+	}
+	m_renderPasses[ key ] = renderPass;
+	return renderPass;
+}
+
+
+IFramebuffer* RenderGraph::GetFramebuffer( IRenderPass* renderPass, const std::vector<ITextureView*>& views )
+{
+	auto key = std::make_pair( renderPass, views );
+	auto i = m_framebuffers.find( key );
+	if ( i != m_framebuffers.end() )
+		return i->second;
+
+	FramebufferDesc desc;
+	desc.Name = "Render graph framebuffer";
+	desc.pRenderPass = renderPass;
+	desc.AttachmentCount = (Uint32)views.size();
+	desc.ppAttachments = views.data();
+
+	RefCntAutoPtr<IFramebuffer> framebuffer;
+	m_device->CreateFramebuffer( desc, &framebuffer );
+	if ( framebuffer )
+	{
+		m_framebuffers[ key ] = framebuffer;
+	}
+	return framebuffer;
+}
+
+
+void RenderGraph::BeginPass( IDeviceContext* context, Pass& pass )
+{
+	std::vector<ITextureView*> views;
+	for ( const Attachment& color : pass.colors )
+	{
+		views.push_back( GetAttachmentView( color, TEXTURE_VIEW_RENDER_TARGET ) );
+	}
+	ITextureView* depthView = nullptr;
+	if ( pass.depth.resource != k_invalidResource )
+	{
+		depthView = GetAttachmentView( pass.depth, TEXTURE_VIEW_DEPTH_STENCIL );
+		views.push_back( depthView );
+	}
+	if ( views.empty() || std::find( views.begin(), views.end(), nullptr ) != views.end() )
+	{
+		pass.useRenderPass = false;
+		return;
+	}
+
+	if ( pass.useRenderPass )
+	{
+		IRenderPass* renderPass = GetRenderPass( pass, views );
+		IFramebuffer* framebuffer = renderPass ? GetFramebuffer( renderPass, views ) : nullptr;
+		if ( framebuffer )
+		{
+			std::vector<OptimizedClearValue> clearValues( views.size() );
+			for ( uint32_t i = 0; i < (uint32_t)pass.colors.size(); i++ )
+			{
+				clearValues[ i ].Format = views[ i ]->GetDesc().Format;
+				std::copy( pass.colors[ i ].clear, pass.colors[ i ].clear + 4, clearValues[ i ].Color );
+			}
+			if ( depthView )
+			{
+				clearValues.back().Format = depthView->GetDesc().Format;
+				clearValues.back().DepthStencil.Depth = pass.depth.clear[ 0 ];
+				clearValues.back().DepthStencil.Stencil = 0;
+			}
+
+			BeginRenderPassAttribs attribs;
+			attribs.pRenderPass = renderPass;
+			attribs.pFramebuffer = framebuffer;
+			attribs.ClearValueCount = (Uint32)clearValues.size();
+			attribs.pClearValues = clearValues.data();
+			attribs.StateTransitionMode = RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+			context->BeginRenderPass( attribs );
+			return;
+		}
+
+		// fall back to plain render targets rather than dropping the pass
+		pass.useRenderPass = false;
+	}
+
+	context->SetRenderTargets( (Uint32)pass.colors.size(), views.data(), depthView, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+	for ( uint32_t i = 0; i < (uint32_t)pass.colors.size(); i++ )
+	{
+		if ( pass.colors[ i ].load == AttachmentLoad::Clear )
+		{
+			context->ClearRenderTarget( views[ i ], pass.colors[ i ].clear, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+		}
+	}
+	if ( depthView && pass.depth.load == AttachmentLoad::Clear )
+	{
+		context->ClearDepthStencil( depthView, CLEAR_DEPTH_FLAG, pass.depth.clear[ 0 ], 0, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+	}
+}
+
+
+void RenderGraph::Execute( IDeviceContext* context )
+{
+	XRDE_PROFILE_FUNCTION();
+	AllocateTransients();
+	PlanTransitions();
+
+	m_lastBatchCount = 0;
+	m_lastBarrierCount = (uint32_t)m_barriers.size();
+	IssueBarriers( context, 0, m_startBarrierCount );
+
+	for ( Pass& pass : m_passes )
+	{
+		XRDE_PROFILE_ZONE( pass.name );
+		uint32_t profileHandle = ~0u;
+		if ( m_profiler && pass.profileName )
+		{
+			profileHandle = m_profiler->BeginPass( context, pass.profileName, pass.profileEye );
+		}
+
+		if ( pass.prepare )
+		{
+			pass.prepare( context );
+		}
+		IssueBarriers( context, pass.firstBarrier, pass.barrierCount );
+
+		bool hasTargets = !pass.colors.empty() || pass.depth.resource != k_invalidResource;
+		if ( hasTargets )
+		{
+			BeginPass( context, pass );
+		}
+		if ( pass.execute )
+		{
+			pass.execute( context );
+		}
+		if ( hasTargets && pass.useRenderPass )
+		{
+			context->EndRenderPass();
+		}
+
+		if ( m_profiler && pass.profileName )
+		{
+			m_profiler->EndPass( context, profileHandle );
+		}
+	}
+
+	IssueBarriers( context, (uint32_t)m_barriers.size() - m_endBarrierCount, m_endBarrierCount );
+}
+
+
+void RenderGraph::TrimTransients()
+{
+	bool trimmed = false;
+	for ( auto i = m_transientPool.begin(); i != m_transientPool.end(); )
+	{
+		if ( !i->usedThisFrame && ++i->idleFrames > k_transientIdleFrames )
+		{
+			if ( m_memoryBudget )
+			{
+				m_memoryBudget->Unregister( i->texture.RawPtr() );
+			}
+			i = m_transientPool.erase( i );
+			trimmed = true;
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// framebuffers hold on to their views, so drop them to really let go of the textures
+	if ( trimmed )
+	{
+		m_framebuffers.clear();
+	}
+}
@@ -0,0 +1,309 @@
+#include "scene_transforms.h"
+#include "profile_zones.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace XRDE;
+using namespace Diligent;
+
+// a level is split into jobs once it has this many nodes, or skinned meshes for the skins
+static const uint32_t k_nodeBatchSize = 4096;
+static const uint32_t k_skinBatchSize = 16;
+
+const uint32_t SceneTransforms::k_invalidIndex;
+
+void SceneTransforms::AddModel( GLTF::Model* model )
+{
+	if ( !model )
+		return;
+
+	Hierarchy hierarchy;
+	hierarchy.key = model;
+	hierarchy.model = model;
+	for ( auto& root : model->Nodes )
+	{
+		hierarchy.roots.push_back( root.get() );
+	}
+	m_hierarchies.push_back( std::move( hierarchy ) );
+	m_layoutDirty = true;
+}
+
+
+void SceneTransforms::RemoveModel( const GLTF::Model* model )
+{
+	Remove( model );
+}
+
+
+void SceneTransforms::AddHierarchy( GLTF::Node* root )
+{
+	if ( !root )
+		return;
+
+	m_hierarchies.push_back( { root, nullptr, { root } } );
+	m_layoutDirty = true;
+}
+
+
+void SceneTransforms::RemoveHierarchy( const GLTF::Node* root )
+{
+	Remove( root );
+}
+
+
+void SceneTransforms::Remove( const void* key )
+{
+	auto removed = std::remove_if( m_hierarchies.begin(), m_hierarchies.end(),
+		[ key ]( const Hierarchy& hierarchy ) { return hierarchy.key == key; } );
+	if ( removed == m_hierarchies.end() )
+		return;
+
+	m_hierarchies.erase( removed, m_hierarchies.end() );
+	m_layoutDirty = true;
+}
+
+
+uint32_t SceneTransforms::FindNode( const GLTF::Node* node ) const
+{
+	auto found = m_nodeIndices.find( node );
+	return found != m_nodeIndices.end() ? found->second : k_invalidIndex;
+}
+
+
+void SceneTransforms::MarkDirty( uint32_t index )
+{
+	if ( index >= m_dirty.size() )
+		return;
+
+	m_dirty[ index ] = 1;
+	uint32_t level = m_levels[ index ];
+	uint32_t first = m_firstDirtyLevel.load( std::memory_order_relaxed );
+	while ( level < first && !m_firstDirtyLevel.compare_exchange_weak( first, level, std::memory_order_relaxed ) )
+	{
+	}
+}
+
+
+void SceneTransforms::MarkDirty( const GLTF::Node* node )
+{
+	MarkDirty( FindNode( node ) );
+}
+
+
+void SceneTransforms::MarkModelDirty( const GLTF::Model* model )
+{
+	if ( !model )
+		return;
+
+	for ( const GLTF::Node* node : model->LinearNodes )
+	{
+		MarkDirty( FindNode( node ) );
+	}
+}
+
+
+void SceneTransforms::Rebuild()
+{
+	XRDE_PROFILE_FUNCTION();
+	m_nodes.clear();
+	m_parents.clear();
+	m_levels.clear();
+	m_levelStarts.clear();
+	m_nodeIndices.clear();
+	m_skinnedMeshes.clear();
+	m_skinJoints.clear();
+
+	// breadth first over every hierarchy at once keeps each level in one piece
+	for ( const Hierarchy& hierarchy : m_hierarchies )
+	{
+		for ( GLTF::Node* root : hierarchy.roots )
+		{
+			m_nodes.push_back( root );
+			m_parents.push_back( k_invalidIndex );
+		}
+	}
+	uint32_t levelBegin = 0;
+	while ( levelBegin < (uint32_t)m_nodes.size() )
+	{
+		uint32_t levelEnd = (uint32_t)m_nodes.size();
+		m_levelStarts.push_back( levelBegin );
+		for ( uint32_t i = levelBegin; i < levelEnd; i++ )
+		{
+			m_levels.push_back( (uint32_t)m_levelStarts.size() - 1 );
+			for ( auto& child : m_nodes[ i ]->Children )
+			{
+				m_nodes.push_back( child.get() );
+				m_parents.push_back( i );
+			}
+		}
+		levelBegin = levelEnd;
+	}
+	m_levelStarts.push_back( (uint32_t)m_nodes.size() );
+
+	for ( uint32_t i = 0; i < (uint32_t)m_nodes.size(); i++ )
+	{
+		m_nodeIndices[ m_nodes[ i ] ] = i;
+	}
+
+	for ( const Hierarchy& hierarchy : m_hierarchies )
+	{
+		if ( !hierarchy.model )
+			continue;
+
+		for ( GLTF::Node* node : hierarchy.model->LinearNodes )
+		{
+			if ( !node->Mesh || node->SkinIndex < 0 || node->SkinIndex >= (int)hierarchy.model->Skins.size() )
+				continue;
+
+			const GLTF::Skin* skin = hierarchy.model->Skins[ node->SkinIndex ].get();
+			SkinnedMesh mesh;
+			mesh.node = FindNode( node );
+			mesh.skin = skin;
+			mesh.firstJoint = (uint32_t)m_skinJoints.size();
+			mesh.jointCount = (uint32_t)std::min( skin->Joints.size(), std::size( node->Mesh->Transforms.jointMatrix ) );
+			for ( uint32_t j = 0; j < mesh.jointCount; j++ )
+			{
+				m_skinJoints.push_back( FindNode( skin->Joints[ j ] ) );
+			}
+
+			bool complete = mesh.node != k_invalidIndex && std::find( m_skinJoints.begin() + mesh.firstJoint,
+				m_skinJoints.end(), k_invalidIndex ) == m_skinJoints.end();
+			if ( complete )
+			{
+				m_skinnedMeshes.push_back( mesh );
+			}
+			else
+			{
+				m_skinJoints.resize( mesh.firstJoint );
+			}
+		}
+	}
+
+	// everything starts out dirty
+	m_dirty.assign( m_nodes.size(), 1 );
+	m_world.resize( m_nodes.size() );
+	m_firstDirtyLevel = m_nodes.empty() ? k_invalidIndex : 0;
+	m_layoutDirty = false;
+	m_layoutVersion++;
+}
+
+
+uint32_t SceneTransforms::UpdateNodes( uint32_t begin, uint32_t end )
+{
+	uint32_t updated = 0;
+	for ( uint32_t i = begin; i < end; i++ )
+	{
+		uint32_t parent = m_parents[ i ];
+		if ( parent != k_invalidIndex && m_dirty[ parent ] )
+		{
+			m_dirty[ i ] = 1;
+		}
+		if ( !m_dirty[ i ] )
+			continue;
+
+		GLTF::Node* node = m_nodes[ i ];
+		m_world[ i ] = parent != k_invalidIndex ? node->LocalMatrix() * m_world[ parent ] : node->LocalMatrix();
+		if ( node->Mesh )
+		{
+			node->Mesh->Transforms.matrix = m_world[ i ];
+		}
+		updated++;
+	}
+	return updated;
+}
+
+
+// the same joint matrices Node::UpdateTransforms makes, from the world matrices that are already known
+uint32_t SceneTransforms::UpdateSkins( uint32_t begin, uint32_t end )
+{
+	uint32_t updated = 0;
+	for ( uint32_t s = begin; s < end; s++ )
+	{
+		const SkinnedMesh& mesh = m_skinnedMeshes[ s ];
+		const uint32_t* joints = &m_skinJoints[ mesh.firstJoint ];
+		bool dirty = m_dirty[ mesh.node ] != 0;
+		for ( uint32_t j = 0; j < mesh.jointCount && !dirty; j++ )
+		{
+			dirty = m_dirty[ joints[ j ] ] != 0;
+		}
+		if ( !dirty )
+			continue;
+
+		auto& transforms = m_nodes[ mesh.node ]->Mesh->Transforms;
+		float4x4 meshToModel = m_world[ mesh.node ].Inverse();
+		for ( uint32_t j = 0; j < mesh.jointCount; j++ )
+		{
+			transforms.jointMatrix[ j ] = mesh.skin->InverseBindMatrices[ j ] * m_world[ joints[ j ] ] * meshToModel;
+		}
+		transforms.jointcount = (int)mesh.jointCount;
+		updated++;
+	}
+	return updated;
+}
+
+
+void SceneTransforms::Update( JobSystem& jobs )
+{
+	if ( m_layoutDirty )
+	{
+		Rebuild();
+	}
+
+	m_lastStats = SceneTransformStats();
+	m_lastStats.nodeCount = (uint32_t)m_nodes.size();
+	m_lastStats.levelCount = (uint32_t)m_levelStarts.size() - ( m_levelStarts.empty() ? 0 : 1 );
+	uint32_t firstLevel = m_firstDirtyLevel.exchange( k_invalidIndex );
+	if ( firstLevel >= m_lastStats.levelCount )
+		return;
+
+	XRDE_PROFILE_FUNCTION();
+	std::atomic<uint32_t> updatedNodes { 0 };
+	for ( uint32_t level = firstLevel; level < m_lastStats.levelCount; level++ )
+	{
+		// a level only reads the one above it, which is finished
+		uint32_t begin = m_levelStarts[ level ];
+		uint32_t end = m_levelStarts[ level + 1 ];
+		if ( end - begin < 2 * k_nodeBatchSize || jobs.GetThreadCount() < 2 )
+		{
+			updatedNodes += UpdateNodes( begin, end );
+			continue;
+		}
+
+		JobCounter levelJobs;
+		for ( uint32_t batch = begin; batch < end; batch += k_nodeBatchSize )
+		{
+			uint32_t batchEnd = std::min( end, batch + k_nodeBatchSize );
+			jobs.Run( "Scene transforms", [ this, batch, batchEnd, &updatedNodes ]
+				{
+					updatedNodes += UpdateNodes( batch, batchEnd );
+				}, &levelJobs );
+		}
+		jobs.Wait( levelJobs );
+	}
+
+	std::atomic<uint32_t> updatedSkins { 0 };
+	uint32_t skinCount = (uint32_t)m_skinnedMeshes.size();
+	if ( skinCount < 2 * k_skinBatchSize || jobs.GetThreadCount() < 2 )
+	{
+		updatedSkins += UpdateSkins( 0, skinCount );
+	}
+	else
+	{
+		JobCounter skinJobs;
+		for ( uint32_t batch = 0; batch < skinCount; batch += k_skinBatchSize )
+		{
+			uint32_t batchEnd = std::min( skinCount, batch + k_skinBatchSize );
+			jobs.Run( "Skin joints", [ this, batch, batchEnd, &updatedSkins ]
+				{
+					updatedSkins += UpdateSkins( batch, batchEnd );
+				}, &skinJobs );
+		}
+		jobs.Wait( skinJobs );
+	}
+
+	// nothing above the first dirty level was marked
+	std::fill( m_dirty.begin() + m_levelStarts[ firstLevel ], m_dirty.end(), (uint8_t)0 );
+	m_lastStats.updatedNodeCount = updatedNodes;
+	m_lastStats.updatedSkinCount = updatedSkins;
+}
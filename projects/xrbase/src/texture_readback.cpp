@@ -0,0 +1,271 @@
+#include "texture_readback.h"
+
+#include <GraphicsAccessories.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace XRDE;
+using namespace Diligent;
+
+bool TextureReadbackRing::Init( IRenderDevice* device, uint32_t width, uint32_t height, TEXTURE_FORMAT format, uint32_t depth )
+{
+	Shutdown();
+	if ( !device || !depth )
+		return false;
+
+	FenceDesc fenceDesc;
+	fenceDesc.Name = "Texture readback fence";
+	device->CreateFence( fenceDesc, &m_fence );
+	if ( !m_fence )
+		return false;
+
+	TextureDesc desc;
+	desc.Name = "Texture readback staging";
+	desc.Type = RESOURCE_DIM_TEX_2D;
+	desc.Width = width;
+	desc.Height = height;
+	desc.Format = format;
+	desc.MipLevels = 1;
+	desc.Usage = USAGE_STAGING;
+	desc.BindFlags = BIND_NONE;
+	desc.CPUAccessFlags = CPU_ACCESS_READ;
+
+	m_slots.resize( depth );
+	for ( Slot& slot : m_slots )
+	{
+		device->CreateTexture( desc, nullptr, &slot.staging );
+		if ( !slot.staging )
+		{
+			std::cerr << "Unable to create a " << width << "x" << height << " staging texture for readback\n";
+			Shutdown();
+			return false;
+		}
+	}
+
+	m_format = format;
+	return true;
+}
+
+
+void TextureReadbackRing::Shutdown()
+{
+	// mapped copies can't be unmapped without a context, but dropping the staging textures releases them anyway
+	m_slots.clear();
+	m_fence.Release();
+	m_fenceValue = 0;
+	m_oldest = 0;
+	m_inFlight = 0;
+	m_mapped = 0;
+}
+
+
+bool TextureReadbackRing::Enqueue( IDeviceContext* context, ITexture* source, uint32_t arraySlice, uint32_t width, uint32_t height,
+	uint64_t frameIndex )
+{
+	if ( m_slots.empty() )
+		return false;
+
+	if ( m_inFlight == m_slots.size() )
+	{
+		m_dropped++;
+		return false;
+	}
+
+	Slot& slot = m_slots[ ( m_oldest + m_inFlight ) % m_slots.size() ];
+	const TextureDesc& stagingDesc = slot.staging->GetDesc();
+	slot.width = std::min( width, stagingDesc.Width );
+	slot.height = std::min( height, stagingDesc.Height );
+	slot.arraySlice = arraySlice;
+	slot.frameIndex = frameIndex;
+
+	Box srcBox;
+	srcBox.MaxX = slot.width;
+	srcBox.MaxY = slot.height;
+
+	CopyTextureAttribs copy;
+	copy.pSrcTexture = source;
+	copy.SrcSlice = arraySlice;
+	copy.pSrcBox = &srcBox;
+	copy.SrcTextureTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+	copy.pDstTexture = slot.staging;
+	copy.DstTextureTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+	context->CopyTexture( copy );
+
+	slot.fenceValue = ++m_fenceValue;
+	context->EnqueueSignal( m_fence, slot.fenceValue );
+	m_inFlight++;
+	return true;
+}
+
+
+void TextureReadbackRing::Poll( IDeviceContext* context, const ReadbackConsumer& consume )
+{
+	if ( !m_inFlight )
+		return;
+
+	uint64_t completed = m_fence->GetCompletedValue();
+	while ( m_inFlight )
+	{
+		Slot& slot = m_slots[ m_oldest ];
+		if ( slot.fenceValue > completed || !ReadBack( context, slot, consume ) )
+			break;
+	}
+}
+
+
+bool TextureReadbackRing::WaitForOldest( IDeviceContext* context, const ReadbackConsumer& consume )
+{
+	if ( !m_inFlight )
+		return false;
+
+	Slot& slot = m_slots[ m_oldest ];
+	context->WaitForFence( m_fence, slot.fenceValue, true );
+	if ( !ReadBack( context, slot, consume ) )
+	{
+		// the copy is finished but the texture can't be mapped, so give up on it rather than wait forever
+		m_oldest = ( m_oldest + 1 ) % m_slots.size();
+		m_inFlight--;
+		m_dropped++;
+	}
+	return true;
+}
+
+
+void TextureReadbackRing::Drain( IDeviceContext* context, const ReadbackConsumer& consume )
+{
+	while ( WaitForOldest( context, consume ) )
+	{
+	}
+}
+
+
+bool TextureReadbackRing::MapOldest( IDeviceContext* context, ReadbackFrame* frame )
+{
+	if ( m_mapped == m_inFlight )
+		return false;
+
+	Slot& slot = m_slots[ ( m_oldest + m_mapped ) % m_slots.size() ];
+	if ( slot.fenceValue > m_fence->GetCompletedValue() )
+		return false;
+
+	MappedTextureSubresource mapped;
+	context->MapTextureSubresource( slot.staging, 0, 0, MAP_READ, MAP_FLAG_DO_NOT_WAIT, nullptr, mapped );
+	if ( !mapped.pData )
+		return false;
+
+	frame->frameIndex = slot.frameIndex;
+	frame->arraySlice = slot.arraySlice;
+	frame->width = slot.width;
+	frame->height = slot.height;
+	frame->format = m_format;
+	frame->data = (const uint8_t*)mapped.pData;
+	frame->stride = (uint32_t)mapped.Stride;
+	m_mapped++;
+	return true;
+}
+
+
+void TextureReadbackRing::ReleaseOldest( IDeviceContext* context )
+{
+	if ( !m_mapped )
+		return;
+
+	context->UnmapTextureSubresource( m_slots[ m_oldest ].staging, 0, 0 );
+	m_oldest = ( m_oldest + 1 ) % m_slots.size();
+	m_inFlight--;
+	m_mapped--;
+	m_read++;
+}
+
+
+bool TextureReadbackRing::ReadBack( IDeviceContext* context, Slot& slot, const ReadbackConsumer& consume )
+{
+	MappedTextureSubresource mapped;
+	context->MapTextureSubresource( slot.staging, 0, 0, MAP_READ, MAP_FLAG_DO_NOT_WAIT, nullptr, mapped );
+	if ( !mapped.pData )
+		return false;
+
+	ReadbackFrame frame;
+	frame.frameIndex = slot.frameIndex;
+	frame.arraySlice = slot.arraySlice;
+	frame.width = slot.width;
+	frame.height = slot.height;
+	frame.format = m_format;
+	frame.data = (const uint8_t*)mapped.pData;
+	frame.stride = (uint32_t)mapped.Stride;
+	if ( consume )
+	{
+		consume( frame );
+	}
+	context->UnmapTextureSubresource( slot.staging, 0, 0 );
+
+	m_oldest = ( m_oldest + 1 ) % m_slots.size();
+	m_inFlight--;
+	m_read++;
+	return true;
+}
+
+
+static bool IsBgra8( TEXTURE_FORMAT format )
+{
+	return format == TEX_FORMAT_BGRA8_UNORM || format == TEX_FORMAT_BGRA8_UNORM_SRGB || format == TEX_FORMAT_BGRA8_TYPELESS;
+}
+
+
+bool XRDE::CanWriteAsPpm( TEXTURE_FORMAT format )
+{
+	// runtimes often create typeless swapchain images so the app can pick sRGB or linear views
+	return format == TEX_FORMAT_RGBA8_UNORM || format == TEX_FORMAT_RGBA8_UNORM_SRGB || format == TEX_FORMAT_RGBA8_TYPELESS
+		|| IsBgra8( format );
+}
+
+
+bool XRDE::WriteReadbackFrame( const std::string& path, const ReadbackFrame& frame )
+{
+	bool bgra = IsBgra8( frame.format );
+
+	FILE* file = nullptr;
+	if ( fopen_s( &file, path.c_str(), "wb" ) != 0 || !file )
+	{
+		std::cerr << "Unable to open " << path << " to write a frame\n";
+		return false;
+	}
+
+	bool ok = true;
+	if ( CanWriteAsPpm( frame.format ) )
+	{
+		fprintf( file, "P6\n%u %u\n255\n", frame.width, frame.height );
+		std::vector<uint8_t> row( frame.width * 3 );
+		for ( uint32_t y = 0; y < frame.height && ok; y++ )
+		{
+			const uint8_t* src = frame.data + (size_t)y * frame.stride;
+			for ( uint32_t x = 0; x < frame.width; x++ )
+			{
+				row[ x * 3 + 0 ] = src[ x * 4 + ( bgra ? 2 : 0 ) ];
+				row[ x * 3 + 1 ] = src[ x * 4 + 1 ];
+				row[ x * 3 + 2 ] = src[ x * 4 + ( bgra ? 0 : 2 ) ];
+			}
+			ok = fwrite( row.data(), 1, row.size(), file ) == row.size();
+		}
+	}
+	else
+	{
+		const TextureFormatAttribs& attribs = GetTextureFormatAttribs( frame.format );
+		uint32_t rowBytes = frame.width * attribs.ComponentSize * attribs.NumComponents;
+		uint32_t header[] = { frame.width, frame.height, (uint32_t)frame.format, rowBytes };
+		ok = fwrite( header, sizeof( header ), 1, file ) == 1;
+		for ( uint32_t y = 0; y < frame.height && ok; y++ )
+		{
+			ok = fwrite( frame.data + (size_t)y * frame.stride, 1, rowBytes, file ) == rowBytes;
+		}
+	}
+
+	fclose( file );
+	if ( !ok )
+	{
+		std::cerr << "Unable to write " << path << "\n";
+	}
+	return ok;
+}
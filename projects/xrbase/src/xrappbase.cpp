@@ -1,10 +1,14 @@
 #include "xrappbase.h"
+#include "command_line.h"
 
 #include <iomanip>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <map>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
 
 #ifndef NOMINMAX
 #	define NOMINMAX
@@ -110,10 +114,46 @@ XrExtensionMap GetAvailableOpenXRExtensions()
 
 XrAppBase::~XrAppBase()
 {
+	StopSimulationThread();
+	m_jobSystem.Wait( m_occlusionJobs );
+	m_jobSystem.Shutdown();
+	if ( XRDE::ActiveInputTrace() == &m_inputTrace )
+	{
+		XRDE::SetActiveInputTrace( nullptr );
+	}
+	m_inputTrace.Close();
+	m_commandRecorder.Shutdown();
+	if ( m_frameCapture.IsEnabled() )
+	{
+		std::cerr << "Captured " << m_frameCapture.GetCapturedCount() << " eye images, dropped "
+			<< m_frameCapture.GetDroppedCount() << " frames\n";
+	}
 	if ( m_pGraphicsBinding )
 	{
+		m_frameCapture.Shutdown( m_pGraphicsBinding->GetImmediateContext() );
 		m_pGraphicsBinding->GetImmediateContext()->Flush();
 	}
+	m_compositionLayers.PrintSummary( std::cerr );
+	m_compositionLayers.Shutdown();
+	m_drawList.Shutdown();
+	m_gpuSkinning.Shutdown();
+	m_renderGraph.Shutdown();
+
+	// the derived app is already gone, so nobody is left to hear about the last misses
+	m_framePacing.SetMissCallback( nullptr );
+	m_framePacing.Flush();
+	m_framePacing.PrintSummary( std::cerr );
+	if ( XRDE::ActiveLatencyTracker() == &m_latencyTracker )
+	{
+		XRDE::SetActiveLatencyTracker( nullptr );
+	}
+	m_latencyTracker.PrintSummary( std::cerr );
+
+	if ( !m_profileTracePath.empty() )
+	{
+		XRDE::StopProfileCapture();
+		XRDE::WriteProfileTrace( m_profileTracePath );
+	}
 }
 
 std::string XrAppBase::GetWindowName() 
@@ -131,23 +171,73 @@ std::string XrAppBase::GetWindowName()
 
 bool XrAppBase::Initialize( HWND hWnd )
 {
+	XRDE_PROFILE_THREAD_NAME( "Main" );
+	XRDE_PROFILE_FUNCTION();
+
+	m_framePacing.SetMissCallback( [ this ]( const XRDE::FrameMiss& miss ) { OnFrameMissed( miss ); } );
+
 	m_pGraphicsBinding = IGraphicsBinding::CreateBindingForDeviceType( m_DeviceType );
 	if ( !m_pGraphicsBinding )
 	{
 		return false;
 	}
 
+	if ( m_offline )
+	{
+		if ( m_replayTracePath.empty() )
+		{
+			std::cerr << "-offline only works with a trace to replay, see -replay-trace\n";
+			return false;
+		}
+
+		// there is no instance, so paths are local to the app and everything else comes from the trace
+		XRDE::InitPaths( XR_NULL_HANDLE );
+		m_views[ 0 ].type = XR_TYPE_VIEW_CONFIGURATION_VIEW;
+		m_views[ 1 ].type = XR_TYPE_VIEW_CONFIGURATION_VIEW;
+	}
 	// create the OpenXR instance first because it will have an opinion about device creation
-	if ( !InitializeOpenXr() )
+	else if ( !InitializeOpenXr() )
 	{
 		return false;
 	}
 
+	m_pGraphicsBinding->SetDeferredContextCount( m_recordingThreadCount );
 	if ( !XR_SUCCEEDED( m_pGraphicsBinding->CreateDevice( m_instance, m_systemId ) ) )
 	{
 		return false;
 	}
 
+	std::vector<IDeviceContext*> deferredContexts;
+	for ( uint32_t i = 0; i < m_pGraphicsBinding->GetDeferredContextCount(); i++ )
+	{
+		deferredContexts.push_back( m_pGraphicsBinding->GetDeferredContext( i ) );
+	}
+	m_commandRecorder.Init( deferredContexts );
+
+
+	m_memoryBudget.Init( m_pGraphicsBinding->GetRenderDevice() );
+	m_gpuProfiler.Init( m_pGraphicsBinding->GetRenderDevice() );
+	m_renderGraph.Init( m_pGraphicsBinding->GetRenderDevice(), &m_memoryBudget, &m_gpuProfiler );
+	m_drawList.Init( m_pGraphicsBinding->GetRenderDevice(), &m_memoryBudget );
+	m_gpuSkinning.Init( m_pGraphicsBinding->GetRenderDevice(), &m_memoryBudget );
+	m_animations.Init( &m_sceneTransforms );
+	m_occlusionCuller.Init();
+	if ( m_occlusionCulling )
+	{
+		m_drawList.SetOcclusionCuller( &m_occlusionCuller );
+	}
+
+	if ( m_jobThreadCount < 0 )
+	{
+		// leave the main thread its own core
+		m_jobThreadCount = std::max( 0, (int32_t)std::thread::hardware_concurrency() - 1 );
+	}
+	m_jobSystem.Init( (uint32_t)m_jobThreadCount );
+	RegisterQualityKnobs();
+	if ( !StartInputTrace() )
+	{
+		return false;
+	}
 
 	m_prevFrameTime = m_frameTimer.GetElapsedTime();
 
@@ -244,7 +334,10 @@ bool XrAppBase::Initialize( HWND hWnd )
 	if ( !PreSession() )
 		return false;
 
-	if ( !CreateSession() )
+	if ( m_offline ? !CreateOfflineEyeTextures() : !CreateSession() )
+		return false;
+
+	if ( !StartFrameCapture() )
 		return false;
 
 	CreateGltfRenderer();
@@ -258,6 +351,7 @@ bool XrAppBase::Initialize( HWND hWnd )
 
 bool XrAppBase::InitializeOpenXr()
 {
+	XRDE_PROFILE_FUNCTION();
 	m_availableExtensions = GetAvailableOpenXRExtensions();
 
 	std::vector< std::string > xrExtensions = m_pGraphicsBinding->GetXrExtensions();
@@ -279,6 +373,19 @@ bool XrAppBase::InitializeOpenXr()
 		return false;
 	}
 
+	// the clock extension lets the latency tracker put the app's timestamps on the runtime's clock, and the
+	// cylinder extension lets apps add cylinder layers
+	const char* clockExtension = XRDE::XrClock::GetExtensionName();
+	for ( const char* optional : { clockExtension, XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME } )
+	{
+		auto i = m_availableExtensions.find( optional );
+		if ( i != m_availableExtensions.end() && !IsExtensionActive( optional ) )
+		{
+			xrExtensions.push_back( optional );
+			m_activeExtensions.insert( *i );
+		}
+	}
+
 	// CODE GOES HERE: Add any additional extensions required by your application
 
 	std::vector<const char*> extensionPointers;
@@ -304,6 +411,11 @@ bool XrAppBase::InitializeOpenXr()
 
 	XRDE::InitPaths( m_instance );
 
+	if ( IsExtensionActive( clockExtension ) && m_latencyTracker.Init( m_instance ) )
+	{
+		XRDE::SetActiveLatencyTracker( &m_latencyTracker );
+	}
+
 	XrSystemGetInfo getInfo = { XR_TYPE_SYSTEM_GET_INFO };
 	getInfo.formFactor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;
 	res = xrGetSystem( m_instance, &getInfo, &m_systemId );
@@ -352,6 +464,7 @@ bool XrAppBase::IsExtensionActive( const std::string& extensionName )
 
 bool XrAppBase::CreateSession()
 {
+	XRDE_PROFILE_FUNCTION();
 	XrSessionCreateInfo createInfo = { XR_TYPE_SESSION_CREATE_INFO };
 	createInfo.systemId = m_systemId;
 	createInfo.createFlags = 0;
@@ -420,39 +533,15 @@ bool XrAppBase::CreateSession()
 	m_rpColorSwapchainTextures = m_pGraphicsBinding->ReadImagesFromSwapchain( m_swapchain );
 	for ( RefCntAutoPtr<ITexture>& pTexture : m_rpColorSwapchainTextures )
 	{
-		TextureViewDesc viewDesc;
-		viewDesc.ViewType = TEXTURE_VIEW_RENDER_TARGET;
-		viewDesc.FirstArraySlice = 0;
-		viewDesc.NumArraySlices = 1;
-		viewDesc.AccessFlags = UAV_ACCESS_FLAG_WRITE;
-
-		RefCntAutoPtr< ITextureView > pLeftEyeView;
-		pTexture->CreateView( viewDesc, &pLeftEyeView );
-		m_rpEyeSwapchainViews[ 0 ].push_back( pLeftEyeView );
-
-		viewDesc.FirstArraySlice = 1;
-		RefCntAutoPtr< ITextureView > pRightEyeView;
-		pTexture->CreateView( viewDesc, &pRightEyeView );
-		m_rpEyeSwapchainViews[ 1 ].push_back( pRightEyeView );
+		m_memoryBudget.RegisterTexture( pTexture, XRDE::MemoryCategory::SwapchainColor );
+		CreateEyeViews( pTexture, TEXTURE_VIEW_RENDER_TARGET, m_rpEyeSwapchainViews );
 	}
 
 	m_rpDepthSwapchainTextures = m_pGraphicsBinding->ReadImagesFromSwapchain( m_depthSwapchain );
 	for ( RefCntAutoPtr<ITexture>& pTexture : m_rpDepthSwapchainTextures )
 	{
-		TextureViewDesc viewDesc;
-		viewDesc.ViewType = TEXTURE_VIEW_DEPTH_STENCIL;
-		viewDesc.FirstArraySlice = 0;
-		viewDesc.NumArraySlices = 1;
-		viewDesc.AccessFlags = UAV_ACCESS_FLAG_WRITE;
-
-		RefCntAutoPtr< ITextureView > pLeftEyeView;
-		pTexture->CreateView( viewDesc, &pLeftEyeView );
-		m_rpEyeDepthViews[ 0 ].push_back( pLeftEyeView );
-
-		viewDesc.FirstArraySlice = 1;
-		RefCntAutoPtr< ITextureView > pRightEyeView;
-		pTexture->CreateView( viewDesc, &pRightEyeView );
-		m_rpEyeDepthViews[ 1 ].push_back( pRightEyeView );
+		m_memoryBudget.RegisterTexture( pTexture, XRDE::MemoryCategory::SwapchainDepth );
+		CreateEyeViews( pTexture, TEXTURE_VIEW_DEPTH_STENCIL, m_rpEyeDepthViews );
 	}
 
 	XrReferenceSpaceCreateInfo spaceCreateInfo = { XR_TYPE_REFERENCE_SPACE_CREATE_INFO };
@@ -460,6 +549,9 @@ bool XrAppBase::CreateSession()
 	spaceCreateInfo.poseInReferenceSpace = IdentityXrPose();
 	CHECK_XR_RESULT( xrCreateReferenceSpace( m_session, &spaceCreateInfo, &m_stageSpace ) );
 
+	m_compositionLayers.Init( m_session, m_stageSpace, m_pGraphicsBinding.get(), &m_memoryBudget, scCreateInfo.format,
+		IsExtensionActive( XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME ) );
+
 	if ( m_enableHandTrackers )
 	{
 		XrHandTrackerCreateInfoEXT handTrackerCreateInfo = { XR_TYPE_HAND_TRACKER_CREATE_INFO_EXT };
@@ -479,13 +571,215 @@ bool XrAppBase::CreateSession()
 }
 
 
+void XrAppBase::CreateEyeViews( ITexture* texture, TEXTURE_VIEW_TYPE viewType, std::vector< RefCntAutoPtr<ITextureView> > eyeViews[ 2 ] )
+{
+	TextureViewDesc viewDesc;
+	viewDesc.ViewType = viewType;
+	viewDesc.NumArraySlices = 1;
+	viewDesc.AccessFlags = UAV_ACCESS_FLAG_WRITE;
+
+	for ( uint32_t eye = 0; eye < 2; eye++ )
+	{
+		viewDesc.FirstArraySlice = eye;
+		RefCntAutoPtr< ITextureView > pEyeView;
+		texture->CreateView( viewDesc, &pEyeView );
+		eyeViews[ eye ].push_back( pEyeView );
+	}
+}
+
+
+bool XrAppBase::CreateOfflineEyeTextures()
+{
+	// enough that the GPU can still be rendering one while the next is being recorded
+	static const uint32_t k_offlineImageCount = 3;
+
+	TextureDesc desc;
+	desc.Type = RESOURCE_DIM_TEX_2D_ARRAY;
+	desc.Width = m_views[ 0 ].recommendedImageRectWidth;
+	desc.Height = m_views[ 0 ].recommendedImageRectHeight;
+	desc.ArraySize = 2;
+	desc.MipLevels = 1;
+	desc.Usage = USAGE_DEFAULT;
+
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+	for ( uint32_t i = 0; i < k_offlineImageCount; i++ )
+	{
+		// 8 bit sRGB so frames can be written out as they are
+		RefCntAutoPtr<ITexture> pColor;
+		desc.Name = "Offline eye color";
+		desc.Format = TEX_FORMAT_RGBA8_UNORM_SRGB;
+		desc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+		device->CreateTexture( desc, nullptr, &pColor );
+
+		if ( !pColor )
+		{
+			std::cerr << "Unable to create " << desc.Width << "x" << desc.Height << " offline eye textures\n";
+			return false;
+		}
+
+		m_rpColorSwapchainTextures.push_back( pColor );
+		m_memoryBudget.RegisterTexture( pColor, XRDE::MemoryCategory::SwapchainColor );
+		CreateEyeViews( pColor, TEXTURE_VIEW_RENDER_TARGET, m_rpEyeSwapchainViews );
+	}
+
+	// Nothing reads the depth after the frame, so it's a render graph transient instead of one per image. The
+	// eyes clear it in turn, so one slice is enough.
+	m_offlineDepthDesc = desc;
+	m_offlineDepthDesc.Name = "Offline eye depth";
+	m_offlineDepthDesc.Type = RESOURCE_DIM_TEX_2D;
+	m_offlineDepthDesc.ArraySize = 1;
+	m_offlineDepthDesc.Format = TEX_FORMAT_D32_FLOAT;
+	m_offlineDepthDesc.BindFlags = BIND_DEPTH_STENCIL;
+
+	if ( m_offlineOutputPath.empty() )
+		return true;
+
+	CreateDirectoryA( m_offlineOutputPath.c_str(), nullptr );
+	if ( !m_offlineReadback.Init( device, desc.Width, desc.Height, TEX_FORMAT_RGBA8_UNORM_SRGB ) )
+		return false;
+
+	for ( uint32_t i = 0; i < m_offlineReadback.GetDepth(); i++ )
+	{
+		m_memoryBudget.RegisterTexture( m_offlineReadback.GetStagingTexture( i ), XRDE::MemoryCategory::Other );
+	}
+	return true;
+}
+
+
+bool XrAppBase::StartFrameCapture()
+{
+	std::unique_ptr<XRDE::ICaptureSink> sink;
+	if ( !m_captureSharedMemoryName.empty() )
+	{
+		sink = std::make_unique<XRDE::CaptureSharedMemorySink>( m_captureSharedMemoryName );
+	}
+	else if ( !m_captureDirectory.empty() )
+	{
+		sink = std::make_unique<XRDE::CaptureFileSink>( m_captureDirectory );
+	}
+	else
+	{
+		return true;
+	}
+
+	if ( !m_frameCapture.Init( m_pGraphicsBinding->GetRenderDevice(), m_rpColorSwapchainTextures.front()->GetDesc(), std::move( sink ) ) )
+	{
+		std::cerr << "Unable to start capturing frames\n";
+		return false;
+	}
+
+	const XRDE::TextureReadbackRing& ring = m_frameCapture.GetRing();
+	for ( uint32_t i = 0; i < ring.GetDepth(); i++ )
+	{
+		m_memoryBudget.RegisterTexture( ring.GetStagingTexture( i ), XRDE::MemoryCategory::Other );
+	}
+	return true;
+}
+
+
+void XrAppBase::ReadBackOfflineEyes( ITexture* colorTexture )
+{
+	IDeviceContext* immediateContext = m_pGraphicsBinding->GetImmediateContext();
+	auto write = [ this ]( const XRDE::ReadbackFrame& frame ) { WriteOfflineFrame( frame ); };
+
+	// Every frame has to make it to disk, so when the ring is full wait for the oldest copy instead of dropping
+	// this one. That only happens when the GPU or the disk can't keep up.
+	for ( uint32_t eye = 0; eye < 2; eye++ )
+	{
+		while ( !m_offlineReadback.Enqueue( immediateContext, colorTexture, eye, GetEyeRenderWidth(), GetEyeRenderHeight(), m_replayFrameCount ) )
+		{
+			if ( !m_offlineReadback.WaitForOldest( immediateContext, write ) )
+				break;
+		}
+	}
+	m_offlineReadback.Poll( immediateContext, write );
+}
+
+
+void XrAppBase::WriteOfflineFrame( const XRDE::ReadbackFrame& frame )
+{
+	char name[ 64 ];
+	snprintf( name, sizeof( name ), "/frame_%06llu_eye%u.ppm", (unsigned long long)frame.frameIndex, frame.arraySlice );
+	if ( XRDE::WriteReadbackFrame( m_offlineOutputPath + name, frame ) )
+	{
+		m_offlineFramesWritten++;
+	}
+}
+
+
 bool XrAppBase::ProcessCommandLine( const std::string& cmdLine )
 {
-	const auto* Key = "-mode ";
-	const auto* pos = strstr( cmdLine.c_str(), Key );
-	if ( pos != nullptr )
+	std::string budgetMb;
+	if ( XRDE::GetCommandLineValue( cmdLine, "-vram-budget ", &budgetMb ) )
+	{
+		m_memoryBudget.SetBudget( XRDE::MemoryLocation::Gpu, strtoull( budgetMb.c_str(), nullptr, 10 ) << 20 );
+	}
+
+	std::string recordingThreads;
+	if ( XRDE::GetCommandLineValue( cmdLine, "-record-threads ", &recordingThreads ) )
+	{
+		m_recordingThreadCount = (uint32_t)strtoul( recordingThreads.c_str(), nullptr, 10 );
+	}
+
+	std::string jobThreads;
+	if ( XRDE::GetCommandLineValue( cmdLine, "-job-threads ", &jobThreads ) )
+	{
+		m_jobThreadCount = atoi( jobThreads.c_str() );
+	}
+
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-threaded-sim" ) )
+	{
+		m_threadedSimulation = true;
+	}
+
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-gpu-cull" ) )
+	{
+		m_drawList.SetGpuCulling( true );
+	}
+
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-gpu-skinning" ) )
+	{
+		m_gltfCachePolicy.SetGpuSkinning( true );
+	}
+
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-occlusion-cull" ) )
+	{
+		m_occlusionCulling = true;
+	}
+
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-quality-governor" ) )
+	{
+		m_qualityGovernor.SetEnabled( true );
+	}
+
+	std::string headroom;
+	if ( XRDE::GetCommandLineValue( cmdLine, "-quality-headroom ", &headroom ) )
+	{
+		XRDE::QualityGovernorSettings settings = m_qualityGovernor.GetSettings();
+		settings.targetHeadroom = (float)atof( headroom.c_str() ) / 100.f;
+		m_qualityGovernor.SetSettings( settings );
+	}
+
+	XRDE::GetCommandLineValue( cmdLine, "-record-trace ", &m_recordTracePath );
+	XRDE::GetCommandLineValue( cmdLine, "-replay-trace ", &m_replayTracePath );
+	XRDE::GetCommandLineValue( cmdLine, "-offline-output ", &m_offlineOutputPath );
+	XRDE::GetCommandLineValue( cmdLine, "-capture ", &m_captureDirectory );
+	XRDE::GetCommandLineValue( cmdLine, "-capture-shm ", &m_captureSharedMemoryName );
+	if ( XRDE::GetCommandLineValue( cmdLine, "-profile-trace ", &m_profileTracePath ) )
 	{
-		pos += strlen( Key );
+		// start now so Initialize shows up in the trace
+		XRDE::StartProfileCapture();
+	}
+	// writing the eye images only works offline
+	if ( XRDE::HasCommandLineFlag( cmdLine, "-offline" ) || !m_offlineOutputPath.empty() )
+	{
+		m_offline = true;
+	}
+
+	std::string mode;
+	if ( XRDE::GetCommandLineValue( cmdLine, "-mode ", &mode ) )
+	{
+		const auto* pos = mode.c_str();
 		if ( _stricmp( pos, "D3D11" ) == 0 )
 		{
 #if D3D11_SUPPORTED
@@ -545,16 +839,327 @@ bool XrAppBase::ProcessCommandLine( const std::string& cmdLine )
 
 void XrAppBase::RunMainFrame()
 {
+	XRDE_PROFILE_ZONE( "Frame" );
+
+	// the simulation thread runs on wall clock time, which would make replays nondeterministic
+	if ( m_threadedSimulation && SupportsThreadedSimulation() && !m_simulationThread.joinable() && !IsReplayingTrace() )
+	{
+		StartSimulationThread();
+	}
+
 	XrTime displayTime;
+	m_animatedThisFrame = false;
+	m_drawListBuilt = false;
 	RunXrFrame( &displayTime );
 
 	auto currTIme = m_frameTimer.GetElapsedTime();
+	if ( IsReplayingTrace() && displayTime != 0 )
+	{
+		// replays run as fast as possible, so drive the simulation from the recorded display times instead
+		if ( m_replayFirstDisplayTime == 0 )
+		{
+			m_replayFirstDisplayTime = displayTime;
+			m_prevFrameTime = 0;
+		}
+		currTIme = (double)( displayTime - m_replayFirstDisplayTime ) * 1e-9;
+	}
 	auto elapsedTime = currTIme - m_prevFrameTime;
 	m_prevFrameTime = currTIme;
-	Update( currTIme, elapsedTime, displayTime );
 
-	Render();
-	Present();
+	// frames that didn't wait still pose the models for the mirror
+	if ( !m_animatedThisFrame )
+	{
+		UpdateAnimations( elapsedTime );
+		m_lastAnimationDisplayTime = 0;
+	}
+
+	if ( !m_simulationThread.joinable() )
+	{
+		XRDE_PROFILE_ZONE( "Update" );
+		Update( currTIme, elapsedTime, displayTime );
+	}
+	m_lastFrameJobTimings = m_jobSystem.CollectTimings();
+
+	// the desktop mirror is the first thing to go when the governor needs time back, and offline replays skip it
+	bool renderMirror = !m_offline && ( m_mirrorFrame++ % m_mirrorInterval ) == 0;
+	if ( renderMirror )
+	{
+		XRDE_PROFILE_ZONE( "Mirror" );
+		XRDE::GpuProfileScope mirrorScope( m_gpuProfiler, m_pGraphicsBinding->GetImmediateContext(), "Mirror" );
+
+		// Update usually poses the models again after the eyes were drawn
+		m_sceneTransforms.Update( m_jobSystem );
+		if ( UpdateGpuSkinning( m_pGraphicsBinding->GetImmediateContext() ) )
+		{
+			m_gpuSkinning.Dispatch( m_pGraphicsBinding->GetImmediateContext(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+		}
+		Render();
+	}
+	m_gpuProfiler.EndFrame( m_pGraphicsBinding->GetImmediateContext() );
+	if ( m_gpuProfiler.GetFrameSeconds() > 0 )
+	{
+		m_framePacing.GpuFrameTimed( (int64_t)m_gpuProfiler.GetResultFrameIndex(), m_gpuProfiler.GetFrameSeconds() );
+	}
+	if ( renderMirror )
+	{
+		XRDE_PROFILE_ZONE( "Present" );
+		Present();
+	}
+	else if ( m_offline )
+	{
+		// nothing presents, so submit the frame here
+		m_pGraphicsBinding->GetImmediateContext()->Flush();
+	}
+
+	m_frameStats.cpuFrameSeconds = elapsedTime;
+	m_frameStats.cpuWaitSeconds = m_lastWaitFrameSeconds;
+	m_frameStats.cpuWorkSeconds = std::max( 0.0, elapsedTime - m_lastWaitFrameSeconds );
+	m_frameStats.displayPeriodSeconds = m_lastDisplayPeriodSeconds;
+	m_frameStats.cpuSubmitSeconds = m_lastSubmitCpuTime;
+	m_frameStats.gpuFrameSeconds = m_gpuProfiler.GetFrameSeconds();
+	m_frameStats.gpuPasses = m_gpuProfiler.GetPassTimings();
+
+	// Time spent in xrWaitFrame is the runtime pacing us, not work, so only the rest counts against the budget
+	m_qualityGovernor.Update( m_frameStats.displayPeriodSeconds, m_frameStats.cpuWorkSeconds, m_frameStats.gpuFrameSeconds );
+}
+
+bool XrAppBase::StartInputTrace()
+{
+	if ( !m_replayTracePath.empty() )
+	{
+		if ( !m_inputTrace.StartReplay( m_replayTracePath ) )
+			return false;
+	}
+	else if ( !m_recordTracePath.empty() )
+	{
+		if ( !m_inputTrace.StartRecording( m_recordTracePath ) )
+			return false;
+	}
+	else
+	{
+		return true;
+	}
+
+	m_traceFrameChannel = m_inputTrace.GetChannel( XRDE::TraceChannelKind::FrameState, "frame" );
+	m_traceViewsChannel = m_inputTrace.GetChannel( XRDE::TraceChannelKind::Views, "views" );
+	m_traceSessionChannel = m_inputTrace.GetChannel( XRDE::TraceChannelKind::SessionState, "session" );
+	m_traceHandChannels[ 0 ] = m_inputTrace.GetChannel( XRDE::TraceChannelKind::HandJoints, "hand/left" );
+	m_traceHandChannels[ 1 ] = m_inputTrace.GetChannel( XRDE::TraceChannelKind::HandJoints, "hand/right" );
+	m_traceViewConfigChannel = m_inputTrace.GetChannel( XRDE::TraceChannelKind::ViewConfiguration, "view configuration" );
+	XRDE::SetActiveInputTrace( &m_inputTrace );
+
+	if ( m_inputTrace.IsRecording() )
+	{
+		m_inputTrace.RecordViewConfiguration( m_traceViewConfigChannel, 2, m_views );
+	}
+	else if ( m_offline )
+	{
+		uint32_t viewCount = 0;
+		if ( !m_inputTrace.ReplayViewConfiguration( m_traceViewConfigChannel, 2, &viewCount, m_views ) || viewCount < 2 )
+		{
+			// a typical headset's recommended size
+			std::cerr << "The trace has no view configuration, rendering offline at 2016x2240\n";
+			for ( XrViewConfigurationView& view : m_views )
+			{
+				view.recommendedImageRectWidth = 2016;
+				view.recommendedImageRectHeight = 2240;
+				view.recommendedSwapchainSampleCount = 1;
+			}
+		}
+	}
+	return true;
+}
+
+void XrAppBase::FinishReplay()
+{
+	if ( m_offlineReadback.IsInitialized() )
+	{
+		m_offlineReadback.Drain( m_pGraphicsBinding->GetImmediateContext(),
+			[ this ]( const XRDE::ReadbackFrame& frame ) { WriteOfflineFrame( frame ); } );
+	}
+
+	// timed from the first replayed frame so loading doesn't count against the sustained rate
+	double seconds = m_frameTimer.GetElapsedTime() - m_replayStartTime;
+	std::cerr << ( m_offline ? "Offline replay" : "Replay" ) << " finished: " << m_replayFrameCount << " frames in " << seconds << "s";
+	if ( seconds > 0 )
+	{
+		std::cerr << " (" << (double)m_replayFrameCount / seconds << " fps)";
+	}
+	std::cerr << "\n";
+	std::cerr << "Render graph: " << m_renderGraph.GetTransientTextureCount() << " transient textures, "
+		<< m_renderGraph.GetLastBatchCount() << " transition batches and " << m_renderGraph.GetLastBarrierCount()
+		<< " barriers in the last frame\n";
+	if ( m_offlineReadback.IsInitialized() )
+	{
+		std::cerr << m_offlineFramesWritten << " eye images written to " << m_offlineOutputPath << "\n";
+	}
+
+	XRDE::SetActiveInputTrace( nullptr );
+	m_inputTrace.Close();
+	PostQuitMessage( 0 );
+}
+
+XrResult XrAppBase::LocateHandJointLocations( int hand, XrTime time, XrHandJointLocationsEXT* locations )
+{
+	if ( m_inputTrace.IsReplaying() )
+	{
+		XrResult res;
+		if ( !m_inputTrace.ReplayHandJoints( m_traceHandChannels[ hand ], &res, locations ) )
+			return XR_ERROR_HANDLE_INVALID;
+		return res;
+	}
+
+	if ( !m_enableHandTrackers )
+		return XR_ERROR_FUNCTION_UNSUPPORTED;
+
+	m_latencyTracker.PoseSampled( time );
+
+	XrHandJointsLocateInfoEXT locateInfo = { XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT };
+	locateInfo.time = time;
+	locateInfo.baseSpace = m_stageSpace;
+	XrResult res = m_xrLocateHandJointsEXT( m_handTrackers[ hand ], &locateInfo, locations );
+	m_inputTrace.RecordHandJoints( m_traceHandChannels[ hand ], res, *locations );
+	return res;
+}
+
+XrResult XrAppBase::LocateViews( XrTime displayTime, XrViewState* viewState, uint32_t viewCapacity, uint32_t* viewCount, XrView* views )
+{
+	if ( m_inputTrace.IsReplaying() )
+	{
+		XrResult res;
+		if ( !m_inputTrace.ReplayViews( m_traceViewsChannel, &res, viewState, viewCapacity, viewCount, views ) )
+			return XR_ERROR_HANDLE_INVALID;
+		return res;
+	}
+
+	m_latencyTracker.ViewsSampled( displayTime );
+	XrViewLocateInfo locateInfo = { XR_TYPE_VIEW_LOCATE_INFO };
+	locateInfo.displayTime = displayTime;
+	locateInfo.space = m_stageSpace;
+	locateInfo.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+	XrResult res = xrLocateViews( m_session, &locateInfo, viewState, viewCapacity, viewCount, views );
+	m_inputTrace.RecordViews( m_traceViewsChannel, res, *viewState, *viewCount, views );
+	return res;
+}
+
+void XrAppBase::RegisterQualityKnobs()
+{
+	static const float k_renderScales[] = { 1.f, 0.85f, 0.7f, 0.6f };
+	XRDE::QualityKnobDesc renderScale;
+	renderScale.name = "render scale";
+	renderScale.priority = 100;
+	renderScale.levelCount = (int)std::size( k_renderScales );
+	renderScale.cost = XRDE::QualityKnobCost::Gpu;
+	renderScale.apply = [ this ]( int level ) { m_renderScale = k_renderScales[ level ]; };
+	m_qualityGovernor.RegisterKnob( renderScale );
+
+	static const uint32_t k_mirrorIntervals[] = { 1, 2, 4 };
+	XRDE::QualityKnobDesc mirrorRate;
+	mirrorRate.name = "mirror rate";
+	mirrorRate.priority = 0;
+	mirrorRate.levelCount = (int)std::size( k_mirrorIntervals );
+	mirrorRate.cost = XRDE::QualityKnobCost::Both;
+	mirrorRate.apply = [ this ]( int level ) { m_mirrorInterval = k_mirrorIntervals[ level ]; };
+	m_qualityGovernor.RegisterKnob( mirrorRate );
+}
+
+uint32_t XrAppBase::GetEyeRenderWidth() const
+{
+	return std::max( 1u, (uint32_t)( m_views[ 0 ].recommendedImageRectWidth * m_renderScale ) );
+}
+
+uint32_t XrAppBase::GetEyeRenderHeight() const
+{
+	return std::max( 1u, (uint32_t)( m_views[ 0 ].recommendedImageRectHeight * m_renderScale ) );
+}
+
+void XrAppBase::SetEyeViewport( IDeviceContext* context )
+{
+	// SetRenderTargets resets the viewport to the whole target, so this has to come after it
+	Viewport viewport;
+	viewport.Width = (float)GetEyeRenderWidth();
+	viewport.Height = (float)GetEyeRenderHeight();
+	context->SetViewports( 1, &viewport, 0, 0 );
+}
+
+void XrAppBase::UpdateAnimations( double elapsedTime )
+{
+	XRDE_PROFILE_ZONE( "Animations" );
+	if ( m_haveLastViews )
+	{
+		m_animations.SetViews( m_lastViews );
+	}
+	m_animations.Update( m_jobSystem, elapsedTime );
+	m_animatedThisFrame = true;
+}
+
+void XrAppBase::StartSimulationThread()
+{
+	m_stopSimulation = false;
+	m_simulationThread = std::thread( &XrAppBase::SimulationThread, this );
+}
+
+void XrAppBase::StopSimulationThread()
+{
+	if ( !m_simulationThread.joinable() )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( m_simulationMutex );
+		m_stopSimulation = true;
+	}
+	m_simulationWake.notify_all();
+	m_simulationThread.join();
+}
+
+void XrAppBase::SimulationThread()
+{
+	XRDE_PROFILE_THREAD_NAME( "Simulation" );
+	XrTime lastDisplayTime = 0;
+	double prevTime = m_frameTimer.GetElapsedTime();
+	while ( true )
+	{
+		XrTime renderDisplayTime;
+		XrDuration displayPeriod;
+		{
+			// This lock only puts the thread to sleep between frames, the snapshots themselves are handed over
+			// through the lock-free triple buffer
+			std::unique_lock<std::mutex> lock( m_simulationMutex );
+			m_simulationWake.wait( lock, [ & ] { return m_stopSimulation || m_renderDisplayTime != lastDisplayTime; } );
+			if ( m_stopSimulation )
+				return;
+
+			renderDisplayTime = m_renderDisplayTime;
+			displayPeriod = m_renderDisplayPeriod;
+		}
+		lastDisplayTime = renderDisplayTime;
+
+		// The render thread is already working on renderDisplayTime, so simulate the frame after that one.
+		// It will pick the snapshot up after its next xrWaitFrame.
+		XrTime displayTime = renderDisplayTime + displayPeriod;
+
+		double currTime = m_frameTimer.GetElapsedTime();
+		XRDE::FrameSnapshot& snapshot = m_snapshots.WriteBuffer();
+		snapshot.displayTime = displayTime;
+		snapshot.simulationTime = currTime;
+		{
+			XRDE_PROFILE_ZONE( "Update" );
+			SimulateSnapshot( currTime, currTime - prevTime, displayTime, snapshot );
+		}
+		m_snapshots.Publish();
+		prevTime = currTime;
+	}
+}
+
+void XrAppBase::KeyPressed( wchar_t key )
+{
+	if ( ( key == L'p' || key == L'P' ) && !m_profileTracePath.empty() )
+	{
+		if ( XRDE::WriteProfileTrace( m_profileTracePath ) )
+		{
+			std::cerr << "Wrote profile trace to " << m_profileTracePath << "\n";
+		}
+	}
 }
 
 void XrAppBase::Present()
@@ -586,7 +1191,11 @@ bool XrAppBase::ShouldWait() const
 
 void XrAppBase::ProcessOpenXrEvents()
 {
-	while ( true )
+	XRDE_PROFILE_FUNCTION();
+	std::vector<XrSessionState> sessionStates;
+
+	// offline replays have no instance to poll
+	while ( m_instance != XR_NULL_HANDLE )
 	{
 		XrEventDataBuffer eventData = { XR_TYPE_EVENT_DATA_BUFFER };
 		XrResult res = xrPollEvent( m_instance, &eventData );
@@ -620,12 +1229,24 @@ void XrAppBase::ProcessOpenXrEvents()
 			}
 			break;
 
+			case XR_SESSION_STATE_EXITING:
+			case XR_SESSION_STATE_LOSS_PENDING:
+			{
+				// the session is going away, so a live replay ends here instead of rendering the rest of the trace
+				if ( m_inputTrace.IsReplaying() )
+				{
+					m_jobSystem.Wait( m_occlusionJobs );
+					FinishReplay();
+				}
+			}
+			break;
+
 			default:
 				// nothing special to do for this session state
 				break;
 			}
 
-			m_sessionState = event->state;
+			sessionStates.push_back( event->state );
 		}
 		break;
 
@@ -634,23 +1255,142 @@ void XrAppBase::ProcessOpenXrEvents()
 			break;
 		}
 	}
+
+	// Only an offline replay takes its session states from the trace. A live replay only replays poses and input,
+	// and follows the real session, so the runtime can still stop it or tell it the session is exiting or lost.
+	if ( m_offline )
+	{
+		if ( !m_inputTrace.ReplaySessionStates( m_traceSessionChannel, &sessionStates ) )
+		{
+			sessionStates.clear();
+		}
+	}
+	else if ( !m_inputTrace.IsReplaying() )
+	{
+		m_inputTrace.RecordSessionStates( m_traceSessionChannel, sessionStates );
+	}
+
+	for ( XrSessionState state : sessionStates )
+	{
+		m_sessionState = state;
+	}
 }
 
+namespace
+{
+	// adds the time until the end of the scope to a frame's total time blocked in the runtime
+	class RuntimeCallTimer
+	{
+	public:
+		explicit RuntimeCallTimer( double* seconds ) : m_seconds( seconds ), m_start( std::chrono::high_resolution_clock::now() ) {}
+		~RuntimeCallTimer()
+		{
+			*m_seconds += std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - m_start ).count();
+		}
+
+	private:
+		double* m_seconds;
+		std::chrono::high_resolution_clock::time_point m_start;
+	};
+}
+
+static const float k_nearClip = 0.01f;
+static const float k_farClip = 10.f;
+
 bool XrAppBase::RunXrFrame( XrTime *displayTime )
 {
+	XRDE_PROFILE_FUNCTION();
 	ProcessOpenXrEvents();
 
 	*displayTime = 0;
+	m_lastWaitFrameSeconds = 0;
+	m_lastDisplayPeriodSeconds = 0;
+	m_frameRuntimeSeconds = 0;
 
 	if ( !ShouldWait() )
 		return true;
 
+	// the occluders are rasterized while xrWaitFrame blocks, and have to be done before the draw list is built
+	if ( m_occlusionCulling && m_haveLastViews )
+	{
+		// a frame that bailed out early may not have waited for the last ones
+		m_jobSystem.Wait( m_occlusionJobs );
+		m_occlusionCuller.SetViews( m_lastViews, k_nearClip, k_farClip );
+		m_occlusionCuller.Rasterize( m_jobSystem, m_occlusionJobs );
+	}
+
 	XrFrameState frameState = { XR_TYPE_FRAME_STATE };
-	XrFrameWaitInfo waitInfo = { XR_TYPE_FRAME_WAIT_INFO };
-	CHECK_XR_RESULT( xrWaitFrame( m_session, &waitInfo, &frameState ) );
+	bool replaying = m_inputTrace.IsReplaying();
+	if ( replaying )
+	{
+		if ( !m_inputTrace.ReplayFrameState( m_traceFrameChannel, &frameState ) )
+		{
+			m_jobSystem.Wait( m_occlusionJobs );
+			FinishReplay();
+			return true;
+		}
+		if ( m_replayFrameCount++ == 0 )
+		{
+			m_replayStartTime = m_frameTimer.GetElapsedTime();
+		}
+	}
+	else
+	{
+		XRDE_PROFILE_ZONE( "xrWaitFrame" );
+		XrFrameWaitInfo waitInfo = { XR_TYPE_FRAME_WAIT_INFO };
+		double waitStart = m_frameTimer.GetElapsedTime();
+		CHECK_XR_RESULT( xrWaitFrame( m_session, &waitInfo, &frameState ) );
+		double waitEnd = m_frameTimer.GetElapsedTime();
+		m_lastWaitFrameSeconds = waitEnd - waitStart;
+		m_inputTrace.RecordFrameState( m_traceFrameChannel, frameState );
+
+		// replays don't keep the recorded pacing, so only live frames are analyzed
+		m_framePacing.FrameWaited( waitStart, waitEnd, frameState );
+	}
+	m_lastDisplayPeriodSeconds = (double)frameState.predictedDisplayPeriod * 1e-9;
+
+	if ( m_simulationThread.joinable() )
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_simulationMutex );
+			m_renderDisplayTime = frameState.predictedDisplayTime;
+			m_renderDisplayPeriod = frameState.predictedDisplayPeriod;
+		}
+		m_simulationWake.notify_one();
+
+		// use whatever the simulation most recently finished
+		if ( m_snapshots.Acquire() )
+		{
+			m_haveSnapshot = true;
+		}
+		if ( m_haveSnapshot )
+		{
+			ApplySnapshot( m_snapshots.ReadBuffer() );
+		}
+	}
 
-	XrFrameBeginInfo beginInfo = { XR_TYPE_FRAME_BEGIN_INFO };
-	CHECK_XR_RESULT( xrBeginFrame( m_session, &beginInfo ) );
+	// The models belong to the render thread whichever thread runs Update, so they're animated here. The step is
+	// the one between display times, which replays reproduce.
+	double animationStep = 0;
+	if ( m_lastAnimationDisplayTime != 0 && frameState.predictedDisplayTime > m_lastAnimationDisplayTime )
+	{
+		animationStep = (double)( frameState.predictedDisplayTime - m_lastAnimationDisplayTime ) * 1e-9;
+	}
+	m_lastAnimationDisplayTime = frameState.predictedDisplayTime;
+	UpdateAnimations( animationStep );
+
+	{
+		XRDE_PROFILE_ZONE( "Wait for occlusion culling" );
+		m_jobSystem.Wait( m_occlusionJobs );
+	}
+
+	if ( !replaying )
+	{
+		XRDE_PROFILE_ZONE( "xrBeginFrame" );
+		RuntimeCallTimer runtimeTimer( &m_frameRuntimeSeconds );
+		XrFrameBeginInfo beginInfo = { XR_TYPE_FRAME_BEGIN_INFO };
+		CHECK_XR_RESULT( xrBeginFrame( m_session, &beginInfo ) );
+	}
 
 	XrFrameEndInfo frameEndInfo = { XR_TYPE_FRAME_END_INFO };
 	frameEndInfo.displayTime = frameState.predictedDisplayTime;
@@ -659,77 +1399,235 @@ bool XrAppBase::RunXrFrame( XrTime *displayTime )
 
 	XrCompositionLayerProjectionView projectionViews[ 2 ] = { { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW }, { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW } };
 	XrCompositionLayerProjection projectionLayer = { XR_TYPE_COMPOSITION_LAYER_PROJECTION };
-	XrCompositionLayerBaseHeader* layers[] = { (XrCompositionLayerBaseHeader*)&projectionLayer };
+	m_frameLayers.clear();
 
+	int64_t gpuFrame = -1;
 	if ( frameState.shouldRender && ShouldRender() )
 	{
-		// acquire the image index for this swapchain
-		XrSwapchainImageAcquireInfo acquireInfo = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
 		uint32_t colorIndex, depthIndex;
-		CHECK_XR_RESULT( xrAcquireSwapchainImage( m_swapchain, &acquireInfo, &colorIndex ) );
-		CHECK_XR_RESULT( xrAcquireSwapchainImage( m_depthSwapchain, &acquireInfo, &depthIndex ) );
-
-		// wait for swap chains
-		XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
-		waitInfo.timeout = 999999;
-		CHECK_XR_RESULT( xrWaitSwapchainImage( m_swapchain, &waitInfo ) );
-		CHECK_XR_RESULT( xrWaitSwapchainImage( m_depthSwapchain, &waitInfo ) );
-
-		XrViewLocateInfo locateInfo = { XR_TYPE_VIEW_LOCATE_INFO };
-		locateInfo.displayTime = frameState.predictedDisplayTime;
-		locateInfo.space = m_stageSpace;
-		locateInfo.viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+		if ( m_offline )
+		{
+			// the app owns the offline eye textures, so just take turns
+			colorIndex = depthIndex = m_offlineImageIndex;
+			m_offlineImageIndex = ( m_offlineImageIndex + 1 ) % (uint32_t)m_rpColorSwapchainTextures.size();
+		}
+		else
+		{
+			XRDE_PROFILE_ZONE( "Acquire swapchain images" );
+			RuntimeCallTimer runtimeTimer( &m_frameRuntimeSeconds );
+
+			// acquire the image index for this swapchain
+			XrSwapchainImageAcquireInfo acquireInfo = { XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+			CHECK_XR_RESULT( xrAcquireSwapchainImage( m_swapchain, &acquireInfo, &colorIndex ) );
+			CHECK_XR_RESULT( xrAcquireSwapchainImage( m_depthSwapchain, &acquireInfo, &depthIndex ) );
+
+			// wait for swap chains
+			XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+			waitInfo.timeout = 999999;
+			CHECK_XR_RESULT( xrWaitSwapchainImage( m_swapchain, &waitInfo ) );
+			CHECK_XR_RESULT( xrWaitSwapchainImage( m_depthSwapchain, &waitInfo ) );
+		}
 
 		XrViewState viewState = { XR_TYPE_VIEW_STATE };
 		XrView views[ 2 ] = { { XR_TYPE_VIEW }, { XR_TYPE_VIEW } };
 		uint32_t viewCount;
-		CHECK_XR_RESULT( xrLocateViews( m_session, &locateInfo, &viewState, 2, &viewCount, views ) );
+		{
+			XRDE_PROFILE_ZONE( "LocateViews" );
+			CHECK_XR_RESULT( LocateViews( frameState.predictedDisplayTime, &viewState, 2, &viewCount, views ) );
+		}
+		m_lastViews[ 0 ] = views[ 0 ];
+		m_lastViews[ 1 ] = views[ 1 ];
+		m_haveLastViews = true;
+
+		auto submitStart = std::chrono::high_resolution_clock::now();
+		IDeviceContext* immediateContext = m_pGraphicsBinding->GetImmediateContext();
+		m_latencyTracker.RecordStarted( frameState.predictedDisplayTime );
+		m_gpuProfiler.BeginFrame( immediateContext );
+		if ( m_gpuProfiler.IsEnabled() )
+		{
+			gpuFrame = (int64_t)m_gpuProfiler.GetFrameIndex();
+		}
 
-		static const float k_nearClip = 0.01f;
-		static const float k_farClip = 10.f;
+		// both eyes draw the same instances, so they're sorted and uploaded once, and the same goes for skinning
+		m_drawList.Build( immediateContext );
+		m_drawListBuilt = true;
+		m_sceneTransforms.Update( m_jobSystem );
+		m_lodSelector.Update( views, GetEyeRenderWidth(), GetEyeRenderHeight() );
+		bool skinning = UpdateGpuSkinning( immediateContext );
+
+		// the whole frame is declared up front so the graph can batch its state transitions, and it leaves the
+		// swapchain images in the states OpenXR expects them back in
+		m_renderGraph.Reset();
+		uint32_t color = m_renderGraph.ImportTexture( m_rpColorSwapchainTextures[ colorIndex ], RESOURCE_STATE_RENDER_TARGET );
+		uint32_t depth = m_offline ? m_renderGraph.CreateTransientTexture( m_offlineDepthDesc )
+			: m_renderGraph.ImportTexture( m_rpDepthSwapchainTextures[ depthIndex ], RESOURCE_STATE_DEPTH_WRITE );
+
+		if ( skinning )
+		{
+			m_renderGraph.AddPass( "Skin glTF models",
+				[ & ]( XRDE::RenderGraphPassBuilder& pass )
+				{
+					pass.SetProfileName( "Skinning" );
+					m_gpuSkinning.DeclareResources( pass );
+				},
+				[ this ]( IDeviceContext* context )
+				{
+					m_gpuSkinning.Dispatch( context );
+				} );
+		}
 
-		// render
-		for ( uint32_t i = 0; i < 2; i++ )
+		// one culling pass serves both eyes, so it tests against both frusta
+		float4x4 stageToProj[ 2 ];
+		if ( m_drawList.IsGpuCullingEnabled() )
 		{
+			for ( uint32_t i = 0; i < 2; i++ )
+			{
+				float4x4 eyeToProj;
+				float4x4_CreateProjection( &eyeToProj, m_DeviceType, views[ i ].fov, k_nearClip, k_farClip );
+				stageToProj[ i ] = matrixFromPose( views[ i ].pose ).Inverse() * eyeToProj;
+			}
 
-			float4x4 eyeToProj;
-			float4x4_CreateProjection( &eyeToProj, m_DeviceType, views[ i ].fov, k_nearClip, k_farClip );
+			m_renderGraph.AddPass( "Cull draw list",
+				[ & ]( XRDE::RenderGraphPassBuilder& pass )
+				{
+					pass.SetProfileName( "Culling" );
+					m_drawList.DeclareCullResources( pass );
+				},
+				[ this, &stageToProj ]( IDeviceContext* context )
+				{
+					m_drawList.Cull( context, stageToProj );
+				} );
+		}
 
-			m_ViewToProj = eyeToProj;
+		for ( uint32_t i = 0; i < 2; i++ )
+		{
+			ITextureView* eyeBuffer = m_rpEyeSwapchainViews[ i ][ colorIndex ];
+			// null for the offline transient, whose default view the graph binds
+			ITextureView* depthBuffer = m_offline ? nullptr : m_rpEyeDepthViews[ i ][ depthIndex ];
+			m_renderGraph.AddPass( i == 0 ? "Left eye" : "Right eye",
+				[ & ]( XRDE::RenderGraphPassBuilder& pass )
+				{
+					static const float k_clearColor[] = { 1.f, 0.350f, 0.350f, 1.0f };
+					pass.WriteColor( color, XRDE::AttachmentLoad::Clear, k_clearColor, eyeBuffer );
+					pass.WriteDepth( depth, XRDE::AttachmentLoad::Clear, 1.f, depthBuffer );
+					pass.SetProfileName( "RenderEye", i );
+					m_drawList.DeclareResources( pass );
+					DeclareEyeResources( i, pass );
+
+					// the eye's constants are mapped before its render pass begins
+					pass.SetPrepare( [ this, i, &views ]( IDeviceContext* context )
+						{
+							float4x4 eyeToProj;
+							float4x4_CreateProjection( &eyeToProj, m_DeviceType, views[ i ].fov, k_nearClip, k_farClip );
+
+							m_ViewToProj = eyeToProj;
+
+							float4x4 eyeToStage = matrixFromPose( views[ i ].pose );
+							float4x4 stageToEye = eyeToStage.Inverse();
+
+							UpdateEyeTransforms( eyeToProj, stageToEye, views[ i ] );
+						} );
+				},
+				[ this, i ]( IDeviceContext* context )
+				{
+					XRDE_PROFILE_ZONE( "RenderEye" );
+					SetEyeViewport( context );
+					RenderEye( i );
+				} );
 
-			float4x4 eyeToStage = matrixFromPose( views[ i ].pose );
-			float4x4 stageToEye = eyeToStage.Inverse();
+			// command lists can't be executed inside a render pass, so the chunks get a pass of their own
+			if ( GetEyeDrawChunkCount( i ) )
+			{
+				m_renderGraph.AddPass( i == 0 ? "Left eye chunks" : "Right eye chunks",
+					[ & ]( XRDE::RenderGraphPassBuilder& pass )
+					{
+						pass.WriteColor( color, XRDE::AttachmentLoad::Load, nullptr, eyeBuffer );
+						pass.WriteDepth( depth, XRDE::AttachmentLoad::Load, 1.f, depthBuffer );
+						pass.BindWithoutRenderPass();
+						pass.SetProfileName( "Chunks", i );
+					},
+					[ this, i, eyeBuffer, depthBuffer, depth ]( IDeviceContext* context )
+					{
+						ITextureView* depthView = depthBuffer;
+						if ( !depthView )
+						{
+							ITexture* transient = m_renderGraph.GetTexture( depth );
+							depthView = transient ? transient->GetDefaultView( TEXTURE_VIEW_DEPTH_STENCIL ) : nullptr;
+						}
+						RenderEyeChunks( i, eyeBuffer, depthView );
+					} );
+			}
 
-			UpdateEyeTransforms( eyeToProj, stageToEye, views[ i ] );
-			UpdateGltfBuffers( eyeToProj, stageToEye, views[ i ], k_nearClip, k_farClip );
+			// the PBR renderer transitions what it binds, which isn't allowed inside a render pass either
+			if ( m_gltfRenderer && m_gltfCachePolicy.GetLiveModelCount() )
+			{
+				m_renderGraph.AddPass( i == 0 ? "Left eye glTF" : "Right eye glTF",
+					[ & ]( XRDE::RenderGraphPassBuilder& pass )
+					{
+						pass.WriteColor( color, XRDE::AttachmentLoad::Load, nullptr, eyeBuffer );
+						pass.WriteDepth( depth, XRDE::AttachmentLoad::Load, 1.f, depthBuffer );
+						pass.BindWithoutRenderPass();
+						pass.SetProfileName( "glTF", i );
+						DeclareGltfResources( pass );
+						pass.SetPrepare( [ this, i, &views ]( IDeviceContext* context )
+							{
+								float4x4 eyeToProj;
+								float4x4_CreateProjection( &eyeToProj, m_DeviceType, views[ i ].fov, k_nearClip, k_farClip );
+								float4x4 stageToEye = matrixFromPose( views[ i ].pose ).Inverse();
+								UpdateGltfBuffers( eyeToProj, stageToEye, views[ i ], k_nearClip, k_farClip );
+							} );
+					},
+					[ this, i ]( IDeviceContext* context )
+					{
+						XRDE_PROFILE_ZONE( "RenderEyeGltf" );
+						SetEyeViewport( context );
+						RenderEyeGltf( i );
+					} );
+			}
+		}
 
-			// Clear the back buffer
-			auto& eyeBuffer = m_rpEyeSwapchainViews[ i ][ colorIndex ];
-			auto& depthBuffer = m_rpEyeDepthViews[ i ][ depthIndex ];
-			const float ClearColor[] = { 1.f, 0.350f, 0.350f, 1.0f };
-			m_pGraphicsBinding->GetImmediateContext()->SetRenderTargets( 1, &eyeBuffer, depthBuffer, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-			m_pGraphicsBinding->GetImmediateContext()->ClearRenderTarget( eyeBuffer, ClearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
-			m_pGraphicsBinding->GetImmediateContext()->ClearDepthStencil( depthBuffer, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION );
+		if ( m_offlineReadback.IsInitialized() )
+		{
+			m_renderGraph.AddPass( "Offline readback",
+				[ & ]( XRDE::RenderGraphPassBuilder& pass ) { pass.Read( color, RESOURCE_STATE_COPY_SOURCE ); },
+				[ this, colorIndex ]( IDeviceContext* context ) { ReadBackOfflineEyes( m_rpColorSwapchainTextures[ colorIndex ] ); } );
+		}
 
-			RenderEye( i );
+		// the copies have to be recorded before the image goes back to the runtime
+		if ( m_frameCapture.IsEnabled() )
+		{
+			m_renderGraph.AddPass( "Capture",
+				[ & ]( XRDE::RenderGraphPassBuilder& pass )
+				{
+					pass.Read( color, RESOURCE_STATE_COPY_SOURCE );
+					pass.SetProfileName( "Capture" );
+				},
+				[ this, colorIndex ]( IDeviceContext* context )
+				{
+					m_frameCapture.Capture( context, m_rpColorSwapchainTextures[ colorIndex ], GetEyeRenderWidth(), GetEyeRenderHeight() );
+				} );
 		}
 
-		// ensure the swapchain images have the resource state required by OpenXR in order to release to the runtime
+		m_renderGraph.Execute( immediateContext );
+
+		// replays don't submit, so there's nothing to show the layers on
+		if ( m_compositionLayers.IsInitialized() && !replaying )
 		{
-			StateTransitionDesc transitions[ 2 ]; // color and depth
-			transitions[0].pResource = m_rpColorSwapchainTextures[ colorIndex ];
-			transitions[0].NewState = RESOURCE_STATE_RENDER_TARGET;
-			transitions[0].Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
-			transitions[1].pResource = m_rpDepthSwapchainTextures[ depthIndex ];
-			transitions[1].NewState = RESOURCE_STATE_DEPTH_WRITE;
-			transitions[1].Flags = STATE_TRANSITION_FLAG_UPDATE_STATE;
-			m_pGraphicsBinding->GetImmediateContext()->TransitionResourceStates( 2, transitions );
+			XRDE::GpuProfileScope layerScope( m_gpuProfiler, immediateContext, "Layers" );
+			m_compositionLayers.UpdateLayers( immediateContext, frameState.predictedDisplayTime );
 		}
 
+		m_lastSubmitCpuTime = std::chrono::duration<double>( std::chrono::high_resolution_clock::now() - submitStart ).count();
+
 		// release the image we just rendered into
-		XrSwapchainImageReleaseInfo releaseInfo = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
-		CHECK_XR_RESULT( xrReleaseSwapchainImage( m_swapchain, &releaseInfo ) );
-		CHECK_XR_RESULT( xrReleaseSwapchainImage( m_depthSwapchain, &releaseInfo ) );
+		if ( !m_offline )
+		{
+			XRDE_PROFILE_ZONE( "Release swapchain images" );
+			RuntimeCallTimer runtimeTimer( &m_frameRuntimeSeconds );
+			XrSwapchainImageReleaseInfo releaseInfo = { XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+			CHECK_XR_RESULT( xrReleaseSwapchainImage( m_swapchain, &releaseInfo ) );
+			CHECK_XR_RESULT( xrReleaseSwapchainImage( m_depthSwapchain, &releaseInfo ) );
+		}
 
 		XrCompositionLayerDepthInfoKHR depthLayers[ 2 ] = { { XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR }, { XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR } };
 		for ( uint32_t i = 0; i < 2; i++ )
@@ -742,8 +1640,8 @@ bool XrAppBase::RunXrFrame( XrTime *displayTime )
 			{
 				{ 0, 0 },
 				{
-					(int32_t)m_views[ 0 ].recommendedImageRectWidth,
-					(int32_t)m_views[ 0 ].recommendedImageRectHeight
+					(int32_t)GetEyeRenderWidth(),
+					(int32_t)GetEyeRenderHeight()
 				}
 			};
 
@@ -764,34 +1662,99 @@ bool XrAppBase::RunXrFrame( XrTime *displayTime )
 		projectionLayer.viewCount = 2;
 		projectionLayer.views = projectionViews;
 
-		frameEndInfo.layers = layers;
-		frameEndInfo.layerCount = 1;
+		// the other layers go on top of the scene
+		m_frameLayers.push_back( (XrCompositionLayerBaseHeader*)&projectionLayer );
+		if ( !replaying )
+		{
+			m_compositionLayers.AppendLayers( m_frameLayers );
+		}
+		frameEndInfo.layers = m_frameLayers.data();
+		frameEndInfo.layerCount = (uint32_t)m_frameLayers.size();
 	}
 
-	CHECK_XR_RESULT( xrEndFrame( m_session, &frameEndInfo ) );
+	if ( !replaying )
+	{
+		{
+			XRDE_PROFILE_ZONE( "xrEndFrame" );
+			RuntimeCallTimer runtimeTimer( &m_frameRuntimeSeconds );
+			m_latencyTracker.FrameEnded( frameEndInfo.displayTime );
+			CHECK_XR_RESULT( xrEndFrame( m_session, &frameEndInfo ) );
+		}
+		m_framePacing.FrameEnded( m_frameRuntimeSeconds, gpuFrame );
+	}
+
+	m_commandRecorder.FinishFrame();
 
 	return true;
 }
 
 
-void XrAppBase::CreateGLTFResourceCache()
+void XrAppBase::RenderEyeChunks( int eye, ITextureView* eyeBuffer, ITextureView* depthBuffer )
+{
+	uint32_t chunkCount = GetEyeDrawChunkCount( eye );
+	if ( !chunkCount )
+		return;
+
+	IDeviceContext* immediateContext = m_pGraphicsBinding->GetImmediateContext();
+	PrepareEyeDrawChunks( eye, immediateContext );
+
+	m_commandRecorder.RecordAndExecute( immediateContext, chunkCount,
+		[ & ]( IDeviceContext* context )
+		{
+			// the immediate context already transitioned the eye buffers when it cleared them
+			context->SetRenderTargets( 1, &eyeBuffer, depthBuffer, RESOURCE_STATE_TRANSITION_MODE_VERIFY );
+			SetEyeViewport( context );
+		},
+		[ & ]( IDeviceContext* context, uint32_t firstChunk, uint32_t count )
+		{
+			RecordEyeDrawChunks( eye, context, firstChunk, count );
+		} );
+}
+
+
+void XrAppBase::DeclareGltfResources( XRDE::RenderGraphPassBuilder& pass )
 {
-	std::array<BufferSuballocatorCreateInfo, 3> Buffers = {};
+	// The graph has these in the right states before the glTF pass, so the transitions the PBR renderer asks for
+	// when it binds them don't issue barriers
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+	IDeviceContext* context = m_pGraphicsBinding->GetImmediateContext();
+	if ( m_pResourceMgr )
+	{
+		pass.Read( m_pResourceMgr->GetBuffer( XRDE::GltfPool_BasicVertexAttribs, device, context ), RESOURCE_STATE_VERTEX_BUFFER );
+		pass.Read( m_pResourceMgr->GetBuffer( XRDE::GltfPool_SkinVertexAttribs, device, context ), RESOURCE_STATE_VERTEX_BUFFER );
+		pass.Read( m_pResourceMgr->GetBuffer( XRDE::GltfPool_Indices, device, context ), RESOURCE_STATE_INDEX_BUFFER );
+		pass.Read( m_pResourceMgr->GetTexture( TEX_FORMAT_RGBA8_UNORM, device, context ), RESOURCE_STATE_SHADER_RESOURCE );
+	}
+	if ( m_gltfRenderer && m_pEnvironmentMapSRV )
+	{
+		pass.Read( m_gltfRenderer->GetIrradianceCubeSRV()->GetTexture(), RESOURCE_STATE_SHADER_RESOURCE );
+		pass.Read( m_gltfRenderer->GetPrefilteredEnvCubeSRV()->GetTexture(), RESOURCE_STATE_SHADER_RESOURCE );
+		pass.Read( m_gltfRenderer->GetBRDFLUTSRV()->GetTexture(), RESOURCE_STATE_SHADER_RESOURCE );
+	}
+}
 
-	Buffers[ 0 ].Desc.Name = "GLTF basic vertex attribs buffer";
-	Buffers[ 0 ].Desc.BindFlags = BIND_VERTEX_BUFFER;
-	Buffers[ 0 ].Desc.Usage = USAGE_DEFAULT;
-	Buffers[ 0 ].Desc.uiSizeInBytes = sizeof( GLTF::Model::VertexBasicAttribs ) * 16 << 10;
 
-	Buffers[ 1 ].Desc.Name = "GLTF skin attribs buffer";
-	Buffers[ 1 ].Desc.BindFlags = BIND_VERTEX_BUFFER;
-	Buffers[ 1 ].Desc.Usage = USAGE_DEFAULT;
-	Buffers[ 1 ].Desc.uiSizeInBytes = sizeof( GLTF::Model::VertexSkinAttribs ) * 16 << 10;
+bool XrAppBase::UpdateGpuSkinning( IDeviceContext* context )
+{
+	if ( !m_gltfCachePolicy.IsGpuSkinningEnabled() || !m_pResourceMgr )
+		return false;
+
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+	return m_gpuSkinning.Update( context, m_pResourceMgr->GetBuffer( XRDE::GltfPool_BasicVertexAttribs, device, context ),
+		m_pResourceMgr->GetBuffer( XRDE::GltfPool_SkinVertexAttribs, device, context ) );
+}
 
-	Buffers[ 2 ].Desc.Name = "GLTF index buffer";
-	Buffers[ 2 ].Desc.BindFlags = BIND_INDEX_BUFFER;
-	Buffers[ 2 ].Desc.Usage = USAGE_DEFAULT;
-	Buffers[ 2 ].Desc.uiSizeInBytes = sizeof( Uint32 ) * 8 << 10;
+
+void XrAppBase::CreateGLTFResourceCache()
+{
+	if ( !m_gltfCachePolicyInitialized )
+	{
+		m_gltfCachePolicy.AddManifestEntries( GetGltfModelManifest() );
+		m_gltfCachePolicyInitialized = true;
+	}
+
+	std::array<BufferSuballocatorCreateInfo, XRDE::GltfPool_Count> Buffers = {};
+	m_gltfCachePolicy.FillBufferSuballocators( Buffers.data(), static_cast<Uint32>( Buffers.size() ) );
 
 	std::array<DynamicTextureAtlasCreateInfo, 1> Atlases;
 	Atlases[ 0 ].Desc.Name = "GLTF texture atlas";
@@ -819,21 +1782,24 @@ void XrAppBase::CreateGLTFResourceCache()
 	m_pResourceMgr = GLTF::ResourceManager::Create( m_pGraphicsBinding->GetRenderDevice(), ResourceMgrCI );
 
 	m_CacheUseInfo.pResourceMgr = m_pResourceMgr;
-	m_CacheUseInfo.VertexBuffer0Idx = 0;
-	m_CacheUseInfo.VertexBuffer1Idx = 1;
-	m_CacheUseInfo.IndexBufferIdx = 2;
+	m_CacheUseInfo.VertexBuffer0Idx = XRDE::GltfPool_BasicVertexAttribs;
+	m_CacheUseInfo.VertexBuffer1Idx = XRDE::GltfPool_SkinVertexAttribs;
+	m_CacheUseInfo.IndexBufferIdx = XRDE::GltfPool_Indices;
 
 	m_CacheUseInfo.BaseColorFormat = TEX_FORMAT_RGBA8_UNORM;
 	m_CacheUseInfo.PhysicalDescFormat = TEX_FORMAT_RGBA8_UNORM;
 	m_CacheUseInfo.NormalFormat = TEX_FORMAT_RGBA8_UNORM;
 	m_CacheUseInfo.OcclusionFormat = TEX_FORMAT_RGBA8_UNORM;
 	m_CacheUseInfo.EmissiveFormat = TEX_FORMAT_RGBA8_UNORM;
+
+	UpdateGltfCacheStats();
 }
 
 
 
 std::unique_ptr<GLTF::Model> XrAppBase::LoadGltfModel( const std::string& path )
 {
+	XRDE_PROFILE_FUNCTION();
 	GLTF::Model::CreateInfo ci;
 	ci.FileName = path.c_str();
 	ci.LoadAnimationAndSkin = true;
@@ -842,14 +1808,76 @@ std::unique_ptr<GLTF::Model> XrAppBase::LoadGltfModel( const std::string& path )
 	auto model = std::make_unique<GLTF::Model>(
 		m_pGraphicsBinding->GetRenderDevice(), m_pGraphicsBinding->GetImmediateContext(), ci );
 
+	m_gltfCachePolicy.OnModelLoaded( model.get() );
+	m_sceneTransforms.AddModel( model.get() );
+	if ( m_gltfCachePolicy.IsGpuSkinningEnabled() && m_pResourceMgr )
+	{
+		IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+		IDeviceContext* context = m_pGraphicsBinding->GetImmediateContext();
+		m_gpuSkinning.AddModel( context, model.get(),
+			m_pResourceMgr->GetBuffer( XRDE::GltfPool_BasicVertexAttribs, device, context ) );
+	}
+
+	// last, since it takes the coarser levels' primitives out of their nodes
+	m_lodSelector.AddModel( model.get() );
 	return model;
 }
 
+void XrAppBase::ReleaseGltfModel( std::unique_ptr<GLTF::Model>& model )
+{
+	m_lodSelector.RemoveModel( model.get() );
+	m_gltfCachePolicy.OnModelReleased( model.get() );
+	m_gpuSkinning.RemoveModel( model.get() );
+	m_sceneTransforms.RemoveModel( model.get() );
+	m_animations.RemoveModel( model.get() );
+	model.reset();
+}
+
+bool XrAppBase::TrimGltfResourceCache()
+{
+	UpdateGltfCacheStats();
+	if ( !m_gltfCachePolicy.ShouldTrim() )
+		return false;
+
+	// Nothing lives in the cache anymore, so throw away the grown and fragmented pages and start over at the
+	// size the manifest asked for
+	m_pGraphicsBinding->GetImmediateContext()->Flush();
+	m_CacheUseInfo.pResourceMgr = nullptr;
+	m_pResourceMgr.Release();
+	CreateGLTFResourceCache();
+	m_gltfCachePolicy.OnCacheRecreated();
+
+	// The bindings still point at the old pools and atlas. The new cache can start at the same texture version
+	// the old one had, so GLTF_PBR_Renderer::Begin wouldn't notice. Without an SRB it builds new bindings.
+	m_CacheBindings = GLTF_PBR_Renderer::ResourceCacheBindings();
+	return true;
+}
+
+void XrAppBase::UpdateGltfCacheStats()
+{
+	IRenderDevice* device = m_pGraphicsBinding->GetRenderDevice();
+	IDeviceContext* context = m_pGraphicsBinding->GetImmediateContext();
+	m_gltfCachePolicy.UpdateStats( m_pResourceMgr, device, context );
+
+	// the pools can grow or be recreated, so re-register whatever is backing them now
+	m_memoryBudget.UnregisterCategory( XRDE::MemoryCategory::GltfBuffers );
+	m_memoryBudget.UnregisterCategory( XRDE::MemoryCategory::TextureAtlas );
+	if ( !m_pResourceMgr )
+		return;
+
+	for ( Uint32 pool = 0; pool < XRDE::GltfPool_Count; pool++ )
+	{
+		m_memoryBudget.RegisterBuffer( m_pResourceMgr->GetBuffer( pool, device, context ), XRDE::MemoryCategory::GltfBuffers );
+	}
+	m_memoryBudget.RegisterTexture( m_pResourceMgr->GetTexture( TEX_FORMAT_RGBA8_UNORM, device, context ),
+		XRDE::MemoryCategory::TextureAtlas );
+}
+
 void XrAppBase::CreateGltfRenderer()
 {
 	GLTF_PBR_Renderer::CreateInfo rendererCi;
 	rendererCi.RTVFmt = m_rpEyeSwapchainViews[ 0 ].front()->GetDesc().Format;
-	rendererCi.DSVFmt = m_rpEyeDepthViews[ 0 ].front()->GetDesc().Format;
+	rendererCi.DSVFmt = m_offline ? m_offlineDepthDesc.Format : m_rpEyeDepthViews[ 0 ].front()->GetDesc().Format;
 	rendererCi.AllowDebugView = true;
 	rendererCi.UseIBL = true;
 	rendererCi.FrontCCW = true;
@@ -860,6 +1888,8 @@ void XrAppBase::CreateGltfRenderer()
 
 	CreateUniformBuffer( m_pGraphicsBinding->GetRenderDevice(), sizeof( CameraAttribs ), "Camera attribs buffer", &m_CameraAttribsCB );
 	CreateUniformBuffer( m_pGraphicsBinding->GetRenderDevice(), sizeof( LightAttribs ), "Light attribs buffer", &m_LightAttribsCB );
+	m_memoryBudget.RegisterBuffer( m_CameraAttribsCB, XRDE::MemoryCategory::ConstantBuffers );
+	m_memoryBudget.RegisterBuffer( m_LightAttribsCB, XRDE::MemoryCategory::ConstantBuffers );
 	//	CreateUniformBuffer( m_pGraphicsBinding->GetRenderDevice(), sizeof( EnvMapRenderAttribs ), "Env map render attribs buffer", &m_EnvMapRenderAttribsCB );
 	// clang-format off
 	StateTransitionDesc Barriers[] =
@@ -875,12 +1905,19 @@ void XrAppBase::CreateGltfRenderer()
 
 void XrAppBase::SetPbrEnvironmentMap( const std::string& environmentMapPath )
 {
+	XRDE_PROFILE_FUNCTION();
 	RefCntAutoPtr<ITexture> environmentMap;
 	CreateTextureFromFile( environmentMapPath.c_str(), TextureLoadInfo { "Environment Map" }, m_pGraphicsBinding->GetRenderDevice(),
 		&environmentMap );
 	m_pEnvironmentMapSRV = environmentMap->GetDefaultView( TEXTURE_VIEW_SHADER_RESOURCE );
 	m_gltfRenderer->PrecomputeCubemaps( m_pGraphicsBinding->GetRenderDevice(), m_pGraphicsBinding->GetImmediateContext(),
 		m_pEnvironmentMapSRV );
+
+	m_memoryBudget.UnregisterCategory( XRDE::MemoryCategory::EnvironmentMaps );
+	m_memoryBudget.RegisterTexture( environmentMap, XRDE::MemoryCategory::EnvironmentMaps );
+	m_memoryBudget.RegisterTexture( m_gltfRenderer->GetIrradianceCubeSRV()->GetTexture(), XRDE::MemoryCategory::EnvironmentMaps );
+	m_memoryBudget.RegisterTexture( m_gltfRenderer->GetPrefilteredEnvCubeSRV()->GetTexture(), XRDE::MemoryCategory::EnvironmentMaps );
+	m_memoryBudget.RegisterTexture( m_gltfRenderer->GetBRDFLUTSRV()->GetTexture(), XRDE::MemoryCategory::EnvironmentMaps );
 }
 
 
@@ -896,7 +1933,7 @@ void XrAppBase::UpdateGltfBuffers( float4x4 eyeToProj, float4x4 stageToEye, XrVi
 		CamAttribs->mViewProjInvT = stageToProj.Inverse().Transpose();
 		CamAttribs->f4Position = float4( vectorFromXrVector( view.pose.position ), 1 );
 
-		float2 viewSize = { (float)m_views[ 0 ].recommendedImageRectWidth, (float)m_views[ 0 ].recommendedImageRectHeight };
+		float2 viewSize = { (float)GetEyeRenderWidth(), (float)GetEyeRenderHeight() };
 		CamAttribs->f4ViewportSize = { viewSize.x, viewSize.y, 1.f / viewSize.x, 1.f / viewSize.y };
 		CamAttribs->f2ViewportOrigin = { 0, 0 };
 		CamAttribs->fNearPlaneZ = nearClip;
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Compares two xrbase_bench JSON result files and reports benchmarks that got slower.
+
+    compare_bench.py <baseline.json> <current.json> [--threshold 0.10] [--metric cpu_time]
+    compare_bench.py <baseline.json> <current.json> --update
+
+Uses the median aggregate for each benchmark when there is one, and the mean of the individual runs otherwise.
+Exits with 1 if any benchmark regressed by more than the threshold. A missing baseline isn't an error, so a
+fresh checkout can build the compare target before anyone recorded one. --update replaces the baseline with the
+current results instead of comparing.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import sys
+
+
+def load_results(path, metric):
+    with open(path) as f:
+        data = json.load(f)
+
+    medians = {}
+    runs = {}
+    for bench in data.get("benchmarks", []):
+        if bench.get("error_occurred"):
+            continue
+        name = bench.get("run_name", bench["name"])
+        if bench.get("run_type") == "aggregate":
+            if bench.get("aggregate_name") == "median":
+                medians[name] = bench[metric]
+        else:
+            runs.setdefault(name, []).append(bench[metric])
+
+    results = {name: sum(values) / len(values) for name, values in runs.items()}
+    results.update(medians)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="fractional slowdown that counts as a regression (default 0.10)")
+    parser.add_argument("--metric", default="cpu_time", choices=["cpu_time", "real_time"])
+    parser.add_argument("--update", action="store_true", help="copy current over baseline and exit")
+    args = parser.parse_args()
+
+    if args.update:
+        os.makedirs(os.path.dirname(os.path.abspath(args.baseline)), exist_ok=True)
+        shutil.copyfile(args.current, args.baseline)
+        print("Baseline updated from " + args.current)
+        return 0
+
+    try:
+        baseline = load_results(args.baseline, args.metric)
+    except FileNotFoundError:
+        print("No baseline at %s, nothing to compare. Record a baseline first, on the reference machine with --update."
+              % args.baseline)
+        return 0
+    current = load_results(args.current, args.metric)
+
+    regressions = 0
+    print("%-48s %12s %12s %8s" % ("Benchmark", "Baseline", "Current", "Change"))
+    print("-" * 84)
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print("%-48s %12.1f %12s %8s" % (name, baseline[name], "missing", ""))
+            continue
+        if name not in baseline:
+            print("%-48s %12s %12.1f %8s" % (name, "new", current[name], ""))
+            continue
+
+        old = baseline[name]
+        new = current[name]
+        change = (new - old) / old if old > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-48s %12.1f %12.1f %+7.1f%%%s" % (name, old, new, change * 100.0, flag))
+
+    if regressions:
+        print("\n%d benchmark(s) regressed by more than %.0f%% in %s" % (regressions, args.threshold * 100.0, args.metric))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
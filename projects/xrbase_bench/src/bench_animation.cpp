@@ -0,0 +1,118 @@
+#include "benchmark.h"
+#include "bench_environment.h"
+
+#include "animation_system.h"
+
+#include <memory>
+#include <random>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_characterCount = 200;
+static const uint32_t k_jointCount = 60;
+static const uint32_t k_keyCount = 30;
+static const float k_keyInterval = 1.f / 30.f;
+
+// Characters with a chain of joints, each with translation, rotation and scale keys, standing on a 40 m field
+// around a viewer in the middle who looks down -z
+struct AnimatedCrowd
+{
+	std::vector< std::unique_ptr<GLTF::Node> > nodes;
+	std::vector< std::unique_ptr<GLTF::Animation> > animations;
+	SceneTransforms transforms;
+	AnimationSystem animationSystem;
+	XrView views[ 2 ];
+};
+
+static float4 RandomRotation( std::mt19937& random )
+{
+	std::normal_distribution<float> normal;
+	float4 q( normal( random ), normal( random ), normal( random ), normal( random ) );
+	return q / sqrtf( q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w );
+}
+
+static void MakeAnimatedCrowd( AnimatedCrowd* crowd )
+{
+	std::mt19937 random( 1234 );
+	std::uniform_real_distribution<float> unit( -1.f, 1.f );
+	crowd->animationSystem.Init( &crowd->transforms );
+	for ( uint32_t c = 0; c < k_characterCount; c++ )
+	{
+		std::unique_ptr<GLTF::Animation> animation = std::make_unique<GLTF::Animation>();
+		animation->Start = 0;
+		animation->End = ( k_keyCount - 1 ) * k_keyInterval;
+		GLTF::Node* parent = nullptr;
+		for ( uint32_t j = 0; j < k_jointCount; j++ )
+		{
+			std::unique_ptr<GLTF::Node> node = std::make_unique<GLTF::Node>();
+			node->Parent = parent;
+			for ( auto path : { GLTF::AnimationChannel::PATH_TYPE::TRANSLATION, GLTF::AnimationChannel::PATH_TYPE::ROTATION,
+				GLTF::AnimationChannel::PATH_TYPE::SCALE } )
+			{
+				GLTF::AnimationSampler sampler;
+				sampler.Interpolation = GLTF::AnimationSampler::INTERPOLATION_TYPE::LINEAR;
+				for ( uint32_t k = 0; k < k_keyCount; k++ )
+				{
+					sampler.Inputs.push_back( k * k_keyInterval );
+					if ( path == GLTF::AnimationChannel::PATH_TYPE::ROTATION )
+					{
+						sampler.OutputsVec4.push_back( RandomRotation( random ) );
+					}
+					else
+					{
+						sampler.OutputsVec4.push_back( float4( 1.f + unit( random ) * 0.1f, 1.f, 1.f, 0 ) );
+					}
+				}
+				GLTF::AnimationChannel channel;
+				channel.PathType = path;
+				channel.node = node.get();
+				channel.SamplerIndex = (uint32_t)animation->Samplers.size();
+				animation->Samplers.push_back( std::move( sampler ) );
+				animation->Channels.push_back( channel );
+			}
+
+			GLTF::Node* child = node.get();
+			if ( parent )
+			{
+				parent->Children.push_back( std::move( node ) );
+			}
+			else
+			{
+				crowd->transforms.AddHierarchy( child );
+				crowd->nodes.push_back( std::move( node ) );
+			}
+			parent = child;
+		}
+
+		uint32_t instance = crowd->animationSystem.AddInstance( animation.get() );
+		float3 position( unit( random ) * 20.f, 0, unit( random ) * 20.f );
+		crowd->animationSystem.SetBounds( instance, position + float3( 0, 0.9f, 0 ), 1.f );
+		crowd->animations.push_back( std::move( animation ) );
+	}
+
+	MakeStereoViews( crowd->views );
+}
+
+
+// range(0) is 0 to sample every character every frame, and 1 to give the system the viewer's eyes so it samples
+// distant and unseen characters less often
+static void RunAnimationUpdate( BenchmarkState& state, uint32_t workerCount )
+{
+	BenchmarkFixture<AnimatedCrowd> fixture( MakeAnimatedCrowd, workerCount );
+	AnimatedCrowd& crowd = fixture.scene;
+	if ( state.range( 0 ) )
+	{
+		crowd.animationSystem.SetViews( crowd.views );
+	}
+
+	int64_t channels = 0;
+	for ( auto _ : state )
+	{
+		crowd.animationSystem.Update( fixture.jobs, 1.0 / 90.0 );
+		crowd.transforms.Update( fixture.jobs );
+		channels += crowd.animationSystem.GetLastStats().sampledChannelCount;
+	}
+	state.SetItemsProcessed( channels );
+}
+XRDE_BENCHMARK_WITH_WORKERS( AnimationUpdate, RunAnimationUpdate, 0, 1 );
@@ -0,0 +1,158 @@
+#include "bench_environment.h"
+
+#include <iostream>
+
+#include <EngineFactoryD3D11.h>
+#include <GraphicsUtilities.h>
+
+#include "paths.h"
+
+namespace Diligent
+{
+#include <Shaders/Common/public/BasicStructures.fxh>
+};
+
+using namespace XRDE;
+using namespace Diligent;
+
+// A Direct3D 11 device on the WARP adapter. Nothing here talks to OpenXR, so it can't be used for a session.
+class SoftwareGraphicsBinding : public IGraphicsBinding
+{
+public:
+	virtual std::vector<std::string> GetXrExtensions() override { return {}; }
+
+	virtual XrResult CreateDevice( XrInstance instance, XrSystemId systemId ) override
+	{
+#if ENGINE_DLL
+		auto* GetEngineFactoryD3D11 = LoadGraphicsEngineD3D11();
+#endif
+		auto* pFactoryD3D11 = GetEngineFactoryD3D11();
+		m_pEngineFactory = pFactoryD3D11;
+
+		const Version minVersion{ 11, 0 };
+		Uint32 adapterCount = 0;
+		pFactoryD3D11->EnumerateAdapters( minVersion, adapterCount, nullptr );
+		std::vector<GraphicsAdapterInfo> adapters( adapterCount );
+		if ( adapterCount )
+		{
+			pFactoryD3D11->EnumerateAdapters( minVersion, adapterCount, adapters.data() );
+		}
+
+		EngineD3D11CreateInfo EngineCI;
+		EngineCI.AdapterId = DEFAULT_ADAPTER_ID;
+		for ( Uint32 i = 0; i < adapterCount; i++ )
+		{
+			if ( adapters[ i ].Type == ADAPTER_TYPE_SOFTWARE )
+			{
+				EngineCI.AdapterId = i;
+				break;
+			}
+		}
+		if ( EngineCI.AdapterId == DEFAULT_ADAPTER_ID )
+		{
+			std::cerr << "No software adapter found, benchmarking on the default adapter\n";
+		}
+
+		EngineCI.GraphicsAPIVersion = minVersion;
+		pFactoryD3D11->CreateDeviceAndContextsD3D11( EngineCI, &m_pDevice, &m_pImmediateContext );
+		return m_pDevice ? XR_SUCCESS : XR_ERROR_INITIALIZATION_FAILED;
+	}
+
+	virtual IEngineFactory* GetEngineFactory() override { return m_pEngineFactory; }
+	virtual IRenderDevice* GetRenderDevice() override { return m_pDevice; }
+	virtual IDeviceContext* GetImmediateContext() override { return m_pImmediateContext; }
+
+	virtual void SetDeferredContextCount( uint32_t count ) override {}
+	virtual uint32_t GetDeferredContextCount() override { return 0; }
+	virtual IDeviceContext* GetDeferredContext( uint32_t index ) override { return nullptr; }
+	virtual std::vector<int64_t> GetRequestedColorFormats() override { return {}; }
+	virtual std::vector<int64_t> GetRequestedDepthFormats() override { return {}; }
+	virtual void* GetSessionBinding() override { return nullptr; }
+	virtual std::vector< RefCntAutoPtr<ITexture> > ReadImagesFromSwapchain( XrSwapchain swapchain ) override { return {}; }
+
+private:
+	RefCntAutoPtr<IEngineFactory> m_pEngineFactory;
+	RefCntAutoPtr<IRenderDevice> m_pDevice;
+	RefCntAutoPtr<IDeviceContext> m_pImmediateContext;
+};
+
+
+bool BenchmarkXrApp::InitForBenchmark()
+{
+	auto binding = std::make_unique<SoftwareGraphicsBinding>();
+	if ( XR_FAILED( binding->CreateDevice( XR_NULL_HANDLE, XR_NULL_SYSTEM_ID ) ) )
+		return false;
+	m_pGraphicsBinding = std::move( binding );
+
+	// a typical headset's recommended size, which only feeds the viewport size in the camera constants
+	m_views[ 0 ].recommendedImageRectWidth = 2016;
+	m_views[ 0 ].recommendedImageRectHeight = 2240;
+
+	CreateUniformBuffer( m_pGraphicsBinding->GetRenderDevice(), sizeof( CameraAttribs ), "Camera attribs buffer", &m_CameraAttribsCB );
+	CreateUniformBuffer( m_pGraphicsBinding->GetRenderDevice(), sizeof( LightAttribs ), "Light attribs buffer", &m_LightAttribsCB );
+	return m_CameraAttribsCB && m_LightAttribsCB;
+}
+
+
+XrInstance XRDE::BenchmarkInstance()
+{
+	static XrInstance instance = XR_NULL_HANDLE;
+	static bool initialized = false;
+	if ( initialized )
+		return instance;
+	initialized = true;
+
+	XrInstanceCreateInfo createInfo = { XR_TYPE_INSTANCE_CREATE_INFO };
+	strcpy_s( createInfo.applicationInfo.applicationName, XR_MAX_APPLICATION_NAME_SIZE, "xrbase_bench" );
+	createInfo.applicationInfo.applicationVersion = 1;
+	strcpy_s( createInfo.applicationInfo.engineName, XR_MAX_ENGINE_NAME_SIZE, "xrbase" );
+	createInfo.applicationInfo.engineVersion = 1;
+	createInfo.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
+
+	XrResult res = xrCreateInstance( &createInfo, &instance );
+	if ( XR_FAILED( res ) )
+	{
+		std::cerr << "xrCreateInstance failed with " << res << ", skipping benchmarks that need a runtime\n";
+		instance = XR_NULL_HANDLE;
+		return instance;
+	}
+
+	if ( XR_FAILED( InitPaths( instance ) ) )
+	{
+		std::cerr << "Unable to create the standard paths, skipping benchmarks that need a runtime\n";
+		xrDestroyInstance( instance );
+		instance = XR_NULL_HANDLE;
+	}
+	return instance;
+}
+
+
+BenchmarkXrApp* XRDE::BenchmarkApp()
+{
+	static std::unique_ptr<BenchmarkXrApp> app;
+	static bool initialized = false;
+	if ( initialized )
+		return app.get();
+	initialized = true;
+
+	app = std::make_unique<BenchmarkXrApp>();
+	if ( !app->InitForBenchmark() )
+	{
+		std::cerr << "Unable to create a software device, skipping benchmarks that need a device\n";
+		app.reset();
+	}
+	return app.get();
+}
+
+
+void XRDE::MakeStereoViews( XrView views[ 2 ] )
+{
+	for ( int eye = 0; eye < 2; eye++ )
+	{
+		XrView& view = views[ eye ];
+		view = { XR_TYPE_VIEW };
+		view.pose.orientation = { 0, 0, 0, 1 };
+		view.pose.position = { eye == 0 ? -0.032f : 0.032f, 1.7f, 0 };
+		view.fov = eye == 0 ? XrFovf { -0.87f, 0.79f, 0.83f, -0.91f } : XrFovf { -0.79f, 0.87f, 0.83f, -0.91f };
+	}
+}
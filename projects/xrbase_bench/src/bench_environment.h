@@ -0,0 +1,60 @@
+#pragma once
+
+#include "xrappbase.h"
+
+namespace XRDE
+{
+
+// An app with no session, just enough device state to exercise XrAppBase's per-frame helpers
+class BenchmarkXrApp : public XrAppBase
+{
+public:
+	bool InitForBenchmark();
+
+	virtual void Render() override {}
+	virtual void Update( double currTime, double elapsedTime, XrTime displayTime ) override {}
+	virtual bool RenderEye( int eye ) override { return true; }
+
+	void RunUpdateGltfBuffers( float4x4 eyeToProj, float4x4 stageToEye, XrView& view )
+	{
+		UpdateGltfBuffers( eyeToProj, stageToEye, view, 0.01f, 10.f );
+	}
+};
+
+// Shared setup for benchmarks that need a runtime or a device. The OpenXR instance comes from whatever runtime
+// the loader finds, so point XR_RUNTIME_JSON at a stand-in runtime to get numbers that don't depend on the
+// headset software. The device is a Direct3D 11 device on the software (WARP) adapter.
+// Each getter returns null if its setup failed, and the benchmarks that need it skip with an error.
+XrInstance BenchmarkInstance();
+BenchmarkXrApp* BenchmarkApp();
+
+// Two eyes 64 mm apart at standing height in the middle of the stage, looking down -z with a typical headset's
+// field of view
+void MakeStereoViews( XrView views[ 2 ] );
+
+// The job system workers the Threaded variants of the CPU benchmarks run with, besides the calling thread
+static const uint32_t k_benchmarkWorkerCount = 3;
+
+// A synthetic scene built by make, and a job system to update it with
+template< typename Scene >
+struct BenchmarkFixture
+{
+	Scene scene;
+	JobSystem jobs;
+
+	BenchmarkFixture( void ( *make )( Scene* scene ), uint32_t workerCount )
+	{
+		make( &scene );
+		jobs.Init( workerCount );
+	}
+};
+
+}
+
+// Registers BM_<name> and BM_<name>Threaded, which call run( state, workerCount ) with no workers and with
+// k_benchmarkWorkerCount of them. Both get the same range(0) arguments.
+#define XRDE_BENCHMARK_WITH_WORKERS( name, run, ... ) \
+	static void BM_##name( XRDE::BenchmarkState& state ) { run( state, 0 ); } \
+	static void BM_##name##Threaded( XRDE::BenchmarkState& state ) { run( state, XRDE::k_benchmarkWorkerCount ); } \
+	static XRDE::BenchmarkRegistration s_benchmark_##name( "BM_" #name, BM_##name, { __VA_ARGS__ } ); \
+	static XRDE::BenchmarkRegistration s_benchmark_##name##Threaded( "BM_" #name "Threaded", BM_##name##Threaded, { __VA_ARGS__ } )
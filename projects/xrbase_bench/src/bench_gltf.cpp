@@ -0,0 +1,34 @@
+#include "benchmark.h"
+#include "bench_environment.h"
+
+#include "graphics_utilities.h"
+
+using namespace XRDE;
+using namespace Diligent;
+
+// Per eye camera and light constant updates, including the map/discard on the software device
+static void BM_UpdateGltfBuffers( BenchmarkState& state )
+{
+	BenchmarkXrApp* app = BenchmarkApp();
+	if ( !app )
+	{
+		state.SkipWithError( "no software device" );
+		return;
+	}
+
+	XrView view = { XR_TYPE_VIEW };
+	view.fov = { -0.87f, 0.79f, 0.83f, -0.91f };
+	view.pose = IdentityXrPose();
+	view.pose.position = { 0.03f, 1.6f, 0.f };
+
+	float4x4 eyeToProj;
+	float4x4_CreateProjection( &eyeToProj, RENDER_DEVICE_TYPE_D3D11, view.fov, 0.01f, 10.f );
+	float4x4 stageToEye = matrixFromPose( view.pose ).Inverse();
+
+	for ( auto _ : state )
+	{
+		app->RunUpdateGltfBuffers( eyeToProj, stageToEye, view );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() );
+}
+XRDE_BENCHMARK( BM_UpdateGltfBuffers );
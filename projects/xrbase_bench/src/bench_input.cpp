@@ -0,0 +1,133 @@
+#include "benchmark.h"
+#include "bench_environment.h"
+
+#include "actions.h"
+#include "paths.h"
+
+#include <iterator>
+#include <memory>
+
+using namespace XRDE;
+
+// Builds range(0) boolean actions, each bound on both hands for every interaction profile the standard paths
+// know about. The actions are never created in the runtime so only the binding bookkeeping is measured.
+static std::unique_ptr<ActionSet> MakeActionSet( uint32_t actionCount, XrPath* profile )
+{
+	const StandardPaths& paths = Paths();
+	const XrPath profiles[] =
+	{
+		paths.interactionProfilesKHRSimpleController,
+		paths.interactionProfilesHTCViveController,
+		paths.interactionProfilesOculusTouchController,
+		paths.interactionProfilesValveIndexController,
+		paths.interactionProfilesMicrosoftMotionController,
+	};
+
+	auto actionSet = std::make_unique<ActionSet>( "bench", "Benchmark", 0 );
+	for ( uint32_t i = 0; i < actionCount; i++ )
+	{
+		std::string name = "action_" + std::to_string( i );
+		Action* action = actionSet->AddAction( name, name, XR_ACTION_TYPE_BOOLEAN_INPUT,
+			{ paths.userHandLeft, paths.userHandRight } );
+		for ( XrPath ip : profiles )
+		{
+			action->AddIPBinding( ip, paths.leftTriggerClick );
+			action->AddIPBinding( ip, paths.rightTriggerClick );
+		}
+		if ( i % 4 == 0 )
+		{
+			action->AddGlobalBinding( paths.leftSelectClick );
+		}
+	}
+
+	*profile = paths.interactionProfilesValveIndexController;
+	return actionSet;
+}
+
+
+static void BM_CollectBindings( BenchmarkState& state )
+{
+	if ( !BenchmarkInstance() )
+	{
+		state.SkipWithError( "no OpenXR runtime" );
+		return;
+	}
+
+	XrPath profile;
+	std::unique_ptr<ActionSet> actionSet = MakeActionSet( (uint32_t)state.range( 0 ), &profile );
+	for ( auto _ : state )
+	{
+		size_t bindingCount = 0;
+		for ( const auto& action : *actionSet )
+		{
+			std::vector<XrActionSuggestedBinding> bindings = action->CollectBindings( profile );
+			bindingCount += bindings.size();
+		}
+		DoNotOptimize( bindingCount );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() * state.range( 0 ) );
+}
+XRDE_BENCHMARK( BM_CollectBindings, 16, 256, 1024 );
+
+
+// The runtime rejects suggestions for actions that were never created, so this creates them for real and
+// times the whole call including the runtime's validation
+static void BM_SuggestBindings( BenchmarkState& state )
+{
+	XrInstance instance = BenchmarkInstance();
+	if ( !instance )
+	{
+		state.SkipWithError( "no OpenXR runtime" );
+		return;
+	}
+
+	XrPath profile;
+	std::unique_ptr<ActionSet> actionSet = MakeActionSet( (uint32_t)state.range( 0 ), &profile );
+	if ( XR_FAILED( actionSet->Init( instance ) ) )
+	{
+		if ( actionSet->Handle() )
+		{
+			xrDestroyActionSet( actionSet->Handle() );
+		}
+		state.SkipWithError( "unable to create the actions" );
+		return;
+	}
+
+	for ( auto _ : state )
+	{
+		XrResult res = SuggestBindings( instance, profile, { actionSet.get() } );
+		DoNotOptimize( res );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() * state.range( 0 ) );
+	xrDestroyActionSet( actionSet->Handle() );
+}
+XRDE_BENCHMARK( BM_SuggestBindings, 16, 256 );
+
+
+static void BM_PathToString( BenchmarkState& state )
+{
+	XrInstance instance = BenchmarkInstance();
+	if ( !instance )
+	{
+		state.SkipWithError( "no OpenXR runtime" );
+		return;
+	}
+
+	const StandardPaths& paths = Paths();
+	const XrPath samples[] =
+	{
+		paths.userHandLeft,
+		paths.leftTriggerValue,
+		paths.interactionProfilesValveIndexController,
+		paths.gamepadThumbstickRightClick,
+	};
+
+	uint32_t index = 0;
+	for ( auto _ : state )
+	{
+		std::string s = PathToString( instance, samples[ index++ % std::size( samples ) ] );
+		DoNotOptimize( s );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() );
+}
+XRDE_BENCHMARK( BM_PathToString );
@@ -0,0 +1,106 @@
+#include "benchmark.h"
+
+#include <openxr/openxr.h>
+#include <BasicMath.hpp>
+#include <GraphicsTypes.h>
+
+#include "graphics_utilities.h"
+#include "hand_joints.h"
+
+#include <cmath>
+#include <random>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_poseCount = 1024;
+
+// Random but valid poses, so the benchmarks don't all hit the same cache lines or constant-fold
+static std::vector<XrPosef> MakePoses( uint32_t count )
+{
+	std::mt19937 random( 1234 );
+	std::uniform_real_distribution<float> unit( -1.f, 1.f );
+
+	std::vector<XrPosef> poses( count );
+	for ( XrPosef& pose : poses )
+	{
+		float x = unit( random ), y = unit( random ), z = unit( random ), w = unit( random );
+		float length = sqrtf( x * x + y * y + z * z + w * w );
+		if ( length < 1e-3f )
+		{
+			x = y = z = 0;
+			w = length = 1.f;
+		}
+		pose.orientation = { x / length, y / length, z / length, w / length };
+		pose.position = { unit( random ), unit( random ), unit( random ) };
+	}
+	return poses;
+}
+
+
+static void BM_MatrixFromPose( BenchmarkState& state )
+{
+	std::vector<XrPosef> poses = MakePoses( k_poseCount );
+	uint32_t index = 0;
+	for ( auto _ : state )
+	{
+		float4x4 m = matrixFromPose( poses[ index++ % k_poseCount ] );
+		DoNotOptimize( m );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() );
+}
+XRDE_BENCHMARK( BM_MatrixFromPose );
+
+
+static void BM_QuaternionFromXrQuaternion( BenchmarkState& state )
+{
+	std::vector<XrPosef> poses = MakePoses( k_poseCount );
+	uint32_t index = 0;
+	for ( auto _ : state )
+	{
+		Quaternion q = quaternionFromXrQuaternion( poses[ index++ % k_poseCount ].orientation );
+		DoNotOptimize( q );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() );
+}
+XRDE_BENCHMARK( BM_QuaternionFromXrQuaternion );
+
+
+// range(0) is the device type, which changes the clip space conventions
+static void BM_CreateProjection( BenchmarkState& state )
+{
+	RENDER_DEVICE_TYPE deviceType = (RENDER_DEVICE_TYPE)state.range( 0 );
+	XrFovf fov = { -0.87f, 0.79f, 0.83f, -0.91f };
+	for ( auto _ : state )
+	{
+		float4x4 eyeToProj;
+		float4x4_CreateProjection( &eyeToProj, deviceType, fov, 0.01f, 10.f );
+		DoNotOptimize( eyeToProj );
+		fov.angleLeft += 1e-6f;
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() );
+}
+XRDE_BENCHMARK( BM_CreateProjection, RENDER_DEVICE_TYPE_D3D11, RENDER_DEVICE_TYPE_VULKAN, RENDER_DEVICE_TYPE_GL );
+
+
+// The per hand, per frame joint hierarchy work from locating hand joints
+static void BM_JointsToParent( BenchmarkState& state )
+{
+	std::vector<XrPosef> poses = MakePoses( XR_HAND_JOINT_COUNT_EXT );
+	XrHandJointLocationEXT locations[ XR_HAND_JOINT_COUNT_EXT ];
+	for ( uint32_t i = 0; i < XR_HAND_JOINT_COUNT_EXT; i++ )
+	{
+		locations[ i ].locationFlags = XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT;
+		locations[ i ].pose = poses[ i ];
+		locations[ i ].radius = 0.01f;
+	}
+
+	float4x4 jointsToParent[ XR_HAND_JOINT_COUNT_EXT ];
+	for ( auto _ : state )
+	{
+		JointsToParentFromLocations( locations, jointsToParent );
+		DoNotOptimize( jointsToParent );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() * XR_HAND_JOINT_COUNT_EXT );
+}
+XRDE_BENCHMARK( BM_JointsToParent );
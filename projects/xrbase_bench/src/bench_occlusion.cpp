@@ -0,0 +1,111 @@
+#include "benchmark.h"
+#include "bench_environment.h"
+
+#include "occlusion_culler.h"
+
+#include <random>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_blocksPerSide = 12;
+static const float k_blockSize = 24.f;
+static const float k_streetWidth = 10.f;
+static const uint32_t k_propCount = 4096;
+
+// A grid of city blocks with a tall building on each, seen from the middle of a street at eye height, and
+// small props scattered over the whole area. Most props are behind a building.
+struct CityBlock
+{
+	OcclusionCuller culler;
+	XrView views[ 2 ];
+	std::vector<float3> propMin;
+	std::vector<float3> propMax;
+};
+
+static void MakeCityBlock( CityBlock* city )
+{
+	static const float3 k_cubePositions[ 8 ] =
+	{
+		{ -0.5f, 0, -0.5f }, { 0.5f, 0, -0.5f }, { -0.5f, 1, -0.5f }, { 0.5f, 1, -0.5f },
+		{ -0.5f, 0, 0.5f }, { 0.5f, 0, 0.5f }, { -0.5f, 1, 0.5f }, { 0.5f, 1, 0.5f },
+	};
+	static const uint32_t k_cubeIndices[ 36 ] =
+	{
+		0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 4, 2, 2, 4, 6,
+		1, 3, 5, 3, 7, 5,  2, 6, 3, 3, 6, 7,  0, 1, 4, 1, 5, 4,
+	};
+
+	std::mt19937 random( 1234 );
+	std::uniform_real_distribution<float> unit( 0.f, 1.f );
+
+	city->culler.Init();
+	uint32_t building = city->culler.AddOccluderMesh( k_cubePositions, 8, k_cubeIndices, 36 );
+
+	// the viewer stands at the crossing in the middle, looking down a street
+	float origin = -0.5f * k_blocksPerSide * k_blockSize;
+	for ( uint32_t x = 0; x < k_blocksPerSide; x++ )
+	{
+		for ( uint32_t z = 0; z < k_blocksPerSide; z++ )
+		{
+			float size = k_blockSize - k_streetWidth;
+			float height = 8.f + unit( random ) * 40.f;
+			float3 center( origin + ( x + 0.5f ) * k_blockSize, 0, origin + ( z + 0.5f ) * k_blockSize );
+			city->culler.SubmitOccluder( building,
+				float4x4::Scale( size, height, size ) * float4x4::Translation( center.x, center.y, center.z ) );
+		}
+	}
+
+	city->propMin.resize( k_propCount );
+	city->propMax.resize( k_propCount );
+	for ( uint32_t i = 0; i < k_propCount; i++ )
+	{
+		float3 position( origin + unit( random ) * k_blocksPerSide * k_blockSize, 0,
+			origin + unit( random ) * k_blocksPerSide * k_blockSize );
+		float size = 0.5f + unit( random ) * 1.5f;
+		city->propMin[ i ] = position - float3( size, 0, size ) * 0.5f;
+		city->propMax[ i ] = position + float3( size, size * 2.f, size ) * 0.5f;
+	}
+
+	MakeStereoViews( city->views );
+}
+
+
+static void RunOcclusionRasterize( BenchmarkState& state, uint32_t workerCount )
+{
+	BenchmarkFixture<CityBlock> fixture( MakeCityBlock, workerCount );
+	CityBlock& city = fixture.scene;
+	for ( auto _ : state )
+	{
+		JobCounter counter;
+		city.culler.SetViews( city.views, 0.01f, 500.f );
+		city.culler.Rasterize( fixture.jobs, counter );
+		fixture.jobs.Wait( counter );
+		DoNotOptimize( city.culler.GetDepthBuffer()[ 0 ] );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() * city.culler.GetLastStats().triangleCount );
+}
+XRDE_BENCHMARK_WITH_WORKERS( OcclusionRasterize, RunOcclusionRasterize );
+
+
+static void BM_OcclusionTestBoxes( BenchmarkState& state )
+{
+	BenchmarkFixture<CityBlock> fixture( MakeCityBlock, 0 );
+	CityBlock& city = fixture.scene;
+	JobCounter counter;
+	city.culler.SetViews( city.views, 0.01f, 500.f );
+	city.culler.Rasterize( fixture.jobs, counter );
+	fixture.jobs.Wait( counter );
+
+	for ( auto _ : state )
+	{
+		uint32_t visible = 0;
+		for ( uint32_t i = 0; i < k_propCount; i++ )
+		{
+			visible += city.culler.IsBoxVisible( city.propMin[ i ], city.propMax[ i ] ) ? 1 : 0;
+		}
+		DoNotOptimize( visible );
+	}
+	state.SetItemsProcessed( (int64_t)state.iterations() * k_propCount );
+}
+XRDE_BENCHMARK( BM_OcclusionTestBoxes );
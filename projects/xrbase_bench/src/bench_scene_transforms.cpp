@@ -0,0 +1,76 @@
+#include "benchmark.h"
+#include "bench_environment.h"
+
+#include "scene_transforms.h"
+
+#include <memory>
+#include <random>
+
+using namespace XRDE;
+using namespace Diligent;
+
+static const uint32_t k_rootCount = 800;
+static const uint32_t k_branching = 3;
+static const uint32_t k_depth = 5;
+
+// 800 trees of five levels with three children per node, about 97k nodes, most of them in the deepest level
+struct NodeForest
+{
+	std::vector< std::unique_ptr<GLTF::Node> > roots;
+	std::vector<GLTF::Node*> nodes;
+	SceneTransforms transforms;
+};
+
+static void AddChildren( NodeForest* forest, GLTF::Node* parent, uint32_t depth, std::mt19937& random )
+{
+	std::uniform_real_distribution<float> unit( -1.f, 1.f );
+	for ( uint32_t c = 0; c < k_branching && depth + 1 < k_depth; c++ )
+	{
+		std::unique_ptr<GLTF::Node> child = std::make_unique<GLTF::Node>();
+		child->Parent = parent;
+		child->Translation = float3( unit( random ), unit( random ), unit( random ) );
+		child->Rotation = Quaternion::RotationFromAxisAngle( float3( 0, 1, 0 ), unit( random ) );
+		forest->nodes.push_back( child.get() );
+		AddChildren( forest, child.get(), depth + 1, random );
+		parent->Children.push_back( std::move( child ) );
+	}
+}
+
+static void MakeNodeForest( NodeForest* forest )
+{
+	std::mt19937 random( 1234 );
+	for ( uint32_t r = 0; r < k_rootCount; r++ )
+	{
+		forest->roots.push_back( std::make_unique<GLTF::Node>() );
+		forest->nodes.push_back( forest->roots.back().get() );
+		AddChildren( forest, forest->roots.back().get(), 0, random );
+		forest->transforms.AddHierarchy( forest->roots.back().get() );
+	}
+}
+
+
+// range(0) is the percentage of nodes that move each frame
+static void RunSceneTransformsUpdate( BenchmarkState& state, uint32_t workerCount )
+{
+	BenchmarkFixture<NodeForest> fixture( MakeNodeForest, workerCount );
+	NodeForest& forest = fixture.scene;
+	forest.transforms.Update( fixture.jobs );
+
+	std::mt19937 random( 5678 );
+	std::uniform_int_distribution<uint32_t> pick( 0, (uint32_t)forest.nodes.size() - 1 );
+	uint32_t moving = (uint32_t)forest.nodes.size() * (uint32_t)state.range( 0 ) / 100;
+	int64_t updated = 0;
+	for ( auto _ : state )
+	{
+		for ( uint32_t m = 0; m < moving; m++ )
+		{
+			GLTF::Node* node = forest.nodes[ pick( random ) ];
+			node->Translation.y += 0.001f;
+			forest.transforms.MarkDirty( node );
+		}
+		forest.transforms.Update( fixture.jobs );
+		updated += forest.transforms.GetLastStats().updatedNodeCount;
+	}
+	state.SetItemsProcessed( updated );
+}
+XRDE_BENCHMARK_WITH_WORKERS( SceneTransformsUpdate, RunSceneTransformsUpdate, 0, 3, 100 );
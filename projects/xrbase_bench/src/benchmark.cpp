@@ -0,0 +1,376 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <Windows.h>
+#endif
+
+using namespace XRDE;
+
+std::atomic<const volatile void*> XRDE::g_benchmarkSink;
+
+static double RealSeconds()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static double ThreadCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if ( !GetThreadTimes( GetCurrentThread(), &creation, &exit, &kernel, &user ) )
+		return 0;
+
+	auto toSeconds = []( const FILETIME& time )
+	{
+		return (double)( ( (uint64_t)time.dwHighDateTime << 32 ) | time.dwLowDateTime ) * 1e-7;
+	};
+	return toSeconds( kernel ) + toSeconds( user );
+#else
+	timespec ts;
+	clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+
+void BenchmarkState::Start()
+{
+	m_remaining = m_iterations;
+	m_started = true;
+	m_paused = false;
+	m_realSeconds = 0;
+	m_cpuSeconds = 0;
+	m_realStart = RealSeconds();
+	m_cpuStart = ThreadCpuSeconds();
+}
+
+
+bool BenchmarkState::KeepRunning()
+{
+	if ( m_remaining > 0 )
+	{
+		m_remaining--;
+		return true;
+	}
+
+	if ( m_started )
+	{
+		if ( !m_paused )
+		{
+			m_realSeconds += RealSeconds() - m_realStart;
+			m_cpuSeconds += ThreadCpuSeconds() - m_cpuStart;
+		}
+		m_started = false;
+	}
+	return false;
+}
+
+
+void BenchmarkState::PauseTiming()
+{
+	if ( m_paused )
+		return;
+
+	m_realSeconds += RealSeconds() - m_realStart;
+	m_cpuSeconds += ThreadCpuSeconds() - m_cpuStart;
+	m_paused = true;
+}
+
+
+void BenchmarkState::ResumeTiming()
+{
+	if ( !m_paused )
+		return;
+
+	m_realStart = RealSeconds();
+	m_cpuStart = ThreadCpuSeconds();
+	m_paused = false;
+}
+
+
+namespace XRDE
+{
+
+struct BenchmarkEntry
+{
+	std::string name;
+	BenchmarkFunction function;
+	int64_t arg;
+};
+
+static std::vector<BenchmarkEntry>& Registry()
+{
+	static std::vector<BenchmarkEntry> registry;
+	return registry;
+}
+
+BenchmarkRegistration::BenchmarkRegistration( const char* name, BenchmarkFunction function, const std::vector<int64_t>& args )
+{
+	if ( args.empty() )
+	{
+		Registry().push_back( { name, function, 0 } );
+		return;
+	}
+
+	for ( int64_t arg : args )
+	{
+		Registry().push_back( { std::string( name ) + "/" + std::to_string( arg ), function, arg } );
+	}
+}
+
+struct BenchmarkRun
+{
+	std::string name;
+	uint64_t iterations;
+	double realNs;	// per iteration
+	double cpuNs;
+	double itemsPerSecond;
+	std::string error;
+};
+
+struct BenchmarkRunner
+{
+	double minTime = 0.5;
+	int repetitions = 3;
+	std::string filter;
+	std::string outPath;
+
+	static BenchmarkState Run( const BenchmarkEntry& entry, uint64_t iterations )
+	{
+		BenchmarkState state( iterations, entry.arg );
+		entry.function( state );
+		return state;
+	}
+
+	// Grows the iteration count until one run takes at least minTime, the same way Google Benchmark does
+	bool Measure( const BenchmarkEntry& entry, BenchmarkRun* run )
+	{
+		uint64_t iterations = 1;
+		while ( true )
+		{
+			BenchmarkState state = Run( entry, iterations );
+			if ( !state.m_error.empty() )
+			{
+				run->name = entry.name;
+				run->iterations = 0;
+				run->realNs = run->cpuNs = run->itemsPerSecond = 0;
+				run->error = state.m_error;
+				return false;
+			}
+
+			if ( state.m_realSeconds >= minTime || iterations >= 1000000000ull )
+			{
+				run->name = entry.name;
+				run->iterations = iterations;
+				run->realNs = state.m_realSeconds * 1e9 / (double)iterations;
+				run->cpuNs = state.m_cpuSeconds * 1e9 / (double)iterations;
+				run->itemsPerSecond = state.m_itemsProcessed && state.m_realSeconds > 0
+					? (double)state.m_itemsProcessed / state.m_realSeconds : 0;
+				return true;
+			}
+
+			double multiplier = state.m_realSeconds > 0 ? minTime * 1.4 / state.m_realSeconds : 10.0;
+			multiplier = std::min( 10.0, std::max( 2.0, multiplier ) );
+			iterations = (uint64_t)( (double)iterations * multiplier );
+		}
+	}
+
+	static std::string Escape( const std::string& in )
+	{
+		std::string out;
+		for ( char c : in )
+		{
+			if ( c == '"' || c == '\\' )
+				out.push_back( '\\' );
+			out.push_back( c );
+		}
+		return out;
+	}
+
+	static void WriteRun( std::ostream& out, const BenchmarkRun& run, const char* runType, const char* aggregate, bool last )
+	{
+		out << "    {\n";
+		out << "      \"name\": \"" << Escape( run.name ) << ( aggregate ? std::string( "_" ) + aggregate : "" ) << "\",\n";
+		out << "      \"run_name\": \"" << Escape( run.name ) << "\",\n";
+		out << "      \"run_type\": \"" << runType << "\",\n";
+		if ( aggregate )
+		{
+			out << "      \"aggregate_name\": \"" << aggregate << "\",\n";
+		}
+		if ( !run.error.empty() )
+		{
+			out << "      \"error_occurred\": true,\n";
+			out << "      \"error_message\": \"" << Escape( run.error ) << "\",\n";
+		}
+		out << "      \"iterations\": " << run.iterations << ",\n";
+		out << "      \"real_time\": " << run.realNs << ",\n";
+		out << "      \"cpu_time\": " << run.cpuNs << ",\n";
+		if ( run.itemsPerSecond > 0 )
+		{
+			out << "      \"items_per_second\": " << run.itemsPerSecond << ",\n";
+		}
+		out << "      \"time_unit\": \"ns\"\n";
+		out << "    }" << ( last ? "\n" : ",\n" );
+	}
+
+	bool WriteJson( const std::vector<BenchmarkRun>& runs, const std::vector<BenchmarkRun>& medians, const char* executable )
+	{
+		std::ofstream out( outPath );
+		if ( !out )
+		{
+			std::cerr << "Unable to write benchmark results to " << outPath << "\n";
+			return false;
+		}
+
+		char date[ 64 ];
+		time_t now = time( nullptr );
+		strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", localtime( &now ) );
+
+		out.precision( 6 );
+		out << std::fixed;
+		out << "{\n";
+		out << "  \"context\": {\n";
+		out << "    \"date\": \"" << date << "\",\n";
+		out << "    \"executable\": \"" << Escape( executable ) << "\",\n";
+		out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+		out << "    \"library_build_type\": \"release\"\n";
+#else
+		out << "    \"library_build_type\": \"debug\"\n";
+#endif
+		out << "  },\n";
+		out << "  \"benchmarks\": [\n";
+		for ( size_t i = 0; i < runs.size(); i++ )
+		{
+			WriteRun( out, runs[ i ], "iteration", nullptr, false );
+		}
+		for ( size_t i = 0; i < medians.size(); i++ )
+		{
+			WriteRun( out, medians[ i ], "aggregate", "median", i + 1 == medians.size() );
+		}
+		out << "  ]\n";
+		out << "}\n";
+		return true;
+	}
+
+	int RunAll( const char* executable )
+	{
+		std::vector<BenchmarkRun> runs;
+		std::vector<BenchmarkRun> medians;
+
+		printf( "%-48s %14s %14s %12s\n", "Benchmark", "Time", "CPU", "Iterations" );
+		printf( "%s\n", std::string( 91, '-' ).c_str() );
+		for ( const BenchmarkEntry& entry : Registry() )
+		{
+			if ( !filter.empty() && entry.name.find( filter ) == std::string::npos )
+				continue;
+
+			std::vector<BenchmarkRun> repeats;
+			for ( int i = 0; i < repetitions; i++ )
+			{
+				BenchmarkRun run;
+				bool ok = Measure( entry, &run );
+				runs.push_back( run );
+				if ( !ok )
+				{
+					printf( "%-48s ERROR: %s\n", entry.name.c_str(), run.error.c_str() );
+					repeats.clear();
+					break;
+				}
+
+				printf( "%-48s %11.1f ns %11.1f ns %12llu\n", entry.name.c_str(), run.realNs, run.cpuNs,
+					(unsigned long long)run.iterations );
+				repeats.push_back( run );
+			}
+
+			if ( repeats.empty() )
+				continue;
+
+			auto middle = []( std::vector<BenchmarkRun> sorted, double BenchmarkRun::*field )
+			{
+				std::sort( sorted.begin(), sorted.end(), [ & ]( const BenchmarkRun& a, const BenchmarkRun& b ) { return a.*field < b.*field; } );
+				return sorted[ sorted.size() / 2 ].*field;
+			};
+
+			BenchmarkRun median = repeats[ 0 ];
+			median.realNs = middle( repeats, &BenchmarkRun::realNs );
+			median.cpuNs = middle( repeats, &BenchmarkRun::cpuNs );
+			median.itemsPerSecond = middle( repeats, &BenchmarkRun::itemsPerSecond );
+			medians.push_back( median );
+		}
+
+		if ( !outPath.empty() && !WriteJson( runs, medians, executable ) )
+			return 1;
+
+		return 0;
+	}
+};
+
+}
+
+
+static bool ParseFlag( const char* arg, const char* flag, std::string* value )
+{
+	size_t length = strlen( flag );
+	if ( strncmp( arg, flag, length ) != 0 || arg[ length ] != '=' )
+		return false;
+
+	*value = arg + length + 1;
+	return true;
+}
+
+
+int XRDE::RunBenchmarks( int argc, char** argv )
+{
+	BenchmarkRunner runner;
+	for ( int i = 1; i < argc; i++ )
+	{
+		std::string value;
+		if ( ParseFlag( argv[ i ], "--benchmark_filter", &value ) )
+		{
+			runner.filter = value;
+		}
+		else if ( ParseFlag( argv[ i ], "--benchmark_out", &value ) )
+		{
+			runner.outPath = value;
+		}
+		else if ( ParseFlag( argv[ i ], "--benchmark_repetitions", &value ) )
+		{
+			runner.repetitions = std::max( 1, atoi( value.c_str() ) );
+		}
+		else if ( ParseFlag( argv[ i ], "--benchmark_min_time", &value ) )
+		{
+			runner.minTime = atof( value.c_str() );
+		}
+		else if ( strcmp( argv[ i ], "--benchmark_list_tests" ) == 0 )
+		{
+			for ( const BenchmarkEntry& entry : Registry() )
+			{
+				printf( "%s\n", entry.name.c_str() );
+			}
+			return 0;
+		}
+		else if ( strcmp( argv[ i ], "--benchmark_out_format=json" ) != 0 )
+		{
+			std::cerr << "Unknown argument " << argv[ i ] << "\n";
+			std::cerr << "Usage: " << argv[ 0 ] << " [--benchmark_filter=<substring>] [--benchmark_out=<file.json>] "
+				"[--benchmark_repetitions=<n>] [--benchmark_min_time=<seconds>] [--benchmark_list_tests]\n";
+			return 1;
+		}
+	}
+
+	return runner.RunAll( argv[ 0 ] );
+}
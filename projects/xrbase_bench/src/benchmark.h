@@ -0,0 +1,91 @@
+#pragma once
+
+// A small microbenchmark harness with the same shape as Google Benchmark: benchmarks take a state object and
+// loop with "for ( auto _ : state )", the command line flags have the same names, and --benchmark_out writes
+// the same JSON format so the usual comparison tooling works on it.
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace XRDE
+{
+
+class BenchmarkState
+{
+public:
+	BenchmarkState( uint64_t iterations, int64_t arg ) : m_iterations( iterations ), m_arg( arg ) {}
+
+	int64_t range( int index = 0 ) const { return index == 0 ? m_arg : 0; }
+	uint64_t iterations() const { return m_iterations; }
+
+	// Work done in the loop that shouldn't be timed, like resetting inputs
+	void PauseTiming();
+	void ResumeTiming();
+
+	void SetItemsProcessed( int64_t items ) { m_itemsProcessed = items; }
+	void SkipWithError( const char* error ) { m_error = error; m_remaining = 0; }
+
+	// Has a destructor so "auto _" doesn't trip unused variable warnings
+	struct Value
+	{
+		~Value() {}
+	};
+
+	struct Iterator
+	{
+		BenchmarkState* state;
+		bool operator!=( const Iterator& ) const { return state->KeepRunning(); }
+		void operator++() {}
+		Value operator*() const { return Value(); }
+	};
+	Iterator begin() { Start(); return { this }; }
+	Iterator end() { return { this }; }
+
+private:
+	friend struct BenchmarkRunner;
+
+	void Start();
+	bool KeepRunning();
+
+	double m_realSeconds = 0;
+	double m_cpuSeconds = 0;
+	int64_t m_itemsProcessed = 0;
+	std::string m_error;
+
+	uint64_t m_iterations;
+	uint64_t m_remaining = 0;
+	int64_t m_arg;
+	bool m_started = false;
+	bool m_paused = false;
+	double m_realStart = 0;
+	double m_cpuStart = 0;
+};
+
+typedef void ( *BenchmarkFunction )( BenchmarkState& state );
+
+struct BenchmarkRegistration
+{
+	BenchmarkRegistration( const char* name, BenchmarkFunction function, const std::vector<int64_t>& args = {} );
+};
+
+int RunBenchmarks( int argc, char** argv );
+
+extern std::atomic<const volatile void*> g_benchmarkSink;
+
+// Keeps the compiler from optimizing away a result that is otherwise unused
+template< typename T >
+inline void DoNotOptimize( const T& value )
+{
+	g_benchmarkSink.store( &value, std::memory_order_relaxed );
+	std::atomic_signal_fence( std::memory_order_seq_cst );
+}
+
+}
+
+#define XRDE_BENCHMARK_CONCAT2( a, b ) a ## b
+#define XRDE_BENCHMARK_CONCAT( a, b ) XRDE_BENCHMARK_CONCAT2( a, b )
+
+#define XRDE_BENCHMARK( function, ... ) \
+	static XRDE::BenchmarkRegistration XRDE_BENCHMARK_CONCAT( s_benchmark_, __LINE__ )( #function, function, { __VA_ARGS__ } )